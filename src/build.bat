@@ -28,4 +28,5 @@ cl samples\game\game.cpp samples\game\mainloop.cpp ..\build\unity.obj /Fo..\buil
 cl tools\editor\*.cpp thirdparty\imgui\*.cpp ..\build\unity.obj /Fo..\build\ -W4 /nologo /DVK_USE_PLATFORM_WIN32_KHR /D_CRT_SECURE_NO_WARNINGS %SIMD% /Iinclude /Isamples/game/include /Ivideo /Icore /Ithirdparty/imgui/ /std:c++17 /FC /diagnostics:column /link /INCREMENTAL:NO /LIBPATH:%VULKAN_SDK%\Lib Comdlg32.lib Ole32.lib vulkan-1.lib /OUT:..\build\editor.exe
 mt -manifest tools\editor\editor.manifest -outputresource:..\build\editor.exe;1
 cl tools\convert_obj\convert_obj.cpp thirdparty\meshoptimizer\*.cpp ..\build\unity.obj -Zi -W4 /nologo /DVK_USE_PLATFORM_WIN32_KHR /D_CRT_SECURE_NO_WARNINGS %SIMD% /Iinclude /Ivideo /Icore /Ithirdparty/meshoptimizer /std:c++17 /Fo..\build\ /FC /diagnostics:column /link /INCREMENTAL:NO /LIBPATH:%VULKAN_SDK%\Lib Ole32.lib user32.lib vulkan-1.lib /OUT:..\build\convert_obj.exe
+cl tools\convert_scene\convert_scene.cpp -Zi -W4 /nologo /D_CRT_SECURE_NO_WARNINGS /Icore /std:c++17 /Fo..\build\ /FC /diagnostics:column /link /INCREMENTAL:NO /OUT:..\build\convert_scene.exe
 
@@ -1,18 +1,21 @@
 #include <stdint.h>
 #include "audio.h"
 #include "file.h"
+#include "profiler.h"
 #include "te_stdlib.h"
 
 void LoadAudioWAV( const char* path, unsigned clipIndex );
 void PlayAudioClip( unsigned clipIndex );
+void AudioBackendInitStorage( unsigned maxAudioClips );
+void EngineEnsureInitialized();
 
 struct AudioClip
 {
     unsigned internalIndex = 0; // index to audio_wasapi.cpp, audio_mac.cpp or audio_alsa.cpp struct
 };
 
-static constexpr unsigned MaxAudioClips = 1000;
-static struct AudioClip gAudioClips[ MaxAudioClips ];
+static struct AudioClip* gAudioClips = nullptr;
+static unsigned gAudioClipCapacity = 0;
 static unsigned gAudioClipIndex = 0;
 
 struct AudioSource
@@ -22,10 +25,21 @@ struct AudioSource
 
 static constexpr unsigned MaxAudioSources = 1000;
 static struct AudioSource gAudioSources[ MaxAudioSources ];
+TE_TRACK_STATIC_MEMORY( audioMemory, teMemoryTag::Audio, sizeof( gAudioSources ) );
+
+void AudioInitStorage( unsigned maxAudioClips )
+{
+    gAudioClips = teMallocArray< AudioClip >( maxAudioClips, teMemoryTag::Audio );
+    gAudioClipCapacity = maxAudioClips;
+    AudioBackendInitStorage( maxAudioClips );
+}
 
 teAudioClip teLoadAudioClip( const struct teFile& wavFile )
 {
-    teAssert( gAudioClipIndex + 1 < MaxAudioClips );
+    TE_PROFILE_SCOPE( "teLoadAudioClip" );
+
+    EngineEnsureInitialized();
+    teAssert( gAudioClipIndex + 1 < gAudioClipCapacity );
 
     teAudioClip outClip;
     outClip.index = ++gAudioClipIndex;
@@ -36,6 +50,8 @@ teAudioClip teLoadAudioClip( const struct teFile& wavFile )
 
 void tePlayAudioClip( teAudioClip clip )
 {
+    TE_PROFILE_SCOPE( "tePlayAudioClip" );
+
     PlayAudioClip( clip.index );
 }
 
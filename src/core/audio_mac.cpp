@@ -49,7 +49,12 @@ struct AudioClipInternal
     int16_t* data = nullptr;
 };
 
-AudioClipInternal audioClipInternals[ 1000 ]; // Indexed by audio_common.cpp audioClipIndex
+AudioClipInternal* audioClipInternals = nullptr; // Indexed by audio_common.cpp audioClipIndex
+
+void AudioBackendInitStorage( unsigned maxAudioClips )
+{
+    audioClipInternals = teMallocArray< AudioClipInternal >( maxAudioClips, teMemoryTag::Audio );
+}
 
 OSStatus tone( void* inRef, AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* timeStamp, UInt32 busNumber, UInt32 numberFrames, AudioBufferList* ioData )
 {
@@ -30,26 +30,32 @@ struct CameraImpl
     } orthoParams;
 };
 
-constexpr unsigned MaxCameras = 10000;
-CameraImpl cameras[ MaxCameras ];
+CameraImpl* cameras = nullptr; // Indexed by game object.
+static unsigned cameraCapacity = 0;
+
+void CameraInitStorage( unsigned maxGameObjects )
+{
+    cameras = teMallocArray< CameraImpl >( maxGameObjects, teMemoryTag::Scene );
+    cameraCapacity = maxGameObjects;
+}
 
 float teCameraGetFovDegrees( unsigned index )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
     
     return cameras[ index ].fovDegrees;
 }
 
 float teCameraGetFar( unsigned index )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
     
     return cameras[ index ].farDepth;
 }
 
 void teCameraSetClear( unsigned index, teClearFlag clearFlag, const Vec4& color )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
 
     cameras[ index ].clearColor = color;
     cameras[ index ].clearFlag = clearFlag;
@@ -57,7 +63,7 @@ void teCameraSetClear( unsigned index, teClearFlag clearFlag, const Vec4& color
 
 void teCameraGetClear( unsigned index, teClearFlag& outClearFlag, Vec4& outColor )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
 
     outColor = cameras[ index ].clearColor;
     outClearFlag = cameras[ index ].clearFlag;
@@ -65,19 +71,19 @@ void teCameraGetClear( unsigned index, teClearFlag& outClearFlag, Vec4& outColor
 
 teTexture2D& teCameraGetColorTexture( unsigned index )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
     return cameras[ index ].color;
 }
 
 teTexture2D& teCameraGetDepthTexture( unsigned index )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
     return cameras[ index ].depth;
 }
 
 Vec3 teCameraGetScreenPoint( unsigned index, const Vec3& worldPoint, float viewWidth, float viewHeight )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
 
     Matrix worldToClip;
 
@@ -104,7 +110,7 @@ void teCameraSetProjectionType( unsigned index, teProjectionType projectionType
 
 void teCameraSetProjection( unsigned index, float fovDegrees, float aspect, float nearDepth, float farDepth )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
 
     cameras[ index ].fovDegrees = fovDegrees;
     cameras[ index ].aspect = aspect;
@@ -127,7 +133,7 @@ void teCameraSetProjection( unsigned index, float left, float right, float botto
 
 void teCameraGetProjection( unsigned index, float& outFovDegrees, float& outAspect, float& outNearDepth, float& outFarDepth )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
 
     outFovDegrees = cameras[ index ].fovDegrees;
     outAspect = cameras[ index ].aspect;
@@ -137,13 +143,20 @@ void teCameraGetProjection( unsigned index, float& outFovDegrees, float& outAspe
 
 Matrix& teCameraGetProjection( unsigned index )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
 
     return cameras[ index ].projection;
 }
 
 teTexture2D& teCameraGetDepthNormalsTexture( unsigned index )
 {
-    teAssert( index < MaxCameras );
+    teAssert( index < cameraCapacity );
     return cameras[ index ].depthNormals;
 }
+
+// Render textures are owned by the caller, so they're only forgotten.
+void CameraReset( unsigned index )
+{
+    teAssert( index < cameraCapacity );
+    cameras[ index ] = CameraImpl();
+}
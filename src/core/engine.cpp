@@ -0,0 +1,44 @@
+#include "engine.h"
+#include "te_stdlib.h"
+
+void GameObjectInitStorage( unsigned maxGameObjects );
+void TransformInitStorage( unsigned maxGameObjects );
+void FrustumInitStorage( unsigned maxGameObjects );
+void CameraInitStorage( unsigned maxGameObjects );
+void LightInitStorage( unsigned maxGameObjects );
+void SceneInitStorage( unsigned maxGameObjects );
+void MeshInitStorage( unsigned maxMeshes, unsigned maxGameObjects );
+void MaterialInitStorage( unsigned maxMaterials );
+void ShaderInitStorage( unsigned maxShaders );
+void AudioInitStorage( unsigned maxAudioClips );
+
+static bool isEngineInitialized = false;
+
+void teInitEngine( const teEngineDesc& desc )
+{
+    // Storage was already allocated, either by an earlier call or by creating something first.
+    teAssert( !isEngineInitialized );
+    teAssert( desc.maxGameObjects > 1 && desc.maxMeshes > 0 && desc.maxMaterials > 0 && desc.maxShaders > 0 && desc.maxAudioClips > 1 );
+
+    isEngineInitialized = true;
+
+    GameObjectInitStorage( desc.maxGameObjects );
+    TransformInitStorage( desc.maxGameObjects );
+    FrustumInitStorage( desc.maxGameObjects );
+    CameraInitStorage( desc.maxGameObjects );
+    LightInitStorage( desc.maxGameObjects );
+    SceneInitStorage( desc.maxGameObjects );
+    MeshInitStorage( desc.maxMeshes, desc.maxGameObjects );
+    MaterialInitStorage( desc.maxMaterials );
+    ShaderInitStorage( desc.maxShaders );
+    AudioInitStorage( desc.maxAudioClips );
+}
+
+// Called by functions that create things, so storage exists even if the app didn't call teInitEngine().
+void EngineEnsureInitialized()
+{
+    if (!isEngineInitialized)
+    {
+        teInitEngine( teEngineDesc() );
+    }
+}
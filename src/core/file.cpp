@@ -1,11 +1,14 @@
 #include "file.h"
+#include "profiler.h"
 #include "te_stdlib.h"
 #include <stdio.h>
 #include <sys/stat.h>
 #include <time.h>
 
-teFile teLoadFile( const char* path )
+static teFile LoadFile( const char* path, teArena* arena )
 {
+    TE_PROFILE_SCOPE( "teLoadFile" );
+
     teFile outFile;
     
     if (!path || *path == 0)
@@ -32,7 +35,7 @@ teFile teLoadFile( const char* path )
         fseek( file, 0, SEEK_SET );
         if (length > 0)
         {
-            outFile.data = (unsigned char*)teMalloc( length );
+            outFile.data = arena ? (unsigned char*)teArenaAlloc( *arena, length ) : (unsigned char*)teMalloc( length );
         }
         outFile.size = (unsigned)length;
         
@@ -47,43 +50,281 @@ teFile teLoadFile( const char* path )
     return outFile;
 }
 
+teFile teLoadFile( const char* path )
+{
+    return LoadFile( path, nullptr );
+}
+
+teFile teLoadFile( const char* path, teArena& arena )
+{
+    return LoadFile( path, &arena );
+}
+
+void teFreeFile( teFile& file )
+{
+    teFree( file.data );
+    file.data = nullptr;
+    file.size = 0;
+}
+
 struct Entry
 {
-    int hour = 0;
-    int minute = 0;
-    int second = 0;
+    time_t modificationTime = 0;
+    int watchDescriptor = -1;
     char path[ 260 ] = {};
     void(*updateFunc)(const char*) = nullptr;
 };
 
 Entry fileEntries[ 1000 ];
+TE_TRACK_STATIC_MEMORY( fileEntriesMemory, teMemoryTag::Tools, sizeof( fileEntries ) );
 unsigned fileEntryCount = 0;
 
+#if __linux__
+#include <atomic>
+#include <errno.h>
+#include <poll.h>
+#include <thread>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Single-producer (watcher thread), single-consumer (teHotReload) ring of fileEntries indices.
+// An entry is in the ring at most once, so the ring can never overflow.
+struct HotReloadQueue
+{
+    static constexpr unsigned Capacity = 1024;
+
+    unsigned entryIndices[ Capacity ] = {};
+    std::atomic< unsigned > head{ 0 };
+    std::atomic< unsigned > tail{ 0 };
+    std::atomic< bool > isQueued[ 1000 ] = {};
+    std::atomic< unsigned > publishedEntryCount{ 0 };
+    int inotifyFd = -1;
+    int stopFd = -1; // Written by teHotReloadStop() to wake the watcher thread.
+    bool isStopped = false;
+    std::thread watcherThread;
+};
+
+HotReloadQueue hotReloadQueue;
+
+static void HotReloadQueuePush( unsigned entryIndex )
+{
+    if (hotReloadQueue.isQueued[ entryIndex ].exchange( true, std::memory_order_acq_rel ))
+    {
+        return;
+    }
+
+    const unsigned tail = hotReloadQueue.tail.load( std::memory_order_relaxed );
+    hotReloadQueue.entryIndices[ tail % HotReloadQueue::Capacity ] = entryIndex;
+    hotReloadQueue.tail.store( tail + 1, std::memory_order_release );
+}
+
+static bool HotReloadQueuePop( unsigned& outEntryIndex )
+{
+    const unsigned head = hotReloadQueue.head.load( std::memory_order_relaxed );
+
+    if (head == hotReloadQueue.tail.load( std::memory_order_acquire ))
+    {
+        return false;
+    }
+
+    outEntryIndex = hotReloadQueue.entryIndices[ head % HotReloadQueue::Capacity ];
+    hotReloadQueue.head.store( head + 1, std::memory_order_release );
+    hotReloadQueue.isQueued[ outEntryIndex ].store( false, std::memory_order_release );
+
+    return true;
+}
+
+static const char* GetFileName( const char* path )
+{
+    const char* fileName = path;
+
+    for (const char* c = path; *c != 0; ++c)
+    {
+        if (*c == '/')
+        {
+            fileName = c + 1;
+        }
+    }
+
+    return fileName;
+}
+
+// Runs until teHotReloadStop() or an inotify error. Only interrupted calls are retried.
+static void HotReloadWatcherThread()
+{
+    alignas( inotify_event ) char buffer[ 4096 ];
+
+    while (true)
+    {
+        pollfd fds[ 2 ] = { { hotReloadQueue.inotifyFd, POLLIN, 0 }, { hotReloadQueue.stopFd, POLLIN, 0 } };
+
+        if (poll( fds, 2, -1 ) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            tePrint( "Could not wait for file modifications, hot reload is disabled.\n" );
+            return;
+        }
+
+        if (fds[ 1 ].revents != 0)
+        {
+            return;
+        }
+
+        const ssize_t length = read( hotReloadQueue.inotifyFd, buffer, sizeof( buffer ) );
+
+        if (length == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (length <= 0)
+        {
+            tePrint( "Could not read file modifications, hot reload is disabled.\n" );
+            return;
+        }
+
+        const unsigned entryCount = hotReloadQueue.publishedEntryCount.load( std::memory_order_acquire );
+
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event* event = (const inotify_event*)&buffer[ offset ];
+            offset += sizeof( inotify_event ) + event->len;
+
+            if (event->len == 0)
+            {
+                continue;
+            }
+
+            for (unsigned i = 0; i < entryCount; ++i)
+            {
+                if (fileEntries[ i ].watchDescriptor == event->wd && teStrcmp( GetFileName( fileEntries[ i ].path ), event->name ) == 0)
+                {
+                    HotReloadQueuePush( i );
+                }
+            }
+        }
+    }
+}
+
 void RegisterFileForModifications( const teFile& file, void(*updateFunc)(const char*) )
 {
     teAssert( fileEntryCount < 1000 );
 
-    struct stat inode;
+    if (hotReloadQueue.isStopped)
+    {
+        return;
+    }
+
+    if (hotReloadQueue.inotifyFd == -1)
+    {
+        hotReloadQueue.inotifyFd = inotify_init1( IN_CLOEXEC );
+        hotReloadQueue.stopFd = eventfd( 0, EFD_CLOEXEC );
+
+        if (hotReloadQueue.inotifyFd == -1 || hotReloadQueue.stopFd == -1)
+        {
+            tePrint( "Could not initialize inotify, hot reload is disabled.\n" );
+            hotReloadQueue.isStopped = true;
+            return;
+        }
+
+        hotReloadQueue.watcherThread = std::thread( HotReloadWatcherThread );
+        // Registered after hotReloadQueue is constructed, so it runs before the thread object is destroyed.
+        atexit( teHotReloadStop );
+    }
+
+    Entry& entry = fileEntries[ fileEntryCount ];
 
     for (unsigned i = 0; i < 260; ++i)
     {
-        fileEntries[ fileEntryCount ].path[ i ] = file.path[ i ];
+        entry.path[ i ] = file.path[ i ];
     }
 
-    fileEntries[ fileEntryCount ].updateFunc = updateFunc;
+    entry.updateFunc = updateFunc;
 
-    for (unsigned i = 0; i < fileEntryCount; ++i)
+    // Watches the directory instead of the file because editors often save by renaming a temp file over the original.
+    char directory[ 260 ] = {};
+    const unsigned directoryLength = (unsigned)(GetFileName( entry.path ) - entry.path);
+
+    if (directoryLength == 0)
     {
-#if _MSC_VER
-        tm timeinfo = {};
-        localtime_s( &timeinfo, &inode.st_mtime );
-        const tm* timeinfo2 = &timeinfo;
+        directory[ 0 ] = '.';
+    }
+    else
+    {
+        teMemcpy( directory, entry.path, directoryLength );
+    }
+
+    entry.watchDescriptor = inotify_add_watch( hotReloadQueue.inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO );
+
+    if (entry.watchDescriptor == -1)
+    {
+        tePrint( "Could not watch %s for modifications.\n", directory );
+    }
+
+    ++fileEntryCount;
+    hotReloadQueue.publishedEntryCount.store( fileEntryCount, std::memory_order_release );
+}
+
+void teHotReload()
+{
+    unsigned entryIndex = 0;
+
+    while (HotReloadQueuePop( entryIndex ))
+    {
+        fileEntries[ entryIndex ].updateFunc( fileEntries[ entryIndex ].path );
+    }
+}
+
+void teHotReloadStop()
+{
+    if (hotReloadQueue.isStopped || hotReloadQueue.inotifyFd == -1)
+    {
+        hotReloadQueue.isStopped = true;
+        return;
+    }
+
+    hotReloadQueue.isStopped = true;
+
+    const uint64_t one = 1;
+    ssize_t written = 0;
+
+    do
+    {
+        written = write( hotReloadQueue.stopFd, &one, sizeof( one ) );
+    } while (written == -1 && errno == EINTR);
+
+    hotReloadQueue.watcherThread.join();
+    close( hotReloadQueue.inotifyFd );
+    close( hotReloadQueue.stopFd );
+    hotReloadQueue.inotifyFd = -1;
+    hotReloadQueue.stopFd = -1;
+}
 #else
-        const tm* timeinfo2 = localtime( &inode.st_mtime );
-#endif
-        fileEntries[ fileEntryCount ].hour = timeinfo2->tm_hour;
-        fileEntries[ fileEntryCount ].minute = timeinfo2->tm_min;
-        fileEntries[ fileEntryCount ].second = timeinfo2->tm_sec;
+// Other platforms stat every registered file in teHotReload(). st_mtime has a resolution of one second, so a file
+// that's saved again in the same second as the previous reload isn't reloaded.
+void RegisterFileForModifications( const teFile& file, void(*updateFunc)(const char*) )
+{
+    teAssert( fileEntryCount < 1000 );
+
+    Entry& entry = fileEntries[ fileEntryCount ];
+
+    for (unsigned i = 0; i < 260; ++i)
+    {
+        entry.path[ i ] = file.path[ i ];
+    }
+
+    entry.updateFunc = updateFunc;
+
+    struct stat inode = {};
+
+    if (stat( entry.path, &inode ) != -1)
+    {
+        entry.modificationTime = inode.st_mtime;
     }
 
     ++fileEntryCount;
@@ -95,26 +336,19 @@ void teHotReload()
 
     for (unsigned i = 0; i < fileEntryCount; ++i)
     {
-        if (stat( fileEntries[ i ].path, &inode ) != -1)
+        if (stat( fileEntries[ i ].path, &inode ) != -1 && inode.st_mtime != fileEntries[ i ].modificationTime)
         {
-#if _MSC_VER
-            tm timeinfo = {};
-            localtime_s( &timeinfo, &inode.st_mtime );
-            const tm* timeinfo2 = &timeinfo;
-#else
-            const tm* timeinfo2 = localtime( &inode.st_mtime );
-#endif
-            if (timeinfo2->tm_hour != fileEntries[ i ].hour || timeinfo2->tm_min != fileEntries[ i ].minute || timeinfo2->tm_sec != fileEntries[ i ].second)
-            {
-                fileEntries[ i ].updateFunc( fileEntries[ i ].path );
-                fileEntries[ i ].hour = timeinfo2->tm_hour;
-                fileEntries[ i ].minute = timeinfo2->tm_min;
-                fileEntries[ i ].second = timeinfo2->tm_sec;
-            }
+            fileEntries[ i ].modificationTime = inode.st_mtime;
+            fileEntries[ i ].updateFunc( fileEntries[ i ].path );
         }
     }
 }
 
+void teHotReloadStop()
+{
+}
+#endif
+
 #if _MSC_VER
 struct DirectoryHandle
 {
@@ -1,7 +1,10 @@
 #include "frustum.h"
 #include <math.h>
+#include "te_stdlib.h"
 #include "vec3.h"
 
+void BoxesInPlanes( const Vec4* planes, unsigned planeCount, const Vec3* mins, const Vec3* maxs, unsigned count, bool* outIsInside );
+
 struct FrustumImpl
 {
     void UpdateCornersAndCenters( const Vec3& cameraPosition, const Vec3& zAxis );
@@ -43,7 +46,12 @@ struct FrustumImpl
     } planes[ 6 ]; // Clipping planes.
 };
 
-FrustumImpl frustums[ 10000 ];
+FrustumImpl* frustums = nullptr; // Indexed by game object.
+
+void FrustumInitStorage( unsigned maxGameObjects )
+{
+    frustums = teMallocArray< FrustumImpl >( maxGameObjects, teMemoryTag::Scene );
+}
 
 void FrustumSetProjection( int index, float fieldOfView, float aAspect, float aNear, float aFar )
 {
@@ -185,3 +193,17 @@ bool BoxInFrustum( int index, const Vec3& min, const Vec3& max )
     
     return result;
 }
+
+// Tests many boxes at once, 8 per iteration on AVX2 CPUs.
+void BoxesInFrustum( int index, const Vec3* mins, const Vec3* maxs, unsigned count, bool* outIsInside )
+{
+    Vec4 planes[ 6 ];
+
+    for (unsigned p = 0; p < 6; ++p)
+    {
+        const FrustumImpl::Plane& plane = frustums[ index ].planes[ p ];
+        planes[ p ] = Vec4( plane.normal.x, plane.normal.y, plane.normal.z, plane.d );
+    }
+
+    BoxesInPlanes( planes, 6, mins, maxs, count, outIsInside );
+}
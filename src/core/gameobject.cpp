@@ -3,30 +3,273 @@
 
 void teAddPointLight( unsigned index );
 void teAddSpotLight( unsigned index );
+void RemovePointLight( unsigned index );
+void RemoveSpotLight( unsigned index );
+void TransformReset( unsigned index );
+void CameraReset( unsigned index );
+void MeshRendererReset( unsigned gameObjectIndex );
+void SceneRemoveFromAll( unsigned gameObjectIndex );
+void StreamingForgetGameObject( unsigned gameObjectIndex );
+void EngineEnsureInitialized();
 
 constexpr unsigned MaxNameLength = 100;
+constexpr unsigned ComponentTypeCount = 7;
+constexpr unsigned NamePoolBytes = 128 * 1024;
+constexpr unsigned NameHashSlots = 16384; // Power of two. At most half are used, so probe sequences stay short.
 
-struct teGameObjectImpl
+static_assert( (1u << (ComponentTypeCount - 1)) == teComponent::InstancedMeshRenderer, "ComponentTypeCount must match teComponent" );
+
+// Game objects that have a component. objects is dense: [0, count) are in use, so systems only visit their own objects.
+struct ComponentObjects
+{
+    unsigned* objects = nullptr;
+    unsigned* slots = nullptr; // Game object index -> slot in objects + 1. 0 means the game object doesn't have the component.
+    unsigned count = 0;
+};
+
+struct NameSlot
 {
-    unsigned components = 0;
-    char name[ MaxNameLength ] = {};
+    unsigned offset = 0; // 0 means the slot is empty.
+    unsigned refCount = 0;
 };
 
-constexpr unsigned MaxGameObjects = 10000;
-teGameObjectImpl gameObjects[ MaxGameObjects ];
-unsigned gameObjectCount = 0;
+// Names are interned: each distinct name is stored once in the pool and game objects refer to it by offset.
+// Offset 0 is the empty string. Names whose refCount drops to 0 stay until the pool is full, and are then
+// removed by CompactNames().
+struct NamePool
+{
+    char chars[ NamePoolBytes ] = {};
+    unsigned usedBytes = 1;
+    unsigned unusedBytes = 0; // Bytes of names with refCount 0.
+    unsigned nameCount = 0;
+    NameSlot hashSlots[ NameHashSlots ];
+};
+
+// Component masks are read in every per-frame loop, so they're kept apart from the cold name offsets.
+// Arrays have gameObjectCapacity elements and are allocated by GameObjectInitStorage().
+static unsigned* gameObjectComponents = nullptr;
+static unsigned* gameObjectNames = nullptr;
+static unsigned* gameObjectGenerations = nullptr; // Odd when the game object is alive.
+static ComponentObjects componentObjects[ ComponentTypeCount ];
+static NamePool namePool;
+static unsigned* freeIndices = nullptr; // Destroyed game objects' indices, reused before new ones.
+TE_TRACK_STATIC_MEMORY( gameObjectsMemory, teMemoryTag::Scene, sizeof( namePool ) );
+static unsigned gameObjectCapacity = 0;
+static unsigned gameObjectCount = 0;
+static unsigned freeIndexCount = 0;
+
+void GameObjectInitStorage( unsigned capacity )
+{
+    gameObjectCapacity = capacity;
+    gameObjectComponents = teMallocArray< unsigned >( capacity, teMemoryTag::Scene );
+    gameObjectNames = teMallocArray< unsigned >( capacity, teMemoryTag::Scene );
+    gameObjectGenerations = teMallocArray< unsigned >( capacity, teMemoryTag::Scene );
+    freeIndices = teMallocArray< unsigned >( capacity, teMemoryTag::Scene );
+
+    for (unsigned typeIndex = 0; typeIndex < ComponentTypeCount; ++typeIndex)
+    {
+        componentObjects[ typeIndex ].objects = teMallocArray< unsigned >( capacity, teMemoryTag::Scene );
+        componentObjects[ typeIndex ].slots = teMallocArray< unsigned >( capacity, teMemoryTag::Scene );
+    }
+}
+
+static unsigned GetComponentTypeIndex( teComponent component )
+{
+    unsigned typeIndex = 0;
+
+    while ((1u << typeIndex) != (unsigned)component)
+    {
+        ++typeIndex;
+    }
+
+    teAssert( typeIndex < ComponentTypeCount );
+    return typeIndex;
+}
+
+static unsigned HashName( const char* name, unsigned length )
+{
+    // FNV-1a
+    unsigned hash = 2166136261u;
+
+    for (unsigned i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (unsigned char)name[ i ]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// @return The slot that has the name, or the empty slot where it would be added.
+static unsigned FindNameSlot( const NamePool& pool, const char* name, unsigned length )
+{
+    unsigned slot = HashName( name, length ) & (NameHashSlots - 1);
+
+    while (pool.hashSlots[ slot ].offset != 0)
+    {
+        const char* interned = &pool.chars[ pool.hashSlots[ slot ].offset ];
+
+        if (teStrlen( interned ) == length && memcmp( interned, name, length ) == 0)
+        {
+            return slot;
+        }
+
+        slot = (slot + 1) & (NameHashSlots - 1);
+    }
+
+    return slot;
+}
+
+// @return name's offset in pool, with its refCount incremented, or 0 if the pool is full.
+static unsigned AddNameReference( NamePool& pool, const char* name )
+{
+    unsigned length = teStrlen( name );
+    length = length + 1 < MaxNameLength ? length : MaxNameLength - 1;
+
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    const unsigned slot = FindNameSlot( pool, name, length );
+    NameSlot& nameSlot = pool.hashSlots[ slot ];
+
+    if (nameSlot.offset != 0)
+    {
+        pool.unusedBytes -= nameSlot.refCount == 0 ? length + 1 : 0;
+        ++nameSlot.refCount;
+        return nameSlot.offset;
+    }
+
+    if (pool.usedBytes + length + 1 > NamePoolBytes || pool.nameCount == NameHashSlots / 2)
+    {
+        return 0;
+    }
+
+    nameSlot.offset = pool.usedBytes;
+    nameSlot.refCount = 1;
+    teMemcpy( &pool.chars[ nameSlot.offset ], name, length );
+    pool.chars[ nameSlot.offset + length ] = 0;
+    pool.usedBytes += length + 1;
+    ++pool.nameCount;
+
+    return nameSlot.offset;
+}
+
+static void ReleaseName( unsigned offset )
+{
+    if (offset == 0)
+    {
+        return;
+    }
+
+    const char* name = &namePool.chars[ offset ];
+    const unsigned length = teStrlen( name );
+    NameSlot& nameSlot = namePool.hashSlots[ FindNameSlot( namePool, name, length ) ];
+    teAssert( nameSlot.offset == offset && nameSlot.refCount > 0 );
+
+    if (--nameSlot.refCount == 0)
+    {
+        namePool.unusedBytes += length + 1;
+    }
+}
+
+// Rebuilds the pool from the names that game objects use, so unused names' bytes and slots can be reused.
+static void CompactNames()
+{
+    NamePool* compacted = new (teMalloc( sizeof( NamePool ), teMemoryTag::Scene )) NamePool();
+
+    for (unsigned i = 1; i <= gameObjectCount; ++i)
+    {
+        gameObjectNames[ i ] = gameObjectNames[ i ] != 0 ? AddNameReference( *compacted, &namePool.chars[ gameObjectNames[ i ] ] ) : 0;
+    }
+
+    teMemcpy( &namePool, compacted, sizeof( NamePool ) );
+    teFree( compacted );
+}
+
+static unsigned InternName( const char* name )
+{
+    unsigned offset = AddNameReference( namePool, name );
+
+    if (offset == 0 && name[ 0 ] != 0 && namePool.unusedBytes > 0)
+    {
+        // name can point into the pool, which compaction overwrites.
+        char nameCopy[ MaxNameLength ] = {};
+        teMemcpy( nameCopy, name, teStrlen( name ) + 1 < MaxNameLength ? teStrlen( name ) : MaxNameLength - 1 );
+
+        CompactNames();
+        offset = AddNameReference( namePool, nameCopy );
+    }
+
+    if (offset == 0 && name[ 0 ] != 0)
+    {
+        teLog( teLogLevel::Warning, "Game object name pool is full, could not add %s\n", name );
+    }
+
+    return offset;
+}
+
+static void AddToComponentObjects( unsigned index, unsigned components )
+{
+    for (unsigned typeIndex = 0; typeIndex < ComponentTypeCount; ++typeIndex)
+    {
+        ComponentObjects& objects = componentObjects[ typeIndex ];
+
+        if ((components & (1u << typeIndex)) != 0 && objects.slots[ index ] == 0)
+        {
+            objects.objects[ objects.count ] = index;
+            ++objects.count;
+            objects.slots[ index ] = objects.count;
+        }
+    }
+}
+
+static void RemoveFromComponentObjects( unsigned index )
+{
+    for (unsigned typeIndex = 0; typeIndex < ComponentTypeCount; ++typeIndex)
+    {
+        ComponentObjects& objects = componentObjects[ typeIndex ];
+        const unsigned slot = objects.slots[ index ];
+
+        if (slot == 0)
+        {
+            continue;
+        }
+
+        // Moves the last game object into the hole.
+        const unsigned lastIndex = objects.objects[ objects.count - 1 ];
+        objects.objects[ slot - 1 ] = lastIndex;
+        objects.slots[ lastIndex ] = slot;
+        objects.objects[ objects.count - 1 ] = 0;
+        objects.slots[ index ] = 0;
+        --objects.count;
+    }
+}
 
 teGameObject teCreateGameObject( const char* name, unsigned components )
 {
-    teAssert( gameObjectCount + 1 < MaxGameObjects );
+    EngineEnsureInitialized();
 
     teGameObject outGo;
-    outGo.index = ++gameObjectCount;
-    
-    gameObjects[ outGo.index ].components = components;
+
+    if (freeIndexCount > 0)
+    {
+        outGo.index = freeIndices[ --freeIndexCount ];
+    }
+    else
+    {
+        teAssert( gameObjectCount + 1 < gameObjectCapacity );
+        outGo.index = ++gameObjectCount;
+    }
+
+    ++gameObjectGenerations[ outGo.index ];
+    outGo.generation = gameObjectGenerations[ outGo.index ];
+
+    gameObjectComponents[ outGo.index ] = components;
+    AddToComponentObjects( outGo.index, components );
 
     teGameObjectSetName( outGo.index, name );
-    
+
     if (components & teComponent::PointLight)
     {
         teAddPointLight( outGo.index );
@@ -40,38 +283,98 @@ teGameObject teCreateGameObject( const char* name, unsigned components )
     return outGo;
 }
 
+void teDestroyGameObject( const teGameObject& gameObject )
+{
+    if (!teGameObjectIsAlive( gameObject ))
+    {
+        teAssert( !"Game object has already been destroyed!" );
+        return;
+    }
+
+    const unsigned index = gameObject.index;
+    SceneRemoveFromAll( index );
+    StreamingForgetGameObject( index );
+
+    if (gameObjectComponents[ index ] & teComponent::PointLight)
+    {
+        RemovePointLight( index );
+    }
+
+    if (gameObjectComponents[ index ] & teComponent::SpotLight)
+    {
+        RemoveSpotLight( index );
+    }
+
+    if (gameObjectComponents[ index ] & (teComponent::MeshRenderer | teComponent::InstancedMeshRenderer))
+    {
+        MeshRendererReset( index );
+    }
+
+    if (gameObjectComponents[ index ] & teComponent::Camera)
+    {
+        CameraReset( index );
+    }
+
+    // Audio sources aren't stored per game object, so there's nothing to reset for them.
+    TransformReset( index );
+    RemoveFromComponentObjects( index );
+    gameObjectComponents[ index ] = 0;
+    ReleaseName( gameObjectNames[ index ] );
+    gameObjectNames[ index ] = 0;
+    ++gameObjectGenerations[ index ];
+    freeIndices[ freeIndexCount++ ] = index;
+}
+
+bool teGameObjectIsAlive( const teGameObject& gameObject )
+{
+    return gameObject.index != 0 && gameObject.index < gameObjectCapacity && gameObject.generation == gameObjectGenerations[ gameObject.index ];
+}
+
 unsigned teGameObjectGetComponents( unsigned index )
 {
-    teAssert( index < MaxGameObjects );
+    teAssert( index < gameObjectCapacity );
 
-    return index < MaxGameObjects ? gameObjects[ index ].components : 0;
+    return index < gameObjectCapacity ? gameObjectComponents[ index ] : 0;
+}
+
+const unsigned* teGameObjectGetObjectsWithComponent( teComponent component, unsigned& outCount )
+{
+    const ComponentObjects& objects = componentObjects[ GetComponentTypeIndex( component ) ];
+    outCount = objects.count;
+
+    return objects.objects;
 }
 
 void teGameObjectSetName( unsigned index, const char* name )
 {
-    unsigned nameLength = teStrlen( name );
-    nameLength = nameLength + 1 < MaxNameLength ? nameLength : MaxNameLength - 1;
-    teMemcpy( gameObjects[ index ].name, name, nameLength );
-    gameObjects[ index ].name[ nameLength ] = 0;
+    teAssert( index < gameObjectCapacity );
+
+    // Released first, so compaction while interning doesn't keep the old name.
+    ReleaseName( gameObjectNames[ index ] );
+    gameObjectNames[ index ] = 0;
+    gameObjectNames[ index ] = InternName( name );
 }
 
-char* teGameObjectGetName( unsigned index )
+const char* teGameObjectGetName( unsigned index )
 {
-    return gameObjects[ index ].name;
+    teAssert( index < gameObjectCapacity );
+
+    return &namePool.chars[ gameObjectNames[ index ] ];
 }
 
 void teGameObjectAddComponent( unsigned index, teComponent component )
 {
-    teAssert( index < MaxGameObjects );
+    teAssert( index < gameObjectCapacity );
 
-    gameObjects[ index ].components |= component;
+    gameObjectComponents[ index ] |= component;
+    AddToComponentObjects( index, component );
 
-    if (gameObjects[ index ].components & teComponent::PointLight)
+    if (gameObjectComponents[ index ] & teComponent::PointLight)
     {
         teAddPointLight( index );
     }
 
-    if (gameObjects[ index ].components & teComponent::SpotLight)
+    if (gameObjectComponents[ index ] & teComponent::SpotLight)
     {
         teAddSpotLight( index );
     }
@@ -1,3 +1,4 @@
+#include "affine3x4.h"
 #include "matrix.h"
 #include "mathutil.h"
 #include "transform.h"
@@ -269,6 +270,41 @@ void Matrix::TransformPoint( const Vec3& point, const Matrix& mat, Vec3& out )
     out.z = res[ 2 ];
 }
 
+#else
+
+// Adds in the same order as the SSE3 path, so both give the same bits.
+void Matrix::Multiply( const Matrix& ma, const Matrix& mb, Matrix& out )
+{
+    Matrix result;
+
+    for (unsigned i = 0; i < 16; i += 4)
+    {
+        for (unsigned c = 0; c < 4; ++c)
+        {
+            float r = mb.m[ c ] * ma.m[ i ];
+
+            for (unsigned j = 1; j < 4; ++j)
+            {
+                r = mb.m[ j * 4 + c ] * ma.m[ i + j ] + r;
+            }
+
+            result.m[ i + c ] = r;
+        }
+    }
+
+    out = result;
+}
+
+void Matrix::TransformPoint( const Vec3& vec, const Matrix& mat, Vec3& out )
+{
+    Vec3 res;
+
+    res.x = (vec.x * mat.m[ 0 ] + vec.y * mat.m[ 4 ]) + (vec.z * mat.m[ 8 ] + mat.m[ 12 ]);
+    res.y = (vec.x * mat.m[ 1 ] + vec.y * mat.m[ 5 ]) + (vec.z * mat.m[ 9 ] + mat.m[ 13 ]);
+    res.z = (vec.x * mat.m[ 2 ] + vec.y * mat.m[ 6 ]) + (vec.z * mat.m[ 10 ] + mat.m[ 14 ]);
+
+    out = res;
+}
 #endif
 
 void Matrix::InitFrom( const float* mat )
@@ -302,6 +338,191 @@ void Matrix::MakeLookAtLH( const Vec3& eye, const Vec3& center, const Vec3& up )
     m[ 12 ] = 0; m[ 13 ] = 0; m[ 14 ] = 0; m[ 15 ] = 1;
 }
 
+#ifdef SIMD_SSE3
+static __m128 SwizzleYXXX( __m128 v ) { return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 0, 0, 0, 1 ) ); }
+static __m128 SwizzleZZYY( __m128 v ) { return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 1, 2, 2 ) ); }
+static __m128 SwizzleWWWZ( __m128 v ) { return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 3, 3 ) ); }
+
+// Returns the sum in all lanes. Shuffles instead of _mm_hadd_ps, so SSE3 codegen isn't needed.
+static __m128 SumLanes( __m128 v )
+{
+    v = _mm_add_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    return _mm_add_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+}
+
+// 2x2 determinants of rows a and b, arranged so that Cofactors() can combine them with a third row.
+static void PairDeterminants( __m128 a, __m128 b, __m128 out[ 3 ] )
+{
+    out[ 0 ] = _mm_sub_ps( _mm_mul_ps( SwizzleZZYY( a ), SwizzleWWWZ( b ) ), _mm_mul_ps( SwizzleWWWZ( a ), SwizzleZZYY( b ) ) );
+    out[ 1 ] = _mm_sub_ps( _mm_mul_ps( SwizzleWWWZ( a ), SwizzleYXXX( b ) ), _mm_mul_ps( SwizzleYXXX( a ), SwizzleWWWZ( b ) ) );
+    out[ 2 ] = _mm_sub_ps( _mm_mul_ps( SwizzleYXXX( a ), SwizzleZZYY( b ) ), _mm_mul_ps( SwizzleZZYY( a ), SwizzleYXXX( b ) ) );
+}
+
+// Cofactors of a row, given the other row pair's determinants and the row left out of the 3x3 minors. Signs are applied by the caller.
+static __m128 Cofactors( __m128 row, const __m128 pairDeterminants[ 3 ] )
+{
+    __m128 result = _mm_mul_ps( SwizzleYXXX( row ), pairDeterminants[ 0 ] );
+    result = _mm_add_ps( result, _mm_mul_ps( SwizzleZZYY( row ), pairDeterminants[ 1 ] ) );
+    return _mm_add_ps( result, _mm_mul_ps( SwizzleWWWZ( row ), pairDeterminants[ 2 ] ) );
+}
+
+// Returns false if the matrix is singular.
+static bool InverseTransposeRows( const float m[ 16 ], __m128 outRows[ 4 ] )
+{
+    const __m128 row0 = _mm_loadu_ps( &m[ 0 ] );
+    const __m128 row1 = _mm_loadu_ps( &m[ 4 ] );
+    const __m128 row2 = _mm_loadu_ps( &m[ 8 ] );
+    const __m128 row3 = _mm_loadu_ps( &m[ 12 ] );
+
+    __m128 determinants23[ 3 ];
+    __m128 determinants01[ 3 ];
+    PairDeterminants( row2, row3, determinants23 );
+    PairDeterminants( row0, row1, determinants01 );
+
+    const __m128 signsEven = _mm_setr_ps( 0.0f, -0.0f, 0.0f, -0.0f );
+    const __m128 signsOdd = _mm_setr_ps( -0.0f, 0.0f, -0.0f, 0.0f );
+    outRows[ 0 ] = _mm_xor_ps( Cofactors( row1, determinants23 ), signsEven );
+    outRows[ 1 ] = _mm_xor_ps( Cofactors( row0, determinants23 ), signsOdd );
+    outRows[ 2 ] = _mm_xor_ps( Cofactors( row3, determinants01 ), signsEven );
+    outRows[ 3 ] = _mm_xor_ps( Cofactors( row2, determinants01 ), signsOdd );
+
+    const __m128 det = SumLanes( _mm_mul_ps( row0, outRows[ 0 ] ) );
+    const float acceptableDelta = 0.0001f;
+
+    if (fabsf( _mm_cvtss_f32( det ) ) < acceptableDelta)
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        outRows[ i ] = _mm_div_ps( outRows[ i ], det );
+    }
+
+    return true;
+}
+
+void Matrix::Invert( const Matrix& matrix, Matrix& out )
+{
+    __m128 rows[ 4 ];
+
+    if (!InverseTransposeRows( matrix.m, rows ))
+    {
+        out.MakeIdentity();
+        return;
+    }
+
+    _MM_TRANSPOSE4_PS( rows[ 0 ], rows[ 1 ], rows[ 2 ], rows[ 3 ] );
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        _mm_store_ps( &out.m[ i * 4 ], rows[ i ] );
+    }
+}
+
+void Matrix::InverseTranspose( const float m[ 16 ], float* out )
+{
+    __m128 rows[ 4 ];
+
+    if (!InverseTransposeRows( m, rows ))
+    {
+        Matrix identity;
+        teMemcpy( out, &identity.m[ 0 ], sizeof( Matrix ) );
+        return;
+    }
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        _mm_storeu_ps( &out[ i * 4 ], rows[ i ] );
+    }
+}
+#elif SIMD_NEON
+static float32x4_t SwizzleYXXX( float32x4_t v ) { return vsetq_lane_f32( vgetq_lane_f32( v, 1 ), vdupq_laneq_f32( v, 0 ), 0 ); }
+static float32x4_t SwizzleZZYY( float32x4_t v ) { return vcombine_f32( vdup_laneq_f32( v, 2 ), vdup_laneq_f32( v, 1 ) ); }
+static float32x4_t SwizzleWWWZ( float32x4_t v ) { return vsetq_lane_f32( vgetq_lane_f32( v, 2 ), vdupq_laneq_f32( v, 3 ), 3 ); }
+
+// 2x2 determinants of rows a and b, arranged so that Cofactors() can combine them with a third row.
+static void PairDeterminants( float32x4_t a, float32x4_t b, float32x4_t out[ 3 ] )
+{
+    out[ 0 ] = vsubq_f32( vmulq_f32( SwizzleZZYY( a ), SwizzleWWWZ( b ) ), vmulq_f32( SwizzleWWWZ( a ), SwizzleZZYY( b ) ) );
+    out[ 1 ] = vsubq_f32( vmulq_f32( SwizzleWWWZ( a ), SwizzleYXXX( b ) ), vmulq_f32( SwizzleYXXX( a ), SwizzleWWWZ( b ) ) );
+    out[ 2 ] = vsubq_f32( vmulq_f32( SwizzleYXXX( a ), SwizzleZZYY( b ) ), vmulq_f32( SwizzleZZYY( a ), SwizzleYXXX( b ) ) );
+}
+
+// Cofactors of a row, given the other row pair's determinants and the row left out of the 3x3 minors. Signs are applied by the caller.
+static float32x4_t Cofactors( float32x4_t row, const float32x4_t pairDeterminants[ 3 ] )
+{
+    float32x4_t result = vmulq_f32( SwizzleYXXX( row ), pairDeterminants[ 0 ] );
+    result = vaddq_f32( result, vmulq_f32( SwizzleZZYY( row ), pairDeterminants[ 1 ] ) );
+    return vaddq_f32( result, vmulq_f32( SwizzleWWWZ( row ), pairDeterminants[ 2 ] ) );
+}
+
+// Returns false if the matrix is singular.
+static bool InverseTransposeRows( const float m[ 16 ], float* out )
+{
+    const float32x4_t row0 = vld1q_f32( &m[ 0 ] );
+    const float32x4_t row1 = vld1q_f32( &m[ 4 ] );
+    const float32x4_t row2 = vld1q_f32( &m[ 8 ] );
+    const float32x4_t row3 = vld1q_f32( &m[ 12 ] );
+
+    float32x4_t determinants23[ 3 ];
+    float32x4_t determinants01[ 3 ];
+    PairDeterminants( row2, row3, determinants23 );
+    PairDeterminants( row0, row1, determinants01 );
+
+    alignas( 16 ) const float signs[ 4 ] = { 1, -1, 1, -1 };
+    const float32x4_t signsEven = vld1q_f32( signs );
+    const float32x4_t signsOdd = vnegq_f32( signsEven );
+    const float32x4_t cofactors0 = vmulq_f32( Cofactors( row1, determinants23 ), signsEven );
+    const float32x4_t cofactors1 = vmulq_f32( Cofactors( row0, determinants23 ), signsOdd );
+    const float32x4_t cofactors2 = vmulq_f32( Cofactors( row3, determinants01 ), signsEven );
+    const float32x4_t cofactors3 = vmulq_f32( Cofactors( row2, determinants01 ), signsOdd );
+
+    const float det = vaddvq_f32( vmulq_f32( row0, cofactors0 ) );
+    const float acceptableDelta = 0.0001f;
+
+    if (fabsf( det ) < acceptableDelta)
+    {
+        return false;
+    }
+
+    const float32x4_t detVector = vdupq_n_f32( det );
+    vst1q_f32( &out[ 0 ], vdivq_f32( cofactors0, detVector ) );
+    vst1q_f32( &out[ 4 ], vdivq_f32( cofactors1, detVector ) );
+    vst1q_f32( &out[ 8 ], vdivq_f32( cofactors2, detVector ) );
+    vst1q_f32( &out[ 12 ], vdivq_f32( cofactors3, detVector ) );
+
+    return true;
+}
+
+void Matrix::Invert( const Matrix& matrix, Matrix& out )
+{
+    alignas( 16 ) float invTrans[ 16 ];
+
+    if (!InverseTransposeRows( matrix.m, invTrans ))
+    {
+        out.MakeIdentity();
+        return;
+    }
+
+    // De-interleaving loads transpose.
+    const float32x4x4_t columns = vld4q_f32( invTrans );
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        vst1q_f32( &out.m[ i * 4 ], columns.val[ i ] );
+    }
+}
+
+void Matrix::InverseTranspose( const float m[ 16 ], float* out )
+{
+    if (!InverseTransposeRows( m, out ))
+    {
+        Matrix identity;
+        teMemcpy( out, &identity.m[ 0 ], sizeof( Matrix ) );
+    }
+}
+#else
 void Matrix::Invert( const Matrix& matrix, Matrix& out )
 {
     float invTrans[ 16 ];
@@ -393,6 +614,7 @@ void Matrix::InverseTranspose( const float m[ 16 ], float* out )
         out[ i ] /= det;
     }
 }
+#endif
 
 void Matrix::MakeIdentity()
 {
@@ -512,6 +734,21 @@ void Matrix::SetTranslation( const Vec3& translation )
     m[ 14 ] = translation.z;
 }
 
+void Matrix::Compose( const Quaternion& rotation, const Vec3& position, float scale, Matrix& out )
+{
+    rotation.GetMatrix( out );
+
+    // Rows' w is 0, so scaling the whole 3x4 part leaves it 0.
+    for (unsigned i = 0; i < 12; ++i)
+    {
+        out.m[ i ] *= scale;
+    }
+
+    out.m[ 12 ] = position.x;
+    out.m[ 13 ] = position.y;
+    out.m[ 14 ] = position.z;
+}
+
 void Matrix::Translate( const Vec3& v )
 {
     Matrix translateMatrix;
@@ -541,14 +778,6 @@ Vec3 Quaternion::operator*( const Vec3& vec ) const
     return vec + (wComponent * vT) + Vec3::Cross( Vec3( x, y, z ), vT );
 }
 
-Quaternion Quaternion::operator*( const Quaternion& aQ ) const
-{
-    return Quaternion( Vec3( w * aQ.x + x * aQ.w + y * aQ.z - z * aQ.y,
-        w * aQ.y + y * aQ.w + z * aQ.x - x * aQ.z,
-        w * aQ.z + z * aQ.w + x * aQ.y - y * aQ.x ),
-        w * aQ.w - x * aQ.x - y * aQ.y - z * aQ.z );
-}
-
 void Quaternion::FromAxisAngle( const Vec3& axis, float angleDeg )
 {
     const float angleRad = angleDeg * (3.14159265358979f / 360.0f);
@@ -608,22 +837,6 @@ float Quaternion::FindTwist( const Vec3& axis ) const
     return acosf( dot );
 }
 
-void Quaternion::Normalize()
-{
-    const float mag2 = w * w + x * x + y * y + z * z;
-    const float acceptableDelta = 0.00001f;
-
-    if (fabsf( mag2 ) > acceptableDelta && fabsf( mag2 - 1.0f ) > acceptableDelta)
-    {
-        const float oneOverMag = 1.0f / sqrtf( mag2 );
-
-        x *= oneOverMag;
-        y *= oneOverMag;
-        z *= oneOverMag;
-        w *= oneOverMag;
-    }
-}
-
 void Quaternion::FromMatrix( const Matrix& mat )
 {
     float t;
@@ -662,6 +875,150 @@ void Quaternion::FromMatrix( const Matrix& mat )
     w *= factor;
 }
 
+#ifdef SIMD_SSE3
+Quaternion Quaternion::operator*( const Quaternion& aQ ) const
+{
+    const __m128 a = _mm_loadu_ps( &x );
+    const __m128 b = _mm_loadu_ps( &aQ.x );
+    const __m128 signW = _mm_setr_ps( 0.0f, 0.0f, 0.0f, -0.0f );
+
+    // Columns of the scalar version's sums: w * b, then a.xyzx * b.wwwx, a.yzxy * b.zxyy and a.zxyz * b.yzxz.
+    __m128 result = _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 3, 3, 3 ) ), b );
+    result = _mm_add_ps( result, _mm_xor_ps( _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 0, 2, 1, 0 ) ), _mm_shuffle_ps( b, b, _MM_SHUFFLE( 0, 3, 3, 3 ) ) ), signW ) );
+    result = _mm_add_ps( result, _mm_xor_ps( _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 1, 0, 2, 1 ) ), _mm_shuffle_ps( b, b, _MM_SHUFFLE( 1, 1, 0, 2 ) ) ), signW ) );
+    result = _mm_sub_ps( result, _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 2, 1, 0, 2 ) ), _mm_shuffle_ps( b, b, _MM_SHUFFLE( 2, 0, 2, 1 ) ) ) );
+
+    Quaternion out;
+    _mm_storeu_ps( &out.x, result );
+    return out;
+}
+
+void Quaternion::Normalize()
+{
+    // Built from the members instead of loaded, because they are often just written one by one and the load would stall.
+    const __m128 q = _mm_setr_ps( x, y, z, w );
+    const __m128 mag2 = SumLanes( _mm_mul_ps( q, q ) );
+
+    const float mag2Scalar = _mm_cvtss_f32( mag2 );
+    const float acceptableDelta = 0.00001f;
+
+    if (fabsf( mag2Scalar ) > acceptableDelta && fabsf( mag2Scalar - 1.0f ) > acceptableDelta)
+    {
+        _mm_storeu_ps( &x, _mm_div_ps( q, _mm_sqrt_ps( mag2 ) ) );
+    }
+}
+
+void Quaternion::GetMatrix( Matrix& outMatrix ) const
+{
+    const __m128 maskXYZ = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+    const __m128 q = _mm_loadu_ps( &x );
+    const __m128 q2 = _mm_add_ps( q, q );
+
+    // 2xx, 2yy, 2zz
+    const __m128 squares = _mm_and_ps( _mm_mul_ps( q, q2 ), maskXYZ );
+    // 1 - 2(yy + zz), 1 - 2(xx + zz), 1 - 2(xx + yy)
+    __m128 diagonal = _mm_sub_ps( _mm_setr_ps( 1, 1, 1, 0 ), _mm_shuffle_ps( squares, squares, _MM_SHUFFLE( 3, 0, 0, 1 ) ) );
+    diagonal = _mm_sub_ps( diagonal, _mm_shuffle_ps( squares, squares, _MM_SHUFFLE( 3, 1, 2, 2 ) ) );
+    // 2xz, 2xy, 2yz and 2wy, 2wz, 2wx
+    const __m128 products = _mm_mul_ps( _mm_shuffle_ps( q, q, _MM_SHUFFLE( 3, 1, 0, 0 ) ), _mm_shuffle_ps( q2, q2, _MM_SHUFFLE( 3, 2, 1, 2 ) ) );
+    const __m128 wProducts = _mm_mul_ps( _mm_shuffle_ps( q, q, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _mm_shuffle_ps( q2, q2, _MM_SHUFFLE( 3, 0, 2, 1 ) ) );
+    const __m128 sum = _mm_and_ps( _mm_add_ps( products, wProducts ), maskXYZ );
+    const __m128 difference = _mm_sub_ps( products, wProducts ); // w is exactly 0.
+
+    _mm_store_ps( &outMatrix.m[ 0 ], _mm_shuffle_ps( _mm_unpacklo_ps( diagonal, difference ), sum, _MM_SHUFFLE( 3, 0, 3, 0 ) ) );
+    _mm_store_ps( &outMatrix.m[ 4 ], _mm_shuffle_ps( _mm_unpacklo_ps( sum, diagonal ), difference, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+    _mm_store_ps( &outMatrix.m[ 8 ], _mm_shuffle_ps( _mm_shuffle_ps( difference, sum, _MM_SHUFFLE( 2, 2, 0, 0 ) ), diagonal, _MM_SHUFFLE( 3, 2, 2, 0 ) ) );
+    _mm_store_ps( &outMatrix.m[ 12 ], _mm_setr_ps( 0, 0, 0, 1 ) );
+}
+#elif SIMD_NEON
+Quaternion Quaternion::operator*( const Quaternion& aQ ) const
+{
+    // Columns of the scalar version's sums.
+    alignas( 16 ) const float a1[ 4 ] = { x, y, z, -x };
+    alignas( 16 ) const float b1[ 4 ] = { aQ.w, aQ.w, aQ.w, aQ.x };
+    alignas( 16 ) const float a2[ 4 ] = { y, z, x, -y };
+    alignas( 16 ) const float b2[ 4 ] = { aQ.z, aQ.x, aQ.y, aQ.y };
+    alignas( 16 ) const float a3[ 4 ] = { z, x, y, z };
+    alignas( 16 ) const float b3[ 4 ] = { aQ.y, aQ.z, aQ.x, aQ.z };
+
+    float32x4_t result = vmulq_n_f32( vld1q_f32( &aQ.x ), w );
+    result = vmlaq_f32( result, vld1q_f32( a1 ), vld1q_f32( b1 ) );
+    result = vmlaq_f32( result, vld1q_f32( a2 ), vld1q_f32( b2 ) );
+    result = vmlsq_f32( result, vld1q_f32( a3 ), vld1q_f32( b3 ) );
+
+    Quaternion out;
+    vst1q_f32( &out.x, result );
+    return out;
+}
+
+void Quaternion::Normalize()
+{
+    const float32x4_t q = vld1q_f32( &x );
+    const float mag2 = vaddvq_f32( vmulq_f32( q, q ) );
+    const float acceptableDelta = 0.00001f;
+
+    if (fabsf( mag2 ) > acceptableDelta && fabsf( mag2 - 1.0f ) > acceptableDelta)
+    {
+        vst1q_f32( &x, vmulq_n_f32( q, 1.0f / sqrtf( mag2 ) ) );
+    }
+}
+
+void Quaternion::GetMatrix( Matrix& outMatrix ) const
+{
+    const float32x4_t q = vld1q_f32( &x );
+    const float32x4_t q2 = vaddq_f32( q, q );
+
+    // 2xx, 2yy, 2zz
+    const float32x4_t squares = vmulq_f32( q, q2 );
+    // 1 - 2(yy + zz), 1 - 2(xx + zz), 1 - 2(xx + yy)
+    const float32x4_t diagonal = vsubq_f32( vsubq_f32( vdupq_n_f32( 1 ), SwizzleYXXX( squares ) ), SwizzleZZYY( squares ) );
+    // 2xz, 2xy, 2yz and 2wy, 2wz, 2wx
+    const float32x4_t qXXYY = vcombine_f32( vdup_laneq_f32( q, 0 ), vdup_laneq_f32( q, 1 ) );
+    const float32x4_t q2ZYZZ = vcombine_f32( vset_lane_f32( vgetq_lane_f32( q2, 2 ), vget_low_f32( q2 ), 0 ), vdup_laneq_f32( q2, 2 ) );
+    const float32x4_t q2YZXX = vsetq_lane_f32( vgetq_lane_f32( q2, 0 ), vextq_f32( q2, q2, 1 ), 2 );
+    const float32x4_t products = vmulq_f32( qXXYY, q2ZYZZ );
+    const float32x4_t wProducts = vmulq_laneq_f32( q2YZXX, q, 3 );
+    const float32x4_t sum = vaddq_f32( products, wProducts );
+    const float32x4_t difference = vsubq_f32( products, wProducts );
+
+    float32x4_t row0 = vsetq_lane_f32( vgetq_lane_f32( difference, 1 ), diagonal, 1 );
+    row0 = vsetq_lane_f32( 0, vsetq_lane_f32( vgetq_lane_f32( sum, 0 ), row0, 2 ), 3 );
+    float32x4_t row1 = vsetq_lane_f32( vgetq_lane_f32( sum, 1 ), diagonal, 0 );
+    row1 = vsetq_lane_f32( 0, vsetq_lane_f32( vgetq_lane_f32( difference, 2 ), row1, 2 ), 3 );
+    float32x4_t row2 = vsetq_lane_f32( vgetq_lane_f32( difference, 0 ), diagonal, 0 );
+    row2 = vsetq_lane_f32( 0, vsetq_lane_f32( vgetq_lane_f32( sum, 2 ), row2, 1 ), 3 );
+
+    alignas( 16 ) const float row3[ 4 ] = { 0, 0, 0, 1 };
+    vst1q_f32( &outMatrix.m[ 0 ], row0 );
+    vst1q_f32( &outMatrix.m[ 4 ], row1 );
+    vst1q_f32( &outMatrix.m[ 8 ], row2 );
+    vst1q_f32( &outMatrix.m[ 12 ], vld1q_f32( row3 ) );
+}
+#else
+Quaternion Quaternion::operator*( const Quaternion& aQ ) const
+{
+    return Quaternion( Vec3( w * aQ.x + x * aQ.w + y * aQ.z - z * aQ.y,
+        w * aQ.y + y * aQ.w + z * aQ.x - x * aQ.z,
+        w * aQ.z + z * aQ.w + x * aQ.y - y * aQ.x ),
+        w * aQ.w - x * aQ.x - y * aQ.y - z * aQ.z );
+}
+
+void Quaternion::Normalize()
+{
+    const float mag2 = w * w + x * x + y * y + z * z;
+    const float acceptableDelta = 0.00001f;
+
+    if (fabsf( mag2 ) > acceptableDelta && fabsf( mag2 - 1.0f ) > acceptableDelta)
+    {
+        const float oneOverMag = 1.0f / sqrtf( mag2 );
+
+        x *= oneOverMag;
+        y *= oneOverMag;
+        z *= oneOverMag;
+        w *= oneOverMag;
+    }
+}
+
 void Quaternion::GetMatrix( Matrix& outMatrix ) const
 {
     const float x2 = x * x;
@@ -691,6 +1048,416 @@ void Quaternion::GetMatrix( Matrix& outMatrix ) const
     outMatrix.m[ 14 ] = 0;
     outMatrix.m[ 15 ] = 1;
 }
+#endif
+
+void Affine3x4::MakeIdentity()
+{
+    for (unsigned i = 0; i < 12; ++i)
+    {
+        m[ i ] = 0;
+    }
+
+    m[ 0 ] = m[ 5 ] = m[ 10 ] = 1;
+}
+
+void Affine3x4::Compose( const Quaternion& rotation, const Vec3& position, float scale, Affine3x4& out )
+{
+    const float x2 = rotation.x * rotation.x;
+    const float y2 = rotation.y * rotation.y;
+    const float z2 = rotation.z * rotation.z;
+    const float xy = rotation.x * rotation.y;
+    const float xz = rotation.x * rotation.z;
+    const float yz = rotation.y * rotation.z;
+    const float wx = rotation.w * rotation.x;
+    const float wy = rotation.w * rotation.y;
+    const float wz = rotation.w * rotation.z;
+
+    // Columns of Quaternion::GetMatrix.
+    out.m[ 0 ] = (1 - 2 * (y2 + z2)) * scale;
+    out.m[ 1 ] = 2 * (xy + wz) * scale;
+    out.m[ 2 ] = 2 * (xz - wy) * scale;
+    out.m[ 3 ] = position.x;
+    out.m[ 4 ] = 2 * (xy - wz) * scale;
+    out.m[ 5 ] = (1 - 2 * (x2 + z2)) * scale;
+    out.m[ 6 ] = 2 * (yz + wx) * scale;
+    out.m[ 7 ] = position.y;
+    out.m[ 8 ] = 2 * (xz + wy) * scale;
+    out.m[ 9 ] = 2 * (yz - wx) * scale;
+    out.m[ 10 ] = (1 - 2 * (x2 + y2)) * scale;
+    out.m[ 11 ] = position.z;
+}
+
+#ifdef SIMD_SSE3
+static __m128 SwizzleYZXW( __m128 v ) { return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 3, 0, 2, 1 ) ); }
+static __m128 SwizzleZXYW( __m128 v ) { return _mm_shuffle_ps( v, v, _MM_SHUFFLE( 3, 1, 0, 2 ) ); }
+
+static __m128 Cross( __m128 a, __m128 b )
+{
+    return _mm_sub_ps( _mm_mul_ps( SwizzleYZXW( a ), SwizzleZXYW( b ) ), _mm_mul_ps( SwizzleZXYW( a ), SwizzleYZXW( b ) ) );
+}
+
+void Affine3x4::FromMatrix( const Matrix& matrix, Affine3x4& out )
+{
+    __m128 row0 = _mm_load_ps( &matrix.m[ 0 ] );
+    __m128 row1 = _mm_load_ps( &matrix.m[ 4 ] );
+    __m128 row2 = _mm_load_ps( &matrix.m[ 8 ] );
+    __m128 row3 = _mm_load_ps( &matrix.m[ 12 ] );
+    _MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+    _mm_store_ps( &out.m[ 0 ], row0 );
+    _mm_store_ps( &out.m[ 4 ], row1 );
+    _mm_store_ps( &out.m[ 8 ], row2 );
+}
+
+void Affine3x4::GetMatrix( Matrix& out ) const
+{
+    __m128 row0 = _mm_load_ps( &m[ 0 ] );
+    __m128 row1 = _mm_load_ps( &m[ 4 ] );
+    __m128 row2 = _mm_load_ps( &m[ 8 ] );
+    __m128 row3 = _mm_setr_ps( 0, 0, 0, 1 );
+    _MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+    _mm_store_ps( &out.m[ 0 ], row0 );
+    _mm_store_ps( &out.m[ 4 ], row1 );
+    _mm_store_ps( &out.m[ 8 ], row2 );
+    _mm_store_ps( &out.m[ 12 ], row3 );
+}
+
+// The rows' cross products are the inverse 3x3 part's columns times the determinant.
+void Affine3x4::Invert( const Affine3x4& affine, Affine3x4& out )
+{
+    const __m128 row0 = _mm_load_ps( &affine.m[ 0 ] );
+    const __m128 row1 = _mm_load_ps( &affine.m[ 4 ] );
+    const __m128 row2 = _mm_load_ps( &affine.m[ 8 ] );
+    const __m128 xyzMask = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+    const __m128 xyz0 = _mm_and_ps( row0, xyzMask );
+    const __m128 xyz1 = _mm_and_ps( row1, xyzMask );
+    const __m128 xyz2 = _mm_and_ps( row2, xyzMask );
+
+    __m128 column0 = Cross( xyz1, xyz2 );
+    __m128 column1 = Cross( xyz2, xyz0 );
+    __m128 column2 = Cross( xyz0, xyz1 );
+
+    const __m128 det = SumLanes( _mm_mul_ps( xyz0, column0 ) );
+    const float acceptableDelta = 0.0001f;
+
+    if (fabsf( _mm_cvtss_f32( det ) ) < acceptableDelta)
+    {
+        out.MakeIdentity();
+        return;
+    }
+
+    column0 = _mm_div_ps( column0, det );
+    column1 = _mm_div_ps( column1, det );
+    column2 = _mm_div_ps( column2, det );
+
+    __m128 translation = _mm_mul_ps( column0, _mm_shuffle_ps( row0, row0, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+    translation = _mm_add_ps( translation, _mm_mul_ps( column1, _mm_shuffle_ps( row1, row1, _MM_SHUFFLE( 3, 3, 3, 3 ) ) ) );
+    translation = _mm_add_ps( translation, _mm_mul_ps( column2, _mm_shuffle_ps( row2, row2, _MM_SHUFFLE( 3, 3, 3, 3 ) ) ) );
+    translation = _mm_sub_ps( _mm_setzero_ps(), translation );
+
+    _MM_TRANSPOSE4_PS( column0, column1, column2, translation );
+    _mm_store_ps( &out.m[ 0 ], column0 );
+    _mm_store_ps( &out.m[ 4 ], column1 );
+    _mm_store_ps( &out.m[ 8 ], column2 );
+}
+
+void Affine3x4::Multiply( const Affine3x4& ma, const Affine3x4& mb, Affine3x4& out )
+{
+    const __m128 rowA0 = _mm_load_ps( &ma.m[ 0 ] );
+    const __m128 rowA1 = _mm_load_ps( &ma.m[ 4 ] );
+    const __m128 rowA2 = _mm_load_ps( &ma.m[ 8 ] );
+    const __m128 translationMask = _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+    __m128 rows[ 3 ];
+
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        const __m128 rowB = _mm_load_ps( &mb.m[ r * 4 ] );
+        __m128 row = _mm_mul_ps( _mm_shuffle_ps( rowB, rowB, _MM_SHUFFLE( 0, 0, 0, 0 ) ), rowA0 );
+        row = _mm_add_ps( row, _mm_mul_ps( _mm_shuffle_ps( rowB, rowB, _MM_SHUFFLE( 1, 1, 1, 1 ) ), rowA1 ) );
+        row = _mm_add_ps( row, _mm_mul_ps( _mm_shuffle_ps( rowB, rowB, _MM_SHUFFLE( 2, 2, 2, 2 ) ), rowA2 ) );
+        rows[ r ] = _mm_add_ps( row, _mm_and_ps( rowB, translationMask ) );
+    }
+
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        _mm_store_ps( &out.m[ r * 4 ], rows[ r ] );
+    }
+}
+
+void Affine3x4::MultiplyProjection( const Affine3x4& affine, const Matrix& projection, Matrix& out )
+{
+    __m128 row0 = _mm_load_ps( &affine.m[ 0 ] );
+    __m128 row1 = _mm_load_ps( &affine.m[ 4 ] );
+    __m128 row2 = _mm_load_ps( &affine.m[ 8 ] );
+    __m128 row3 = _mm_setr_ps( 0, 0, 0, 1 );
+    _MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+
+    const __m128 projectionRows[ 4 ] = { _mm_load_ps( &projection.m[ 0 ] ), _mm_load_ps( &projection.m[ 4 ] ),
+                                         _mm_load_ps( &projection.m[ 8 ] ), _mm_load_ps( &projection.m[ 12 ] ) };
+    const __m128 rows[ 4 ] = { row0, row1, row2, row3 };
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        __m128 result = _mm_mul_ps( _mm_shuffle_ps( rows[ i ], rows[ i ], _MM_SHUFFLE( 0, 0, 0, 0 ) ), projectionRows[ 0 ] );
+        result = _mm_add_ps( result, _mm_mul_ps( _mm_shuffle_ps( rows[ i ], rows[ i ], _MM_SHUFFLE( 1, 1, 1, 1 ) ), projectionRows[ 1 ] ) );
+        result = _mm_add_ps( result, _mm_mul_ps( _mm_shuffle_ps( rows[ i ], rows[ i ], _MM_SHUFFLE( 2, 2, 2, 2 ) ), projectionRows[ 2 ] ) );
+        result = _mm_add_ps( result, _mm_mul_ps( _mm_shuffle_ps( rows[ i ], rows[ i ], _MM_SHUFFLE( 3, 3, 3, 3 ) ), projectionRows[ 3 ] ) );
+        _mm_store_ps( &out.m[ i * 4 ], result );
+    }
+}
+
+// Dot products of the rows with v, in x, y and z.
+static void TransformAffine( __m128 v, const Affine3x4& affine, Vec3& out )
+{
+    __m128 x = _mm_mul_ps( _mm_load_ps( &affine.m[ 0 ] ), v );
+    __m128 y = _mm_mul_ps( _mm_load_ps( &affine.m[ 4 ] ), v );
+    __m128 z = _mm_mul_ps( _mm_load_ps( &affine.m[ 8 ] ), v );
+    __m128 w = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS( x, y, z, w );
+
+    alignas( 16 ) float result[ 4 ];
+    _mm_store_ps( result, _mm_add_ps( _mm_add_ps( x, y ), _mm_add_ps( z, w ) ) );
+
+    out.x = result[ 0 ];
+    out.y = result[ 1 ];
+    out.z = result[ 2 ];
+}
+
+void Affine3x4::TransformDirection( const Vec3& dir, const Affine3x4& affine, Vec3& out )
+{
+    TransformAffine( _mm_setr_ps( dir.x, dir.y, dir.z, 0 ), affine, out );
+}
+
+void Affine3x4::TransformPoint( const Vec3& point, const Affine3x4& affine, Vec3& out )
+{
+    TransformAffine( _mm_setr_ps( point.x, point.y, point.z, 1 ), affine, out );
+}
+#elif SIMD_NEON
+static float32x4_t SwizzleYZXW( float32x4_t v ) { return vsetq_lane_f32( vgetq_lane_f32( v, 3 ), vsetq_lane_f32( vgetq_lane_f32( v, 0 ), vextq_f32( v, v, 1 ), 2 ), 3 ); }
+static float32x4_t SwizzleZXYW( float32x4_t v ) { return SwizzleYZXW( SwizzleYZXW( v ) ); }
+
+static float32x4_t Cross( float32x4_t a, float32x4_t b )
+{
+    return vmlsq_f32( vmulq_f32( SwizzleYZXW( a ), SwizzleZXYW( b ) ), SwizzleZXYW( a ), SwizzleYZXW( b ) );
+}
+
+void Affine3x4::FromMatrix( const Matrix& matrix, Affine3x4& out )
+{
+    const float32x4x4_t columns = vld4q_f32( matrix.m );
+    vst1q_f32( &out.m[ 0 ], columns.val[ 0 ] );
+    vst1q_f32( &out.m[ 4 ], columns.val[ 1 ] );
+    vst1q_f32( &out.m[ 8 ], columns.val[ 2 ] );
+}
+
+void Affine3x4::GetMatrix( Matrix& out ) const
+{
+    alignas( 16 ) const float lastColumn[ 4 ] = { 0, 0, 0, 1 };
+
+    float32x4x4_t columns;
+    columns.val[ 0 ] = vld1q_f32( &m[ 0 ] );
+    columns.val[ 1 ] = vld1q_f32( &m[ 4 ] );
+    columns.val[ 2 ] = vld1q_f32( &m[ 8 ] );
+    columns.val[ 3 ] = vld1q_f32( lastColumn );
+    vst4q_f32( out.m, columns );
+}
+
+// The rows' cross products are the inverse 3x3 part's columns times the determinant.
+void Affine3x4::Invert( const Affine3x4& affine, Affine3x4& out )
+{
+    const float32x4_t row0 = vld1q_f32( &affine.m[ 0 ] );
+    const float32x4_t row1 = vld1q_f32( &affine.m[ 4 ] );
+    const float32x4_t row2 = vld1q_f32( &affine.m[ 8 ] );
+    const float32x4_t xyz0 = vsetq_lane_f32( 0, row0, 3 );
+    const float32x4_t xyz1 = vsetq_lane_f32( 0, row1, 3 );
+    const float32x4_t xyz2 = vsetq_lane_f32( 0, row2, 3 );
+
+    float32x4_t column0 = Cross( xyz1, xyz2 );
+    float32x4_t column1 = Cross( xyz2, xyz0 );
+    float32x4_t column2 = Cross( xyz0, xyz1 );
+
+    const float det = vaddvq_f32( vmulq_f32( xyz0, column0 ) );
+    const float acceptableDelta = 0.0001f;
+
+    if (fabsf( det ) < acceptableDelta)
+    {
+        out.MakeIdentity();
+        return;
+    }
+
+    const float32x4_t detVec = vdupq_n_f32( det );
+    column0 = vdivq_f32( column0, detVec );
+    column1 = vdivq_f32( column1, detVec );
+    column2 = vdivq_f32( column2, detVec );
+
+    float32x4_t translation = vmulq_laneq_f32( column0, row0, 3 );
+    translation = vmlaq_laneq_f32( translation, column1, row1, 3 );
+    translation = vmlaq_laneq_f32( translation, column2, row2, 3 );
+
+    float32x4x4_t columns;
+    columns.val[ 0 ] = column0;
+    columns.val[ 1 ] = column1;
+    columns.val[ 2 ] = column2;
+    columns.val[ 3 ] = vnegq_f32( translation );
+
+    Matrix transposed;
+    vst4q_f32( transposed.m, columns );
+    teMemcpy( out.m, transposed.m, sizeof( out.m ) );
+}
+
+void Affine3x4::Multiply( const Affine3x4& ma, const Affine3x4& mb, Affine3x4& out )
+{
+    const float32x4_t rowA0 = vld1q_f32( &ma.m[ 0 ] );
+    const float32x4_t rowA1 = vld1q_f32( &ma.m[ 4 ] );
+    const float32x4_t rowA2 = vld1q_f32( &ma.m[ 8 ] );
+    float32x4_t rows[ 3 ];
+
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        const float32x4_t rowB = vld1q_f32( &mb.m[ r * 4 ] );
+        float32x4_t row = vmulq_laneq_f32( rowA0, rowB, 0 );
+        row = vmlaq_laneq_f32( row, rowA1, rowB, 1 );
+        row = vmlaq_laneq_f32( row, rowA2, rowB, 2 );
+        rows[ r ] = vsetq_lane_f32( vgetq_lane_f32( row, 3 ) + vgetq_lane_f32( rowB, 3 ), row, 3 );
+    }
+
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        vst1q_f32( &out.m[ r * 4 ], rows[ r ] );
+    }
+}
+
+void Affine3x4::MultiplyProjection( const Affine3x4& affine, const Matrix& projection, Matrix& out )
+{
+    Matrix local;
+    affine.GetMatrix( local );
+    Matrix::Multiply( local, projection, out );
+}
+
+void Affine3x4::TransformDirection( const Vec3& dir, const Affine3x4& affine, Vec3& out )
+{
+    alignas( 16 ) const float v[ 4 ] = { dir.x, dir.y, dir.z, 0 };
+    const float32x4_t vec = vld1q_f32( v );
+
+    out.x = vaddvq_f32( vmulq_f32( vld1q_f32( &affine.m[ 0 ] ), vec ) );
+    out.y = vaddvq_f32( vmulq_f32( vld1q_f32( &affine.m[ 4 ] ), vec ) );
+    out.z = vaddvq_f32( vmulq_f32( vld1q_f32( &affine.m[ 8 ] ), vec ) );
+}
+
+void Affine3x4::TransformPoint( const Vec3& point, const Affine3x4& affine, Vec3& out )
+{
+    alignas( 16 ) const float v[ 4 ] = { point.x, point.y, point.z, 1 };
+    const float32x4_t vec = vld1q_f32( v );
+
+    out.x = vaddvq_f32( vmulq_f32( vld1q_f32( &affine.m[ 0 ] ), vec ) );
+    out.y = vaddvq_f32( vmulq_f32( vld1q_f32( &affine.m[ 4 ] ), vec ) );
+    out.z = vaddvq_f32( vmulq_f32( vld1q_f32( &affine.m[ 8 ] ), vec ) );
+}
+#else
+void Affine3x4::FromMatrix( const Matrix& matrix, Affine3x4& out )
+{
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        for (unsigned c = 0; c < 4; ++c)
+        {
+            out.m[ r * 4 + c ] = matrix.m[ c * 4 + r ];
+        }
+    }
+}
+
+void Affine3x4::GetMatrix( Matrix& out ) const
+{
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        for (unsigned c = 0; c < 4; ++c)
+        {
+            out.m[ c * 4 + r ] = m[ r * 4 + c ];
+        }
+    }
+
+    out.m[ 3 ] = out.m[ 7 ] = out.m[ 11 ] = 0;
+    out.m[ 15 ] = 1;
+}
+
+// The rows' cross products are the inverse 3x3 part's columns times the determinant.
+void Affine3x4::Invert( const Affine3x4& affine, Affine3x4& out )
+{
+    const Vec3 row0( affine.m[ 0 ], affine.m[ 1 ], affine.m[ 2 ] );
+    const Vec3 row1( affine.m[ 4 ], affine.m[ 5 ], affine.m[ 6 ] );
+    const Vec3 row2( affine.m[ 8 ], affine.m[ 9 ], affine.m[ 10 ] );
+    const Vec3 translation( affine.m[ 3 ], affine.m[ 7 ], affine.m[ 11 ] );
+
+    Vec3 columns[ 3 ] = { Vec3::Cross( row1, row2 ), Vec3::Cross( row2, row0 ), Vec3::Cross( row0, row1 ) };
+    const float det = Vec3::Dot( row0, columns[ 0 ] );
+    const float acceptableDelta = 0.0001f;
+
+    if (fabsf( det ) < acceptableDelta)
+    {
+        out.MakeIdentity();
+        return;
+    }
+
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        columns[ c ] = columns[ c ] * (1.0f / det);
+    }
+
+    const Vec3 inverseTranslation = (columns[ 0 ] * translation.x + columns[ 1 ] * translation.y) + columns[ 2 ] * translation.z;
+
+    out.m[ 0 ] = columns[ 0 ].x;
+    out.m[ 1 ] = columns[ 1 ].x;
+    out.m[ 2 ] = columns[ 2 ].x;
+    out.m[ 3 ] = -inverseTranslation.x;
+    out.m[ 4 ] = columns[ 0 ].y;
+    out.m[ 5 ] = columns[ 1 ].y;
+    out.m[ 6 ] = columns[ 2 ].y;
+    out.m[ 7 ] = -inverseTranslation.y;
+    out.m[ 8 ] = columns[ 0 ].z;
+    out.m[ 9 ] = columns[ 1 ].z;
+    out.m[ 10 ] = columns[ 2 ].z;
+    out.m[ 11 ] = -inverseTranslation.z;
+}
+
+void Affine3x4::Multiply( const Affine3x4& ma, const Affine3x4& mb, Affine3x4& out )
+{
+    Affine3x4 result;
+
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        for (unsigned c = 0; c < 4; ++c)
+        {
+            result.m[ r * 4 + c ] = (mb.m[ r * 4 + 0 ] * ma.m[ c ] + mb.m[ r * 4 + 1 ] * ma.m[ 4 + c ]) + mb.m[ r * 4 + 2 ] * ma.m[ 8 + c ];
+        }
+
+        result.m[ r * 4 + 3 ] += mb.m[ r * 4 + 3 ];
+    }
+
+    out = result;
+}
+
+void Affine3x4::MultiplyProjection( const Affine3x4& affine, const Matrix& projection, Matrix& out )
+{
+    Matrix local;
+    affine.GetMatrix( local );
+    Matrix::Multiply( local, projection, out );
+}
+
+void Affine3x4::TransformDirection( const Vec3& dir, const Affine3x4& affine, Vec3& out )
+{
+    const float* a = affine.m;
+
+    out.x = (a[ 0 ] * dir.x + a[ 1 ] * dir.y) + a[ 2 ] * dir.z;
+    out.y = (a[ 4 ] * dir.x + a[ 5 ] * dir.y) + a[ 6 ] * dir.z;
+    out.z = (a[ 8 ] * dir.x + a[ 9 ] * dir.y) + a[ 10 ] * dir.z;
+}
+
+void Affine3x4::TransformPoint( const Vec3& point, const Affine3x4& affine, Vec3& out )
+{
+    const float* a = affine.m;
+
+    out.x = (a[ 0 ] * point.x + a[ 1 ] * point.y) + (a[ 2 ] * point.z + a[ 3 ]);
+    out.y = (a[ 4 ] * point.x + a[ 5 ] * point.y) + (a[ 6 ] * point.z + a[ 7 ]);
+    out.z = (a[ 8 ] * point.x + a[ 9 ] * point.y) + (a[ 10 ] * point.z + a[ 11 ]);
+}
+#endif
 
 void teGetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] )
 {
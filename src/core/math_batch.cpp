@@ -0,0 +1,316 @@
+// Batched math kernels. On x86 the CPU is queried once at startup and AVX2/FMA versions are used when available,
+// so the engine can still be built for SSE3 and run on older CPUs. Other targets use loops over the single versions.
+#include "affine3x4.h"
+#include "matrix.h"
+#include "quaternion.h"
+#include "te_stdlib.h"
+#include "vec3.h"
+#include <stdlib.h>
+
+#ifdef SIMD_SSE3
+#include <immintrin.h>
+#if _MSC_VER
+#include <intrin.h>
+// MSVC allows AVX2 intrinsics in any function.
+#define TE_TARGET_AVX2
+#else
+#define TE_TARGET_AVX2 __attribute__(( target( "avx2,fma" ) ))
+#endif
+#endif
+
+static_assert( sizeof( Vec3 ) == 3 * sizeof( float ), "Batch kernels load Vec3 arrays as floats" );
+
+static void MultiplyBatchGeneric( const Matrix* ma, const Matrix& mb, Matrix* out, unsigned count )
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Matrix::Multiply( ma[ i ], mb, out[ i ] );
+    }
+}
+
+static void TransformPointsGeneric( const Vec3* points, const Matrix& mat, Vec3* out, unsigned count )
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Matrix::TransformPoint( points[ i ], mat, out[ i ] );
+    }
+}
+
+static void ComposeAffineBatchGeneric( const Quaternion* rotations, const Vec3* positions, const float* scales, const unsigned* indices, unsigned count, Affine3x4* out )
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const unsigned index = indices[ i ];
+        Affine3x4::Compose( rotations[ index ], positions[ index ], scales[ index ], out[ index ] );
+    }
+}
+
+// Same test as BoxInFrustum: a box is outside if its most positive vertex is behind any plane.
+static void BoxesInPlanesGeneric( const Vec4* planes, unsigned planeCount, const Vec3* mins, const Vec3* maxs, unsigned count, bool* outIsInside )
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        bool isInside = true;
+
+        for (unsigned p = 0; p < planeCount && isInside; ++p)
+        {
+            const float x = planes[ p ].x >= 0 ? maxs[ i ].x : mins[ i ].x;
+            const float y = planes[ p ].y >= 0 ? maxs[ i ].y : mins[ i ].y;
+            const float z = planes[ p ].z >= 0 ? maxs[ i ].z : mins[ i ].z;
+
+            isInside = !(planes[ p ].x * x + planes[ p ].y * y + planes[ p ].z * z + planes[ p ].w < 0);
+        }
+
+        outIsInside[ i ] = isInside;
+    }
+}
+
+#ifdef SIMD_SSE3
+static bool CpuHasAvx2AndFma()
+{
+#if _MSC_VER
+    int info[ 4 ];
+    __cpuid( info, 0 );
+
+    if (info[ 0 ] < 7)
+    {
+        return false;
+    }
+
+    __cpuid( info, 1 );
+    const bool hasFma = (info[ 2 ] & (1 << 12)) != 0;
+    const bool hasOsxsave = (info[ 2 ] & (1 << 27)) != 0;
+
+    // The OS must also save the upper halves of YMM registers on context switches.
+    if (!hasFma || !hasOsxsave || (_xgetbv( 0 ) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex( info, 7, 0 );
+    return (info[ 1 ] & (1 << 5)) != 0;
+#else
+    // Needed because this runs from a static initializer, possibly before libgcc's own.
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+#endif
+}
+
+// Two rows of a are multiplied per 256-bit register. Both halves of a are loaded before storing, so out can be ma.
+TE_TARGET_AVX2 static void MultiplyBatchAvx2( const Matrix* ma, const Matrix& mb, Matrix* out, unsigned count )
+{
+    const __m256 b0 = _mm256_broadcast_ps( (const __m128*)&mb.m[ 0 ] );
+    const __m256 b1 = _mm256_broadcast_ps( (const __m128*)&mb.m[ 4 ] );
+    const __m256 b2 = _mm256_broadcast_ps( (const __m128*)&mb.m[ 8 ] );
+    const __m256 b3 = _mm256_broadcast_ps( (const __m128*)&mb.m[ 12 ] );
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const __m256 a01 = _mm256_loadu_ps( &ma[ i ].m[ 0 ] );
+        const __m256 a23 = _mm256_loadu_ps( &ma[ i ].m[ 8 ] );
+
+        __m256 r01 = _mm256_mul_ps( _mm256_shuffle_ps( a01, a01, 0x00 ), b0 );
+        r01 = _mm256_fmadd_ps( _mm256_shuffle_ps( a01, a01, 0x55 ), b1, r01 );
+        r01 = _mm256_fmadd_ps( _mm256_shuffle_ps( a01, a01, 0xAA ), b2, r01 );
+        r01 = _mm256_fmadd_ps( _mm256_shuffle_ps( a01, a01, 0xFF ), b3, r01 );
+
+        __m256 r23 = _mm256_mul_ps( _mm256_shuffle_ps( a23, a23, 0x00 ), b0 );
+        r23 = _mm256_fmadd_ps( _mm256_shuffle_ps( a23, a23, 0x55 ), b1, r23 );
+        r23 = _mm256_fmadd_ps( _mm256_shuffle_ps( a23, a23, 0xAA ), b2, r23 );
+        r23 = _mm256_fmadd_ps( _mm256_shuffle_ps( a23, a23, 0xFF ), b3, r23 );
+
+        _mm256_storeu_ps( &out[ i ].m[ 0 ], r01 );
+        _mm256_storeu_ps( &out[ i ].m[ 8 ], r23 );
+    }
+}
+
+// 8 points per iteration. Components are gathered from the Vec3 array, so no SoA copy is needed.
+TE_TARGET_AVX2 static void TransformPointsAvx2( const Vec3* points, const Matrix& mat, Vec3* out, unsigned count )
+{
+    const __m256i offsets = _mm256_setr_epi32( 0, 3, 6, 9, 12, 15, 18, 21 );
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const float* first = &points[ i ].x;
+        const __m256 x = _mm256_i32gather_ps( first, offsets, 4 );
+        const __m256 y = _mm256_i32gather_ps( first + 1, offsets, 4 );
+        const __m256 z = _mm256_i32gather_ps( first + 2, offsets, 4 );
+
+        alignas( 32 ) float results[ 3 ][ 8 ];
+
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            __m256 r = _mm256_fmadd_ps( z, _mm256_set1_ps( mat.m[ 8 + c ] ), _mm256_set1_ps( mat.m[ 12 + c ] ) );
+            r = _mm256_fmadd_ps( y, _mm256_set1_ps( mat.m[ 4 + c ] ), r );
+            r = _mm256_fmadd_ps( x, _mm256_set1_ps( mat.m[ c ] ), r );
+            _mm256_store_ps( results[ c ], r );
+        }
+
+        for (unsigned j = 0; j < 8; ++j)
+        {
+            out[ i + j ] = Vec3( results[ 0 ][ j ], results[ 1 ][ j ], results[ 2 ][ j ] );
+        }
+    }
+
+    TransformPointsGeneric( points + i, mat, out + i, count - i );
+}
+
+// Transposes 4 vectors of 8 transforms' elements into a row of each transform.
+TE_TARGET_AVX2 static void StoreAffineRows( __m256 c0, __m256 c1, __m256 c2, __m256 c3, const unsigned* indices, Affine3x4* out, unsigned row )
+{
+    const __m256 t0 = _mm256_unpacklo_ps( c0, c1 );
+    const __m256 t1 = _mm256_unpackhi_ps( c0, c1 );
+    const __m256 t2 = _mm256_unpacklo_ps( c2, c3 );
+    const __m256 t3 = _mm256_unpackhi_ps( c2, c3 );
+    const __m256 rows[ 4 ] = { _mm256_shuffle_ps( t0, t2, 0x44 ), _mm256_shuffle_ps( t0, t2, 0xEE ), _mm256_shuffle_ps( t1, t3, 0x44 ), _mm256_shuffle_ps( t1, t3, 0xEE ) };
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        _mm_storeu_ps( &out[ indices[ i ] ].m[ row * 4 ], _mm256_castps256_ps128( rows[ i ] ) );
+        _mm_storeu_ps( &out[ indices[ i + 4 ] ].m[ row * 4 ], _mm256_extractf128_ps( rows[ i ], 1 ) );
+    }
+}
+
+// 8 transforms per iteration, with the same formulas as Affine3x4::Compose. Inputs are gathered by index from the streams.
+TE_TARGET_AVX2 static void ComposeAffineBatchAvx2( const Quaternion* rotations, const Vec3* positions, const float* scales, const unsigned* indices, unsigned count, Affine3x4* out )
+{
+    const __m256 one = _mm256_set1_ps( 1 );
+    const __m256 two = _mm256_set1_ps( 2 );
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i index = _mm256_loadu_si256( (const __m256i*)&indices[ i ] );
+        const __m256i quaternionOffsets = _mm256_slli_epi32( index, 2 );
+        const __m256i vec3Offsets = _mm256_add_epi32( _mm256_slli_epi32( index, 1 ), index );
+        const float* rotation = &rotations[ 0 ].x;
+        const float* position = &positions[ 0 ].x;
+        const __m256 x = _mm256_i32gather_ps( rotation, quaternionOffsets, 4 );
+        const __m256 y = _mm256_i32gather_ps( rotation + 1, quaternionOffsets, 4 );
+        const __m256 z = _mm256_i32gather_ps( rotation + 2, quaternionOffsets, 4 );
+        const __m256 w = _mm256_i32gather_ps( rotation + 3, quaternionOffsets, 4 );
+        const __m256 scale = _mm256_i32gather_ps( scales, index, 4 );
+
+        const __m256 x2 = _mm256_mul_ps( x, x );
+        const __m256 y2 = _mm256_mul_ps( y, y );
+        const __m256 z2 = _mm256_mul_ps( z, z );
+        const __m256 xy = _mm256_mul_ps( x, y );
+        const __m256 xz = _mm256_mul_ps( x, z );
+        const __m256 yz = _mm256_mul_ps( y, z );
+        const __m256 wx = _mm256_mul_ps( w, x );
+        const __m256 wy = _mm256_mul_ps( w, y );
+        const __m256 wz = _mm256_mul_ps( w, z );
+        const __m256 twoScale = _mm256_mul_ps( two, scale );
+
+        const __m256 m0 = _mm256_mul_ps( _mm256_fnmadd_ps( two, _mm256_add_ps( y2, z2 ), one ), scale );
+        const __m256 m1 = _mm256_mul_ps( _mm256_add_ps( xy, wz ), twoScale );
+        const __m256 m2 = _mm256_mul_ps( _mm256_sub_ps( xz, wy ), twoScale );
+        const __m256 m4 = _mm256_mul_ps( _mm256_sub_ps( xy, wz ), twoScale );
+        const __m256 m5 = _mm256_mul_ps( _mm256_fnmadd_ps( two, _mm256_add_ps( x2, z2 ), one ), scale );
+        const __m256 m6 = _mm256_mul_ps( _mm256_add_ps( yz, wx ), twoScale );
+        const __m256 m8 = _mm256_mul_ps( _mm256_add_ps( xz, wy ), twoScale );
+        const __m256 m9 = _mm256_mul_ps( _mm256_sub_ps( yz, wx ), twoScale );
+        const __m256 m10 = _mm256_mul_ps( _mm256_fnmadd_ps( two, _mm256_add_ps( x2, y2 ), one ), scale );
+
+        StoreAffineRows( m0, m1, m2, _mm256_i32gather_ps( position, vec3Offsets, 4 ), indices + i, out, 0 );
+        StoreAffineRows( m4, m5, m6, _mm256_i32gather_ps( position + 1, vec3Offsets, 4 ), indices + i, out, 1 );
+        StoreAffineRows( m8, m9, m10, _mm256_i32gather_ps( position + 2, vec3Offsets, 4 ), indices + i, out, 2 );
+    }
+
+    ComposeAffineBatchGeneric( rotations, positions, scales, indices + i, count - i, out );
+}
+
+// 8 boxes per iteration. The comparison is "not less than" so that NaN distances keep the box, like BoxInFrustum.
+TE_TARGET_AVX2 static void BoxesInPlanesAvx2( const Vec4* planes, unsigned planeCount, const Vec3* mins, const Vec3* maxs, unsigned count, bool* outIsInside )
+{
+    const __m256i offsets = _mm256_setr_epi32( 0, 3, 6, 9, 12, 15, 18, 21 );
+    unsigned i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const float* firstMin = &mins[ i ].x;
+        const float* firstMax = &maxs[ i ].x;
+        const __m256 minX = _mm256_i32gather_ps( firstMin, offsets, 4 );
+        const __m256 minY = _mm256_i32gather_ps( firstMin + 1, offsets, 4 );
+        const __m256 minZ = _mm256_i32gather_ps( firstMin + 2, offsets, 4 );
+        const __m256 maxX = _mm256_i32gather_ps( firstMax, offsets, 4 );
+        const __m256 maxY = _mm256_i32gather_ps( firstMax + 1, offsets, 4 );
+        const __m256 maxZ = _mm256_i32gather_ps( firstMax + 2, offsets, 4 );
+
+        __m256 isInside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+
+        for (unsigned p = 0; p < planeCount; ++p)
+        {
+            const Vec4& plane = planes[ p ];
+            __m256 distance = _mm256_fmadd_ps( plane.z >= 0 ? maxZ : minZ, _mm256_set1_ps( plane.z ), _mm256_set1_ps( plane.w ) );
+            distance = _mm256_fmadd_ps( plane.y >= 0 ? maxY : minY, _mm256_set1_ps( plane.y ), distance );
+            distance = _mm256_fmadd_ps( plane.x >= 0 ? maxX : minX, _mm256_set1_ps( plane.x ), distance );
+            isInside = _mm256_and_ps( isInside, _mm256_cmp_ps( distance, _mm256_setzero_ps(), _CMP_NLT_UQ ) );
+        }
+
+        const int mask = _mm256_movemask_ps( isInside );
+
+        for (unsigned j = 0; j < 8; ++j)
+        {
+            outIsInside[ i + j ] = (mask & (1 << j)) != 0;
+        }
+    }
+
+    BoxesInPlanesGeneric( planes, planeCount, mins + i, maxs + i, count - i, outIsInside + i );
+}
+#endif
+
+struct MathBatchKernels
+{
+    void (*multiplyBatch)( const Matrix* ma, const Matrix& mb, Matrix* out, unsigned count );
+    void (*transformPoints)( const Vec3* points, const Matrix& mat, Vec3* out, unsigned count );
+    void (*composeAffineBatch)( const Quaternion* rotations, const Vec3* positions, const float* scales, const unsigned* indices, unsigned count, Affine3x4* out );
+    void (*boxesInPlanes)( const Vec4* planes, unsigned planeCount, const Vec3* mins, const Vec3* maxs, unsigned count, bool* outIsInside );
+    const char* name;
+};
+
+// Setting the environment variable TE_NO_AVX2 selects the fallbacks, for comparing both paths on the same machine.
+static MathBatchKernels SelectMathBatchKernels()
+{
+#ifdef SIMD_SSE3
+    if (CpuHasAvx2AndFma() && getenv( "TE_NO_AVX2" ) == nullptr)
+    {
+        return { MultiplyBatchAvx2, TransformPointsAvx2, ComposeAffineBatchAvx2, BoxesInPlanesAvx2, "AVX2+FMA" };
+    }
+
+    return { MultiplyBatchGeneric, TransformPointsGeneric, ComposeAffineBatchGeneric, BoxesInPlanesGeneric, "SSE3" };
+#elif SIMD_NEON
+    return { MultiplyBatchGeneric, TransformPointsGeneric, ComposeAffineBatchGeneric, BoxesInPlanesGeneric, "NEON" };
+#else
+    return { MultiplyBatchGeneric, TransformPointsGeneric, ComposeAffineBatchGeneric, BoxesInPlanesGeneric, "Scalar" };
+#endif
+}
+
+static const MathBatchKernels mathBatchKernels = SelectMathBatchKernels();
+
+void Matrix::MultiplyBatch( const Matrix* ma, const Matrix& mb, Matrix* out, unsigned count )
+{
+    mathBatchKernels.multiplyBatch( ma, mb, out, count );
+}
+
+void Matrix::TransformPoints( const Vec3* points, const Matrix& mat, Vec3* out, unsigned count )
+{
+    mathBatchKernels.transformPoints( points, mat, out, count );
+}
+
+void Affine3x4::ComposeBatch( const Quaternion* rotations, const Vec3* positions, const float* scales, const unsigned* indices, unsigned count, Affine3x4* out )
+{
+    mathBatchKernels.composeAffineBatch( rotations, positions, scales, indices, count, out );
+}
+
+// Planes are normal in xyz and distance in w, normals pointing inside.
+void BoxesInPlanes( const Vec4* planes, unsigned planeCount, const Vec3* mins, const Vec3* maxs, unsigned count, bool* outIsInside )
+{
+    mathBatchKernels.boxesInPlanes( planes, planeCount, mins, maxs, count, outIsInside );
+}
+
+const char* MathBatchGetKernelName()
+{
+    return mathBatchKernels.name;
+}
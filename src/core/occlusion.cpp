@@ -0,0 +1,325 @@
+#include "occlusion.h"
+#include "te_stdlib.h"
+#include "vec3.h"
+#include "matrix.h"
+#include <math.h>
+#ifdef SIMD_SSE3
+#include <pmmintrin.h>
+#endif
+
+static constexpr int DepthWidth = 256;
+static constexpr int DepthHeight = 128;
+static constexpr int TileSize = 8;
+static constexpr int TileCountX = DepthWidth / TileSize;
+static constexpr int TileCountY = DepthHeight / TileSize;
+
+struct OcclusionBuffer
+{
+    alignas( 16 ) float depth[ DepthWidth * DepthHeight ]; // Nearest occluder depth per pixel.
+    float tileMaxDepth[ TileCountX * TileCountY ]; // Farthest depth in each tile.
+    unsigned occluderCount = 0;
+};
+
+static OcclusionBuffer occlusion;
+TE_TRACK_STATIC_MEMORY( occlusionMemory, teMemoryTag::Scene, sizeof( occlusion ) );
+
+#ifdef SIMD_SSE3
+// Set by tools/bench to check that the SSE3 rasterizer writes the same depths as the scalar one.
+static bool occlusionForceScalar = false;
+#endif
+
+template< typename T > static T OcclusionMin( T a, T b )
+{
+    return a < b ? a : b;
+}
+
+template< typename T > static T OcclusionMax( T a, T b )
+{
+    return a > b ? a : b;
+}
+
+// Box corner i has min or max x, y and z selected by bits 0, 1 and 2.
+static const unsigned boxFaces[ 6 ][ 4 ] =
+{
+    { 0, 2, 6, 4 }, { 1, 5, 7, 3 },
+    { 0, 4, 5, 1 }, { 2, 3, 7, 6 },
+    { 0, 1, 3, 2 }, { 4, 6, 7, 5 }
+};
+
+static void GetClipCorners( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix& localToClip, Vec4 outCorners[ 8 ] )
+{
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        const Vec4 corner( (i & 1) ? aabbMax.x : aabbMin.x, (i & 2) ? aabbMax.y : aabbMin.y, (i & 4) ? aabbMax.z : aabbMin.z, 1 );
+        Matrix::TransformPoint( corner, localToClip, outCorners[ i ] );
+    }
+}
+
+// Clip space to pixels. z is clip z / w.
+static Vec3 ClipToScreen( const Vec4& clip )
+{
+    const float invW = 1.0f / clip.w;
+    return Vec3( (clip.x * invW * 0.5f + 0.5f) * DepthWidth, (clip.y * invW * 0.5f + 0.5f) * DepthHeight, clip.z * invW );
+}
+
+// Sutherland-Hodgman against the near plane (z >= 0). Returns the clipped vertex count.
+static unsigned ClipPolygonNear( const Vec4* vertices, unsigned count, Vec4* outVertices )
+{
+    unsigned outCount = 0;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const Vec4& a = vertices[ i ];
+        const Vec4& b = vertices[ (i + 1) % count ];
+
+        if (a.z >= 0)
+        {
+            outVertices[ outCount++ ] = a;
+        }
+
+        if ((a.z >= 0) != (b.z >= 0))
+        {
+            const float t = a.z / (a.z - b.z);
+            outVertices[ outCount++ ] = Vec4( a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0, a.w + (b.w - a.w) * t );
+        }
+    }
+
+    return outCount;
+}
+
+static void RasterizeTriangle( Vec3 v0, Vec3 v1, Vec3 v2 )
+{
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+    if (fabsf( area ) < 0.0001f)
+    {
+        return;
+    }
+
+    if (area < 0)
+    {
+        const Vec3 temp = v1;
+        v1 = v2;
+        v2 = temp;
+        area = -area;
+    }
+
+    // Pixel x covers [x, x + 1) and is drawn if its center is inside the triangle.
+    const float minXf = v0.x < v1.x ? (v0.x < v2.x ? v0.x : v2.x) : (v1.x < v2.x ? v1.x : v2.x);
+    const float maxXf = v0.x > v1.x ? (v0.x > v2.x ? v0.x : v2.x) : (v1.x > v2.x ? v1.x : v2.x);
+    const float minYf = v0.y < v1.y ? (v0.y < v2.y ? v0.y : v2.y) : (v1.y < v2.y ? v1.y : v2.y);
+    const float maxYf = v0.y > v1.y ? (v0.y > v2.y ? v0.y : v2.y) : (v1.y > v2.y ? v1.y : v2.y);
+    const float maxZ = v0.z > v1.z ? (v0.z > v2.z ? v0.z : v2.z) : (v1.z > v2.z ? v1.z : v2.z);
+
+    const int minX = OcclusionMax( 0, (int)ceilf( minXf - 0.5f ) );
+    const int maxX = OcclusionMin( DepthWidth - 1, (int)floorf( maxXf - 0.5f ) );
+    const int minY = OcclusionMax( 0, (int)ceilf( minYf - 0.5f ) );
+    const int maxY = OcclusionMin( DepthHeight - 1, (int)floorf( maxYf - 0.5f ) );
+
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    // Edge functions e = a * x + b * y + c are positive inside.
+    const float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = -(a0 * v1.x + b0 * v1.y);
+    const float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = -(a1 * v2.x + b1 * v2.y);
+    const float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = -(a2 * v0.x + b2 * v0.y);
+
+    // Depth is linear in screen space. It's evaluated at the pixel's farthest corner so occluders never come out nearer than they are.
+    const float invArea = 1.0f / area;
+    const float zA = (a1 * (v1.z - v0.z) + a2 * (v2.z - v0.z)) * invArea;
+    const float zB = (b1 * (v1.z - v0.z) + b2 * (v2.z - v0.z)) * invArea;
+    const float zC = v0.z + (c1 * (v1.z - v0.z) + c2 * (v2.z - v0.z)) * invArea + 0.5f * (fabsf( zA ) + fabsf( zB ));
+
+#ifdef SIMD_SSE3
+    if (!occlusionForceScalar)
+    {
+        const __m128 pixelCenters = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 maxZ4 = _mm_set1_ps( maxZ );
+        const __m128 a04 = _mm_set1_ps( a0 );
+        const __m128 a14 = _mm_set1_ps( a1 );
+        const __m128 a24 = _mm_set1_ps( a2 );
+        const __m128 zA4 = _mm_set1_ps( zA );
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float py = y + 0.5f;
+            const __m128 row0 = _mm_set1_ps( b0 * py + c0 );
+            const __m128 row1 = _mm_set1_ps( b1 * py + c1 );
+            const __m128 row2 = _mm_set1_ps( b2 * py + c2 );
+            const __m128 rowZ = _mm_set1_ps( zB * py + zC );
+            float* depthRow = &occlusion.depth[ y * DepthWidth ];
+
+            // Starts from a 16-byte boundary. Pixels left of minX fail the edge test.
+            for (int x = minX & ~3; x <= maxX; x += 4)
+            {
+                const __m128 px = _mm_add_ps( _mm_set1_ps( (float)x ), pixelCenters );
+                const __m128 e0 = _mm_add_ps( _mm_mul_ps( a04, px ), row0 );
+                const __m128 e1 = _mm_add_ps( _mm_mul_ps( a14, px ), row1 );
+                const __m128 e2 = _mm_add_ps( _mm_mul_ps( a24, px ), row2 );
+                const __m128 inside = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( e0, zero ), _mm_cmpge_ps( e1, zero ) ), _mm_cmpge_ps( e2, zero ) );
+
+                if (_mm_movemask_ps( inside ) == 0)
+                {
+                    continue;
+                }
+
+                const __m128 z = _mm_min_ps( _mm_add_ps( _mm_mul_ps( zA4, px ), rowZ ), maxZ4 );
+                const __m128 oldDepth = _mm_load_ps( &depthRow[ x ] );
+                const __m128 newDepth = _mm_min_ps( oldDepth, z );
+                _mm_store_ps( &depthRow[ x ], _mm_or_ps( _mm_and_ps( inside, newDepth ), _mm_andnot_ps( inside, oldDepth ) ) );
+            }
+        }
+
+        return;
+    }
+#endif
+
+    // Row terms are summed in the same order as the SSE3 path, so both write the same depths.
+    for (int y = minY; y <= maxY; ++y)
+    {
+        const float py = y + 0.5f;
+        const float row0 = b0 * py + c0;
+        const float row1 = b1 * py + c1;
+        const float row2 = b2 * py + c2;
+        const float rowZ = zB * py + zC;
+        float* depthRow = &occlusion.depth[ y * DepthWidth ];
+
+        for (int x = minX; x <= maxX; ++x)
+        {
+            const float px = x + 0.5f;
+
+            if (a0 * px + row0 < 0 || a1 * px + row1 < 0 || a2 * px + row2 < 0)
+            {
+                continue;
+            }
+
+            const float z = OcclusionMin( zA * px + rowZ, maxZ );
+            depthRow[ x ] = OcclusionMin( depthRow[ x ], z );
+        }
+    }
+}
+
+void OcclusionClear()
+{
+    for (int i = 0; i < DepthWidth * DepthHeight; ++i)
+    {
+        occlusion.depth[ i ] = 1;
+    }
+
+    occlusion.occluderCount = 0;
+}
+
+void OcclusionRasterizeBox( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix& localToClip )
+{
+    Vec4 corners[ 8 ];
+    GetClipCorners( aabbMin, aabbMax, localToClip, corners );
+
+    for (unsigned f = 0; f < 6; ++f)
+    {
+        const Vec4 face[ 4 ] = { corners[ boxFaces[ f ][ 0 ] ], corners[ boxFaces[ f ][ 1 ] ], corners[ boxFaces[ f ][ 2 ] ], corners[ boxFaces[ f ][ 3 ] ] };
+        Vec4 clipped[ 5 ];
+        const unsigned clippedCount = ClipPolygonNear( face, 4, clipped );
+
+        if (clippedCount < 3)
+        {
+            continue;
+        }
+
+        const Vec3 first = ClipToScreen( clipped[ 0 ] );
+
+        for (unsigned v = 1; v + 1 < clippedCount; ++v)
+        {
+            RasterizeTriangle( first, ClipToScreen( clipped[ v ] ), ClipToScreen( clipped[ v + 1 ] ) );
+        }
+    }
+
+    ++occlusion.occluderCount;
+}
+
+void OcclusionBuildHierarchy()
+{
+    for (int ty = 0; ty < TileCountY; ++ty)
+    {
+        for (int tx = 0; tx < TileCountX; ++tx)
+        {
+            float maxDepth = 0;
+
+            for (int y = ty * TileSize; y < (ty + 1) * TileSize; ++y)
+            {
+                for (int x = tx * TileSize; x < (tx + 1) * TileSize; ++x)
+                {
+                    maxDepth = OcclusionMax( maxDepth, occlusion.depth[ y * DepthWidth + x ] );
+                }
+            }
+
+            occlusion.tileMaxDepth[ ty * TileCountX + tx ] = maxDepth;
+        }
+    }
+}
+
+bool OcclusionHasOccluders()
+{
+    return occlusion.occluderCount > 0;
+}
+
+bool OcclusionIsBoxVisible( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix& localToClip )
+{
+    Vec4 corners[ 8 ];
+    GetClipCorners( aabbMin, aabbMax, localToClip, corners );
+
+    float minX = DepthWidth, minY = DepthHeight, maxX = 0, maxY = 0, minDepth = 1;
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        // Boxes that cross the near plane are next to the camera.
+        if (corners[ i ].z < 0)
+        {
+            return true;
+        }
+
+        const Vec3 screen = ClipToScreen( corners[ i ] );
+        minX = OcclusionMin( minX, screen.x );
+        minY = OcclusionMin( minY, screen.y );
+        maxX = OcclusionMax( maxX, screen.x );
+        maxY = OcclusionMax( maxY, screen.y );
+        minDepth = OcclusionMin( minDepth, screen.z );
+    }
+
+    // Every pixel the box touches, not just the ones whose center it covers.
+    const int x0 = OcclusionMax( 0, (int)floorf( minX ) );
+    const int y0 = OcclusionMax( 0, (int)floorf( minY ) );
+    const int x1 = OcclusionMin( DepthWidth - 1, (int)floorf( maxX ) );
+    const int y1 = OcclusionMin( DepthHeight - 1, (int)floorf( maxY ) );
+
+    if (x0 > x1 || y0 > y1)
+    {
+        return true;
+    }
+
+    for (int ty = y0 / TileSize; ty <= y1 / TileSize; ++ty)
+    {
+        for (int tx = x0 / TileSize; tx <= x1 / TileSize; ++tx)
+        {
+            if (occlusion.tileMaxDepth[ ty * TileCountX + tx ] < minDepth)
+            {
+                continue;
+            }
+
+            for (int y = OcclusionMax( y0, ty * TileSize ); y <= OcclusionMin( y1, (ty + 1) * TileSize - 1 ); ++y)
+            {
+                for (int x = OcclusionMax( x0, tx * TileSize ); x <= OcclusionMin( x1, (tx + 1) * TileSize - 1 ); ++x)
+                {
+                    if (occlusion.depth[ y * DepthWidth + x ] >= minDepth)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
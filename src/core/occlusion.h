@@ -0,0 +1,8 @@
+// Software occlusion culling: occluders' bounding boxes are rasterized into a small CPU depth buffer
+// and other boxes are tested against it. Depth is clip z / w, smaller is nearer.
+void OcclusionClear();
+void OcclusionRasterizeBox( const struct Vec3& aabbMin, const Vec3& aabbMax, const struct Matrix& localToClip );
+// Must be called after the last OcclusionRasterizeBox() and before OcclusionIsBoxVisible().
+void OcclusionBuildHierarchy();
+bool OcclusionHasOccluders();
+bool OcclusionIsBoxVisible( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix& localToClip );
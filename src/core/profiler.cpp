@@ -0,0 +1,220 @@
+#include "profiler.h"
+#include "te_stdlib.h"
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+enum class ProfileEventType : unsigned { Begin, End, Frame };
+
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t nanoseconds;
+    ProfileEventType type;
+};
+
+static constexpr unsigned MaxProfiledThreads = 32;
+static constexpr unsigned MaxEventsPerThread = 64 * 1024;
+
+// Written only by its own thread. count is published with release, so the thread that writes the trace sees whole events.
+// A thread resets its buffer when it sees a new captureId, so captures don't need to stop other threads.
+struct ProfileThreadBuffer
+{
+    ProfileEvent* events = nullptr;
+    std::atomic< unsigned > count{ 0 };
+    std::atomic< unsigned > captureId{ 0 };
+};
+
+struct Profiler
+{
+    ProfileThreadBuffer threads[ MaxProfiledThreads ];
+    std::atomic< unsigned > threadCount{ 0 };
+    std::atomic< unsigned > captureId{ 0 };
+    std::atomic< bool > isCapturing{ false };
+    bool isStartRequested = false;
+    unsigned framesLeft = 0;
+    char path[ 260 ] = {};
+    std::chrono::steady_clock::time_point captureStart;
+};
+
+static Profiler profiler;
+TE_TRACK_STATIC_MEMORY( profilerMemory, teMemoryTag::Other, sizeof( profiler ) );
+static thread_local int profileThreadIndex = -1; // -1 until the thread's first event, -2 if there were too many threads.
+
+static uint64_t GetProfileNanoseconds()
+{
+    return (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - profiler.captureStart ).count();
+}
+
+static void AddProfileEvent( const char* name, ProfileEventType type )
+{
+    if (profileThreadIndex == -1)
+    {
+        const unsigned threadIndex = profiler.threadCount.fetch_add( 1 );
+        profileThreadIndex = threadIndex < MaxProfiledThreads ? (int)threadIndex : -2;
+
+        if (profileThreadIndex >= 0)
+        {
+            profiler.threads[ profileThreadIndex ].events = (ProfileEvent*)teMalloc( MaxEventsPerThread * sizeof( ProfileEvent ), teMemoryTag::Other );
+        }
+    }
+
+    if (profileThreadIndex < 0)
+    {
+        return;
+    }
+
+    ProfileThreadBuffer& buffer = profiler.threads[ profileThreadIndex ];
+    const unsigned captureId = profiler.captureId.load( std::memory_order_relaxed );
+
+    if (buffer.captureId.load( std::memory_order_relaxed ) != captureId)
+    {
+        buffer.count.store( 0, std::memory_order_relaxed );
+        buffer.captureId.store( captureId, std::memory_order_relaxed );
+    }
+
+    const unsigned count = buffer.count.load( std::memory_order_relaxed );
+
+    if (count < MaxEventsPerThread)
+    {
+        buffer.events[ count ] = { name, GetProfileNanoseconds(), type };
+        buffer.count.store( count + 1, std::memory_order_release );
+    }
+}
+
+void teProfileBegin( const char* name )
+{
+    if (profiler.isCapturing.load( std::memory_order_acquire ))
+    {
+        AddProfileEvent( name, ProfileEventType::Begin );
+    }
+}
+
+void teProfileEnd()
+{
+    if (profiler.isCapturing.load( std::memory_order_acquire ))
+    {
+        AddProfileEvent( nullptr, ProfileEventType::End );
+    }
+}
+
+void teProfilerCaptureFrames( unsigned frameCount, const char* path )
+{
+    if (teProfilerIsCapturing() || frameCount == 0)
+    {
+        return;
+    }
+
+    strncpy( profiler.path, path, sizeof( profiler.path ) - 1 );
+    profiler.framesLeft = frameCount;
+    profiler.isStartRequested = true;
+}
+
+bool teProfilerIsCapturing()
+{
+    return profiler.isStartRequested || profiler.isCapturing.load( std::memory_order_relaxed );
+}
+
+static void WriteJsonString( FILE* file, const char* str )
+{
+    fputc( '"', file );
+
+    for (const char* c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fputc( '\\', file );
+        }
+
+        fputc( *c, file );
+    }
+
+    fputc( '"', file );
+}
+
+static void WriteTrace()
+{
+    FILE* file = fopen( profiler.path, "w" );
+
+    if (!file)
+    {
+        teLog( teLogLevel::Warning, "Could not open %s for writing the profile!\n", profiler.path );
+        return;
+    }
+
+    const unsigned captureId = profiler.captureId.load( std::memory_order_relaxed );
+    const unsigned threadCount = profiler.threadCount.load() < MaxProfiledThreads ? profiler.threadCount.load() : MaxProfiledThreads;
+    unsigned eventCount = 0;
+    bool isFirst = true;
+
+    fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        const ProfileThreadBuffer& buffer = profiler.threads[ threadIndex ];
+
+        if (buffer.captureId.load( std::memory_order_relaxed ) != captureId)
+        {
+            continue;
+        }
+
+        const unsigned count = buffer.count.load( std::memory_order_acquire );
+
+        for (unsigned e = 0; e < count; ++e)
+        {
+            const ProfileEvent& event = buffer.events[ e ];
+            fputs( isFirst ? "" : ",\n", file );
+            isFirst = false;
+
+            if (event.type == ProfileEventType::End)
+            {
+                fprintf( file, "{\"ph\":\"E\"" );
+            }
+            else if (event.type == ProfileEventType::Begin)
+            {
+                fprintf( file, "{\"ph\":\"B\",\"name\":" );
+                WriteJsonString( file, event.name );
+            }
+            else
+            {
+                // Global instant event: a line across all threads.
+                fprintf( file, "{\"ph\":\"i\",\"s\":\"g\",\"name\":" );
+                WriteJsonString( file, event.name );
+            }
+
+            fprintf( file, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", threadIndex, event.nanoseconds / 1000.0 );
+        }
+
+        eventCount += count;
+    }
+
+    fprintf( file, "\n]}\n" );
+    fclose( file );
+
+    teLog( teLogLevel::Info, "Wrote %u profile events to %s\n", eventCount, profiler.path );
+}
+
+// Called by teBeginFrame on the render thread.
+void ProfilerNewFrame()
+{
+    if (profiler.isCapturing.load( std::memory_order_relaxed ) && profiler.framesLeft == 0)
+    {
+        profiler.isCapturing.store( false, std::memory_order_relaxed );
+        WriteTrace();
+    }
+
+    if (profiler.isStartRequested)
+    {
+        profiler.isStartRequested = false;
+        profiler.captureStart = std::chrono::steady_clock::now();
+        profiler.captureId.fetch_add( 1 );
+        profiler.isCapturing.store( true, std::memory_order_release );
+    }
+
+    if (profiler.isCapturing.load( std::memory_order_relaxed ))
+    {
+        --profiler.framesLeft;
+        AddProfileEvent( "Frame", ProfileEventType::Frame );
+    }
+}
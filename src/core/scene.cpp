@@ -1,4 +1,5 @@
 #include "scene.h"
+#include "affine3x4.h"
 #include "camera.h"
 #include "file.h"
 #include "frustum.h"
@@ -7,31 +8,34 @@
 #include "material.h"
 #include "matrix.h"
 #include "mesh.h"
+#include "occlusion.h"
+#include "profiler.h"
 #include "quaternion.h"
 #include "renderer.h"
+#include "scene_binary.h"
 #include "shader.h"
+#include "streaming.h"
 #include "te_stdlib.h"
 #include "texture.h"
 #include "transform.h"
 #include "vec3.h"
+#include <math.h>
 #include <stdint.h>
 
 void BeginRendering( teTexture2D& color, teTexture2D& depth, teClearFlag clearFlag, const float* clearColor );
 void EndRendering( teTexture2D& color, teTexture2D& depth );
 void PushGroupMarker( const char* name );
 void PopGroupMarker();
+void StatAdd( teStat stat, unsigned amount );
 void DrawLines();
 
 void MeshRendererSetCulled( unsigned gameObjectIndex, unsigned subMeshIndex, bool isCulled );
 bool MeshRendererIsCulled( unsigned gameObjectIndex, unsigned subMeshIndex );
 void TransformSolveLocalMatrix( unsigned index, bool isCamera );
-void teTransformGetComputedLocalToClipMatrix( unsigned index, Matrix& outLocalToClip );
-void teTransformGetComputedLocalToViewMatrix( unsigned index, Matrix& outLocalToView );
-void teTransformSetComputedLocalToShadowClipMatrix( unsigned index, const Matrix& localToShadowClip );
-void teTransformGetComputedLocalToShadowClipMatrix( unsigned index, Matrix& outLocalToShadowClip );
+void TransformSolveLocalMatrices( const unsigned* indices, unsigned count );
+const Affine3x4& TransformGetLocalAffine( unsigned index );
+void TransformCopyLocals( unsigned firstIndex, unsigned count, const float* positions, const float* rotations, const float* scales );
 void Draw( const teShader& shader, unsigned positionOffset, unsigned uvOffset, unsigned normalOffset, unsigned tangentOffset, unsigned indexCount, unsigned indexOffset, teBlendMode blendMode, teCullMode cullMode, teDepthMode depthMode, teTopology topology, teFillMode fillMode, unsigned textureIndex, teTextureSampler sampler, unsigned normalMapIndex, unsigned shadowMapIndex, unsigned meshIndex, unsigned subMeshIndex  );
-void TransformSetComputedLocalToClip( unsigned index, const Matrix& localToClip );
-void TransformSetComputedLocalToView( unsigned index, const Matrix& localToView );
 void teGetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
 void GetMinMax( const Vec3* aPoints, unsigned count, Vec3& outMin, Vec3& outMax );
 unsigned teMeshGetPositionOffset( const teMesh& mesh, unsigned subMeshIndex );
@@ -45,20 +49,33 @@ void CullLights( const teShader& shader, const Matrix& localToView, const Matrix
 void RendererGetSize( unsigned& outWidth, unsigned& outHeight );
 void SetPointLightPosition( unsigned goIndex, const Vec3& positionWS );
 void SetSpotLightPosition( unsigned goIndex, const Vec3& positionWS );
+const Matrix* InstancedMeshRendererGetLocalMatrices( unsigned gameObjectIndex );
+const Vec4* InstancedMeshRendererGetTints( unsigned gameObjectIndex );
+unsigned InstancedMeshRendererGetBatchCount( unsigned gameObjectIndex );
+void InstancedMeshRendererGetBatch( unsigned gameObjectIndex, unsigned batchIndex, const Vec3& meshAabbMin, const Vec3& meshAabbMax,
+                                    unsigned& outFirstInstance, unsigned& outInstanceCount, Vec3& outAabbMin, Vec3& outAabbMax );
+void UpdateInstances( const Matrix* instanceToWorld, const Vec4* tints, unsigned instanceCount );
+unsigned GetMeshletCount( unsigned index, unsigned subMeshIndex );
+teMesh CreateStaticBatchMesh( const teMesh* const* sourceMeshes, const unsigned* sourceSubMeshIndices, const Matrix* sourceLocalToWorlds, unsigned sourceCount );
 
-constexpr unsigned MAX_GAMEOBJECTS = 10000;
+void EngineEnsureInitialized();
+
+static unsigned sceneGameObjectCapacity = 0;
 
 struct ShadowCaster
 {
     teTexture2D color;
     teTexture2D depth;
-    unsigned cameraIndex{ MAX_GAMEOBJECTS - 1 };
+    unsigned cameraIndex = 0; // Slot in gameObjects, the last one.
     Vec3 lightDirection;
 };
 
+// gameObjects is dense: [0, gameObjectCount) are in use, so adding and removing is O(1) and loops stop at the count.
 struct SceneImpl
 {
-    unsigned gameObjects[ MAX_GAMEOBJECTS ] = {};
+    unsigned* gameObjects = nullptr;
+    unsigned* gameObjectSlots = nullptr; // Game object index -> slot in gameObjects + 1. 0 means not in the scene.
+    unsigned gameObjectCount = 0;
     ShadowCaster shadowCaster;
     Vec3 directionalLightColor;
     Vec3 directionalLightDirection;
@@ -66,12 +83,62 @@ struct SceneImpl
 };
 
 SceneImpl scenes[ 2 ];
+TE_TRACK_STATIC_MEMORY( scenesMemory, teMemoryTag::Scene, sizeof( scenes ) );
 unsigned sceneIndex = 0;
 teMesh quadMesh;
 
+constexpr unsigned MaxInstancedDraws = 256;
+
+// Visible instances of one instanced mesh renderer. Arrays are frame allocated.
+struct InstancedDraw
+{
+    unsigned gameObjectIndex = 0;
+    Matrix* instanceToWorld = nullptr;
+    Vec4* tints = nullptr;
+    unsigned instanceCount = 0;
+};
+
+// Instanced draws are in world space, so their UBO matrices are shared by every draw of the current camera.
+struct InstancedDraws
+{
+    InstancedDraw draws[ MaxInstancedDraws ];
+    unsigned drawCount = 0;
+    Matrix worldToClip;
+};
+
+static InstancedDraws instancedDraws;
+TE_TRACK_STATIC_MEMORY( instancedDrawsMemory, teMemoryTag::Scene, sizeof( instancedDraws ) );
+
+// Matrices of the camera being rendered. Objects' UBOs only carry their affine localToView and localToWorld,
+// and shaders multiply them with the projections.
+struct ViewMatrices
+{
+    Affine3x4 worldToView;
+    Matrix viewToClip;
+    Matrix worldToShadowClip;
+    Affine3x4* localToViews = nullptr; // Indexed by slot in the scene's gameObjects. Frame allocated by UpdateTransformsAndCull.
+};
+
+static ViewMatrices viewMatrices;
+
+// Sum of the scene's mesh renderers' submesh counts, found by SolveSceneTransforms. Sizes UpdateTransformsAndCull's arrays.
+static unsigned sceneSubMeshCount = 0;
+
+void SceneInitStorage( unsigned maxGameObjects )
+{
+    sceneGameObjectCapacity = maxGameObjects;
+
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        scenes[ i ].gameObjects = teMallocArray< unsigned >( maxGameObjects, teMemoryTag::Scene );
+        scenes[ i ].gameObjectSlots = teMallocArray< unsigned >( maxGameObjects, teMemoryTag::Scene );
+        scenes[ i ].shadowCaster.cameraIndex = maxGameObjects - 1;
+    }
+}
+
 unsigned teSceneGetMaxGameObjects()
 {
-    return MAX_GAMEOBJECTS;
+    return sceneGameObjectCapacity;
 }
 
 unsigned teSceneGetGameObjectIndex( const teScene& scene, unsigned i )
@@ -81,16 +148,20 @@ unsigned teSceneGetGameObjectIndex( const teScene& scene, unsigned i )
 
 teScene teCreateScene( unsigned directonalShadowMapDimension )
 {
+    EngineEnsureInitialized();
     teAssert( sceneIndex < 2 );
 
     teScene outScene;
     outScene.index = sceneIndex++;
 
-    for (unsigned i = 0; i < MAX_GAMEOBJECTS; ++i)
+    for (unsigned i = 0; i < sceneGameObjectCapacity; ++i)
     {
         scenes[ outScene.index ].gameObjects[ i ] = 0;
+        scenes[ outScene.index ].gameObjectSlots[ i ] = 0;
     }
 
+    scenes[ outScene.index ].gameObjectCount = 0;
+
     if (directonalShadowMapDimension != 0)
     {
         const unsigned cameraGOIndex = scenes[ outScene.index ].gameObjects[ scenes[ outScene.index ].shadowCaster.cameraIndex ];
@@ -123,116 +194,373 @@ void teSceneAdd( const teScene& scene, unsigned gameObjectIndex )
         teAssert( teCameraGetColorTexture( gameObjectIndex ).index != 0 ); // Camera must have a render texture!
     }
 
-    for (unsigned i = 0; i < MAX_GAMEOBJECTS; ++i)
+    teAssert( gameObjectIndex < sceneGameObjectCapacity );
+    SceneImpl& impl = scenes[ scene.index ];
+
+    if (gameObjectIndex == 0 || impl.gameObjectSlots[ gameObjectIndex ] != 0)
     {
-        if (scenes[ scene.index ].gameObjects[ i ] == gameObjectIndex)
-        {
-            return;
-        }
+        return;
     }
 
-    for (unsigned i = 0; i < MAX_GAMEOBJECTS; ++i)
+    if (impl.gameObjectCount == sceneGameObjectCapacity)
     {
-        if (scenes[ scene.index ].gameObjects[ i ] == 0)
-        {
-            scenes[ scene.index ].gameObjects[ i ] = gameObjectIndex;
-            return;
-        }
+        teAssert( !"Too many game objects!" );
+        return;
     }
 
-    teAssert( !"Too many game objects!" );
+    impl.gameObjects[ impl.gameObjectCount ] = gameObjectIndex;
+    ++impl.gameObjectCount;
+    impl.gameObjectSlots[ gameObjectIndex ] = impl.gameObjectCount;
 }
 
 void teSceneRemove( const teScene& scene, unsigned gameObjectIndex )
 {
     teAssert( scene.index < 2 );
 
-    for (unsigned i = 0; i < MAX_GAMEOBJECTS; ++i)
+    teAssert( gameObjectIndex < sceneGameObjectCapacity );
+    SceneImpl& impl = scenes[ scene.index ];
+
+    const unsigned slot = impl.gameObjectSlots[ gameObjectIndex ];
+
+    if (slot == 0)
+    {
+        return;
+    }
+
+    // Moves the last game object into the hole.
+    const unsigned lastGameObjectIndex = impl.gameObjects[ impl.gameObjectCount - 1 ];
+    impl.gameObjects[ slot - 1 ] = lastGameObjectIndex;
+    impl.gameObjectSlots[ lastGameObjectIndex ] = slot;
+    impl.gameObjects[ impl.gameObjectCount - 1 ] = 0;
+    impl.gameObjectSlots[ gameObjectIndex ] = 0;
+    --impl.gameObjectCount;
+}
+
+void SceneRemoveFromAll( unsigned gameObjectIndex )
+{
+    for (unsigned i = 0; i < sceneIndex; ++i)
+    {
+        teScene scene;
+        scene.index = i;
+        teSceneRemove( scene, gameObjectIndex );
+    }
+}
+
+bool teSceneContains( const teScene& scene, unsigned gameObjectIndex )
+{
+    teAssert( scene.index < 2 );
+    teAssert( gameObjectIndex < sceneGameObjectCapacity );
+
+    return scenes[ scene.index ].gameObjectSlots[ gameObjectIndex ] != 0;
+}
+
+static bool IsPointInBox( const Vec3& point, const Vec3& aabbMin, const Vec3& aabbMax )
+{
+    return point.x >= aabbMin.x && point.y >= aabbMin.y && point.z >= aabbMin.z &&
+           point.x <= aabbMax.x && point.y <= aabbMax.y && point.z <= aabbMax.z;
+}
+
+// Culls submeshes whose bounds are hidden behind occluders. Occluders were rasterized by UpdateTransformsAndCull.
+static void CullOccluded( const teScene& scene )
+{
+    TE_PROFILE_SCOPE( "CullOccluded" );
+
+    OcclusionBuildHierarchy();
+
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < scenes[ scene.index ].gameObjectCount; ++gameObjectIndex)
     {
-        if (scenes[ scene.index ].gameObjects[ i ] == gameObjectIndex)
+        const unsigned goIndex = scenes[ scene.index ].gameObjects[ gameObjectIndex ];
+
+        if (goIndex == 0 || (teGameObjectGetComponents( goIndex ) & teComponent::MeshRenderer) == 0)
         {
-            scenes[ scene.index ].gameObjects[ i ] = 0;
+            continue;
+        }
+
+        Matrix localToClip;
+        Affine3x4::MultiplyProjection( viewMatrices.localToViews[ gameObjectIndex ], viewMatrices.viewToClip, localToClip );
+
+        const teMesh* mesh = teMeshRendererGetMesh( goIndex );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < teMeshGetSubMeshCount( mesh ); ++subMeshIndex)
+        {
+            if (MeshRendererIsCulled( goIndex, subMeshIndex ))
+            {
+                continue;
+            }
+
+            Vec3 meshAabbMin, meshAabbMax;
+            teMeshGetSubMeshLocalAABB( *mesh, subMeshIndex, meshAabbMin, meshAabbMax );
+
+            if (!OcclusionIsBoxVisible( meshAabbMin, meshAabbMax, localToClip ))
+            {
+                MeshRendererSetCulled( goIndex, subMeshIndex, true );
+                StatAdd( teStat::CameraSubMeshesOcclusionCulled, 1 );
+            }
         }
     }
 }
 
-static void UpdateTransformsAndCull( const teScene& scene, unsigned cameraGOIndex )
+static void GetWorldAABB( const Vec3& aabbMinLocal, const Vec3& aabbMaxLocal, const Matrix& localToWorld, Vec3& outAabbMinWorld, Vec3& outAabbMaxWorld )
 {
-    for (unsigned gameObjectIndex = 0; gameObjectIndex < MAX_GAMEOBJECTS; ++gameObjectIndex)
+    Vec3 corners[ 8 ];
+    teGetCorners( aabbMinLocal, aabbMaxLocal, corners );
+    Matrix::TransformPoints( corners, localToWorld, corners, 8 );
+    GetMinMax( corners, 8, outAabbMinWorld, outAabbMaxWorld );
+}
+
+// Collects visible instances of instanced mesh renderers into instancedDraws. Batches of instances are culled
+// before their instances, so a field of grass outside the view costs one test per batch.
+static void CullInstances( const teScene& scene, unsigned cameraGOIndex, bool cullOccluded )
+{
+    TE_PROFILE_SCOPE( "CullInstances" );
+
+    instancedDraws.drawCount = 0;
+    Affine3x4::MultiplyProjection( viewMatrices.worldToView, viewMatrices.viewToClip, instancedDraws.worldToClip );
+
+    unsigned instancedCount = 0;
+    const unsigned* instancedGameObjects = teGameObjectGetObjectsWithComponent( teComponent::InstancedMeshRenderer, instancedCount );
+
+    for (unsigned instancedIndex = 0; instancedIndex < instancedCount; ++instancedIndex)
     {
-        if (scenes[ scene.index ].gameObjects[ gameObjectIndex ] == 0 ||
-            (teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) & teComponent::MeshRenderer) == 0)
+        const unsigned goIndex = instancedGameObjects[ instancedIndex ];
+
+        if (scenes[ scene.index ].gameObjectSlots[ goIndex ] == 0 || !teMeshRendererIsEnabled( goIndex ) ||
+            teMeshRendererGetMesh( goIndex ) == nullptr || teInstancedMeshRendererGetInstanceCount( goIndex ) == 0)
         {
             continue;
         }
 
-        TransformSolveLocalMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ], false );
+        if (instancedDraws.drawCount == MaxInstancedDraws)
+        {
+            teLog( teLogLevel::Warning, "Too many instanced mesh renderers, max is %u\n", MaxInstancedDraws );
+            break;
+        }
 
-        const Matrix localToWorld = teTransformGetMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ] );
+        const Matrix localToWorld = teTransformGetMatrix( goIndex );
 
-        Matrix localToView;
-        Matrix localToClip;
-        Matrix::Multiply( localToWorld, teTransformGetMatrix( cameraGOIndex ), localToView );
-        Matrix::Multiply( localToView, teCameraGetProjection( cameraGOIndex ), localToClip );
+        const teMesh* mesh = teMeshRendererGetMesh( goIndex );
+        Vec3 meshAabbMin, meshAabbMax;
+        teMeshGetSubMeshLocalAABB( *mesh, 0, meshAabbMin, meshAabbMax );
+
+        for (unsigned subMeshIndex = 1; subMeshIndex < teMeshGetSubMeshCount( mesh ); ++subMeshIndex)
+        {
+            Vec3 subMeshAabbMin, subMeshAabbMax;
+            teMeshGetSubMeshLocalAABB( *mesh, subMeshIndex, subMeshAabbMin, subMeshAabbMax );
+            const Vec3 corners[ 4 ] = { meshAabbMin, meshAabbMax, subMeshAabbMin, subMeshAabbMax };
+            GetMinMax( corners, 4, meshAabbMin, meshAabbMax );
+        }
+
+        const unsigned instanceCount = teInstancedMeshRendererGetInstanceCount( goIndex );
+        const Matrix* localMatrices = InstancedMeshRendererGetLocalMatrices( goIndex );
+        const Vec4* tints = InstancedMeshRendererGetTints( goIndex );
+
+        InstancedDraw& draw = instancedDraws.draws[ instancedDraws.drawCount ];
+        draw.gameObjectIndex = goIndex;
+        draw.instanceToWorld = (Matrix*)teFrameAlloc( instanceCount * sizeof( Matrix ) );
+        draw.tints = (Vec4*)teFrameAlloc( instanceCount * sizeof( Vec4 ) );
+        draw.instanceCount = 0;
+
+        // Scratch for one batch at a time.
+        Vec3* meshAabbMinsWorld = (Vec3*)teFrameAlloc( instanceCount * sizeof( Vec3 ) );
+        Vec3* meshAabbMaxsWorld = (Vec3*)teFrameAlloc( instanceCount * sizeof( Vec3 ) );
+        bool* isInFrustum = (bool*)teFrameAlloc( instanceCount * sizeof( bool ) );
+
+        for (unsigned batchIndex = 0; batchIndex < InstancedMeshRendererGetBatchCount( goIndex ); ++batchIndex)
+        {
+            unsigned firstInstance, batchInstanceCount;
+            Vec3 batchAabbMin, batchAabbMax;
+            InstancedMeshRendererGetBatch( goIndex, batchIndex, meshAabbMin, meshAabbMax, firstInstance, batchInstanceCount, batchAabbMin, batchAabbMax );
+
+            Vec3 batchAabbMinWorld, batchAabbMaxWorld;
+            GetWorldAABB( batchAabbMin, batchAabbMax, localToWorld, batchAabbMinWorld, batchAabbMaxWorld );
+
+            if (!BoxInFrustum( cameraGOIndex, batchAabbMinWorld, batchAabbMaxWorld ))
+            {
+                continue;
+            }
+
+            // The batch's matrices are written after the already visible instances and compacted below.
+            Matrix* batchToWorld = &draw.instanceToWorld[ draw.instanceCount ];
+            Matrix::MultiplyBatch( &localMatrices[ firstInstance ], localToWorld, batchToWorld, batchInstanceCount );
+
+            for (unsigned b = 0; b < batchInstanceCount; ++b)
+            {
+                GetWorldAABB( meshAabbMin, meshAabbMax, batchToWorld[ b ], meshAabbMinsWorld[ b ], meshAabbMaxsWorld[ b ] );
+            }
+
+            BoxesInFrustum( cameraGOIndex, meshAabbMinsWorld, meshAabbMaxsWorld, batchInstanceCount, isInFrustum );
+
+            for (unsigned b = 0; b < batchInstanceCount; ++b)
+            {
+                if (!isInFrustum[ b ])
+                {
+                    continue;
+                }
+
+                if (cullOccluded)
+                {
+                    Matrix instanceToClip;
+                    Matrix::Multiply( batchToWorld[ b ], instancedDraws.worldToClip, instanceToClip );
+
+                    if (!OcclusionIsBoxVisible( meshAabbMin, meshAabbMax, instanceToClip ))
+                    {
+                        continue;
+                    }
+                }
+
+                draw.instanceToWorld[ draw.instanceCount ] = batchToWorld[ b ];
+                draw.tints[ draw.instanceCount ] = tints[ firstInstance + b ];
+                ++draw.instanceCount;
+            }
+        }
+
+        instancedDraws.drawCount += draw.instanceCount > 0 ? 1 : 0;
+    }
+}
 
-        TransformSetComputedLocalToClip( scenes[ scene.index ].gameObjects[ gameObjectIndex ], localToClip );
-        TransformSetComputedLocalToView( scenes[ scene.index ].gameObjects[ gameObjectIndex ], localToView );
+// Solves the transforms of the scene's mesh renderers and instanced mesh renderers in one batch. Runs once per frame
+// before the views, which only read the solved matrices.
+static void SolveSceneTransforms( const teScene& scene )
+{
+    TE_PROFILE_SCOPE( "SolveSceneTransforms" );
 
-        Matrix localToShadowClip;
+    const unsigned sceneObjectCount = scenes[ scene.index ].gameObjectCount;
+    unsigned* meshGameObjects = (unsigned*)teFrameAlloc( sceneObjectCount * sizeof( unsigned ) );
+    unsigned meshGameObjectCount = 0;
+    sceneSubMeshCount = 0;
 
-        if (cameraGOIndex != scenes[ scene.index ].shadowCaster.cameraIndex)
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < sceneObjectCount; ++gameObjectIndex)
+    {
+        const unsigned goIndex = scenes[ scene.index ].gameObjects[ gameObjectIndex ];
+        const unsigned components = goIndex != 0 ? teGameObjectGetComponents( goIndex ) : 0;
+
+        if ((components & (teComponent::MeshRenderer | teComponent::InstancedMeshRenderer)) != 0)
         {
-            unsigned goIndex = scenes[ scene.index ].gameObjects[ scenes[ scene.index ].shadowCaster.cameraIndex ];
+            meshGameObjects[ meshGameObjectCount++ ] = goIndex;
+        }
 
-            Matrix::Multiply( localToWorld, teTransformGetMatrix( goIndex ), localToShadowClip );
-            Matrix::Multiply( localToShadowClip, teCameraGetProjection( goIndex ), localToShadowClip );
+        if ((components & teComponent::MeshRenderer) != 0)
+        {
+            sceneSubMeshCount += teMeshGetSubMeshCount( teMeshRendererGetMesh( goIndex ) );
         }
+    }
 
-        teTransformSetComputedLocalToShadowClipMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ], localToShadowClip );
+    TransformSolveLocalMatrices( meshGameObjects, meshGameObjectCount );
+}
+
+static void UpdateTransformsAndCull( const teScene& scene, unsigned cameraGOIndex )
+{
+    TE_PROFILE_SCOPE( "UpdateTransformsAndCull" );
+
+    // Shadow maps see different surfaces than the camera, so only the camera's view is occlusion culled.
+    const bool cullOccluded = cameraGOIndex != scenes[ scene.index ].shadowCaster.cameraIndex;
+    const Vec3 cameraPosition = teTransformGetLocalPosition( cameraGOIndex );
+    const teStat objectsTestedStat = cullOccluded ? teStat::CameraObjectsTested : teStat::ShadowObjectsTested;
+    const teStat subMeshesTestedStat = cullOccluded ? teStat::CameraSubMeshesTested : teStat::ShadowSubMeshesTested;
+    const teStat frustumCulledStat = cullOccluded ? teStat::CameraSubMeshesFrustumCulled : teStat::ShadowSubMeshesFrustumCulled;
+
+    if (cullOccluded)
+    {
+        OcclusionClear();
+    }
+
+    viewMatrices.worldToView = TransformGetLocalAffine( cameraGOIndex );
+    viewMatrices.viewToClip = teCameraGetProjection( cameraGOIndex );
+    viewMatrices.worldToShadowClip = Matrix();
+
+    if (cameraGOIndex != scenes[ scene.index ].shadowCaster.cameraIndex)
+    {
+        unsigned goIndex = scenes[ scene.index ].gameObjects[ scenes[ scene.index ].shadowCaster.cameraIndex ];
+
+        Matrix::Multiply( teTransformGetMatrix( goIndex ), teCameraGetProjection( goIndex ), viewMatrices.worldToShadowClip );
+    }
+
+    // Transforms were solved by SolveSceneTransforms. Submesh bounds are gathered first and then tested against the frustum in one batch.
+    const unsigned sceneObjectCount = scenes[ scene.index ].gameObjectCount;
+    const unsigned boxCapacity = sceneSubMeshCount;
+    viewMatrices.localToViews = (Affine3x4*)teFrameAlloc( sceneObjectCount * sizeof( Affine3x4 ) );
+
+    Vec3* meshAabbMinsWorld = (Vec3*)teFrameAlloc( boxCapacity * sizeof( Vec3 ) );
+    Vec3* meshAabbMaxsWorld = (Vec3*)teFrameAlloc( boxCapacity * sizeof( Vec3 ) );
+    bool* isInFrustum = (bool*)teFrameAlloc( boxCapacity * sizeof( bool ) );
+    unsigned boxCount = 0;
+
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < scenes[ scene.index ].gameObjectCount; ++gameObjectIndex)
+    {
+        if (scenes[ scene.index ].gameObjects[ gameObjectIndex ] == 0 ||
+            (teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) & teComponent::MeshRenderer) == 0)
+        {
+            continue;
+        }
+
+        StatAdd( objectsTestedStat, 1 );
+        Affine3x4::Multiply( TransformGetLocalAffine( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ), viewMatrices.worldToView, viewMatrices.localToViews[ gameObjectIndex ] );
+
+        const Matrix localToWorld = teTransformGetMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ] );
 
         const teMesh* mesh = teMeshRendererGetMesh( scenes[ scene.index ].gameObjects[ gameObjectIndex ] );
 
         for (unsigned subMeshIndex = 0; subMeshIndex < teMeshGetSubMeshCount( mesh ); ++subMeshIndex)
         {
-            Vec3 meshAabbMinWorld, meshAabbMaxWorld;
-            teMeshGetSubMeshLocalAABB( *mesh, subMeshIndex, meshAabbMinWorld, meshAabbMaxWorld );
+            Vec3 meshAabbMinLocal, meshAabbMaxLocal;
+            teMeshGetSubMeshLocalAABB( *mesh, subMeshIndex, meshAabbMinLocal, meshAabbMaxLocal );
+            GetWorldAABB( meshAabbMinLocal, meshAabbMaxLocal, localToWorld, meshAabbMinsWorld[ boxCount ], meshAabbMaxsWorld[ boxCount ] );
+            ++boxCount;
+        }
+    }
 
-            Vec3 meshAabbWorld[ 8 ];
-            teGetCorners( meshAabbMinWorld, meshAabbMaxWorld, meshAabbWorld );
+    BoxesInFrustum( cameraGOIndex, meshAabbMinsWorld, meshAabbMaxsWorld, boxCount, isInFrustum );
+    StatAdd( subMeshesTestedStat, boxCount );
+    unsigned boxIndex = 0;
 
-            for (unsigned v = 0; v < 8; ++v)
-            {
-                Vec3 res;
-                Matrix::TransformPoint( meshAabbWorld[ v ], localToWorld, res );
-                meshAabbWorld[ v ] = res;
-            }
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < scenes[ scene.index ].gameObjectCount; ++gameObjectIndex)
+    {
+        const unsigned goIndex = scenes[ scene.index ].gameObjects[ gameObjectIndex ];
 
-            GetMinMax( meshAabbWorld, 8, meshAabbMinWorld, meshAabbMaxWorld );
+        if (goIndex == 0 || (teGameObjectGetComponents( goIndex ) & teComponent::MeshRenderer) == 0)
+        {
+            continue;
+        }
+
+        const teMesh* mesh = teMeshRendererGetMesh( goIndex );
+        // An occluder around the camera would hide everything.
+        const bool isOccluder = cullOccluded && teMeshRendererIsOccluder( goIndex );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < teMeshGetSubMeshCount( mesh ); ++subMeshIndex, ++boxIndex)
+        {
+            MeshRendererSetCulled( goIndex, subMeshIndex, !isInFrustum[ boxIndex ] );
+            StatAdd( frustumCulledStat, isInFrustum[ boxIndex ] ? 0 : 1 );
+
+            if (isOccluder && isInFrustum[ boxIndex ] && !IsPointInBox( cameraPosition, meshAabbMinsWorld[ boxIndex ], meshAabbMaxsWorld[ boxIndex ] ))
+            {
+                Vec3 meshAabbMinLocal, meshAabbMaxLocal;
+                teMeshGetSubMeshLocalAABB( *mesh, subMeshIndex, meshAabbMinLocal, meshAabbMaxLocal );
 
-            MeshRendererSetCulled( scenes[ scene.index ].gameObjects[ gameObjectIndex ], subMeshIndex, !BoxInFrustum( cameraGOIndex, meshAabbMinWorld, meshAabbMaxWorld ) );
+                Matrix localToClip;
+                Affine3x4::MultiplyProjection( viewMatrices.localToViews[ gameObjectIndex ], viewMatrices.viewToClip, localToClip );
+                OcclusionRasterizeBox( meshAabbMinLocal, meshAabbMaxLocal, localToClip );
+            }
         }
     }
+
+    if (cullOccluded && OcclusionHasOccluders())
+    {
+        CullOccluded( scene );
+    }
+
+    CullInstances( scene, cameraGOIndex, cullOccluded && OcclusionHasOccluders() );
 }
 
 static void RenderSky( unsigned cameraGOIndex, const teShader* skyboxShader, const teTextureCube* skyboxTexture, const teMesh* skyboxMesh )
 {
-    Matrix localToView;
-    Matrix localToShadowClip;
+    const Affine3x4 identity;
+    const Matrix worldToShadowClip;
 
-    Matrix localToClip;
-    Matrix view;
-    Quaternion cameraRot = teTransformGetLocalRotation( cameraGOIndex );
-    cameraRot.GetMatrix( view );
-    const Matrix& projection = teCameraGetProjection( cameraGOIndex );
-    Matrix::Multiply( view, projection, localToClip );
+    Affine3x4 view;
+    Affine3x4::Compose( teTransformGetLocalRotation( cameraGOIndex ), Vec3(), 1, view );
     ShaderParams shaderParams{};
-    
-    for (unsigned i = 0; i < 16; ++i)
-    {
-        shaderParams.localToView[ i ] = localToView.m[ i ];
-    }
 
-    UpdateUBO( localToClip.m, localToShadowClip.m, localToView.m, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    UpdateUBO( view, teCameraGetProjection( cameraGOIndex ), identity, worldToShadowClip, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
 
     PushGroupMarker( "Skybox" );
     unsigned indexOffset = teMeshGetIndexOffset( *skyboxMesh, 0 );
@@ -248,8 +576,9 @@ static void RenderSky( unsigned cameraGOIndex, const teShader* skyboxShader, con
 
 void teDrawQuad( const teShader& shader, teTexture2D texture, const ShaderParams& shaderParams, teBlendMode blendMode )
 {
-    Matrix identity;
-    UpdateUBO( identity.m, identity.m, identity.m, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    const Affine3x4 identityAffine;
+    const Matrix identity;
+    UpdateUBO( identityAffine, identity, identityAffine, identity, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
 
     PushGroupMarker( "Fullscreen Quad" );
     unsigned indexOffset = teMeshGetIndexOffset( quadMesh, 0 );
@@ -263,9 +592,82 @@ void teDrawQuad( const teShader& shader, teTexture2D texture, const ShaderParams
     PopGroupMarker();
 }
 
-static void RenderMeshes( const teScene& scene, teBlendMode blendMode, unsigned shadowMapIndex, const teShader* overrideShader )
+static void DrawSubMesh( const teScene& scene, const teMesh& mesh, unsigned subMeshIndex, const teMaterial& material, const Affine3x4& localToView,
+                         const Affine3x4& localToWorld, unsigned shadowMapIndex, const teShader* overrideShader )
+{
+    ShaderParams shaderParams{};
+    Vec4 tint = teMaterialGetTint( material );
+    shaderParams.tint[ 0 ] = tint.x;
+    shaderParams.tint[ 1 ] = tint.y;
+    shaderParams.tint[ 2 ] = tint.z;
+    shaderParams.tint[ 3 ] = tint.w;
+    Vec4 lightDir;
+    lightDir.x = scenes[ scene.index ].directionalLightDirection.x;
+    lightDir.y = scenes[ scene.index ].directionalLightDirection.y;
+    lightDir.z = scenes[ scene.index ].directionalLightDirection.z;
+    Vec4 lightColor;
+    lightColor.x = scenes[ scene.index ].directionalLightColor.x;
+    lightColor.y = scenes[ scene.index ].directionalLightColor.y;
+    lightColor.z = scenes[ scene.index ].directionalLightColor.z;
+    Vec4 lightPosition;
+    lightPosition.x = scenes[ scene.index ].directionalLightPosition.x;
+    lightPosition.y = scenes[ scene.index ].directionalLightPosition.y;
+    lightPosition.z = scenes[ scene.index ].directionalLightPosition.z;
+
+    unsigned width, height;
+    RendererGetSize( width, height );
+    shaderParams.tilesXY[ 0 ] = (float)width;
+    shaderParams.tilesXY[ 1 ] = (float)height;
+
+    UpdateUBO( localToView, viewMatrices.viewToClip, localToWorld, viewMatrices.worldToShadowClip, shaderParams, lightDir, lightColor, lightPosition );
+
+    const teShader shader = overrideShader ? *overrideShader : teMaterialGetShader( material );
+
+    unsigned indexOffset = teMeshGetIndexOffset( mesh, subMeshIndex );
+    unsigned indexCount = teMeshGetIndexCount( mesh, subMeshIndex );
+    unsigned positionOffset = teMeshGetPositionOffset( mesh, subMeshIndex );
+    unsigned normalOffset = teMeshGetNormalOffset( mesh, subMeshIndex );
+    unsigned uvOffset = teMeshGetUVOffset( mesh, subMeshIndex );
+    unsigned tangentOffset = teMeshGetTangentOffset( mesh, subMeshIndex );
+
+    teTexture2D texture = teMaterialGetTexture2D( material, 0 );
+    teTexture2D normalMap = teMaterialGetTexture2D( material, 1 );
+
+    Draw( shader, positionOffset, uvOffset, normalOffset, tangentOffset, indexCount, indexOffset, material.blendMode, material.cullMode, material.depthMode, mesh.topology, material.fillMode, texture.index, texture.sampler, normalMap.index, shadowMapIndex, mesh.index, subMeshIndex );
+}
+
+static void RenderInstancedMeshes( const teScene& scene, teBlendMode blendMode, unsigned shadowMapIndex, const teShader* overrideShader, teStat drawnStat )
+{
+    const Affine3x4 identity;
+
+    for (unsigned drawIndex = 0; drawIndex < instancedDraws.drawCount; ++drawIndex)
+    {
+        const InstancedDraw& draw = instancedDraws.draws[ drawIndex ];
+        const teMesh* mesh = teMeshRendererGetMesh( draw.gameObjectIndex );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < teMeshGetSubMeshCount( mesh ); ++subMeshIndex)
+        {
+            const teMaterial& material = teMeshRendererGetMaterial( draw.gameObjectIndex, subMeshIndex );
+
+            if (material.blendMode != blendMode)
+            {
+                continue;
+            }
+
+            UpdateInstances( draw.instanceToWorld, draw.tints, draw.instanceCount );
+            DrawSubMesh( scene, *mesh, subMeshIndex, material, viewMatrices.worldToView, identity, shadowMapIndex, overrideShader );
+            StatAdd( drawnStat, 1 );
+            StatAdd( teStat::InstancesDrawn, draw.instanceCount );
+        }
+    }
+}
+
+// \param drawnStat Counts the drawn submeshes.
+static void RenderMeshes( const teScene& scene, teBlendMode blendMode, unsigned shadowMapIndex, const teShader* overrideShader, teStat drawnStat )
 {
-    for (unsigned gameObjectIndex = 0; gameObjectIndex < MAX_GAMEOBJECTS; ++gameObjectIndex)
+    TE_PROFILE_SCOPE( "RenderMeshes" );
+
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < scenes[ scene.index ].gameObjectCount; ++gameObjectIndex)
     {
         if (scenes[ scene.index ].gameObjects[ gameObjectIndex ] == 0 ||
             (teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) & teComponent::MeshRenderer) == 0)
@@ -278,16 +680,8 @@ static void RenderMeshes( const teScene& scene, teBlendMode blendMode, unsigned
             continue;
         }
         
-        Matrix localToClip;
-        teTransformGetComputedLocalToClipMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ], localToClip );
-
-        Matrix localToView;
-        teTransformGetComputedLocalToViewMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ], localToView );
-
-        Matrix localToShadowClip;
-        teTransformGetComputedLocalToShadowClipMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ], localToShadowClip );
-
-        Matrix localToWorld = teTransformGetMatrix( scenes[ scene.index ].gameObjects[ gameObjectIndex ] );
+        const Affine3x4& localToView = viewMatrices.localToViews[ gameObjectIndex ];
+        const Affine3x4& localToWorld = TransformGetLocalAffine( scenes[ scene.index ].gameObjects[ gameObjectIndex ] );
 
         const teMesh* mesh = teMeshRendererGetMesh( scenes[ scene.index ].gameObjects[ gameObjectIndex ] );
 
@@ -300,53 +694,12 @@ static void RenderMeshes( const teScene& scene, teBlendMode blendMode, unsigned
                 continue;
             }
 
-            ShaderParams shaderParams{};
-            Vec4 tint = teMaterialGetTint( material );
-            shaderParams.tint[ 0 ] = tint.x;
-            shaderParams.tint[ 1 ] = tint.y;
-            shaderParams.tint[ 2 ] = tint.z;
-            shaderParams.tint[ 3 ] = tint.w;
-            Vec4 lightDir;
-            lightDir.x = scenes[ scene.index ].directionalLightDirection.x;
-            lightDir.y = scenes[ scene.index ].directionalLightDirection.y;
-            lightDir.z = scenes[ scene.index ].directionalLightDirection.z;
-            Vec4 lightColor;
-            lightColor.x = scenes[ scene.index ].directionalLightColor.x;
-            lightColor.y = scenes[ scene.index ].directionalLightColor.y;
-            lightColor.z = scenes[ scene.index ].directionalLightColor.z;
-            Vec4 lightPosition;
-            lightPosition.x = scenes[ scene.index ].directionalLightPosition.x;
-            lightPosition.y = scenes[ scene.index ].directionalLightPosition.y;
-            lightPosition.z = scenes[ scene.index ].directionalLightPosition.z;
-
-            for (unsigned i = 0; i < 16; ++i)
-            {
-                shaderParams.localToView[ i ] = localToView.m[ i ];
-                //shaderParams.clipToView[ i ] = clipToView.m[ i ];
-            }
-
-            unsigned width, height;
-            RendererGetSize( width, height );
-            shaderParams.tilesXY[ 0 ] = (float)width;
-            shaderParams.tilesXY[ 1 ] = (float)height;
-
-            UpdateUBO( localToClip.m, localToShadowClip.m, localToWorld.m, shaderParams, lightDir, lightColor, lightPosition );
-
-            const teShader shader = overrideShader ? *overrideShader : teMaterialGetShader( material );
-
-            unsigned indexOffset = teMeshGetIndexOffset( *mesh, subMeshIndex );
-            unsigned indexCount = teMeshGetIndexCount( *mesh, subMeshIndex );
-            unsigned positionOffset = teMeshGetPositionOffset( *mesh, subMeshIndex );
-            unsigned normalOffset = teMeshGetNormalOffset( *mesh, subMeshIndex );
-            unsigned uvOffset = teMeshGetUVOffset( *mesh, subMeshIndex );
-            unsigned tangentOffset = teMeshGetTangentOffset( *mesh, subMeshIndex );
-
-            teTexture2D texture = teMaterialGetTexture2D( material, 0 );
-            teTexture2D normalMap = teMaterialGetTexture2D( material, 1 );
-
-            Draw( shader, positionOffset, uvOffset, normalOffset, tangentOffset, indexCount, indexOffset, material.blendMode, material.cullMode, material.depthMode, mesh->topology, material.fillMode, texture.index, texture.sampler, normalMap.index, shadowMapIndex, mesh->index, subMeshIndex );
+            DrawSubMesh( scene, *mesh, subMeshIndex, material, localToView, localToWorld, shadowMapIndex, overrideShader );
+            StatAdd( drawnStat, 1 );
         }
     }
+
+    RenderInstancedMeshes( scene, blendMode, shadowMapIndex, overrideShader, drawnStat );
 }
 
 static void RenderDepthAndNormals( const teScene& scene, unsigned cameraGOIndex, const teShader* shader )
@@ -363,8 +716,8 @@ static void RenderDepthAndNormals( const teScene& scene, unsigned cameraGOIndex,
     BeginRendering( depthNormals, depth, clearFlag, &clearColor.x );
     PushGroupMarker( "DepthNormals");
 
-    RenderMeshes( scene, teBlendMode::Off, 0, shader );
-    RenderMeshes( scene, teBlendMode::Alpha, 0, shader );
+    RenderMeshes( scene, teBlendMode::Off, 0, shader, teStat::DepthNormalsSubMeshesDrawn );
+    RenderMeshes( scene, teBlendMode::Alpha, 0, shader, teStat::DepthNormalsSubMeshesDrawn );
 
     PopGroupMarker();
     EndRendering( depthNormals, depth );
@@ -393,15 +746,27 @@ static void RenderSceneWithCamera( const teScene& scene, unsigned cameraGOIndex,
 
     if (cullLightsShader)
     {
-        for (unsigned gameObjectIndex = 0; gameObjectIndex < MAX_GAMEOBJECTS; ++gameObjectIndex)
+        unsigned pointLightCount = 0;
+        const unsigned* pointLights = teGameObjectGetObjectsWithComponent( teComponent::PointLight, pointLightCount );
+
+        for (unsigned i = 0; i < pointLightCount; ++i)
         {
-            if ((teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) & teComponent::PointLight) != 0)
+            if (scenes[ scene.index ].gameObjectSlots[ pointLights[ i ] ] != 0)
             {
-                SetPointLightPosition( scenes[ scene.index ].gameObjects[ gameObjectIndex ], teTransformGetLocalPosition( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) );
+                SetPointLightPosition( pointLights[ i ], teTransformGetLocalPosition( pointLights[ i ] ) );
+                StatAdd( teStat::LightsTiled, 1 );
             }
-            if ((teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) & teComponent::SpotLight) != 0)
+        }
+
+        unsigned spotLightCount = 0;
+        const unsigned* spotLights = teGameObjectGetObjectsWithComponent( teComponent::SpotLight, spotLightCount );
+
+        for (unsigned i = 0; i < spotLightCount; ++i)
+        {
+            if (scenes[ scene.index ].gameObjectSlots[ spotLights[ i ] ] != 0)
             {
-                SetSpotLightPosition( scenes[ scene.index ].gameObjects[ gameObjectIndex ], teTransformGetLocalPosition( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) );
+                SetSpotLightPosition( spotLights[ i ], teTransformGetLocalPosition( spotLights[ i ] ) );
+                StatAdd( teStat::LightsTiled, 1 );
             }
         }
 	
@@ -425,21 +790,23 @@ static void RenderSceneWithCamera( const teScene& scene, unsigned cameraGOIndex,
         RenderSky( cameraGOIndex, skyboxShader, skyboxTexture, skyboxMesh );
     }
 
-    RenderMeshes( scene, teBlendMode::Off, shadowMapindex, momentsShader );
-    RenderMeshes( scene, teBlendMode::Alpha, shadowMapindex, momentsShader );
+    const teStat drawnStat = cameraGOIndex == scenes[ scene.index ].shadowCaster.cameraIndex ? teStat::ShadowSubMeshesDrawn : teStat::CameraSubMeshesDrawn;
+
+    PushGroupMarker( "Opaque" );
+    RenderMeshes( scene, teBlendMode::Off, shadowMapindex, momentsShader, drawnStat );
+    PopGroupMarker();
+
+    PushGroupMarker( "Alpha" );
+    RenderMeshes( scene, teBlendMode::Alpha, shadowMapindex, momentsShader, drawnStat );
+    PopGroupMarker();
 
     PopGroupMarker();
 
     // render lines begin
     if (!momentsShader)
     {
-        Matrix localToView;
-        Matrix localToShadowClip;
-        Matrix localToClip;
-        Matrix localToWorld;
-
-        Matrix::Multiply( localToWorld, teTransformGetMatrix( cameraGOIndex ), localToView );
-        Matrix::Multiply( localToView, teCameraGetProjection( cameraGOIndex ), localToClip );
+        const Affine3x4 localToWorld;
+        const Matrix worldToShadowClip;
 
         ShaderParams shaderParams{};
         shaderParams.tint[ 0 ] = 1;
@@ -447,7 +814,7 @@ static void RenderSceneWithCamera( const teScene& scene, unsigned cameraGOIndex,
         shaderParams.tint[ 2 ] = 1;
         shaderParams.tint[ 3 ] = 1;
 
-        UpdateUBO( localToClip.m, localToShadowClip.m, localToWorld.m, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+        UpdateUBO( TransformGetLocalAffine( cameraGOIndex ), teCameraGetProjection( cameraGOIndex ), localToWorld, worldToShadowClip, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
 
         DrawLines();
     }
@@ -468,17 +835,6 @@ static void RenderDirLightShadow( const teScene& scene, const teShader& momentsS
         teTransformLookAt( index, dirLightPosition, dirLightPosition - scenes[ scene.index ].shadowCaster.lightDirection, {0, 1, 0});
         teCameraSetProjection( index, 45, 1, 0.1f, 400.0f );
 
-        TransformSolveLocalMatrix( index, true );
-        const Matrix localToWorld = teTransformGetMatrix( index );
-
-        Matrix localToView;
-        Matrix localToClip;
-        Matrix::Multiply( localToWorld, teTransformGetMatrix( index ), localToView );
-        Matrix::Multiply( localToView, teCameraGetProjection( index ), localToClip );
-
-        TransformSetComputedLocalToClip( index, localToClip );
-        TransformSetComputedLocalToView( index, localToView );
-
         RenderSceneWithCamera( scene, index, nullptr, nullptr, nullptr, 0, "Shadow Map", &momentsShader, nullptr, nullptr );
     }
 
@@ -487,25 +843,30 @@ static void RenderDirLightShadow( const teScene& scene, const teShader& momentsS
 
 void teSceneRender( const teScene& scene, const teShader* skyboxShader, const teTextureCube* skyboxTexture, const teMesh* skyboxMesh, const teShader& momentsShader, const Vec3& dirLightPosition, const teShader& depthNormalsShader, const teShader& lightCullShader )
 {
+    TE_PROFILE_SCOPE( "teSceneRender" );
+
+    SolveSceneTransforms( scene );
+
     Vec3 dirLightColor{ 1, 1, 1 };
     unsigned shadowMapIndex = 0;
     RenderDirLightShadow( scene, momentsShader, dirLightPosition, dirLightColor, shadowMapIndex );
 
-    int cameraIndex = -1;
+    unsigned cameraCount = 0;
+    const unsigned* cameraObjects = teGameObjectGetObjectsWithComponent( teComponent::Camera, cameraCount );
+    unsigned cameraGOIndex = 0;
 
-    for (unsigned i = 0; i < MAX_GAMEOBJECTS; ++i)
+    for (unsigned i = 0; i < cameraCount; ++i)
     {
-        if (scenes[ scene.index ].gameObjects[ i ] != 0 &&
-            (teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ i ] ) & teComponent::Camera) != 0)
+        if (scenes[ scene.index ].gameObjectSlots[ cameraObjects[ i ] ] != 0)
         {
-            cameraIndex = i;
+            cameraGOIndex = cameraObjects[ i ];
             break;
         }
     }
 
-    if (cameraIndex != -1)
+    if (cameraGOIndex != 0)
     {
-        RenderSceneWithCamera( scene, scenes[ scene.index ].gameObjects[ cameraIndex ], skyboxShader, skyboxTexture, skyboxMesh, shadowMapIndex, "Camera", nullptr, &depthNormalsShader, &lightCullShader );
+        RenderSceneWithCamera( scene, cameraGOIndex, skyboxShader, skyboxTexture, skyboxMesh, shadowMapIndex, "Camera", nullptr, &depthNormalsShader, &lightCullShader );
     }
 }
 
@@ -513,7 +874,7 @@ bool teScenePointInsideAABB( const teScene& scene, const Vec3& point )
 {
     bool isInside = false;
 
-    for (unsigned gameObjectIndex = 0; gameObjectIndex < MAX_GAMEOBJECTS; ++gameObjectIndex)
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < scenes[ scene.index ].gameObjectCount; ++gameObjectIndex)
     {
         if (scenes[ scene.index ].gameObjects[ gameObjectIndex ] != 0 &&
             (teGameObjectGetComponents( scenes[ scene.index ].gameObjects[ gameObjectIndex ] ) & teComponent::Transform) != 0 &&
@@ -554,9 +915,433 @@ bool teScenePointInsideAABB( const teScene& scene, const Vec3& point )
     return isInside;
 }
 
+constexpr unsigned MaxStaticBatches = 1000;
+static teMesh staticBatchMeshes[ MaxStaticBatches ]; // Batch game objects' mesh renderers point here.
+static unsigned staticBatchMeshCount = 0;
+TE_TRACK_STATIC_MEMORY( staticBatchMeshesMemory, teMemoryTag::Scene, sizeof( staticBatchMeshes ) );
+
+struct StaticBatchSource
+{
+    Matrix localToWorld;
+    const teMaterial* material = nullptr;
+    const teMesh* mesh = nullptr;
+    unsigned gameObjectIndex = 0;
+    unsigned sceneListIndex = 0; // Index in the scene's game object list.
+    unsigned subMeshIndex = 0;
+    unsigned vertexCount = 0;
+    int cell[ 3 ] = {};
+    bool hasMeshlets = false;
+};
+
+// Orders sources so that the ones that can be merged are next to each other.
+static int CompareStaticBatchSources( const void* a, const void* b )
+{
+    const StaticBatchSource& sa = *(const StaticBatchSource*)a;
+    const StaticBatchSource& sb = *(const StaticBatchSource*)b;
+
+    const unsigned keysA[] = { sa.material->index, (unsigned)sa.material->blendMode, (unsigned)sa.material->cullMode, (unsigned)sa.material->depthMode,
+                               (unsigned)sa.material->fillMode, sa.hasMeshlets ? 1u : 0u, (unsigned)sa.cell[ 0 ], (unsigned)sa.cell[ 1 ], (unsigned)sa.cell[ 2 ] };
+    const unsigned keysB[] = { sb.material->index, (unsigned)sb.material->blendMode, (unsigned)sb.material->cullMode, (unsigned)sb.material->depthMode,
+                               (unsigned)sb.material->fillMode, sb.hasMeshlets ? 1u : 0u, (unsigned)sb.cell[ 0 ], (unsigned)sb.cell[ 1 ], (unsigned)sb.cell[ 2 ] };
+
+    for (unsigned k = 0; k < sizeof( keysA ) / sizeof( keysA[ 0 ] ); ++k)
+    {
+        if (keysA[ k ] != keysB[ k ])
+        {
+            return keysA[ k ] < keysB[ k ] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+static bool CanMergeStaticBatchSources( const StaticBatchSource& a, const StaticBatchSource& b )
+{
+    return CompareStaticBatchSources( &a, &b ) == 0;
+}
+
+// Fills outSources with the submeshes of the scene's enabled static mesh renderers, except excluded ones, sorted so that
+// mergeable submeshes are next to each other. isExcluded is indexed like the scene's game object list.
+// @return Number of sources.
+static unsigned GatherStaticBatchSources( const SceneImpl& impl, const bool* isExcluded, float clusterSize, StaticBatchSource* outSources )
+{
+    unsigned sourceCount = 0;
+
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < impl.gameObjectCount; ++gameObjectIndex)
+    {
+        const unsigned goIndex = impl.gameObjects[ gameObjectIndex ];
+
+        if (isExcluded[ gameObjectIndex ] || goIndex == 0 || (teGameObjectGetComponents( goIndex ) & teComponent::MeshRenderer) == 0 ||
+            !teMeshRendererIsStatic( goIndex ) || !teMeshRendererIsEnabled( goIndex ) || teMeshRendererGetMesh( goIndex ) == nullptr)
+        {
+            continue;
+        }
+
+        TransformSolveLocalMatrix( goIndex, false );
+
+        const teMesh* mesh = teMeshRendererGetMesh( goIndex );
+
+        for (unsigned subMeshIndex = 0; subMeshIndex < teMeshGetSubMeshCount( mesh ); ++subMeshIndex)
+        {
+            StaticBatchSource& source = outSources[ sourceCount++ ];
+            source = StaticBatchSource();
+            source.gameObjectIndex = goIndex;
+            source.sceneListIndex = gameObjectIndex;
+            source.localToWorld = teTransformGetMatrix( goIndex );
+            source.material = &teMeshRendererGetMaterial( goIndex, subMeshIndex );
+            source.mesh = mesh;
+            source.subMeshIndex = subMeshIndex;
+            source.vertexCount = teMeshGetUVCount( *mesh, subMeshIndex );
+            source.hasMeshlets = GetMeshletCount( mesh->index, subMeshIndex ) > 0;
+
+            Vec3 aabbMinLocal, aabbMaxLocal;
+            teMeshGetSubMeshLocalAABB( *mesh, subMeshIndex, aabbMinLocal, aabbMaxLocal );
+            Vec3 aabbMinWorld, aabbMaxWorld;
+            GetWorldAABB( aabbMinLocal, aabbMaxLocal, source.localToWorld, aabbMinWorld, aabbMaxWorld );
+            const Vec3 center = (aabbMinWorld + aabbMaxWorld) * 0.5f;
+            source.cell[ 0 ] = (int)floorf( center.x / clusterSize );
+            source.cell[ 1 ] = (int)floorf( center.y / clusterSize );
+            source.cell[ 2 ] = (int)floorf( center.z / clusterSize );
+        }
+    }
+
+    qsort( outSources, sourceCount, sizeof( StaticBatchSource ), CompareStaticBatchSources );
+
+    return sourceCount;
+}
+
+// Indices are 16-bit, so a cluster that has more vertices is split into several batches. A batch only has more than
+// 65536 vertices if its single submesh has.
+// @return One past the last source of the batch that starts at first.
+static unsigned GetStaticBatchEnd( const StaticBatchSource* sources, unsigned sourceCount, unsigned first, unsigned& outVertexCount )
+{
+    unsigned end = first;
+    outVertexCount = 0;
+
+    while (end < sourceCount && CanMergeStaticBatchSources( sources[ first ], sources[ end ] ) &&
+           (end == first || outVertexCount + sources[ end ].vertexCount <= 65536))
+    {
+        outVertexCount += sources[ end ].vertexCount;
+        ++end;
+    }
+
+    return end;
+}
+
+unsigned teSceneBuildStaticBatches( const teScene& scene, float clusterSize )
+{
+    teAssert( clusterSize > 0 );
+
+    const SceneImpl& impl = scenes[ scene.index ];
+    unsigned sourceCount = 0;
+
+    for (unsigned gameObjectIndex = 0; gameObjectIndex < impl.gameObjectCount; ++gameObjectIndex)
+    {
+        const unsigned goIndex = impl.gameObjects[ gameObjectIndex ];
+
+        if (goIndex != 0 && (teGameObjectGetComponents( goIndex ) & teComponent::MeshRenderer) != 0 && teMeshRendererIsStatic( goIndex ) &&
+            teMeshRendererIsEnabled( goIndex ))
+        {
+            sourceCount += teMeshGetSubMeshCount( teMeshRendererGetMesh( goIndex ) );
+        }
+    }
+
+    if (sourceCount == 0)
+    {
+        return 0;
+    }
+
+    StaticBatchSource* sources = (StaticBatchSource*)teMalloc( sourceCount * sizeof( StaticBatchSource ), teMemoryTag::Scene );
+    bool* isExcluded = teMallocArray< bool >( impl.gameObjectCount, teMemoryTag::Scene );
+    unsigned excludedCount = 0;
+
+    // A game object is batched whole or not at all, otherwise its unbatched submeshes couldn't be drawn without drawing
+    // the batched ones twice. Excluding a game object changes the batches, so this repeats until every batch fits.
+    for (;;)
+    {
+        sourceCount = GatherStaticBatchSources( impl, isExcluded, clusterSize, sources );
+        const unsigned excludedCountBefore = excludedCount;
+        unsigned batchIndex = staticBatchMeshCount;
+        unsigned vertexCount = 0;
+
+        for (unsigned first = 0, end = 0; first < sourceCount; first = end, ++batchIndex)
+        {
+            end = GetStaticBatchEnd( sources, sourceCount, first, vertexCount );
+
+            if (batchIndex < MaxStaticBatches && vertexCount <= 65536)
+            {
+                continue;
+            }
+
+            for (unsigned s = first; s < end; ++s)
+            {
+                excludedCount += isExcluded[ sources[ s ].sceneListIndex ] ? 0 : 1;
+                isExcluded[ sources[ s ].sceneListIndex ] = true;
+            }
+        }
+
+        if (excludedCount == excludedCountBefore)
+        {
+            break;
+        }
+    }
+
+    if (excludedCount > 0)
+    {
+        teLog( teLogLevel::Warning, "Could not batch %u static game objects: too many batches or a submesh has too many vertices\n", excludedCount );
+    }
+
+    for (unsigned s = 0; s < sourceCount; ++s)
+    {
+        teMeshRendererSetEnabled( sources[ s ].gameObjectIndex, false );
+    }
+
+    const teMesh** batchMeshes = (const teMesh**)teMalloc( sourceCount * sizeof( teMesh* ), teMemoryTag::Scene );
+    unsigned* batchSubMeshIndices = (unsigned*)teMalloc( sourceCount * sizeof( unsigned ), teMemoryTag::Scene );
+    Matrix* batchLocalToWorlds = (Matrix*)teMalloc( sourceCount * sizeof( Matrix ), teMemoryTag::Scene );
+    unsigned batchCount = 0;
+    unsigned first = 0;
+
+    while (first < sourceCount)
+    {
+        unsigned vertexCount = 0;
+        const unsigned end = GetStaticBatchEnd( sources, sourceCount, first, vertexCount );
+        teAssert( staticBatchMeshCount < MaxStaticBatches && vertexCount <= 65536 );
+
+        for (unsigned s = first; s < end; ++s)
+        {
+            batchMeshes[ s - first ] = sources[ s ].mesh;
+            batchSubMeshIndices[ s - first ] = sources[ s ].subMeshIndex;
+            batchLocalToWorlds[ s - first ] = sources[ s ].localToWorld;
+        }
+
+        teMesh& batchMesh = staticBatchMeshes[ staticBatchMeshCount++ ];
+        batchMesh = CreateStaticBatchMesh( batchMeshes, batchSubMeshIndices, batchLocalToWorlds, end - first );
+
+        teGameObject batchGo = teCreateGameObject( "static batch", teComponent::Transform | teComponent::MeshRenderer );
+        teMeshRendererSetMesh( batchGo.index, &batchMesh );
+        teMeshRendererSetMaterial( batchGo.index, *sources[ first ].material, 0 );
+        teSceneAdd( scene, batchGo.index );
+
+        ++batchCount;
+        first = end;
+    }
+
+    teFree( sources );
+    teFree( isExcluded );
+    teFree( batchMeshes );
+    teFree( batchSubMeshIndices );
+    teFree( batchLocalToWorlds );
+
+    return batchCount;
+}
+
+static_assert( SceneBinaryAllSubMeshes == teStreamAllSubMeshes, "Binary scene submesh wildcard is passed to teStreamBindMeshMaterial as-is" );
+
+static bool IsBinaryScene( const teFile& sceneFile )
+{
+    return sceneFile.data && sceneFile.size >= sizeof( SceneBinaryHeader ) && memcmp( sceneFile.data, SceneBinaryMagic, sizeof( SceneBinaryMagic ) ) == 0;
+}
+
+struct BinaryScene
+{
+    const SceneBinaryHeader* header;
+    const SceneBinaryTexture* textures;
+    const SceneBinaryMaterial* materials;
+    const SceneBinaryMesh* meshes;
+    const SceneBinaryGameObject* gameObjects;
+    const float* positions;
+    const float* rotations;
+    const float* scales;
+    const SceneBinaryMeshMaterial* meshMaterials;
+    const char* strings;
+};
+
+static bool IsBinarySceneIndexValid( uint32_t index, uint32_t count )
+{
+    return index < count || index == SceneBinaryNone;
+}
+
+// Finds the sections and checks that every offset and index in them is in range.
+// @return false if the file is not a valid binary scene. Nothing in the file is trusted before this returns true.
+static bool ReadBinarySceneSections( const teFile& sceneFile, BinaryScene& outScene )
+{
+    const SceneBinaryHeader& header = *(const SceneBinaryHeader*)sceneFile.data;
+    const size_t expectedSize = sizeof( SceneBinaryHeader ) + (size_t)header.textureCount * sizeof( SceneBinaryTexture ) + (size_t)header.materialCount * sizeof( SceneBinaryMaterial ) +
+                                (size_t)header.meshCount * sizeof( SceneBinaryMesh ) + (size_t)header.gameObjectCount * (sizeof( SceneBinaryGameObject ) + 8 * sizeof( float )) +
+                                (size_t)header.meshMaterialCount * sizeof( SceneBinaryMeshMaterial ) + header.stringTableBytes;
+
+    if (sceneFile.size != expectedSize || header.stringTableBytes == 0 || sceneFile.data[ sceneFile.size - 1 ] != 0)
+    {
+        teLog( teLogLevel::Error, "%s is not a valid binary scene!\n", sceneFile.path );
+        return false;
+    }
+
+    const unsigned char* cursor = sceneFile.data + sizeof( SceneBinaryHeader );
+
+    outScene.header = &header;
+    outScene.textures = (const SceneBinaryTexture*)cursor;
+    cursor += header.textureCount * sizeof( SceneBinaryTexture );
+    outScene.materials = (const SceneBinaryMaterial*)cursor;
+    cursor += header.materialCount * sizeof( SceneBinaryMaterial );
+    outScene.meshes = (const SceneBinaryMesh*)cursor;
+    cursor += header.meshCount * sizeof( SceneBinaryMesh );
+    outScene.gameObjects = (const SceneBinaryGameObject*)cursor;
+    cursor += header.gameObjectCount * sizeof( SceneBinaryGameObject );
+    outScene.positions = (const float*)cursor;
+    cursor += header.gameObjectCount * 3 * sizeof( float );
+    outScene.rotations = (const float*)cursor;
+    cursor += header.gameObjectCount * 4 * sizeof( float );
+    outScene.scales = (const float*)cursor;
+    cursor += header.gameObjectCount * sizeof( float );
+    outScene.meshMaterials = (const SceneBinaryMeshMaterial*)cursor;
+    cursor += header.meshMaterialCount * sizeof( SceneBinaryMeshMaterial );
+    outScene.strings = (const char*)cursor;
+
+    const uint32_t stringBytes = header.stringTableBytes;
+
+    for (unsigned t = 0; t < header.textureCount; ++t)
+    {
+        if (outScene.textures[ t ].name >= stringBytes || outScene.textures[ t ].path >= stringBytes)
+        {
+            teLog( teLogLevel::Error, "%s: texture %u has a string offset out of range!\n", sceneFile.path, t );
+            return false;
+        }
+    }
+
+    for (unsigned m = 0; m < header.materialCount; ++m)
+    {
+        const SceneBinaryMaterial& material = outScene.materials[ m ];
+
+        if (material.name >= stringBytes || !IsBinarySceneIndexValid( material.tex0, header.textureCount ) || !IsBinarySceneIndexValid( material.tex1, header.textureCount ))
+        {
+            teLog( teLogLevel::Error, "%s: material %u has a string offset or texture index out of range!\n", sceneFile.path, m );
+            return false;
+        }
+    }
+
+    for (unsigned m = 0; m < header.meshCount; ++m)
+    {
+        if (outScene.meshes[ m ].name >= stringBytes || outScene.meshes[ m ].path >= stringBytes)
+        {
+            teLog( teLogLevel::Error, "%s: mesh %u has a string offset out of range!\n", sceneFile.path, m );
+            return false;
+        }
+    }
+
+    for (unsigned g = 0; g < header.gameObjectCount; ++g)
+    {
+        const SceneBinaryGameObject& go = outScene.gameObjects[ g ];
+
+        if (go.name >= stringBytes || !IsBinarySceneIndexValid( go.mesh, header.meshCount ) ||
+            (uint64_t)go.firstMeshMaterial + go.meshMaterialCount > header.meshMaterialCount)
+        {
+            teLog( teLogLevel::Error, "%s: gameobject %u has a string offset, mesh or meshmaterial range out of range!\n", sceneFile.path, g );
+            return false;
+        }
+    }
+
+    for (unsigned mm = 0; mm < header.meshMaterialCount; ++mm)
+    {
+        if (outScene.meshMaterials[ mm ].material >= header.materialCount)
+        {
+            teLog( teLogLevel::Error, "%s: meshmaterial %u has a material index out of range!\n", sceneFile.path, mm );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void ReadBinaryScene( const teFile& sceneFile, const teShader& standardShader, teGameObject* gos, teTexture2D* textures, teMaterial* materials, teMesh* meshes )
+{
+    BinaryScene scene;
+
+    if (!ReadBinarySceneSections( sceneFile, scene ))
+    {
+        return;
+    }
+
+    const SceneBinaryHeader& header = *scene.header;
+
+    for (unsigned t = 0; t < header.textureCount; ++t)
+    {
+        teStreamTexture( scene.strings + scene.textures[ t ].path, teTextureFlags::GenerateMips, &textures[ t ] );
+    }
+
+    for (unsigned m = 0; m < header.materialCount; ++m)
+    {
+        materials[ m ] = teCreateMaterial( standardShader );
+
+        if (scene.materials[ m ].tex0 != SceneBinaryNone)
+        {
+            teStreamBindTexture( &textures[ scene.materials[ m ].tex0 ], materials[ m ], 0 );
+        }
+
+        if (scene.materials[ m ].tex1 != SceneBinaryNone)
+        {
+            teStreamBindTexture( &textures[ scene.materials[ m ].tex1 ], materials[ m ], 1 );
+        }
+    }
+
+    for (unsigned m = 0; m < header.meshCount; ++m)
+    {
+        teStreamMesh( scene.strings + scene.meshes[ m ].path, &meshes[ m ] );
+    }
+
+    for (unsigned g = 0; g < header.gameObjectCount; ++g)
+    {
+        gos[ g ] = teCreateGameObject( scene.strings + scene.gameObjects[ g ].name, scene.gameObjects[ g ].components );
+    }
+
+    // Game objects get consecutive indices unless destroyed ones are reused, so transforms are copied in runs.
+    for (unsigned first = 0; first < header.gameObjectCount;)
+    {
+        unsigned end = first + 1;
+
+        while (end < header.gameObjectCount && gos[ end ].index == gos[ end - 1 ].index + 1)
+        {
+            ++end;
+        }
+
+        TransformCopyLocals( gos[ first ].index, end - first, scene.positions + first * 3, scene.rotations + first * 4, scene.scales + first );
+        first = end;
+    }
+
+    for (unsigned g = 0; g < header.gameObjectCount; ++g)
+    {
+        const SceneBinaryGameObject& sceneGo = scene.gameObjects[ g ];
+
+        if (sceneGo.mesh == SceneBinaryNone)
+        {
+            continue;
+        }
+
+        teMeshRendererSetMesh( gos[ g ].index, &meshes[ sceneGo.mesh ] );
+
+        for (unsigned mm = sceneGo.firstMeshMaterial; mm < sceneGo.firstMeshMaterial + sceneGo.meshMaterialCount; ++mm)
+        {
+            const SceneBinaryMeshMaterial& meshMaterial = scene.meshMaterials[ mm ];
+            teStreamBindMeshMaterial( &meshes[ sceneGo.mesh ], gos[ g ].index, materials[ meshMaterial.material ], meshMaterial.subMesh );
+        }
+    }
+}
+
 void teSceneReadArraySizes( const teFile& sceneFile, unsigned& outGoCount, unsigned& outTextureCount, 
                             unsigned& outMaterialCount, unsigned& outMeshCount )
 {
+    if (IsBinaryScene( sceneFile ))
+    {
+        BinaryScene scene;
+        const bool isValid = ReadBinarySceneSections( sceneFile, scene );
+
+        outGoCount = isValid ? scene.header->gameObjectCount : 0;
+        outTextureCount = isValid ? scene.header->textureCount : 0;
+        outMaterialCount = isValid ? scene.header->materialCount : 0;
+        outMeshCount = isValid ? scene.header->meshCount : 0;
+        return;
+    }
+
     outGoCount = 0;
     outTextureCount = 0;
     outMaterialCount = 0;
@@ -575,7 +1360,7 @@ void teSceneReadArraySizes( const teFile& sceneFile, unsigned& outGoCount, unsig
         {
             line[ i - 1 ] = 0;
             i = 0;
-            tePrint( "line: %s\n", line );
+            teLogVerbose( "line: %s\n", line );
             // TODO: make sure that file names containing spaces work.
             // TODO: don't add duplicates.
             if (teStrstr( line, "texture2d" ) == line)
@@ -610,6 +1395,7 @@ void teSceneReadArraySizes( const teFile& sceneFile, unsigned& outGoCount, unsig
 }
 
 char gSceneStrings[ 20000 ];
+TE_TRACK_STATIC_MEMORY( sceneStringsMemory, teMemoryTag::Scene, sizeof( gSceneStrings ) );
 uint32_t gNextFreeSceneString = 0;
 
 uint32_t InsertSceneString( char* str )
@@ -625,6 +1411,14 @@ uint32_t InsertSceneString( char* str )
 
 void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader, teGameObject* gos, teTexture2D* textures, teMaterial* materials, teMesh* meshes )
 {
+    TE_PROFILE_SCOPE( "teSceneReadScene" );
+
+    if (IsBinaryScene( sceneFile ))
+    {
+        ReadBinaryScene( sceneFile, standardShader, gos, textures, materials, meshes );
+        return;
+    }
+
     unsigned goCount = 0;
     unsigned textureCount = 0;
     unsigned materialCount = 0;
@@ -634,6 +1428,9 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
     unsigned cursor = 0;
     unsigned i = 0;
 
+    // Names are only needed while parsing this file, so every read reuses the whole pool.
+    gNextFreeSceneString = 0;
+
     unsigned meshNameIndices[ 1000 ];
     unsigned textureNameIndices[ 1000 ];
     unsigned materialNameIndices[ 1000 ];
@@ -664,7 +1461,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     name[ nameCursor ] = line[ nameCursor + offset ];
                     ++nameCursor;
                 }
-                tePrint( "texture name: %s\n", name );
+                teLogVerbose( "texture name: %s\n", name );
                 textureNameIndices[ textureCount ] = InsertSceneString( name );
 
                 char fileName[ 100 ] = {};
@@ -682,10 +1479,8 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                 fileName[ fileNameCursor + 1 ] = 'd';
                 fileName[ fileNameCursor + 2 ] = 'd';
                 fileName[ fileNameCursor + 3 ] = 's';
-                tePrint( "file name: %s\n", fileName );
-                teFile texFile = teLoadFile( fileName );
-
-                textures[ textureCount ] = teLoadTexture( texFile, teTextureFlags::GenerateMips, nullptr, 0, 0, teTextureFormat::Invalid );
+                teLogVerbose( "file name: %s\n", fileName );
+                teStreamTexture( fileName, teTextureFlags::GenerateMips, &textures[ textureCount ] );
                 ++textureCount;
             }
             else if (teStrstr( line, "material" ) == line)
@@ -701,7 +1496,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     ++nameCursor;
                 }
 
-                tePrint( "material name: %s\n", name );
+                teLogVerbose( "material name: %s\n", name );
                 materialNameIndices[ materialCount ] = InsertSceneString( name );
                 materials[ materialCount ] = teCreateMaterial( standardShader );
 
@@ -719,13 +1514,13 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     name[ nameCursor ] = line[ nameCursor + offset ];
                     ++nameCursor;
                 }
-                tePrint( "gameobject name: %s\n", name );
-                gos[ goCount ] = teCreateGameObject( "gameobject", teComponent::Transform );
+                teLogVerbose( "gameobject name: %s\n", name );
+                gos[ goCount ] = teCreateGameObject( name, teComponent::Transform );
                 ++goCount;
             }
             else if (teStrstr( line, "meshmaterial" ) == line)
             {
-                tePrint("line begins with meshmaterial\n");
+                teLogVerbose( "line begins with meshmaterial\n");
                 char index[ 100 ] = {};
                 unsigned indexCursor = 0;
                 unsigned offset = teStrlen( "meshmaterial " );
@@ -735,7 +1530,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     index[ indexCursor ] = line[ indexCursor + offset ];
                     ++indexCursor;
                 }
-                tePrint( "meshmaterial submesh index: %s\n", index );
+                teLogVerbose( "meshmaterial submesh index: %s\n", index );
 
                 char materialName[ 100 ] = {};
                 unsigned materialNameCursor = 0;
@@ -747,7 +1542,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     ++materialNameCursor;
                 }
 
-                tePrint( "meshmaterial material name: %s\n", materialName );
+                teLogVerbose( "meshmaterial material name: %s\n", materialName );
                 unsigned materialIndex = 0;
 
                 for (unsigned m = 0; m < materialCount; ++m)
@@ -758,31 +1553,17 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     }
                 }
 
-                if (teStrstr( index, "all" ))
-                {
-                    tePrint( "all submeshes wanted\n" );
-                    for (unsigned subMeshIndex = 0; subMeshIndex < teMeshGetSubMeshCount( teMeshRendererGetMesh( gos[ goCount - 1 ].index ) ); ++subMeshIndex)
-                    {
-                        teMeshRendererSetMaterial( gos[ goCount - 1 ].index, materials[ materialIndex ], subMeshIndex );
-                    }
-                }
-                else
-                {
-                    unsigned subMeshIndex = atoi( index );
-                    
-                    if (subMeshIndex < teMeshGetSubMeshCount( teMeshRendererGetMesh( gos[ goCount - 1 ].index ) ))
-                    {
-                        teMeshRendererSetMaterial( gos[ goCount - 1 ].index, materials[ materialIndex ], subMeshIndex );
-                    }
-                }
+                // Submesh count isn't known until the mesh has streamed in, so the material is reapplied then.
+                const unsigned subMeshIndex = teStrstr( index, "all" ) ? teStreamAllSubMeshes : (unsigned)atoi( index );
+                teStreamBindMeshMaterial( teMeshRendererGetMesh( gos[ goCount - 1 ].index ), gos[ goCount - 1 ].index, materials[ materialIndex ], subMeshIndex );
             }
             else if (teStrstr( line, "meshrenderer" ) == line)
             {
                 if (goCount == 0)
                 {
-                    tePrint( "meshrenderer without gameobject!\n" );
+                    teLog( teLogLevel::Warning, "meshrenderer without gameobject!\n" );
                 }
-                tePrint("line begins with meshrenderer\n");
+                teLogVerbose( "line begins with meshrenderer\n");
                 char name[ 100 ] = {};
                 unsigned nameCursor = 0;
                 unsigned offset = teStrlen( "meshrenderer " );
@@ -793,7 +1574,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     name[ nameCursor ] = line[ nameCursor + offset ];
                     ++nameCursor;
                 }
-                tePrint( "meshrenderer for mesh: '%s'\n", name );
+                teLogVerbose( "meshrenderer for mesh: '%s'\n", name );
                 teGameObjectAddComponent( gos[ goCount - 1 ].index, teComponent::MeshRenderer );
 
                 bool found = false;
@@ -809,7 +1590,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
 
                 if (!found)
                 {
-                    tePrint( "meshrenderer: could not find '%s'\n", name );
+                    teLog( teLogLevel::Warning, "meshrenderer: could not find '%s'\n", name );
                 }
             }
             else if (teStrstr( line, "mesh" ) == line)
@@ -823,7 +1604,7 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     name[ nameCursor ] = line[ nameCursor + offset ];
                     ++nameCursor;
                 }
-                tePrint( "mesh name: %s\n", name );
+                teLogVerbose( "mesh name: %s\n", name );
                 teAssert( meshCount < 1000 );
                 meshNameIndices[ meshCount ] = InsertSceneString( name );
 
@@ -836,9 +1617,8 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     fileName[ fileNameCursor ] = line[ nameCursor + offset + fileNameCursor + 1 ];
                     ++fileNameCursor;
                 }
-                tePrint("mesh fileName: '%s'\n", fileName );
-                teFile meshFile = teLoadFile( fileName );
-                meshes[ meshCount ] = teLoadMesh( meshFile );
+                teLogVerbose( "mesh fileName: '%s'\n", fileName );
+                teStreamMesh( fileName, &meshes[ meshCount ] );
                 ++meshCount;
             }
             else if (teStrstr( line, "tex0" ) == line)
@@ -853,14 +1633,14 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     name[ nameCursor ] = line[ nameCursor + offset ];
                     ++nameCursor;
                 }
-                tePrint( "texture 0 name: %s\n", name );
+                teLogVerbose( "texture 0 name: %s\n", name );
 
                 for (unsigned t = 0; t < textureCount; ++t)
                 {
                     if (teStrstr( gSceneStrings + textureNameIndices[ t ], name ))
                     {
                         tex0Index = t;
-                        teMaterialSetTexture2D( materials[ materialCount - 1 ], textures[ t ], 0 );
+                        teStreamBindTexture( &textures[ t ], materials[ materialCount - 1 ], 0 );
                         break;
                     }
                 }
@@ -877,21 +1657,21 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     name[ nameCursor ] = line[ nameCursor + offset ];
                     ++nameCursor;
                 }
-                tePrint( "texture 1 name: %s\n", name );
+                teLogVerbose( "texture 1 name: %s\n", name );
 
                 for (unsigned t = 0; t < textureCount; ++t)
                 {
                     if (teStrstr( gSceneStrings + textureNameIndices[ t ], name ))
                     {
                         tex1Index = t;
-                        teMaterialSetTexture2D( materials[ materialCount - 1 ], textures[ t ], 1 );
+                        teStreamBindTexture( &textures[ t ], materials[ materialCount - 1 ], 1 );
                         break;
                     }
                 }
             }
             else if (teStrstr( line, "lightcolor" ) == line)
             {
-                tePrint( "TODO: read light color\n" );
+                teLogVerbose( "TODO: read light color\n" );
             }
             else if (teStrstr( line, "light" ) == line)
             {
@@ -905,14 +1685,31 @@ void teSceneReadScene( const teFile& sceneFile, const teShader& standardShader,
                     lightType[ typeCursor ] = line[ typeCursor + offset ];
                     ++typeCursor;
                 }
-                tePrint( "light type: %s\n", lightType );
+                teLogVerbose( "light type: %s\n", lightType );
+                // Added as a component like in binary scenes, so the light is in the game object's component bits.
                 if (teStrstr( lightType, "point" ) )
                 {
-                    teAddPointLight( gos[ goCount - 1 ].index );
+                    teGameObjectAddComponent( gos[ goCount - 1 ].index, teComponent::PointLight );
                 }
                 if (teStrstr( lightType, "spot" ))
                 {
-                    teAddSpotLight( gos[ goCount - 1 ].index );
+                    teGameObjectAddComponent( gos[ goCount - 1 ].index, teComponent::SpotLight );
+                }
+            }
+            else if (teStrstr( line, "position" ) == line)
+            {
+                if (goCount == 0)
+                {
+                    teLog( teLogLevel::Warning, "position without gameobject!\n" );
+                }
+                else
+                {
+                    char* end = line + teStrlen( "position" );
+                    Vec3 position;
+                    position.x = strtof( end, &end );
+                    position.y = strtof( end, &end );
+                    position.z = strtof( end, &end );
+                    teTransformSetLocalPosition( gos[ goCount - 1 ].index, position );
                 }
             }
             
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+// Layout of a .tsceneb file, written by tools/convert_scene and read by teSceneReadScene.
+// All sections follow the header in this order and are 4-byte aligned:
+//   SceneBinaryTexture[ textureCount ]
+//   SceneBinaryMaterial[ materialCount ]
+//   SceneBinaryMesh[ meshCount ]
+//   SceneBinaryGameObject[ gameObjectCount ]
+//   float positions[ gameObjectCount * 3 ] (x, y, z)
+//   float rotations[ gameObjectCount * 4 ] (x, y, z, w)
+//   float scales[ gameObjectCount ]
+//   SceneBinaryMeshMaterial[ meshMaterialCount ]
+//   char strings[ stringTableBytes ]
+// Name and path fields are byte offsets into the string table.
+// Transforms are stored as streams like in transform.cpp, so they are copied without conversion.
+// Lights are only component bits, so they get the same defaults as lights read from a text scene.
+
+static constexpr char SceneBinaryMagic[ 4 ] = { 't', 's', 'b', '2' }; // Last char is incremented when reading compatibility breaks.
+static constexpr uint32_t SceneBinaryNone = 0xFFFFFFFF;
+static constexpr uint32_t SceneBinaryAllSubMeshes = 0xFFFFFFFF;
+
+struct SceneBinaryHeader
+{
+    char     magic[ 4 ];
+    uint32_t textureCount;
+    uint32_t materialCount;
+    uint32_t meshCount;
+    uint32_t gameObjectCount;
+    uint32_t meshMaterialCount;
+    uint32_t stringTableBytes;
+};
+
+struct SceneBinaryTexture
+{
+    uint32_t name;
+    uint32_t path;
+};
+
+struct SceneBinaryMaterial
+{
+    uint32_t name;
+    uint32_t tex0; // Index into textures or SceneBinaryNone.
+    uint32_t tex1;
+};
+
+struct SceneBinaryMesh
+{
+    uint32_t name;
+    uint32_t path;
+};
+
+struct SceneBinaryGameObject
+{
+    uint32_t name;
+    uint32_t components; // teComponent bits.
+    uint32_t mesh; // Index into meshes or SceneBinaryNone.
+    uint32_t firstMeshMaterial;
+    uint32_t meshMaterialCount;
+};
+
+struct SceneBinaryMeshMaterial
+{
+    uint32_t subMesh; // SceneBinaryAllSubMeshes applies the material to every submesh.
+    uint32_t material;
+};
+
+static_assert( sizeof( SceneBinaryHeader ) == 28, "SceneBinaryHeader layout changed" );
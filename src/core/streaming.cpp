@@ -0,0 +1,697 @@
+#include "streaming.h"
+#include "file.h"
+#include "material.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "te_stdlib.h"
+#include "texture.h"
+#include "textureloader.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+struct MeshData;
+
+void QueueMeshBufferUploads();
+MeshData* ParseMesh( const teFile& file );
+teMesh CreateMesh( const char* path, MeshData* data );
+teTexture2D CreateTextureFromDDS( const teFile& file, unsigned flags, const DDSData& dds );
+
+enum class StreamType { Mesh, Texture, File };
+enum class StreamState { Queued, Loaded, Resident };
+
+// Every teStreamMesh/teStreamTexture call with the same path and flags shares one asset.
+// Assets stay cached after their last reference is released because the renderers can't destroy meshes or textures.
+struct StreamedAsset
+{
+    char path[ 260 ] = {};
+    StreamType type = StreamType::Mesh;
+    unsigned flags = 0;
+    teMesh mesh;
+    teTexture2D texture;
+    unsigned fileBytes = 0;
+    unsigned refCount = 0;
+    bool isLoading = false;
+    bool isResident = false;
+};
+
+struct StreamRequest
+{
+    char path[ 260 ] = {};
+    StreamType type = StreamType::Mesh;
+    unsigned assetIndex = 0; // Not used by File requests.
+    bool isLoader = false; // Only the first request for an asset reads the file, the others wait for it.
+    teMesh* outMesh = nullptr; // Out pointers are cleared when the caller releases them before they're resident.
+    teTexture2D* outTexture = nullptr;
+    teFile* outFile = nullptr;
+    teFile file; // Written by a worker before state becomes Loaded.
+    MeshData* meshData = nullptr; // Parsed by a worker. Its vertex streams point into file.
+    DDSData dds; // Parsed by a worker when isDDS is set.
+    bool isDDS = false;
+    std::atomic< StreamState > state{ StreamState::Queued };
+    bool isUsed = false; // Slots are freed when the request becomes resident.
+};
+
+struct TextureBinding
+{
+    const teTexture2D* texture;
+    teMaterial material;
+    unsigned slot;
+};
+
+struct MeshMaterialBinding
+{
+    const teMesh* mesh;
+    teMaterial material;
+    unsigned gameObjectIndex;
+    unsigned subMeshIndex;
+};
+
+static constexpr unsigned MaxStreamRequests = 1000;
+static constexpr unsigned MaxStreamBindings = 2000;
+static constexpr unsigned MaxStreamedAssets = 2000;
+static constexpr unsigned MaxStreamWorkers = 4;
+
+// Request slots are freed by the render thread as soon as the request is resident, and bindings when their request
+// is resolved or released. Workers only see request indices that are pushed to the queue, and stop touching a request
+// after it's Loaded.
+struct Streaming
+{
+    StreamedAsset assets[ MaxStreamedAssets ];
+    unsigned assetCount = 0;
+
+    StreamRequest requests[ MaxStreamRequests ];
+    unsigned requestCount = 0; // Slots at or above this have never been used.
+    unsigned usedRequestCount = 0;
+    unsigned freeRequests[ MaxStreamRequests ] = {};
+    unsigned freeRequestCount = 0;
+
+    TextureBinding textureBindings[ MaxStreamBindings ];
+    unsigned textureBindingCount = 0;
+    MeshMaterialBinding meshMaterialBindings[ MaxStreamBindings ];
+    unsigned meshMaterialBindingCount = 0;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    unsigned queue[ MaxStreamRequests ] = {}; // Ring, each request is in it at most once.
+    unsigned queueHead = 0;
+    unsigned queueCount = 0;
+    bool areWorkersStarted = false;
+    bool areWorkersStopping = false; // Protected by queueMutex.
+    std::thread workers[ MaxStreamWorkers ];
+    unsigned workerCount = 0;
+
+    teMesh placeholderMesh;
+    bool needsMeshBufferFinalize = false;
+    unsigned frameBudgetBytes = 16 * 1024 * 1024;
+};
+
+static Streaming streaming;
+TE_TRACK_STATIC_MEMORY( streamingMemory, teMemoryTag::Scene, sizeof( streaming ) );
+
+static bool IsPathExtension( const char* path, const char* extension )
+{
+    const size_t pathLength = strlen( path );
+    const size_t extensionLength = strlen( extension );
+
+    return pathLength >= extensionLength && strcmp( path + pathLength - extensionLength, extension ) == 0;
+}
+
+// Runs on a worker. Rejects files that the loaders would assert on, so a broken asset keeps its placeholder.
+static void ValidateStreamedFile( StreamRequest& request )
+{
+    teFile& file = request.file;
+
+    if (!file.data || request.type == StreamType::File)
+    {
+        return;
+    }
+
+    bool isValid = true;
+
+    if (request.type == StreamType::Mesh)
+    {
+        isValid = file.size > 12 && file.data[ 0 ] == 't' && file.data[ 1 ] == '3' && file.data[ 2 ] == 'd' && file.data[ 6 ] == '4';
+    }
+    else if (IsPathExtension( request.path, ".dds" ) || IsPathExtension( request.path, ".DDS" ))
+    {
+        isValid = file.size > 128 && memcmp( file.data, "DDS ", 4 ) == 0;
+    }
+    else if (IsPathExtension( request.path, ".tga" ) || IsPathExtension( request.path, ".TGA" ))
+    {
+        isValid = file.size > 18 && file.data[ 2 ] == 2 && file.data[ 16 ] == 32;
+    }
+
+    if (!isValid)
+    {
+        teLog( teLogLevel::Warning, "Streaming: %s is not a supported file, keeping the placeholder.\n", request.path );
+        teFreeFile( file );
+    }
+}
+
+// Runs on a worker after ValidateStreamedFile, so StreamingUpdate only has to create and upload GPU resources.
+// Files that fail to parse are dropped and their asset keeps the placeholder.
+static void ParseStreamedFile( StreamRequest& request )
+{
+    teFile& file = request.file;
+
+    if (!file.data || request.type == StreamType::File)
+    {
+        return;
+    }
+
+    bool isValid = true;
+
+    if (request.type == StreamType::Mesh)
+    {
+        request.meshData = ParseMesh( file );
+        isValid = request.meshData != nullptr;
+    }
+    else if (IsPathExtension( request.path, ".dds" ) || IsPathExtension( request.path, ".DDS" ))
+    {
+        request.isDDS = LoadDDS( file, request.dds );
+        isValid = request.isDDS;
+    }
+
+    if (!isValid)
+    {
+        teLog( teLogLevel::Warning, "Streaming: Could not parse %s, keeping the placeholder.\n", request.path );
+        teFreeFile( file );
+    }
+}
+
+static void StreamingWorker()
+{
+    for (;;)
+    {
+        unsigned requestIndex = 0;
+
+        {
+            std::unique_lock< std::mutex > lock( streaming.queueMutex );
+            streaming.queueCondition.wait( lock, [] { return streaming.queueCount != 0 || streaming.areWorkersStopping; } );
+
+            if (streaming.areWorkersStopping)
+            {
+                return;
+            }
+
+            requestIndex = streaming.queue[ streaming.queueHead ];
+            streaming.queueHead = (streaming.queueHead + 1) % MaxStreamRequests;
+            --streaming.queueCount;
+        }
+
+        TE_PROFILE_SCOPE( "Streaming load" );
+
+        StreamRequest& request = streaming.requests[ requestIndex ];
+        request.file = teLoadFile( request.path );
+        ValidateStreamedFile( request );
+        ParseStreamedFile( request );
+        request.state.store( StreamState::Loaded, std::memory_order_release );
+    }
+}
+
+static unsigned FindOrAddAsset( const char* path, StreamType type, unsigned flags )
+{
+    for (unsigned i = 0; i < streaming.assetCount; ++i)
+    {
+        if (streaming.assets[ i ].type == type && streaming.assets[ i ].flags == flags && strcmp( streaming.assets[ i ].path, path ) == 0)
+        {
+            return i;
+        }
+    }
+
+    teAssert( streaming.assetCount < MaxStreamedAssets );
+
+    StreamedAsset& asset = streaming.assets[ streaming.assetCount ];
+    strncpy( asset.path, path, sizeof( asset.path ) - 1 );
+    asset.type = type;
+    asset.flags = flags;
+
+    return streaming.assetCount++;
+}
+
+static unsigned AddStreamRequest( const char* path, StreamType type )
+{
+    teAssert( streaming.freeRequestCount > 0 || streaming.requestCount < MaxStreamRequests );
+
+    const unsigned requestIndex = streaming.freeRequestCount > 0 ? streaming.freeRequests[ --streaming.freeRequestCount ] : streaming.requestCount++;
+    ++streaming.usedRequestCount;
+
+    StreamRequest& request = streaming.requests[ requestIndex ];
+    request.isUsed = true;
+    strncpy( request.path, path, sizeof( request.path ) - 1 );
+    request.path[ sizeof( request.path ) - 1 ] = 0;
+    request.type = type;
+    request.assetIndex = 0;
+    request.isLoader = false;
+    request.outMesh = nullptr;
+    request.outTexture = nullptr;
+    request.outFile = nullptr;
+    request.file = teFile();
+    request.meshData = nullptr;
+    request.isDDS = false;
+    request.state.store( StreamState::Queued, std::memory_order_relaxed );
+
+    return requestIndex;
+}
+
+static void ReleaseStreamRequest( unsigned requestIndex )
+{
+    StreamRequest& request = streaming.requests[ requestIndex ];
+    teAssert( request.isUsed );
+
+    request.state.store( StreamState::Resident, std::memory_order_relaxed );
+    request.isUsed = false;
+    streaming.freeRequests[ streaming.freeRequestCount++ ] = requestIndex;
+    --streaming.usedRequestCount;
+}
+
+// Workers finish the file they're reading, queued requests are dropped.
+static void StopStreamingWorkers()
+{
+    {
+        std::lock_guard< std::mutex > lock( streaming.queueMutex );
+        streaming.areWorkersStopping = true;
+    }
+
+    streaming.queueCondition.notify_all();
+
+    for (unsigned i = 0; i < streaming.workerCount; ++i)
+    {
+        streaming.workers[ i ].join();
+    }
+}
+
+static void QueueStreamRequest( unsigned requestIndex )
+{
+    if (!streaming.areWorkersStarted)
+    {
+        unsigned workerCount = std::thread::hardware_concurrency();
+        workerCount = workerCount > 1 ? workerCount - 1 : 1;
+        workerCount = workerCount > MaxStreamWorkers ? MaxStreamWorkers : workerCount;
+
+        for (unsigned i = 0; i < workerCount; ++i)
+        {
+            streaming.workers[ i ] = std::thread( StreamingWorker );
+        }
+
+        streaming.workerCount = workerCount;
+        streaming.areWorkersStarted = true;
+        // Registered after streaming is constructed, so the workers are joined before its condition variable is destroyed.
+        atexit( StopStreamingWorkers );
+    }
+
+    streaming.requests[ requestIndex ].isLoader = true;
+
+    {
+        std::lock_guard< std::mutex > lock( streaming.queueMutex );
+        teAssert( streaming.queueCount < MaxStreamRequests );
+        streaming.queue[ (streaming.queueHead + streaming.queueCount) % MaxStreamRequests ] = requestIndex;
+        ++streaming.queueCount;
+    }
+
+    streaming.queueCondition.notify_one();
+}
+
+static int FindPendingRequest( StreamType type, const void* out )
+{
+    for (unsigned i = 0; i < streaming.requestCount; ++i)
+    {
+        const StreamRequest& request = streaming.requests[ i ];
+        const void* requestOut = type == StreamType::Mesh ? (const void*)request.outMesh : (const void*)request.outTexture;
+
+        if (request.isUsed && request.type == type && requestOut == out)
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static void ApplyMeshMaterialBinding( const MeshMaterialBinding& binding )
+{
+    const unsigned subMeshCount = teMeshGetSubMeshCount( binding.mesh );
+
+    for (unsigned subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    {
+        if (binding.subMeshIndex == teStreamAllSubMeshes || binding.subMeshIndex == subMeshIndex)
+        {
+            teMeshRendererSetMaterial( binding.gameObjectIndex, binding.material, subMeshIndex );
+        }
+    }
+}
+
+void teStreamMesh( const char* path, teMesh* outMesh )
+{
+    teAssert( outMesh );
+
+    StreamedAsset& asset = streaming.assets[ FindOrAddAsset( path, StreamType::Mesh, 0 ) ];
+    ++asset.refCount;
+
+    if (asset.isResident)
+    {
+        *outMesh = asset.mesh;
+        strncpy( outMesh->path, path, sizeof( outMesh->path ) - 1 );
+        return;
+    }
+
+    if (streaming.placeholderMesh.index == 0)
+    {
+        streaming.placeholderMesh = teCreateCubeMesh();
+        streaming.needsMeshBufferFinalize = true;
+    }
+
+    *outMesh = streaming.placeholderMesh;
+    strncpy( outMesh->path, path, sizeof( outMesh->path ) - 1 );
+
+    const unsigned requestIndex = AddStreamRequest( path, StreamType::Mesh );
+    streaming.requests[ requestIndex ].assetIndex = (unsigned)(&asset - streaming.assets);
+    streaming.requests[ requestIndex ].outMesh = outMesh;
+
+    if (!asset.isLoading)
+    {
+        asset.isLoading = true;
+        QueueStreamRequest( requestIndex );
+    }
+}
+
+void teStreamTexture( const char* path, unsigned flags, teTexture2D* outTexture )
+{
+    teAssert( outTexture );
+
+    StreamedAsset& asset = streaming.assets[ FindOrAddAsset( path, StreamType::Texture, flags ) ];
+    ++asset.refCount;
+
+    if (asset.isResident)
+    {
+        *outTexture = asset.texture;
+        return;
+    }
+
+    *outTexture = teTexture2D();
+
+    const unsigned requestIndex = AddStreamRequest( path, StreamType::Texture );
+    streaming.requests[ requestIndex ].assetIndex = (unsigned)(&asset - streaming.assets);
+    streaming.requests[ requestIndex ].outTexture = outTexture;
+
+    if (!asset.isLoading)
+    {
+        asset.isLoading = true;
+        QueueStreamRequest( requestIndex );
+    }
+}
+
+void teStreamFile( const char* path, teFile* outFile )
+{
+    teAssert( outFile );
+
+    *outFile = teFile();
+
+    const unsigned requestIndex = AddStreamRequest( path, StreamType::File );
+    streaming.requests[ requestIndex ].outFile = outFile;
+    QueueStreamRequest( requestIndex );
+}
+
+void teStreamReleaseMesh( const teMesh* mesh )
+{
+    const int requestIndex = FindPendingRequest( StreamType::Mesh, mesh );
+
+    if (requestIndex != -1)
+    {
+        StreamRequest& request = streaming.requests[ requestIndex ];
+        request.outMesh = nullptr;
+        teAssert( streaming.assets[ request.assetIndex ].refCount > 0 );
+        --streaming.assets[ request.assetIndex ].refCount;
+
+        for (unsigned b = 0; b < streaming.meshMaterialBindingCount; ++b)
+        {
+            if (streaming.meshMaterialBindings[ b ].mesh == mesh)
+            {
+                streaming.meshMaterialBindings[ b ].mesh = nullptr;
+            }
+        }
+
+        return;
+    }
+
+    for (unsigned i = 0; i < streaming.assetCount; ++i)
+    {
+        StreamedAsset& asset = streaming.assets[ i ];
+
+        if (asset.type == StreamType::Mesh && asset.isResident && strcmp( asset.path, mesh->path ) == 0)
+        {
+            teAssert( asset.refCount > 0 );
+            --asset.refCount;
+            return;
+        }
+    }
+}
+
+void teStreamReleaseTexture( const teTexture2D* texture )
+{
+    const int requestIndex = FindPendingRequest( StreamType::Texture, texture );
+
+    if (requestIndex != -1)
+    {
+        StreamRequest& request = streaming.requests[ requestIndex ];
+        request.outTexture = nullptr;
+        teAssert( streaming.assets[ request.assetIndex ].refCount > 0 );
+        --streaming.assets[ request.assetIndex ].refCount;
+
+        for (unsigned b = 0; b < streaming.textureBindingCount; ++b)
+        {
+            if (streaming.textureBindings[ b ].texture == texture)
+            {
+                streaming.textureBindings[ b ].texture = nullptr;
+            }
+        }
+
+        return;
+    }
+
+    // Textures that failed to load have index 0 and can't be told apart, but they also don't take any memory.
+    for (unsigned i = 0; i < streaming.assetCount && texture->index != 0; ++i)
+    {
+        StreamedAsset& asset = streaming.assets[ i ];
+
+        if (asset.type == StreamType::Texture && asset.isResident && asset.texture.index == texture->index)
+        {
+            teAssert( asset.refCount > 0 );
+            --asset.refCount;
+            return;
+        }
+    }
+}
+
+void teStreamBindTexture( const teTexture2D* texture, const teMaterial& material, unsigned slot )
+{
+    teMaterialSetTexture2D( material, *texture, slot );
+
+    if (FindPendingRequest( StreamType::Texture, texture ) != -1)
+    {
+        teAssert( streaming.textureBindingCount < MaxStreamBindings );
+        streaming.textureBindings[ streaming.textureBindingCount++ ] = { texture, material, slot };
+    }
+}
+
+void teStreamBindMeshMaterial( const teMesh* mesh, unsigned gameObjectIndex, const teMaterial& material, unsigned subMeshIndex )
+{
+    const MeshMaterialBinding binding = { mesh, material, gameObjectIndex, subMeshIndex };
+    ApplyMeshMaterialBinding( binding );
+
+    if (FindPendingRequest( StreamType::Mesh, mesh ) != -1)
+    {
+        teAssert( streaming.meshMaterialBindingCount < MaxStreamBindings );
+        streaming.meshMaterialBindings[ streaming.meshMaterialBindingCount++ ] = binding;
+    }
+}
+
+// Pending bindings of a destroyed game object would otherwise set materials to the next game object that gets its index.
+void StreamingForgetGameObject( unsigned gameObjectIndex )
+{
+    for (unsigned b = 0; b < streaming.meshMaterialBindingCount; ++b)
+    {
+        if (streaming.meshMaterialBindings[ b ].gameObjectIndex == gameObjectIndex)
+        {
+            streaming.meshMaterialBindings[ b ].mesh = nullptr;
+        }
+    }
+}
+
+void teStreamingSetFrameBudget( unsigned bytes )
+{
+    streaming.frameBudgetBytes = bytes;
+}
+
+unsigned teStreamingGetPendingCount()
+{
+    return streaming.usedRequestCount;
+}
+
+unsigned teStreamingGetReferencedBytes()
+{
+    unsigned bytes = 0;
+
+    for (unsigned i = 0; i < streaming.assetCount; ++i)
+    {
+        bytes += streaming.assets[ i ].refCount > 0 ? streaming.assets[ i ].fileBytes : 0;
+    }
+
+    return bytes;
+}
+
+// Hands a resident asset to every request that waits for it.
+static void ResolveAssetRequests( unsigned assetIndex )
+{
+    const StreamedAsset& asset = streaming.assets[ assetIndex ];
+
+    for (unsigned i = 0; i < streaming.requestCount; ++i)
+    {
+        StreamRequest& request = streaming.requests[ i ];
+
+        if (!request.isUsed || request.type == StreamType::File || request.assetIndex != assetIndex)
+        {
+            continue;
+        }
+
+        if (request.outMesh)
+        {
+            *request.outMesh = asset.mesh;
+            strncpy( request.outMesh->path, asset.path, sizeof( request.outMesh->path ) - 1 );
+
+            for (unsigned b = 0; b < streaming.meshMaterialBindingCount; ++b)
+            {
+                if (streaming.meshMaterialBindings[ b ].mesh == request.outMesh)
+                {
+                    ApplyMeshMaterialBinding( streaming.meshMaterialBindings[ b ] );
+                    streaming.meshMaterialBindings[ b ].mesh = nullptr;
+                }
+            }
+        }
+
+        if (request.outTexture)
+        {
+            *request.outTexture = asset.texture;
+
+            for (unsigned b = 0; b < streaming.textureBindingCount; ++b)
+            {
+                if (streaming.textureBindings[ b ].texture == request.outTexture)
+                {
+                    teMaterialSetTexture2D( streaming.textureBindings[ b ].material, *request.outTexture, streaming.textureBindings[ b ].slot );
+                    streaming.textureBindings[ b ].texture = nullptr;
+                }
+            }
+        }
+
+        ReleaseStreamRequest( i );
+    }
+}
+
+// Removes bindings whose request was resolved or released.
+static void CompactBindings()
+{
+    unsigned textureBindingCount = 0;
+
+    for (unsigned b = 0; b < streaming.textureBindingCount; ++b)
+    {
+        if (streaming.textureBindings[ b ].texture)
+        {
+            streaming.textureBindings[ textureBindingCount++ ] = streaming.textureBindings[ b ];
+        }
+    }
+
+    streaming.textureBindingCount = textureBindingCount;
+
+    unsigned meshMaterialBindingCount = 0;
+
+    for (unsigned b = 0; b < streaming.meshMaterialBindingCount; ++b)
+    {
+        if (streaming.meshMaterialBindings[ b ].mesh)
+        {
+            streaming.meshMaterialBindings[ meshMaterialBindingCount++ ] = streaming.meshMaterialBindings[ b ];
+        }
+    }
+
+    streaming.meshMaterialBindingCount = meshMaterialBindingCount;
+}
+
+// Called by teBeginFrame on the render thread.
+void StreamingUpdate()
+{
+    TE_PROFILE_SCOPE( "StreamingUpdate" );
+
+    unsigned uploadedBytes = 0;
+    bool isFirstUpload = true;
+
+    for (unsigned i = 0; i < streaming.requestCount; ++i)
+    {
+        StreamRequest& request = streaming.requests[ i ];
+
+        if (!request.isUsed || !request.isLoader || request.state.load( std::memory_order_acquire ) != StreamState::Loaded)
+        {
+            continue;
+        }
+
+        if (!isFirstUpload && uploadedBytes + request.file.size > streaming.frameBudgetBytes)
+        {
+            break;
+        }
+
+        isFirstUpload = false;
+        uploadedBytes += request.file.size;
+
+        if (request.type == StreamType::File)
+        {
+            if (request.outFile)
+            {
+                *request.outFile = request.file;
+            }
+            else
+            {
+                teFree( request.file.data );
+            }
+
+            request.file = teFile();
+            ReleaseStreamRequest( i );
+            continue;
+        }
+
+        StreamedAsset& asset = streaming.assets[ request.assetIndex ];
+
+        // Failed loads keep the placeholder instead of creating another cube.
+        if (request.type == StreamType::Mesh)
+        {
+            asset.mesh = request.meshData ? CreateMesh( request.path, request.meshData ) : streaming.placeholderMesh;
+            streaming.needsMeshBufferFinalize |= request.meshData != nullptr;
+            request.meshData = nullptr;
+        }
+        else if (request.isDDS)
+        {
+            asset.texture = CreateTextureFromDDS( request.file, asset.flags, request.dds );
+        }
+        else
+        {
+            asset.texture = request.file.data ? teLoadTexture( request.file, asset.flags, nullptr, 0, 0, teTextureFormat::Invalid ) : teTexture2D();
+        }
+
+        asset.fileBytes = request.file.size;
+        asset.isLoading = false;
+        asset.isResident = true;
+
+        teFree( request.file.data );
+        request.file = teFile();
+        ResolveAssetRequests( request.assetIndex );
+    }
+
+    // Only the geometry added since the last upload is copied.
+    if (streaming.needsMeshBufferFinalize)
+    {
+        QueueMeshBufferUploads();
+        streaming.needsMeshBufferFinalize = false;
+    }
+
+    CompactBindings();
+}
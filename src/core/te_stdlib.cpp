@@ -2,13 +2,18 @@
 #if !defined( _MSC_VER )
 #include <unistd.h>
 #endif
+#include <atomic>
+#include <condition_variable>
 #include <fcntl.h>
+#include <mutex>
+#include <signal.h>
 #include <stdarg.h>
+#include <thread>
 
-char* convert( unsigned int num, int base, char** output )
+static void convert( unsigned int num, int base, char** output )
 {
     static const char Representation[] = "0123456789ABCDEF";
-    static char buffer[ 50 ];
+    char buffer[ 50 ];
     char* ptr = &buffer[ 49 ];
     *ptr = '\0';
 
@@ -24,23 +29,208 @@ char* convert( unsigned int num, int base, char** output )
         ++*output;
         ++ptr;
     }
+}
+
+constexpr unsigned LogRecordLength = 1260;
+constexpr unsigned LogRecordCount = 256; // Must be a power of two.
+
+struct LogRecord
+{
+    std::atomic< unsigned > sequence{ 0 };
+    unsigned length = 0;
+    char text[ LogRecordLength ];
+};
+
+// Bounded multi-producer, multi-consumer ring. Consumers are the log thread and crash/explicit flushes.
+// The log thread sleeps on wakeCondition while the ring is empty.
+struct Logger
+{
+    Logger();
+
+    LogRecord records[ LogRecordCount ];
+    std::atomic< unsigned > enqueuePosition{ 0 };
+    std::atomic< unsigned > dequeuePosition{ 0 };
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+};
+
+static void WriteLog( const char* text, unsigned length )
+{
+#if _MSC_VER
+    (void)length;
+    OutputDebugStringA( text );
+#else
+    while (length > 0)
+    {
+        const ssize_t written = write( STDOUT_FILENO, text, length );
+
+        if (written <= 0)
+        {
+            return;
+        }
 
-    return ptr;
+        text += written;
+        length -= (unsigned)written;
+    }
+#endif
 }
 
-void tePrint( const char* format, ... )
+static bool LogPush( Logger& logger, const char* text, unsigned length )
 {
-    va_list arg;
-    va_start( arg, format );
+    unsigned position = logger.enqueuePosition.load( std::memory_order_relaxed );
+    LogRecord* record = nullptr;
+
+    while (true)
+    {
+        record = &logger.records[ position & (LogRecordCount - 1) ];
+        const int diff = (int)(record->sequence.load( std::memory_order_acquire ) - position);
+
+        if (diff == 0)
+        {
+            if (logger.enqueuePosition.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = logger.enqueuePosition.load( std::memory_order_relaxed );
+        }
+    }
+
+    memcpy( record->text, text, length + 1 );
+    record->length = length;
+    record->sequence.store( position + 1, std::memory_order_release );
+
+    return true;
+}
+
+// Writes the oldest queued record. Only uses async-signal-safe calls so it can run in a crash handler.
+static bool LogPopAndWrite( Logger& logger )
+{
+    unsigned position = logger.dequeuePosition.load( std::memory_order_relaxed );
+    LogRecord* record = nullptr;
+
+    while (true)
+    {
+        record = &logger.records[ position & (LogRecordCount - 1) ];
+        const int diff = (int)(record->sequence.load( std::memory_order_acquire ) - (position + 1));
+
+        if (diff == 0)
+        {
+            if (logger.dequeuePosition.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = logger.dequeuePosition.load( std::memory_order_relaxed );
+        }
+    }
+
+    WriteLog( record->text, record->length );
+    record->sequence.store( position + LogRecordCount, std::memory_order_release );
+
+    return true;
+}
 
+// Never destroyed: the log thread waits on wakeCondition until the process exits, and destroying a condition
+// variable that has a waiter blocks.
+static Logger& GetLogger()
+{
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+static void LogCrashHandler( int signalNumber )
+{
+    while (LogPopAndWrite( GetLogger() ))
+    {
+    }
+
+    signal( signalNumber, SIG_DFL );
+    raise( signalNumber );
+}
+
+static bool IsLogRecordQueued( const Logger& logger )
+{
+    const unsigned position = logger.dequeuePosition.load( std::memory_order_relaxed );
+
+    return logger.records[ position & (LogRecordCount - 1) ].sequence.load( std::memory_order_acquire ) == position + 1;
+}
+
+static void LogThread()
+{
+    Logger& logger = GetLogger();
+
+    while (true)
+    {
+        while (LogPopAndWrite( logger ))
+        {
+        }
+
+        std::unique_lock< std::mutex > lock( logger.wakeMutex );
+        logger.wakeCondition.wait( lock, [ &logger ] { return IsLogRecordQueued( logger ); } );
+    }
+}
+
+Logger::Logger()
+{
+    for (unsigned i = 0; i < LogRecordCount; ++i)
+    {
+        records[ i ].sequence.store( i, std::memory_order_relaxed );
+    }
+
+#if !_MSC_VER
+    // Redirects stdout to the terminal once instead of on every print.
+    const int terminal = open( "/dev/tty", O_WRONLY | O_CLOEXEC );
+
+    if (terminal >= 0)
+    {
+        dup2( terminal, STDOUT_FILENO );
+        close( terminal );
+    }
+#endif
+
+    signal( SIGSEGV, LogCrashHandler );
+    signal( SIGABRT, LogCrashHandler );
+    signal( SIGILL, LogCrashHandler );
+    signal( SIGFPE, LogCrashHandler );
+#ifdef SIGTRAP
+    signal( SIGTRAP, LogCrashHandler ); // __builtin_trap on ARM
+#endif
+#ifdef SIGBUS
+    signal( SIGBUS, LogCrashHandler );
+#endif
+    atexit( teLogFlush );
+
+    std::thread( LogThread ).detach();
+}
+
+void teLogFlush()
+{
+    while (LogPopAndWrite( GetLogger() ))
+    {
+    }
+}
+
+static unsigned FormatLogMessage( char* output, const char* format, va_list arg )
+{
     const char* ptr;
     char* s;
     int i;
     float f = 0;
     unsigned int u = 0;
 
-    constexpr unsigned length = 1260;
-    char output[ length ] = {};
     char* outPtr = output;
 
     for (ptr = format; *ptr != '\0'; ++ptr)
@@ -84,7 +274,7 @@ void tePrint( const char* format, ... )
             break;
         case 's':
             s = va_arg( arg, char* );
-            teAssert( teStrlen( output ) + teStrlen( s ) < length );
+            teAssert( (unsigned)(outPtr - output) + teStrlen( s ) < LogRecordLength );
             teMemcpy( outPtr, s, teStrlen( s ) );
             outPtr += teStrlen( s );
             break;
@@ -108,20 +298,464 @@ void tePrint( const char* format, ... )
         }
     }
 
+    *outPtr = '\0';
+
+    return (unsigned)(outPtr - output);
+}
+
+static void LogV( teLogLevel level, const char* format, va_list arg )
+{
+    if ((unsigned)level < TE_LOG_MIN_LEVEL)
+    {
+        return;
+    }
+
+    static thread_local char output[ LogRecordLength ];
+    unsigned prefixLength = 0;
+
+    if (level == teLogLevel::Warning)
+    {
+        prefixLength = 9;
+        teMemcpy( output, "Warning: ", prefixLength );
+    }
+    else if (level == teLogLevel::Error)
+    {
+        prefixLength = 7;
+        teMemcpy( output, "Error: ", prefixLength );
+    }
+
+    const unsigned length = prefixLength + FormatLogMessage( output + prefixLength, format, arg );
+    Logger& logger = GetLogger();
+
+    if (LogPush( logger, output, length ))
+    {
+        // The empty lock orders the push before the log thread's check, so the notification can't be missed.
+        {
+            std::lock_guard< std::mutex > lock( logger.wakeMutex );
+        }
+
+        logger.wakeCondition.notify_one();
+    }
+    else
+    {
+        // Ring is full: keep the message and its order relative to this thread's earlier ones.
+        teLogFlush();
+        WriteLog( output, length );
+    }
+
+    if (level == teLogLevel::Error)
+    {
+        teLogFlush();
+    }
+}
+
+void teLog( teLogLevel level, const char* format, ... )
+{
+    va_list arg;
+    va_start( arg, format );
+    LogV( level, format, arg );
     va_end( arg );
+}
 
-#if _MSC_VER
-    OutputDebugStringA( output );
-#else
-    int terminal = open( "/dev/tty", O_WRONLY );
+void tePrint( const char* format, ... )
+{
+    va_list arg;
+    va_start( arg, format );
+    LogV( teLogLevel::Info, format, arg );
+    va_end( arg );
+}
+
+#if _DEBUG
+static constexpr unsigned char AllocatedPoison = 0xCD;
+static constexpr unsigned char FreedPoison = 0xDD;
+#endif
+
+struct teArenaBlock
+{
+    teArenaBlock* next = nullptr;
+    size_t capacity = 0;
+    size_t offset = 0;
+};
+
+static size_t AlignUp( size_t value, size_t alignment )
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void* teArenaAlloc( teArena& arena, size_t bytes, size_t alignment )
+{
+    teAssert( (alignment & (alignment - 1)) == 0 );
 
-    if (terminal < 0)
+    teArenaBlock* block = arena.blocks;
+    const size_t headerSize = AlignUp( sizeof( teArenaBlock ), 16 );
+    size_t offset = 0;
+
+    if (block)
+    {
+        const size_t begin = (size_t)((unsigned char*)block + headerSize);
+        offset = AlignUp( begin + block->offset, alignment ) - begin;
+    }
+
+    if (!block || offset + bytes > block->capacity)
+    {
+        // Allocations larger than a block get a block of their own.
+        const size_t capacity = bytes + alignment > arena.blockSize ? bytes + alignment : arena.blockSize;
+        block = (teArenaBlock*)teMalloc( headerSize + capacity, arena.tag );
+        block->next = arena.blocks;
+        block->capacity = capacity;
+        block->offset = 0;
+        arena.blocks = block;
+
+        const size_t begin = (size_t)((unsigned char*)block + headerSize);
+        offset = AlignUp( begin, alignment ) - begin;
+    }
+
+    unsigned char* outMemory = (unsigned char*)block + headerSize + offset;
+    block->offset = offset + bytes;
+
+    arena.usedBytes += bytes;
+
+    if (arena.usedBytes > arena.highWaterMark)
+    {
+        arena.highWaterMark = arena.usedBytes;
+    }
+
+#if _DEBUG
+    memset( outMemory, AllocatedPoison, bytes );
+#endif
+
+    return outMemory;
+}
+
+// If the arena grew past one block, the blocks are replaced by one block as large as all of them, so an arena that is
+// reset every frame stops allocating once it has seen its largest frame.
+void teArenaReset( teArena& arena )
+{
+    const size_t headerSize = AlignUp( sizeof( teArenaBlock ), 16 );
+
+    if (arena.blocks && arena.blocks->next)
+    {
+        size_t capacity = 0;
+        teArenaBlock* block = arena.blocks;
+
+        while (block)
+        {
+            teArenaBlock* next = block->next;
+            capacity += block->capacity;
+            teFree( block );
+            block = next;
+        }
+
+        arena.blocks = (teArenaBlock*)teMalloc( headerSize + capacity, arena.tag );
+        arena.blocks->next = nullptr;
+        arena.blocks->capacity = capacity;
+    }
+
+    if (arena.blocks)
+    {
+        arena.blocks->offset = 0;
+#if _DEBUG
+        memset( (unsigned char*)arena.blocks + headerSize, FreedPoison, arena.blocks->capacity );
+#endif
+    }
+
+    arena.usedBytes = 0;
+}
+
+void teArenaFree( teArena& arena )
+{
+    teArenaBlock* block = arena.blocks;
+
+    while (block)
+    {
+        teArenaBlock* next = block->next;
+        teFree( block );
+        block = next;
+    }
+
+    arena.blocks = nullptr;
+    arena.usedBytes = 0;
+}
+
+void tePoolInit( tePool& pool, size_t elementSize, unsigned capacity, teMemoryTag tag )
+{
+    teAssert( capacity > 0 );
+
+    pool.elementSize = AlignUp( elementSize < sizeof( void* ) ? sizeof( void* ) : elementSize, sizeof( void* ) );
+    pool.capacity = capacity;
+    pool.usedCount = 0;
+    pool.highWaterMark = 0;
+    pool.elements = (unsigned char*)teMalloc( pool.elementSize * capacity, tag );
+    pool.freeList = nullptr;
+
+    for (unsigned i = capacity; i > 0; --i)
+    {
+        void* element = pool.elements + (i - 1) * pool.elementSize;
+        *(void**)element = pool.freeList;
+        pool.freeList = element;
+    }
+}
+
+void* tePoolAlloc( tePool& pool )
+{
+    if (!pool.freeList)
+    {
+        return nullptr;
+    }
+
+    void* outElement = pool.freeList;
+    pool.freeList = *(void**)outElement;
+    ++pool.usedCount;
+
+    if (pool.usedCount > pool.highWaterMark)
+    {
+        pool.highWaterMark = pool.usedCount;
+    }
+
+#if _DEBUG
+    memset( outElement, AllocatedPoison, pool.elementSize );
+#endif
+
+    return outElement;
+}
+
+void tePoolFree( tePool& pool, void* ptr )
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    teAssert( (unsigned char*)ptr >= pool.elements && (unsigned char*)ptr < pool.elements + pool.elementSize * pool.capacity );
+    teAssert( pool.usedCount > 0 );
+
+#if _DEBUG
+    memset( ptr, FreedPoison, pool.elementSize );
+#endif
+    *(void**)ptr = pool.freeList;
+    pool.freeList = ptr;
+    --pool.usedCount;
+}
+
+void tePoolDestroy( tePool& pool )
+{
+    teFree( pool.elements );
+    pool = tePool();
+}
+
+static teArena frameArena;
+
+void* teFrameAlloc( size_t bytes, size_t alignment )
+{
+    return teArenaAlloc( frameArena, bytes, alignment );
+}
+
+size_t teFrameAllocatorGetHighWaterMark()
+{
+    return frameArena.highWaterMark;
+}
+
+void ResetFrameAllocator()
+{
+    teArenaReset( frameArena );
+}
+
+#if TE_MEMORY_TRACKING
+// Maps live teMalloc pointers to their size and tag, so teFree doesn't need a header in front of the allocation.
+struct HeapAllocationRecord
+{
+    const void* ptr = nullptr;
+    size_t bytes = 0;
+    teMemoryTag tag = teMemoryTag::Other;
+};
+
+static constexpr unsigned InitialHeapRecordCount = 1 << 16;
+static const void* const HeapRecordTombstone = (const void*)1;
+
+// records is an open addressing table that's at most half full, counting tombstones. It uses plain calloc,
+// because teMalloc would track itself.
+static struct
+{
+    std::mutex mutex;
+    teMemoryStats stats;
+    HeapAllocationRecord* records = nullptr;
+    unsigned recordCount = 0; // Power of two.
+    unsigned usedRecordCount = 0;
+    unsigned tombstoneCount = 0;
+} memoryTracker;
+
+static unsigned HashPointer( const void* ptr )
+{
+    size_t h = (size_t)ptr >> 4;
+    h ^= h >> 17;
+    h *= 0xED5AD4BBu;
+    h ^= h >> 11;
+    return (unsigned)h & (memoryTracker.recordCount - 1);
+}
+
+// Moves the live records to a table of recordCount records, which also drops the tombstones.
+static void RehashHeapRecords( unsigned recordCount )
+{
+    HeapAllocationRecord* oldRecords = memoryTracker.records;
+    const unsigned oldRecordCount = memoryTracker.recordCount;
+
+    memoryTracker.records = (HeapAllocationRecord*)calloc( recordCount, sizeof( HeapAllocationRecord ) );
+    teAssert( memoryTracker.records );
+    memoryTracker.recordCount = recordCount;
+    memoryTracker.tombstoneCount = 0;
+
+    for (unsigned r = 0; r < oldRecordCount; ++r)
+    {
+        if (oldRecords[ r ].ptr == nullptr || oldRecords[ r ].ptr == HeapRecordTombstone)
+        {
+            continue;
+        }
+
+        unsigned i = HashPointer( oldRecords[ r ].ptr );
+
+        while (memoryTracker.records[ i ].ptr != nullptr)
+        {
+            i = (i + 1) & (recordCount - 1);
+        }
+
+        memoryTracker.records[ i ] = oldRecords[ r ];
+    }
+
+    free( oldRecords );
+}
+
+static void AddToStats( teMemoryTag tag, size_t bytes )
+{
+    teMemoryTagStats& stats = memoryTracker.stats.tags[ (unsigned)tag ];
+    stats.currentBytes += bytes;
+    ++stats.allocationCount;
+
+    if (stats.currentBytes > stats.peakBytes)
+    {
+        stats.peakBytes = stats.currentBytes;
+    }
+}
+
+static void RemoveFromStats( teMemoryTag tag, size_t bytes )
+{
+    teMemoryTagStats& stats = memoryTracker.stats.tags[ (unsigned)tag ];
+    teAssert( stats.currentBytes >= bytes && stats.allocationCount > 0 );
+    stats.currentBytes -= bytes;
+    --stats.allocationCount;
+}
+
+static HeapAllocationRecord* FindHeapRecord( const void* ptr )
+{
+    for (unsigned i = HashPointer( ptr ), probe = 0; probe < memoryTracker.recordCount; i = (i + 1) & (memoryTracker.recordCount - 1), ++probe)
+    {
+        if (memoryTracker.records[ i ].ptr == ptr)
+        {
+            return &memoryTracker.records[ i ];
+        }
+
+        if (memoryTracker.records[ i ].ptr == nullptr)
+        {
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+void teMemoryTrackHeapAllocation( const void* ptr, size_t bytes, teMemoryTag tag )
+{
+    if (!ptr)
     {
         return;
     }
 
-    dup2( terminal, STDOUT_FILENO );
-    
-    write( terminal, output, teStrlen( output ) );
+    std::lock_guard< std::mutex > lock( memoryTracker.mutex );
+
+    if (!memoryTracker.records)
+    {
+        RehashHeapRecords( InitialHeapRecordCount );
+    }
+
+    // The address was released with plain free() and has been reused.
+    HeapAllocationRecord* stale = FindHeapRecord( ptr );
+
+    if (stale)
+    {
+        RemoveFromStats( stale->tag, stale->bytes );
+        stale->ptr = HeapRecordTombstone;
+        --memoryTracker.usedRecordCount;
+        ++memoryTracker.tombstoneCount;
+    }
+
+    // Grows when live records fill a quarter of the table, otherwise only the tombstones are dropped.
+    if ((memoryTracker.usedRecordCount + memoryTracker.tombstoneCount + 1) * 2 > memoryTracker.recordCount)
+    {
+        const bool grow = (memoryTracker.usedRecordCount + 1) * 4 > memoryTracker.recordCount;
+        RehashHeapRecords( grow ? memoryTracker.recordCount * 2 : memoryTracker.recordCount );
+    }
+
+    unsigned i = HashPointer( ptr );
+
+    while (memoryTracker.records[ i ].ptr != nullptr && memoryTracker.records[ i ].ptr != HeapRecordTombstone)
+    {
+        i = (i + 1) & (memoryTracker.recordCount - 1);
+    }
+
+    memoryTracker.tombstoneCount -= memoryTracker.records[ i ].ptr == HeapRecordTombstone ? 1 : 0;
+    memoryTracker.records[ i ].ptr = ptr;
+    memoryTracker.records[ i ].bytes = bytes;
+    memoryTracker.records[ i ].tag = tag;
+    ++memoryTracker.usedRecordCount;
+
+    AddToStats( tag, bytes );
+}
+
+void teMemoryTrackHeapFree( const void* ptr )
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( memoryTracker.mutex );
+
+    HeapAllocationRecord* record = FindHeapRecord( ptr );
+
+    if (record)
+    {
+        RemoveFromStats( record->tag, record->bytes );
+        record->ptr = HeapRecordTombstone;
+        --memoryTracker.usedRecordCount;
+        ++memoryTracker.tombstoneCount;
+    }
+}
+
+void teMemoryTrackAllocation( teMemoryTag tag, size_t bytes )
+{
+    std::lock_guard< std::mutex > lock( memoryTracker.mutex );
+    AddToStats( tag, bytes );
+}
+
+teMemoryStats teGetMemoryStats()
+{
+    std::lock_guard< std::mutex > lock( memoryTracker.mutex );
+    return memoryTracker.stats;
+}
+#else
+void teMemoryTrackHeapAllocation( const void*, size_t, teMemoryTag ) {}
+void teMemoryTrackHeapFree( const void* ) {}
+void teMemoryTrackAllocation( teMemoryTag, size_t ) {}
+
+teMemoryStats teGetMemoryStats()
+{
+    return teMemoryStats();
+}
 #endif
+
+const char* teMemoryTagGetName( teMemoryTag tag )
+{
+    static const char* const Names[] = { "Other", "Scene", "Mesh", "Texture", "Audio", "Renderer", "Tools" };
+    static_assert( sizeof( Names ) / sizeof( Names[ 0 ] ) == (unsigned)teMemoryTag::Count, "Names must match teMemoryTag" );
+
+    return tag < teMemoryTag::Count ? Names[ (unsigned)tag ] : "Invalid";
 }
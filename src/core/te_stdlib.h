@@ -3,6 +3,8 @@
 // TODO: Replace includes with own implementation of memcpy and malloc.
 #include <string.h>
 #include <stdlib.h>
+#include <new>
+#include "memorystats.h"
 
 #if _MSC_VER
 #define teAssert( c ) if (!(c)) __debugbreak()
@@ -31,7 +33,51 @@
 #define TE_ALLOCA alloca
 #endif // TE_ALLOCA
 
+#ifndef TE_MEMORY_TRACKING
+#if _DEBUG
+#define TE_MEMORY_TRACKING 1
+#else
+#define TE_MEMORY_TRACKING 0
+#endif
+#endif
+
+// Records memory that doesn't come from teMalloc, like static arrays and mapped GPU buffers.
+void teMemoryTrackAllocation( teMemoryTag tag, size_t bytes );
+void teMemoryTrackHeapAllocation( const void* ptr, size_t bytes, teMemoryTag tag );
+void teMemoryTrackHeapFree( const void* ptr );
+
+#if TE_MEMORY_TRACKING
+struct teStaticMemoryRecord
+{
+    teStaticMemoryRecord( teMemoryTag tag, size_t bytes ) { teMemoryTrackAllocation( tag, bytes ); }
+};
+// Counts a module's static arrays towards tag.
+#define TE_TRACK_STATIC_MEMORY( name, tag, bytes ) static teStaticMemoryRecord name( tag, bytes )
+#else
+#define TE_TRACK_STATIC_MEMORY( name, tag, bytes )
+#endif
+
+enum class teLogLevel : unsigned { Verbose, Info, Warning, Error };
+
+// Messages below this level are dropped before they're formatted. _DEBUG doesn't lower it, because the Makefile
+// always defines _DEBUG, so verbose logs are only built with -DTE_LOG_MIN_LEVEL=0.
+#ifndef TE_LOG_MIN_LEVEL
+#define TE_LOG_MIN_LEVEL 1
+#endif
+
+// Verbose logging is stripped at compile time unless TE_LOG_MIN_LEVEL is 0.
+#if TE_LOG_MIN_LEVEL <= 0
+#define teLogVerbose( ... ) teLog( teLogLevel::Verbose, __VA_ARGS__ )
+#else
+#define teLogVerbose( ... ) ((void)0)
+#endif
+
+// Formats on the calling thread and queues the message for the log thread. Error messages are flushed immediately.
+void teLog( teLogLevel level, const char* format, ... );
+// Same as teLog( teLogLevel::Info, ... ).
 void tePrint( const char* format, ... );
+// Writes all queued messages before returning.
+void teLogFlush();
 
 static int teStrcmp( const char* s1, const char* s2 )
 {
@@ -97,14 +143,77 @@ static void teZero( char* dst, size_t size )
     }
 }
 
-static void* teMalloc( size_t bytes )
+static void* teMalloc( size_t bytes, teMemoryTag tag = teMemoryTag::Other )
 {
     teAssert( bytes > 0 );
 
-    return malloc( bytes );
+    void* outMemory = malloc( bytes );
+#if TE_MEMORY_TRACKING
+    teMemoryTrackHeapAllocation( outMemory, bytes, tag );
+#else
+    (void)tag;
+#endif
+    return outMemory;
 }
 
 static void teFree( void* ptr )
 {
+#if TE_MEMORY_TRACKING
+    teMemoryTrackHeapFree( ptr );
+#endif
     free( ptr );
 }
+
+// @return count default-constructed Ts. Used for storage that's sized by teInitEngine() and lives until exit.
+template< typename T >
+T* teMallocArray( unsigned count, teMemoryTag tag )
+{
+    T* outArray = (T*)teMalloc( count * sizeof( T ), tag );
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        new (&outArray[ i ]) T();
+    }
+
+    return outArray;
+}
+
+struct teArenaBlock;
+
+// Linear allocator for memory that shares a lifetime (a level, a load, a frame). Grows in blocks of blockSize.
+struct teArena
+{
+    teArenaBlock* blocks = nullptr;
+    size_t blockSize = 1024 * 1024;
+    size_t usedBytes = 0;
+    size_t highWaterMark = 0;
+    teMemoryTag tag = teMemoryTag::Other;
+};
+
+// @return Memory aligned to alignment, which must be a power of two. Never null.
+void* teArenaAlloc( teArena& arena, size_t bytes, size_t alignment = 16 );
+// Invalidates all allocations. Keeps one block for reuse, merged from all blocks if there were several.
+void teArenaReset( teArena& arena );
+// Releases all blocks.
+void teArenaFree( teArena& arena );
+
+// Fixed-size element allocator.
+struct tePool
+{
+    unsigned char* elements = nullptr;
+    void* freeList = nullptr;
+    size_t elementSize = 0;
+    unsigned capacity = 0;
+    unsigned usedCount = 0;
+    unsigned highWaterMark = 0;
+};
+
+void tePoolInit( tePool& pool, size_t elementSize, unsigned capacity, teMemoryTag tag = teMemoryTag::Other );
+// @return Element, or null if the pool is full.
+void* tePoolAlloc( tePool& pool );
+void tePoolFree( tePool& pool, void* ptr );
+void tePoolDestroy( tePool& pool );
+
+// Scratch memory that is valid until the next teBeginFrame.
+void* teFrameAlloc( size_t bytes, size_t alignment = 16 );
+size_t teFrameAllocatorGetHighWaterMark();
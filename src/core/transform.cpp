@@ -1,130 +1,121 @@
 #include "transform.h"
+#include "affine3x4.h"
 #include "matrix.h"
 #include "quaternion.h"
+#include "te_stdlib.h"
 #include "vec3.h"
 
-struct TransformImpl
-{
-    // TODO: Maybe move some of these matrixes into camera?
-    Matrix localMatrix;
-    Matrix localToClip;
-    Matrix localToView;
-    Matrix localToShadowClip;
+// Inputs are kept in separate streams, so systems that only read positions don't pull in rotations and matrices.
+// Arrays have maxGameObjects elements, are indexed by game object and are allocated by TransformInitStorage().
+// Per-view products like localToView are scratch of the view being rendered and live in scene.cpp.
+static Vec3* transformPositions = nullptr;
+static Quaternion* transformRotations = nullptr;
+static float* transformScales = nullptr;
+static Affine3x4* transformMatrices = nullptr; // Written by TransformSolveLocalMatrix/TransformSolveLocalMatrices.
 
-    Quaternion localRotation;
-    Vec3 localPosition;
-    float localScale = 1;
-};
+void TransformInitStorage( unsigned maxGameObjects )
+{
+    transformPositions = teMallocArray< Vec3 >( maxGameObjects, teMemoryTag::Scene );
+    transformRotations = teMallocArray< Quaternion >( maxGameObjects, teMemoryTag::Scene );
+    transformScales = teMallocArray< float >( maxGameObjects, teMemoryTag::Scene );
+    transformMatrices = teMallocArray< Affine3x4 >( maxGameObjects, teMemoryTag::Scene );
 
-TransformImpl transforms[ 10000 ];
+    for (unsigned i = 0; i < maxGameObjects; ++i)
+    {
+        transformScales[ i ] = 1;
+    }
+}
 
 const Vec3& teTransformGetLocalPosition( unsigned index )
 {
-    return transforms[ index ].localPosition;
+    return transformPositions[ index ];
 }
 
 Vec3* teTransformAccessLocalPosition( unsigned index )
 {
-    return &transforms[ index ].localPosition;
+    return &transformPositions[ index ];
 }
 
 void teTransformSetLocalScale( unsigned index, float scale )
 {
-    transforms[ index ].localScale = scale;
+    transformScales[ index ] = scale;
 }
 
 float* teTransformAccessLocalScale( unsigned index )
 {
-    return &transforms[ index ].localScale;
+    return &transformScales[ index ];
 }
 
-const Matrix& teTransformGetMatrix( unsigned index )
-{
-    return transforms[ index ].localMatrix;
-}
-
-void teTransformSetLocalPosition( unsigned index, const Vec3& pos )
+Matrix teTransformGetMatrix( unsigned index )
 {
-    transforms[ index ].localPosition = pos;
-}
-
-const Quaternion& teTransformGetLocalRotation( int index )
-{
-    return transforms[ index ].localRotation;
-}
-
-void teTransformSetLocalRotation( unsigned index, const Quaternion& rotation )
-{
-    transforms[ index ].localRotation = rotation;
+    Matrix localMatrix;
+    transformMatrices[ index ].GetMatrix( localMatrix );
+    return localMatrix;
 }
 
-void teTransformGetComputedLocalToShadowClipMatrix( unsigned index, Matrix& outLocalToShadowClip )
+const Affine3x4& TransformGetLocalAffine( unsigned index )
 {
-    outLocalToShadowClip = transforms[ index ].localToShadowClip;
+    return transformMatrices[ index ];
 }
 
-void teTransformSetComputedLocalToShadowClipMatrix( unsigned index, const Matrix& localToShadowClip )
+void teTransformSetLocalPosition( unsigned index, const Vec3& pos )
 {
-    transforms[ index ].localToShadowClip = localToShadowClip;
+    transformPositions[ index ] = pos;
 }
 
-void teTransformGetComputedLocalToClipMatrix( unsigned index, Matrix& outLocalToClip )
+const Quaternion& teTransformGetLocalRotation( int index )
 {
-    outLocalToClip = transforms[ index ].localToClip;
+    return transformRotations[ index ];
 }
 
-void teTransformGetComputedLocalToViewMatrix( unsigned index, Matrix& outLocalToView )
+void teTransformSetLocalRotation( unsigned index, const Quaternion& rotation )
 {
-    outLocalToView = transforms[ index ].localToView;
+    transformRotations[ index ] = rotation;
 }
 
 void TransformSolveLocalMatrix( unsigned index, bool isCamera )
 {
-    TransformImpl& ti = transforms[ index ];
-    
-    ti.localRotation.GetMatrix( ti.localMatrix );
-
-    if (ti.localScale != 1)
+    if (!isCamera)
     {
-        ti.localMatrix.Scale( ti.localScale, ti.localScale, ti.localScale );
-    }    
+        Affine3x4::Compose( transformRotations[ index ], transformPositions[ index ], transformScales[ index ], transformMatrices[ index ] );
+        return;
+    }
 
-    Matrix translation;
-    if (isCamera)
-        translation.SetTranslation( -ti.localPosition );
-    else
-        translation.SetTranslation( ti.localPosition );
+    Affine3x4 rotation;
+    Affine3x4::Compose( transformRotations[ index ], Vec3(), transformScales[ index ], rotation );
 
     // FIXME: This is a hack to prevent camera's rotation to be weird
-    if (isCamera)
-    {
-        Matrix::Multiply( translation, ti.localMatrix, ti.localMatrix );
-    }
-    else
-    {
-        Matrix::Multiply( ti.localMatrix, translation, ti.localMatrix );
-    }
+    Affine3x4 translation;
+    translation.m[ 3 ] = -transformPositions[ index ].x;
+    translation.m[ 7 ] = -transformPositions[ index ].y;
+    translation.m[ 11 ] = -transformPositions[ index ].z;
+    Affine3x4::Multiply( translation, rotation, transformMatrices[ index ] );
 }
 
-void TransformSetComputedLocalToClip( unsigned index, const Matrix& localToClip )
+// Copies the inputs of count game objects with consecutive indices starting from firstIndex.
+// positions are x, y, z and rotations x, y, z, w per game object.
+void TransformCopyLocals( unsigned firstIndex, unsigned count, const float* positions, const float* rotations, const float* scales )
 {
-    transforms[ index ].localToClip = localToClip;
+    static_assert( sizeof( Vec3 ) == 3 * sizeof( float ) && sizeof( Quaternion ) == 4 * sizeof( float ), "Streams are copied as floats" );
+
+    teMemcpy( &transformPositions[ firstIndex ], positions, count * sizeof( Vec3 ) );
+    teMemcpy( &transformRotations[ firstIndex ], rotations, count * sizeof( Quaternion ) );
+    teMemcpy( &transformScales[ firstIndex ], scales, count * sizeof( float ) );
 }
 
-void TransformSetComputedLocalToView( unsigned index, const Matrix& localToView )
+// Solves non-camera transforms. Only the input streams and the matrices are touched.
+void TransformSolveLocalMatrices( const unsigned* indices, unsigned count )
 {
-    transforms[ index ].localToView = localToView;
+    Affine3x4::ComposeBatch( transformRotations, transformPositions, transformScales, indices, count, transformMatrices );
 }
 
 Vec3 teTransformGetViewDirection( unsigned index )
 {
-    TransformImpl& ti = transforms[ index ];
-
     Matrix view;
-    ti.localRotation.GetMatrix( view );
+    transformRotations[ index ].GetMatrix( view );
 
     Matrix translation;
-    translation.SetTranslation( -ti.localPosition );
+    translation.SetTranslation( -transformPositions[ index ] );
     Matrix::Multiply( translation, view, view );
     
     return Vec3( view.m[ 2 ], view.m[ 6 ], view.m[ 10 ] ).Normalized();
@@ -149,11 +140,11 @@ void teTransformOffsetRotate( unsigned index, const Vec3& axis, float angleDeg )
 
     if (IsAlmost( axis.y, 0 ))
     {
-        newRotation = transforms[ index ].localRotation * rot;
+        newRotation = transformRotations[ index ] * rot;
     }
     else
     {
-        newRotation = rot * transforms[ index ].localRotation;
+        newRotation = rot * transformRotations[ index ];
     }
 
     newRotation.Normalize();
@@ -164,39 +155,39 @@ void teTransformOffsetRotate( unsigned index, const Vec3& axis, float angleDeg )
         return;
     }
 
-    transforms[ index ].localRotation = newRotation;
+    transformRotations[ index ] = newRotation;
 }
 
 void teTransformLookAt( unsigned index, const Vec3& localPosition, const Vec3& center, const Vec3& up )
 {
     Matrix lookAt;
     lookAt.MakeLookAtLH( localPosition, center, up );
-    transforms[ index ].localRotation.FromMatrix( lookAt );
-    transforms[ index ].localPosition = localPosition;
+    transformRotations[ index ].FromMatrix( lookAt );
+    transformPositions[ index ] = localPosition;
 }
 
 void teTransformMoveForward( unsigned index, float amount, bool ignoreX, bool ignoreY, bool ignoreZ )
 {
     if (!IsAlmost( amount, 0 ))
     {
-        const float x = transforms[ index ].localPosition.x;
-        const float y = transforms[ index ].localPosition.y;
-        const float z = transforms[ index ].localPosition.z;
-        transforms[ index ].localPosition += transforms[ index ].localRotation * Vec3( 0, 0, -amount );
+        const float x = transformPositions[ index ].x;
+        const float y = transformPositions[ index ].y;
+        const float z = transformPositions[ index ].z;
+        transformPositions[ index ] += transformRotations[ index ] * Vec3( 0, 0, -amount );
 
         if (ignoreX)
         {
-            transforms[ index ].localPosition.x = x;
+            transformPositions[ index ].x = x;
         }
 
         if (ignoreY)
         {
-            transforms[ index ].localPosition.y = y;
+            transformPositions[ index ].y = y;
         }
 
         if (ignoreZ)
         {
-            transforms[ index ].localPosition.z = z;
+            transformPositions[ index ].z = z;
         }
     }
 }
@@ -205,11 +196,19 @@ void teTransformMoveRight( unsigned index, float amount )
 {
     if (!IsAlmost( amount, 0 ))
     {
-        transforms[ index ].localPosition += transforms[ index ].localRotation * Vec3( amount, 0, 0 );
+        transformPositions[ index ] += transformRotations[ index ] * Vec3( amount, 0, 0 );
     }
 }
 
 void teTransformMoveUp( unsigned index, float amount )
 {
-    transforms[ index ].localPosition.y += amount;
+    transformPositions[ index ].y += amount;
+}
+
+void TransformReset( unsigned index )
+{
+    transformPositions[ index ] = Vec3();
+    transformRotations[ index ] = Quaternion();
+    transformScales[ index ] = 1;
+    transformMatrices[ index ].MakeIdentity();
 }
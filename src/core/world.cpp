@@ -0,0 +1,244 @@
+#include "world.h"
+#include "file.h"
+#include "gameobject.h"
+#include "material.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "scene.h"
+#include "shader.h"
+#include "streaming.h"
+#include "te_stdlib.h"
+#include "texture.h"
+#include "vec3.h"
+#include <math.h>
+
+enum class CellState { Unloaded, ReadingFile, Loaded };
+
+struct Cell
+{
+    char path[ 260 ] = {};
+    int x = 0;
+    int z = 0;
+    CellState state = CellState::Unloaded;
+    teFile sceneFile; // Written by streaming while ReadingFile.
+
+    teGameObject* gos = nullptr;
+    teTexture2D* textures = nullptr;
+    teMaterial* materials = nullptr;
+    teMesh* meshes = nullptr;
+    unsigned goCount = 0;
+    unsigned textureCount = 0;
+    unsigned materialCount = 0;
+    unsigned meshCount = 0;
+};
+
+static constexpr unsigned MaxCells = 1024;
+
+struct World
+{
+    Cell cells[ MaxCells ];
+    unsigned cellCount = 0;
+    teScene scene;
+    teShader standardShader;
+    float cellSize = 100;
+    float loadDistance = 200;
+    float unloadDistance = 300;
+    unsigned memoryBudgetBytes = 512 * 1024 * 1024;
+};
+
+static World world;
+TE_TRACK_STATIC_MEMORY( worldMemory, teMemoryTag::Scene, sizeof( world ) );
+
+void teWorldCreate( const teScene& scene, const teShader& standardShader, float cellSize )
+{
+    teAssert( cellSize > 0 );
+
+    world.scene = scene;
+    world.standardShader = standardShader;
+    world.cellSize = cellSize;
+}
+
+void teWorldAddCell( int cellX, int cellZ, const char* sceneFilePath )
+{
+    teAssert( world.cellCount < MaxCells );
+
+    Cell& cell = world.cells[ world.cellCount++ ];
+    cell.x = cellX;
+    cell.z = cellZ;
+    teMemcpy( cell.path, sceneFilePath, teStrlen( sceneFilePath ) < sizeof( cell.path ) ? teStrlen( sceneFilePath ) : sizeof( cell.path ) - 1 );
+}
+
+void teWorldSetStreamingDistances( float loadDistance, float unloadDistance )
+{
+    teAssert( unloadDistance >= loadDistance );
+
+    world.loadDistance = loadDistance;
+    world.unloadDistance = unloadDistance;
+}
+
+void teWorldSetMemoryBudget( unsigned bytes )
+{
+    world.memoryBudgetBytes = bytes;
+}
+
+unsigned teWorldGetLoadedCellCount()
+{
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < world.cellCount; ++i)
+    {
+        count += world.cells[ i ].state == CellState::Loaded ? 1 : 0;
+    }
+
+    return count;
+}
+
+// Distance on the XZ plane from point to the nearest point of the cell, 0 inside the cell.
+static float GetCellDistance( const Cell& cell, const Vec3& point )
+{
+    const float minX = cell.x * world.cellSize;
+    const float minZ = cell.z * world.cellSize;
+    const float dx = point.x < minX ? minX - point.x : (point.x > minX + world.cellSize ? point.x - minX - world.cellSize : 0);
+    const float dz = point.z < minZ ? minZ - point.z : (point.z > minZ + world.cellSize ? point.z - minZ - world.cellSize : 0);
+
+    return sqrtf( dx * dx + dz * dz );
+}
+
+static void InstantiateCell( Cell& cell )
+{
+    cell.state = CellState::Loaded;
+
+    if (!cell.sceneFile.data)
+    {
+        teLog( teLogLevel::Warning, "World: could not read cell %s\n", cell.path );
+        return;
+    }
+
+    teSceneReadArraySizes( cell.sceneFile, cell.goCount, cell.textureCount, cell.materialCount, cell.meshCount );
+    // teMalloc doesn't accept 0 bytes, so empty arrays stay nullptr.
+    cell.gos = cell.goCount > 0 ? (teGameObject*)teMalloc( cell.goCount * sizeof( teGameObject ), teMemoryTag::Scene ) : nullptr;
+    cell.textures = cell.textureCount > 0 ? (teTexture2D*)teMalloc( cell.textureCount * sizeof( teTexture2D ), teMemoryTag::Scene ) : nullptr;
+    cell.materials = cell.materialCount > 0 ? (teMaterial*)teMalloc( cell.materialCount * sizeof( teMaterial ), teMemoryTag::Scene ) : nullptr;
+    cell.meshes = cell.meshCount > 0 ? (teMesh*)teMalloc( cell.meshCount * sizeof( teMesh ), teMemoryTag::Scene ) : nullptr;
+    teSceneReadScene( cell.sceneFile, world.standardShader, cell.gos, cell.textures, cell.materials, cell.meshes );
+
+    for (unsigned g = 0; g < cell.goCount; ++g)
+    {
+        teSceneAdd( world.scene, cell.gos[ g ].index );
+    }
+
+    teFree( cell.sceneFile.data );
+    cell.sceneFile = teFile();
+}
+
+static void UnloadCell( Cell& cell )
+{
+    // Game objects go first, so nothing points to the cell's meshes when they're released.
+    for (unsigned g = 0; g < cell.goCount; ++g)
+    {
+        if (teGameObjectIsAlive( cell.gos[ g ] ))
+        {
+            teDestroyGameObject( cell.gos[ g ] );
+        }
+    }
+
+    for (unsigned m = 0; m < cell.meshCount; ++m)
+    {
+        teStreamReleaseMesh( &cell.meshes[ m ] );
+    }
+
+    for (unsigned t = 0; t < cell.textureCount; ++t)
+    {
+        teStreamReleaseTexture( &cell.textures[ t ] );
+    }
+
+    // Texture releases above cancel pending bindings into the materials, so they can be reused now.
+    for (unsigned m = 0; m < cell.materialCount; ++m)
+    {
+        teDestroyMaterial( cell.materials[ m ] );
+    }
+
+    if (cell.gos)
+    {
+        teFree( cell.gos );
+    }
+
+    if (cell.textures)
+    {
+        teFree( cell.textures );
+    }
+
+    if (cell.materials)
+    {
+        teFree( cell.materials );
+    }
+
+    if (cell.meshes)
+    {
+        teFree( cell.meshes );
+    }
+
+    cell.gos = nullptr;
+    cell.textures = nullptr;
+    cell.materials = nullptr;
+    cell.meshes = nullptr;
+    cell.goCount = 0;
+    cell.textureCount = 0;
+    cell.materialCount = 0;
+    cell.meshCount = 0;
+    cell.state = CellState::Unloaded;
+}
+
+void teWorldUpdate( const Vec3& cameraPosition )
+{
+    TE_PROFILE_SCOPE( "teWorldUpdate" );
+
+    const bool isOverBudget = teStreamingGetReferencedBytes() > world.memoryBudgetBytes;
+
+    int unloadIndex = -1;
+    float unloadCellDistance = 0;
+    int loadIndex = -1;
+    float loadCellDistance = 0;
+
+    for (unsigned i = 0; i < world.cellCount; ++i)
+    {
+        Cell& cell = world.cells[ i ];
+
+        if (cell.state == CellState::ReadingFile)
+        {
+            // Streaming sets the path when the read has finished, even if it failed.
+            if (cell.sceneFile.path[ 0 ] != 0)
+            {
+                InstantiateCell( cell );
+            }
+
+            continue;
+        }
+
+        const float distance = GetCellDistance( cell, cameraPosition );
+
+        if (cell.state == CellState::Loaded && (distance > world.unloadDistance || (isOverBudget && distance > world.loadDistance)) &&
+            (unloadIndex == -1 || distance > unloadCellDistance))
+        {
+            unloadIndex = (int)i;
+            unloadCellDistance = distance;
+        }
+
+        if (cell.state == CellState::Unloaded && distance <= world.loadDistance && (loadIndex == -1 || distance < loadCellDistance))
+        {
+            loadIndex = (int)i;
+            loadCellDistance = distance;
+        }
+    }
+
+    if (unloadIndex != -1)
+    {
+        UnloadCell( world.cells[ unloadIndex ] );
+    }
+
+    if (loadIndex != -1 && !isOverBudget)
+    {
+        world.cells[ loadIndex ].state = CellState::ReadingFile;
+        teStreamFile( world.cells[ loadIndex ].path, &world.cells[ loadIndex ].sceneFile );
+    }
+}
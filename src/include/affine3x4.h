@@ -0,0 +1,28 @@
+#pragma once
+
+// Affine transform as the first three columns of a Matrix, stored as rows: a row's dot product with (x, y, z, 1)
+// gives one component of a transformed point. Same layout as row_major float3x4 in shaders, 48 bytes instead of 64.
+struct alignas( 16 ) Affine3x4
+{
+    static void FromMatrix( const struct Matrix& matrix, Affine3x4& out );
+    // Same as rotation matrix * scale * translation.
+    static void Compose( const struct Quaternion& rotation, const struct Vec3& position, float scale, Affine3x4& out );
+    // out[ index ] = Compose( rotations[ index ], positions[ index ], scales[ index ] ) for the count indices.
+    // Uses AVX2 when the CPU supports it.
+    static void ComposeBatch( const Quaternion* rotations, const Vec3* positions, const float* scales, const unsigned* indices, unsigned count, Affine3x4* out );
+    // out is identity if the matrix is singular.
+    static void Invert( const Affine3x4& affine, Affine3x4& out );
+    // Same order as Matrix::Multiply: ma is applied first. out can be ma or mb.
+    static void Multiply( const Affine3x4& ma, const Affine3x4& mb, Affine3x4& out );
+    // out = affine * projection, e.g. localToClip from localToView and viewToClip.
+    static void MultiplyProjection( const Affine3x4& affine, const Matrix& projection, Matrix& out );
+    static void TransformDirection( const Vec3& dir, const Affine3x4& affine, Vec3& out );
+    static void TransformPoint( const Vec3& point, const Affine3x4& affine, Vec3& out );
+
+    Affine3x4() noexcept { MakeIdentity(); }
+
+    void GetMatrix( Matrix& out ) const;
+    void MakeIdentity();
+
+    float m[ 12 ];
+};
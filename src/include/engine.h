@@ -0,0 +1,33 @@
+#pragma once
+
+// Compile-time defaults of teEngineDesc. A project can override them with -D instead of calling teInitEngine().
+#ifndef TE_DEFAULT_MAX_GAMEOBJECTS
+#define TE_DEFAULT_MAX_GAMEOBJECTS 10000
+#endif
+#ifndef TE_DEFAULT_MAX_MESHES
+#define TE_DEFAULT_MAX_MESHES 10000
+#endif
+#ifndef TE_DEFAULT_MAX_MATERIALS
+#define TE_DEFAULT_MAX_MATERIALS 500
+#endif
+#ifndef TE_DEFAULT_MAX_SHADERS
+#define TE_DEFAULT_MAX_SHADERS 40
+#endif
+#ifndef TE_DEFAULT_MAX_AUDIO_CLIPS
+#define TE_DEFAULT_MAX_AUDIO_CLIPS 1000
+#endif
+
+// Capacities of engine storage. Each kind of storage is allocated once, so capacities can't grow later.
+struct teEngineDesc
+{
+    // Transforms, cameras, frustums, mesh renderers, lights and scene slots are indexed by game object, so this sizes them too.
+    unsigned maxGameObjects = TE_DEFAULT_MAX_GAMEOBJECTS;
+    unsigned maxMeshes = TE_DEFAULT_MAX_MESHES;
+    unsigned maxMaterials = TE_DEFAULT_MAX_MATERIALS;
+    unsigned maxShaders = TE_DEFAULT_MAX_SHADERS;
+    unsigned maxAudioClips = TE_DEFAULT_MAX_AUDIO_CLIPS;
+};
+
+// Allocates engine storage. Must be called before anything else is created, including the renderer.
+// If it's not called, storage is allocated with the default capacities when the first thing is created.
+void teInitEngine( const teEngineDesc& desc );
@@ -1,5 +1,7 @@
 #pragma once
 
+struct teArena;
+
 struct teFile
 {
     unsigned char* data = nullptr;
@@ -8,10 +10,17 @@ struct teFile
 };
 
 // @param path Path to the file to open.
-// @return File. Caller is responsible for freeing teFile.data using free().
+// @return File. Caller is responsible for freeing it using teFreeFile().
 teFile teLoadFile( const char* path );
+// @param path Path to the file to open.
+// @param arena Arena that owns teFile.data. Don't free it.
+teFile teLoadFile( const char* path, teArena& arena );
+// Frees a file returned by teLoadFile( path ) and clears its data and size. Not for files loaded into an arena.
+void teFreeFile( teFile& file );
 // Reloads shaders, textures etc. that have changed on disk.
 void teHotReload();
+// Stops watching files for modifications. Called at exit, but can be called earlier.
+void teHotReloadStop();
 unsigned teReadDirectory( const char* root );
 bool teGetNextFile( unsigned handle, char** outPath );
 void teCloseDirectory( unsigned handle );
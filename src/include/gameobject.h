@@ -2,21 +2,33 @@
 
 enum teComponent : unsigned
 {
-    Transform    = 1,
-    Camera       = 2,
-    MeshRenderer = 4,
-    PointLight   = 8,
-    SpotLight    = 16,
-    AudioSource  = 32,
+    Transform             = 1,
+    Camera                = 2,
+    MeshRenderer          = 4,
+    PointLight            = 8,
+    SpotLight             = 16,
+    AudioSource           = 32,
+    InstancedMeshRenderer = 64,
 };
 
+// index is reused after the game object is destroyed; generation tells the old and new game object apart.
 struct teGameObject
 {
     unsigned index = 0;
+    unsigned generation = 0;
 };
 
 unsigned teGameObjectGetComponents( unsigned index );
+// @param component A single component.
+// @param outCount Number of game objects that have component.
+// @return Game objects that have component, in no particular order. Changes when a game object gets component.
+const unsigned* teGameObjectGetObjectsWithComponent( teComponent component, unsigned& outCount );
 teGameObject teCreateGameObject( const char* name, unsigned components );
+// Removes the game object from scenes and resets its components. Its index can be returned by a later teCreateGameObject().
+void teDestroyGameObject( const teGameObject& gameObject );
+// @return false if gameObject has been destroyed or was never created.
+bool teGameObjectIsAlive( const teGameObject& gameObject );
+// Names are interned and truncated to 99 characters.
 void teGameObjectSetName( unsigned index, const char* name );
-char* teGameObjectGetName( unsigned index );
+const char* teGameObjectGetName( unsigned index );
 void teGameObjectAddComponent( unsigned index, teComponent component );
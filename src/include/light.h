@@ -7,4 +7,13 @@ float* tePointLightAccessColor( unsigned goIndex );
 float* teSpotLightAccessRadius( unsigned goIndex );
 float* teSpotLightAccessColor( unsigned goIndex );
 void teSpotLightSetParams( unsigned goIndex, Vec3& position, const Vec3& color, float coneAngleDegrees, const Vec3& direction, float falloffRadius );
-float* teSpotLightAccessConeAngle( unsigned goIndex );
\ No newline at end of file
+float* teSpotLightAccessConeAngle( unsigned goIndex );
+// Disabled lights keep their values but aren't uploaded or culled, and don't take a light slot. If all slots are taken,
+// an enabled light isn't rendered until a light is removed or disabled and its slot is given to the waiting light.
+void tePointLightSetEnabled( unsigned goIndex, bool enable );
+void teSpotLightSetEnabled( unsigned goIndex, bool enable );
+bool tePointLightIsEnabled( unsigned goIndex );
+bool teSpotLightIsEnabled( unsigned goIndex );
+// Lights are assigned to clusters on the CPU instead of to screen tiles by the light culling shader. Needs a perspective camera.
+// A frame whose clusters don't fit in the upload ring uses the light culling shader. Time is reported in teStat::CpuLightClusteringMs.
+void teLightSetCpuClustering( bool enable );
@@ -16,6 +16,8 @@ struct teMaterial
 };
 
 teMaterial teCreateMaterial( const struct teShader& shader );
+// The material's index is reused by the next created material, so nothing should use the material after this.
+void teDestroyMaterial( const teMaterial& material );
 void teMaterialSetTexture2D( const teMaterial& material, const struct teTexture2D& tex, unsigned slot );
 teShader& teMaterialGetShader( const teMaterial& material );
 teTexture2D teMaterialGetTexture2D( const teMaterial& material, unsigned slot );
@@ -5,9 +5,15 @@ struct alignas( 16 ) Matrix
     static void Invert( const Matrix& matrix, Matrix& out );
     static void InverseTranspose( const float m[ 16 ], float* out );
     static void Multiply( const Matrix& ma, const Matrix& mb, Matrix& out );
+    // Same as rotation matrix * scale * translation, without the multiplies.
+    static void Compose( const struct Quaternion& rotation, const struct Vec3& position, float scale, Matrix& out );
     static void TransformDirection( const struct Vec3& dir, const Matrix& mat, Vec3* out );
     static void TransformPoint( const Vec3& point, const Matrix& mat, Vec3& out );
     static void TransformPoint( const Vec4& point, const Matrix& mat, Vec4& out );
+    // out[ i ] = ma[ i ] * mb. Uses AVX2 when the CPU supports it. out can be ma.
+    static void MultiplyBatch( const Matrix* ma, const Matrix& mb, Matrix* out, unsigned count );
+    // Uses AVX2 when the CPU supports it. out can be points.
+    static void TransformPoints( const Vec3* points, const Matrix& mat, Vec3* out, unsigned count );
 
     Matrix() noexcept { MakeIdentity(); }
     Matrix( float xDeg, float yDeg, float zDeg ) { MakeRotationXYZ( xDeg, yDeg, zDeg ); }
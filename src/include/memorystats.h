@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+// Engine heap and static memory by tag. Tracking is on in _DEBUG builds, or when TE_MEMORY_TRACKING is 1.
+
+enum class teMemoryTag : unsigned { Other, Scene, Mesh, Texture, Audio, Renderer, Tools, Count };
+
+struct teMemoryTagStats
+{
+    size_t currentBytes = 0;
+    size_t peakBytes = 0;
+    unsigned allocationCount = 0; // Live allocations.
+};
+
+struct teMemoryStats
+{
+    teMemoryTagStats tags[ (unsigned)teMemoryTag::Count ];
+};
+
+// Returns all zeroes when memory tracking is off.
+teMemoryStats teGetMemoryStats();
+const char* teMemoryTagGetName( teMemoryTag tag );
@@ -19,6 +19,20 @@ void teMeshRendererSetMesh( unsigned gameObjectIndex, teMesh* mesh );
 void teMeshRendererSetMaterial( unsigned gameObjectIndex, const struct teMaterial& material, unsigned subMeshIndex );
 void teMeshRendererSetEnabled( unsigned gameObjectIndex, bool enable );
 bool teMeshRendererIsEnabled( unsigned gameObjectIndex );
+// Occluders' submesh bounding boxes hide meshes behind them. Only meshes that fill their bounds, like walls and floors, should be occluders.
+void teMeshRendererSetOccluder( unsigned gameObjectIndex, bool isOccluder );
+bool teMeshRendererIsOccluder( unsigned gameObjectIndex );
+// Static mesh renderers don't move and are merged into batches by teSceneBuildStaticBatches().
+void teMeshRendererSetStatic( unsigned gameObjectIndex, bool isStatic );
+bool teMeshRendererIsStatic( unsigned gameObjectIndex );
+// Instanced mesh renderers draw every instance of their mesh with one draw call per submesh. The mesh and materials are set
+// with teMeshRendererSetMesh() and teMeshRendererSetMaterial(). Instances are in the game object's space and culled per instance.
+// @param tint Multiplied with the material's tint in shaders that use it.
+// @return Instance index.
+unsigned teInstancedMeshRendererAddInstance( unsigned gameObjectIndex, const struct Matrix& localMatrix, const struct Vec4& tint );
+void teInstancedMeshRendererSetInstance( unsigned gameObjectIndex, unsigned instanceIndex, const Matrix& localMatrix, const Vec4& tint );
+unsigned teInstancedMeshRendererGetInstanceCount( unsigned gameObjectIndex );
+void teInstancedMeshRendererClearInstances( unsigned gameObjectIndex );
 const teMaterial& teMeshRendererGetMaterial( unsigned gameObjectIndex, unsigned subMeshIndex );
 unsigned teMeshGetIndexCount( const teMesh& mesh, unsigned subMeshIndex );
 unsigned teMeshGetUVCount( const teMesh& mesh, unsigned subMeshIndex );
@@ -0,0 +1,31 @@
+#pragma once
+
+// CPU profiler. TE_PROFILE_SCOPE( "name" ) records when the enclosing scope begins and ends, but only while a capture
+// is running, so scopes cost one branch otherwise. Each thread writes to its own event buffer.
+// Renderer group markers are recorded too, so passes show up with the same names as in GPU debuggers.
+
+#ifndef TE_PROFILER
+#define TE_PROFILER 1
+#endif
+
+// @param name Must outlive the capture, so usually a string literal.
+void teProfileBegin( const char* name );
+void teProfileEnd();
+// Records the next frameCount frames, counted by teBeginFrame(), and writes them to path in Chrome trace format.
+// The trace can be opened in chrome://tracing or ui.perfetto.dev.
+void teProfilerCaptureFrames( unsigned frameCount, const char* path );
+bool teProfilerIsCapturing();
+
+struct teProfileScope
+{
+    explicit teProfileScope( const char* name ) { teProfileBegin( name ); }
+    ~teProfileScope() { teProfileEnd(); }
+};
+
+#if TE_PROFILER
+#define TE_PROFILE_CONCAT2( a, b ) a##b
+#define TE_PROFILE_CONCAT( a, b ) TE_PROFILE_CONCAT2( a, b )
+#define TE_PROFILE_SCOPE( name ) teProfileScope TE_PROFILE_CONCAT( profileScope, __LINE__ )( name )
+#else
+#define TE_PROFILE_SCOPE( name )
+#endif
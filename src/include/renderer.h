@@ -23,7 +23,47 @@ enum class teStat
 {
     DrawCalls,
     PSOBinds,
+    Triangles,
+    Meshlets,
+    DescriptorWrites,
+    PushConstantBytes,
+    UBOBytes,
+    BufferUploadBytes,
+    TextureUploadBytes,
+    QueueSubmits,
+    QueueWaits, // Times the CPU waited for the GPU.
+    // Scene culling. Shadow is the directional light's shadow map and Camera is the scene's camera.
+    ShadowObjectsTested,
+    ShadowSubMeshesTested,
+    ShadowSubMeshesFrustumCulled,
+    ShadowSubMeshesDrawn,
+    CameraObjectsTested,
+    CameraSubMeshesTested,
+    CameraSubMeshesFrustumCulled,
+    CameraSubMeshesOcclusionCulled,
+    CameraSubMeshesDrawn,
+    DepthNormalsSubMeshesDrawn,
+    InstancesDrawn,
+    LightsTiled, // Point and spot lights in the scene that were given to light culling.
+    CpuLightClusteringMs, // Time of assigning lights to clusters on the CPU. GpuLightCullingMs isn't updated while CPU clustering is used.
+    // GPU times in milliseconds. They're read without waiting for the GPU, so they're from the frame that was
+    // rendered as many frames ago as there are frames in flight. Metal only reports GpuFrameMs.
+    GpuFrameMs,
+    GpuShadowMs,
+    GpuDepthNormalsMs,
+    GpuLightCullingMs,
+    GpuOpaqueMs,
+    GpuAlphaMs,
+    GpuBloomMs, // Compute dispatches whose debug name begins with "bloom".
+    GpuUIMs,
+    Count
 };
 
+// Counters are reset by teBeginFrame(), so this returns the value for the current frame so far. GPU times aren't reset.
 float teRendererGetStat( teStat stat );
+// Average of the last 60 frames.
+float teRendererGetStatAverage( teStat stat );
+// Clears the averages, e.g. after loading a level so that they don't include its uploads.
+void teRendererResetStats();
+const char* teRendererGetStatName( teStat stat );
 void teRendererUpdateLineBuffer( const teShader& shader, const struct Vec3* lines, unsigned count );
\ No newline at end of file
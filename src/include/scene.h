@@ -9,9 +9,15 @@ struct teScene
 teScene teCreateScene( unsigned directonalShadowMapDimension );
 void teSceneAdd( const teScene& scene, unsigned gameObjectIndex );
 void teSceneRemove( const teScene& scene, unsigned gameObjectIndex );
+bool teSceneContains( const teScene& scene, unsigned gameObjectIndex );
 void teSceneRender( const teScene& scene, const struct teShader* skyboxShader, const struct teTextureCube* skyboxTexture, const struct teMesh* skyboxMesh, const teShader& momentsShader, const struct Vec3& dirLightPosition, const teShader& depthNormalsShader, const teShader& lightCullShader );
 bool teScenePointInsideAABB( const teScene& scene, const Vec3& point );
 void teSceneSetupDirectionalLight( const teScene& scene, const Vec3& color, const Vec3& direction );
+// Merges static mesh renderers' submeshes that share a material and are near each other into batch game objects that are added
+// to the scene, and disables the merged mesh renderers. Call after the scene's meshes are loaded and before teFinalizeMeshBuffers().
+// \param clusterSize Submeshes whose bounds' centers are in the same clusterSize^3 cell are merged.
+// \return Number of batches.
+unsigned teSceneBuildStaticBatches( const teScene& scene, float clusterSize );
 unsigned teSceneGetMaxGameObjects();
 // \return 0 if the game object at index i doesn't exist.
 unsigned teSceneGetGameObjectIndex( const teScene& scene, unsigned i );
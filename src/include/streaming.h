@@ -0,0 +1,30 @@
+#pragma once
+
+// Streamed assets are read and validated on worker threads and created on the render thread in teBeginFrame().
+// Assets are shared by path: streaming an asset that's already resident returns it immediately.
+
+constexpr unsigned teStreamAllSubMeshes = 0xFFFFFFFF;
+
+// @param path Path to a .t3d file.
+// @param outMesh Receives a placeholder cube immediately and the real mesh once it's resident. Must stay valid until then.
+void teStreamMesh( const char* path, struct teMesh* outMesh );
+// @param path Path to a .dds or .tga file.
+// @param outTexture Has index 0 (no texture) until the texture is resident. Must stay valid until then.
+void teStreamTexture( const char* path, unsigned flags, struct teTexture2D* outTexture );
+// @param outFile Gets the file once it has been read; outFile->path is empty until then. Caller frees outFile->data using teFree().
+void teStreamFile( const char* path, struct teFile* outFile );
+// Drops a reference taken by teStreamMesh. mesh isn't written to after this, even if it's still pending.
+void teStreamReleaseMesh( const teMesh* mesh );
+// Drops a reference taken by teStreamTexture. texture isn't written to after this, even if it's still pending.
+void teStreamReleaseTexture( const teTexture2D* texture );
+// Sets texture to material's slot now and again when texture becomes resident.
+void teStreamBindTexture( const teTexture2D* texture, const struct teMaterial& material, unsigned slot );
+// Sets material to the game object's submesh now and again when mesh becomes resident.
+// @param subMeshIndex Submesh index or teStreamAllSubMeshes.
+void teStreamBindMeshMaterial( const teMesh* mesh, unsigned gameObjectIndex, const teMaterial& material, unsigned subMeshIndex );
+// @param bytes Maximum file bytes that are uploaded per frame. At least one asset is always uploaded.
+void teStreamingSetFrameBudget( unsigned bytes );
+// @return Number of streamed assets that are not yet resident.
+unsigned teStreamingGetPendingCount();
+// @return File size of resident assets that have at least one reference.
+unsigned teStreamingGetReferencedBytes();
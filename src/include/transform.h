@@ -8,7 +8,7 @@ float* teTransformAccessLocalScale( unsigned index );
 const struct Quaternion& teTransformGetLocalRotation( int index );
 void teTransformSetLocalRotation( unsigned index, const Quaternion& rotation );
 void teTransformLookAt( unsigned index, const Vec3& localPosition, const Vec3& center, const Vec3& up );
-const struct Matrix& teTransformGetMatrix( unsigned index );
+struct Matrix teTransformGetMatrix( unsigned index );
 void teTransformMoveForward( unsigned index, float amount, bool ignoreX, bool ignoreY, bool ignoreZ );
 void teTransformMoveRight( unsigned index, float amount );
 void teTransformMoveUp( unsigned index, float amount );
@@ -0,0 +1,23 @@
+#pragma once
+
+// World partition: a level is split into square cells on the XZ plane, each one a .tscene or .tsceneb file
+// whose game objects are in world space. Cells are loaded and unloaded around the camera by teWorldUpdate().
+
+// @param scene Scene that loaded cells' game objects are added to.
+// @param standardShader Shader for cells' materials.
+// @param cellSize Cell width and depth in world units.
+void teWorldCreate( const struct teScene& scene, const struct teShader& standardShader, float cellSize );
+// @param cellX Cell column. The cell covers x in [cellX * cellSize, (cellX + 1) * cellSize).
+// @param cellZ Cell row.
+// @param sceneFilePath Path to the cell's scene file.
+void teWorldAddCell( int cellX, int cellZ, const char* sceneFilePath );
+// Cells closer than loadDistance are loaded and cells farther than unloadDistance are unloaded.
+// unloadDistance should be larger than loadDistance, so cells near the edge don't reload every time the camera moves a bit.
+void teWorldSetStreamingDistances( float loadDistance, float unloadDistance );
+// When loaded cells' assets take more than bytes, no more cells are loaded and cells outside loadDistance are unloaded first.
+// The budget counts file bytes of the assets that loaded cells reference, it is not a residency limit: renderers can't
+// destroy meshes or textures, so released assets stay in memory and are reused if a cell references them again.
+void teWorldSetMemoryBudget( unsigned bytes );
+// Starts at most one cell load and one unload, so crossing cell boundaries doesn't stall the frame.
+void teWorldUpdate( const struct Vec3& cameraPosition );
+unsigned teWorldGetLoadedCellCount();
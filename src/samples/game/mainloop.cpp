@@ -5,9 +5,11 @@
 #include "light.h"
 #include "material.h"
 #include "mesh.h"
+#include "profiler.h"
 #include "renderer.h"
 #include "scene.h"
 #include "shader.h"
+#include "streaming.h"
 #include "texture.h"
 #include "transform.h"
 #include "vec3.h"
@@ -262,16 +264,12 @@ void GameSceneReadScene( const teFile& sceneFile, teGameObject* gos )
 
                         ++freeIndex;
                     }
-                    teFile meshFile = teLoadFile( name );
-                    gResources.sceneMeshes[ freeIndex ] = teLoadMesh( meshFile );
+                    teStreamMesh( name, &gResources.sceneMeshes[ freeIndex ] );
+                    meshIndex = freeIndex;
                 }
 
                 teMeshRendererSetMesh( gos[ goCount - 1 ].index, &gResources.sceneMeshes[ meshIndex ] );
-
-                for (unsigned m = 0; m < teMeshGetSubMeshCount( &gResources.sceneMeshes[ meshIndex ] ); ++m)
-                {
-                    teMeshRendererSetMaterial( gos[ goCount - 1 ].index, gResources.defaultMaterial, m );
-                }
+                teStreamBindMeshMaterial( &gResources.sceneMeshes[ meshIndex ], gos[ goCount - 1 ].index, gResources.defaultMaterial, teStreamAllSubMeshes );
             }
         }
 
@@ -316,20 +314,17 @@ void LoadResources( unsigned width, unsigned height )
     teFile bottomFile = teLoadFile( "assets/textures/skybox/bottom.dds" );
     gResources.skyTex = teLoadTexture( rightFile, leftFile, topFile, bottomFile, backFile, frontFile, 0 );
 
-    teFile brickFile = teLoadFile( "assets/textures/brickwall_d.dds" );
-    //teFile brickFile = teLoadFile( "assets/textures/test/manhole_diamond_bc4_with_mips.dds" );
-    gResources.defaultTexture2D = teLoadTexture( brickFile, teTextureFlags::GenerateMips, nullptr, 0, 0, teTextureFormat::Invalid );
-
-    teFile brickNormalFile = teLoadFile( "assets/textures/brickwall_n.tga" );
-    gResources.defaultNormalMap = teLoadTexture( brickNormalFile, teTextureFlags::GenerateMips, nullptr, 0, 0, teTextureFormat::Invalid );
+    teStreamTexture( "assets/textures/brickwall_d.dds", teTextureFlags::GenerateMips, &gResources.defaultTexture2D );
+    //teStreamTexture( "assets/textures/test/manhole_diamond_bc4_with_mips.dds", teTextureFlags::GenerateMips, &gResources.defaultTexture2D );
+    teStreamTexture( "assets/textures/brickwall_n.tga", teTextureFlags::GenerateMips, &gResources.defaultNormalMap );
     teFile cubeFile = teLoadFile( "assets/meshes/cube.t3d" );
     gResources.cubeMesh = teLoadMesh( cubeFile );
 
     gResources.scene = teCreateScene( 0 );
 
     gResources.defaultMaterial = teCreateMaterial( gResources.standardShader );
-    teMaterialSetTexture2D( gResources.defaultMaterial, gResources.defaultTexture2D, 0 );
-    teMaterialSetTexture2D( gResources.defaultMaterial, gResources.defaultNormalMap, 1 );
+    teStreamBindTexture( &gResources.defaultTexture2D, gResources.defaultMaterial, 0 );
+    teStreamBindTexture( &gResources.defaultNormalMap, gResources.defaultMaterial, 1 );
 
     gResources.camera3d = teCreateGameObject( "camera3d", teComponent::Transform | teComponent::Camera );
     Vec3 cameraPos = { 0, 2, 10 };
@@ -465,6 +460,10 @@ void HandleEvent( const teWindowEvent& event )
     {
         gInput.moveDir.y = -0.5f;
     }
+    else if (event.type == teWindowEvent::Type::KeyDown && event.keyCode == teWindowEvent::KeyCode::P)
+    {
+        teProfilerCaptureFrames( 10, "profile.json" );
+    }
 
     if (event.type == teWindowEvent::Type::Mouse2Down)
     {
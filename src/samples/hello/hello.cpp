@@ -7,6 +7,7 @@
 #include "matrix.h"
 #include "mathutil.h"
 #include "material.h"
+#include "memorystats.h"
 #include "mesh.h"
 #include "quaternion.h"
 #include "renderer.h"
@@ -922,7 +923,20 @@ int main()
         //teDrawQuad( fullscreenAdditiveShader, /*bilinearTestTarget*/bloomComposeTarget, shaderParams, teBlendMode::Additive);
 
         ImGui::Begin( "Info" );
-        ImGui::Text( "draw calls: %.0f\nPSO binds: %.0f", teRendererGetStat( teStat::DrawCalls ), teRendererGetStat( teStat::PSOBinds ) );
+
+        for (unsigned statIndex = 0; statIndex < (unsigned)teStat::Count; ++statIndex)
+        {
+            ImGui::Text( "%s: %.1f", teRendererGetStatName( (teStat)statIndex ), teRendererGetStatAverage( (teStat)statIndex ) );
+        }
+
+        const teMemoryStats memoryStats = teGetMemoryStats();
+
+        for (unsigned tagIndex = 0; tagIndex < (unsigned)teMemoryTag::Count; ++tagIndex)
+        {
+            ImGui::Text( "%s memory: %.2f MiB, peak %.2f MiB", teMemoryTagGetName( (teMemoryTag)tagIndex ),
+                memoryStats.tags[ tagIndex ].currentBytes / (1024.0f * 1024.0f), memoryStats.tags[ tagIndex ].peakBytes / (1024.0f * 1024.0f) );
+        }
+
         ImGui::SliderFloat( "Bloom Threshold", &bloomThreshold, 0.01f, 1.0f );
         ImGui::SliderFloat( "Compose Weight 0", &shaderParams.tint[ 0 ], 0.01f, 1.0f );
         ImGui::SliderFloat( "Compose Weight 1", &shaderParams.tint[ 1 ], 0.01f, 1.0f );
@@ -946,23 +960,23 @@ int main()
         teEndFrame();
     }
 
-    free( unlitVsFile.data );
-    free( unlitPsFile.data );
-    free( uiVsFile.data );
-    free( uiPsFile.data );
-    free( fullscreenVsFile.data );
-    free( fullscreenPsFile.data );
-    free( skyboxVsFile.data );
-    free( skyboxPsFile.data );
-    free( bloomThresholdFile.data );
-    free( gliderFile.data );
-    free( backFile.data );
-    free( frontFile.data );
-    free( leftFile.data );
-    free( rightFile.data );
-    free( topFile.data );
-    free( bottomFile.data );
-    free( bc1File.data );
+    teFreeFile( unlitVsFile );
+    teFreeFile( unlitPsFile );
+    teFreeFile( uiVsFile );
+    teFreeFile( uiPsFile );
+    teFreeFile( fullscreenVsFile );
+    teFreeFile( fullscreenPsFile );
+    teFreeFile( skyboxVsFile );
+    teFreeFile( skyboxPsFile );
+    teFreeFile( bloomThresholdFile );
+    teFreeFile( gliderFile );
+    teFreeFile( backFile );
+    teFreeFile( frontFile );
+    teFreeFile( leftFile );
+    teFreeFile( rightFile );
+    teFreeFile( topFile );
+    teFreeFile( bottomFile );
+    teFreeFile( bc1File );
 
     io.BackendRendererUserData = nullptr;
     ImGui::DestroyContext( imContext );
@@ -8,15 +8,16 @@ struct VSOutput
     float3 normalVS : NORMAL;
 };
 
-VSOutput depthNormalsVS( uint vertexId : SV_VertexID )
+VSOutput depthNormalsVS( uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID )
 {
     VSOutput vsOut;
+    InstanceData instance = LoadInstance( instanceId );
     
-    float3 pos = vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId);
-    vsOut.pos = mul( uniforms.localToClip, float4( pos, 1 ) );
+    float3 pos = InstanceTransformPoint( instance, vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId) );
+    vsOut.pos = LocalToClip( pos );
     vsOut.positionVS = mul( uniforms.localToView, float4( pos, 1 ) ).xyz;
     
-    float3 normal = vk::RawBufferLoad < float3 > (pushConstants.normalBuf + 12 * vertexId);
+    float3 normal = InstanceTransformVector( instance, vk::RawBufferLoad < float3 > (pushConstants.normalBuf + 12 * vertexId) );
     vsOut.normalVS = mul( uniforms.localToView, float4( normal, 0 ) ).xyz;
     
     float2 uv = vk::RawBufferLoad< float2 > (pushConstants.uvBuf + 8 * vertexId);
@@ -10,7 +10,7 @@ VSOutput fullscreenVS( uint vertexId : SV_VertexID )
 {
     VSOutput vsOut;
     float3 pos = vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId);
-    vsOut.pos = mul( uniforms.localToClip, float4( pos, 1 ) );
+    vsOut.pos = LocalToClip( pos );
     vsOut.pos.xy *= uniforms.tilesXY.xy;
     vsOut.pos.xy += uniforms.tilesXY.zw;
     
@@ -7,13 +7,13 @@ struct VSOutput
     float2 uv    : TEXCOORD;
 };
 
-VSOutput momentsVS( uint vertexId : SV_VertexID )
+VSOutput momentsVS( uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID )
 {
     VSOutput vsOut;
-    float3 pos = vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId);
-    vsOut.pos = mul( uniforms.localToClip, float4( pos, 1 ) );
+    float3 pos = InstanceTransformPoint( LoadInstance( instanceId ), vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId) );
+    vsOut.pos = LocalToClip( pos );
 
-    vsOut.posVS = mul( uniforms.localToView, float4( pos, 1 ) );
+    vsOut.posVS = float4( mul( uniforms.localToView, float4( pos, 1 ) ), 1 );
     
     float2 uv = vk::RawBufferLoad< float2 > (pushConstants.uvBuf + 8 * vertexId);
     vsOut.uv = uv;
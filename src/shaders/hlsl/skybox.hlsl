@@ -11,7 +11,7 @@ VSOutput skyboxVS( uint vertexId : SV_VertexID )
     VSOutput vsOut;
     float3 pos = vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId);
     vsOut.uv = pos;
-    vsOut.pos = mul( uniforms.localToClip, float4( pos, 1 ) );
+    vsOut.pos = LocalToClip( pos );
 
     return vsOut;
 }
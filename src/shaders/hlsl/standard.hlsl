@@ -13,6 +13,7 @@ struct VSOutput
     float3 bitangentVS : BINORMAL;
     float3 positionVS  : POSITION;
     float3 positionWS  : POSITION1;
+    float4 tint        : COLOR0;
 };
 
 uint GetNumLightsInThisTile( uint tileIndex )
@@ -56,20 +57,34 @@ uint GetTileIndex( float2 screenPos )
     return tileIdx;
 }
 
-VSOutput standardVS( uint vertexId : SV_VertexID )
+// Start of the pixel's list in lights assigned to clusters on the CPU, see LightClusters in light.cpp.
+uint GetClusterListStart( float2 screenPos, float viewDepth )
+{
+    const uint tileRes = (uint) uniforms.clusterParams.x;
+    const uint tilesX = ((uint) uniforms.tilesXY.x + tileRes - 1) / tileRes;
+    const uint tilesY = ((uint) uniforms.tilesXY.y + tileRes - 1) / tileRes;
+    const float slice = clamp( floor( log( max( viewDepth, 1e-6f ) ) * uniforms.clusterParams.y + uniforms.clusterParams.z ), 0, uniforms.clusterParams.w - 1 );
+    const uint clusterIndex = (uint) (screenPos.x / tileRes) + (uint) (screenPos.y / tileRes) * tilesX + (uint) slice * tilesX * tilesY;
+    return vk::RawBufferLoad< uint >( pushConstants.lightIndexBuf + 4 * clusterIndex );
+}
+
+VSOutput standardVS( uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID )
 {
     VSOutput vsOut;
+    InstanceData instance = LoadInstance( instanceId );
     float2 uv = vk::RawBufferLoad < float2 > (pushConstants.uvBuf + 8 * vertexId);
     vsOut.uv = uv;
-    float3 pos = vk::RawBufferLoad < float3 > (pushConstants.posBuf + 12 * vertexId);
-    vsOut.pos = mul( uniforms.localToClip, float4( pos, 1 ) );
-    float3 normal = vk::RawBufferLoad< float3 > (pushConstants.normalBuf + 12 * vertexId);
+    float3 pos = InstanceTransformPoint( instance, vk::RawBufferLoad < float3 > (pushConstants.posBuf + 12 * vertexId) );
+    vsOut.pos = LocalToClip( pos );
+    float3 normal = InstanceTransformVector( instance, vk::RawBufferLoad< float3 > (pushConstants.normalBuf + 12 * vertexId) );
     vsOut.normalVS = mul( uniforms.localToView, float4( normal, 0 ) ).xyz;
     float4 tangent = vk::RawBufferLoad< float4 > (pushConstants.tangentBuf + 16 * vertexId);
+    tangent.xyz = InstanceTransformVector( instance, tangent.xyz );
     vsOut.tangentVS = mul( uniforms.localToView, float4( tangent.xyz, 0 ) ).xyz;
-    vsOut.projCoord = mul( uniforms.localToShadowClip, float4( pos, 1 ) );
+    vsOut.projCoord = LocalToShadowClip( pos );
     vsOut.positionVS = mul( uniforms.localToView, float4( pos, 1 ) ).xyz;
     vsOut.positionWS = mul( uniforms.localToWorld, float4( pos, 1 ) ).xyz;
+    vsOut.tint = instance.tint;
     
     // aether:
     //float3 ct = cross( tangent.xyz, normal ) * tangent.w;
@@ -169,8 +184,7 @@ float4 standardPS( VSOutput vsOut ) : SV_Target
     
     float4 albedo = texture2ds[ pushConstants.textureIndex ].Sample( samplers[ S_LINEAR_REPEAT ], vsOut.uv );
     
-    const uint tileIndex = GetTileIndex( vsOut.pos.xy );
-    uint index = uniforms.maxLightsPerTile * tileIndex;
+    uint index = uniforms.clusterParams.w > 0 ? GetClusterListStart( vsOut.pos.xy, -vsOut.positionVS.z ) : uniforms.maxLightsPerTile * GetTileIndex( vsOut.pos.xy );
     uint nextLightIndex = vk::RawBufferLoad< uint > (pushConstants.lightIndexBuf + 4 * index);
     
     // Point lights
@@ -244,5 +258,5 @@ float4 standardPS( VSOutput vsOut ) : SV_Target
 
     accumDiffuseAndSpecular = max( ambient, accumDiffuseAndSpecular );
     
-    return albedo * float4( saturate( accumDiffuseAndSpecular ), 1 );
+    return albedo * float4( saturate( accumDiffuseAndSpecular ), 1 ) * vsOut.tint;
 }
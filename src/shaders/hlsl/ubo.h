@@ -1,9 +1,10 @@
+// Object transforms are affine, so they are 3x4. Use LocalToClip() and LocalToShadowClip() for clip space positions.
 struct UniformData
 {
-    matrix localToClip;
-    matrix localToView;
-    matrix localToShadowClip;
-    matrix localToWorld;
+    row_major float3x4 localToView;
+    row_major float3x4 localToWorld;
+    matrix viewToClip;
+    matrix worldToShadowClip;
     matrix clipToView;
     float4 bloomParams;
     float4 tilesXY;
@@ -11,6 +12,7 @@ struct UniformData
     float4 lightDirection;
     float4 lightColor;
     float4 lightPosition;
+    float4 clusterParams; // x: tile size in pixels, y and z: depth slice scale and bias, w: slice count, 0 if lights are in tile lists.
     uint pointLightCount;
     uint spotLightCount;
     uint maxLightsPerTile;
@@ -31,6 +33,7 @@ struct PushConstants
     uint64_t spotLightCenterAndRadiusBuf;
     uint64_t spotLightColorBuf;
     uint64_t spotLightParamBuf;
+    uint64_t instanceBuf;
     int textureIndex;
     int shadowTextureIndex;
     int normalMapIndex;
@@ -62,3 +65,46 @@ struct Meshlet
 [[vk::binding(1)]] SamplerState samplers[ 6 ];
 [[vk::binding(2)]] ConstantBuffer< UniformData > uniforms;
 [[vk::binding(3)]] RWTexture2D<float4> rwTexture2d;
+
+float4 LocalToClip( float3 pos )
+{
+    return mul( uniforms.viewToClip, float4( mul( uniforms.localToView, float4( pos, 1 ) ), 1 ) );
+}
+
+float4 LocalToShadowClip( float3 pos )
+{
+    return mul( uniforms.worldToShadowClip, float4( mul( uniforms.localToWorld, float4( pos, 1 ) ), 1 ) );
+}
+
+// Instance-to-world affine rows and tint. Non-instanced draws have one identity instance with white tint,
+// so vertex shaders can always apply the instance before localToView etc.
+struct InstanceData
+{
+    float4 row0;
+    float4 row1;
+    float4 row2;
+    float4 tint;
+};
+
+InstanceData LoadInstance( uint instanceId )
+{
+    uint64_t address = pushConstants.instanceBuf + 64 * instanceId;
+
+    InstanceData instance;
+    instance.row0 = vk::RawBufferLoad< float4 > (address);
+    instance.row1 = vk::RawBufferLoad< float4 > (address + 16);
+    instance.row2 = vk::RawBufferLoad< float4 > (address + 32);
+    instance.tint = vk::RawBufferLoad< float4 > (address + 48);
+    return instance;
+}
+
+float3 InstanceTransformPoint( InstanceData instance, float3 pos )
+{
+    const float4 pos4 = float4( pos, 1 );
+    return float3( dot( instance.row0, pos4 ), dot( instance.row1, pos4 ), dot( instance.row2, pos4 ) );
+}
+
+float3 InstanceTransformVector( InstanceData instance, float3 dir )
+{
+    return float3( dot( instance.row0.xyz, dir ), dot( instance.row1.xyz, dir ), dot( instance.row2.xyz, dir ) );
+}
@@ -5,23 +5,29 @@ struct VSOutput
     float4 pos : SV_Position;
     float2 uv : TEXCOORD;
     float3 color : COLOR0; // for debugging
+    float4 tint : COLOR1;
 };
 
-VSOutput unlitVS( uint vertexId : SV_VertexID )
+VSOutput unlitVS( uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID )
 {
     VSOutput vsOut;
-    float3 pos = vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId);
-    vsOut.pos = mul( uniforms.localToClip, float4( pos, 1 ) );
+    InstanceData instance = LoadInstance( instanceId );
+    float3 pos = InstanceTransformPoint( instance, vk::RawBufferLoad< float3 > (pushConstants.posBuf + 12 * vertexId) );
+    vsOut.pos = LocalToClip( pos );
     float2 uv = vk::RawBufferLoad< float2 > (pushConstants.uvBuf + 8 * vertexId);
     vsOut.uv = uv;
+    vsOut.tint = instance.tint;
 
     return vsOut;
 }
 
 [outputtopology("triangle")]
 [numthreads(128, 1, 1)]
-void unlitMS( uint gtid : SV_GroupThreadID, uint gid : SV_GroupID, out indices uint3 triangles[ 128 ], out vertices VSOutput vertices[ 64 ] )
+void unlitMS( uint gtid : SV_GroupThreadID, uint3 groupId : SV_GroupID, out indices uint3 triangles[ 128 ], out vertices VSOutput vertices[ 64 ] )
 {
+    // Groups are dispatched as (meshlet, instance).
+    uint gid = groupId.x;
+    InstanceData instance = LoadInstance( groupId.y );
     uint4 meshletData = vk::RawBufferLoad < uint4 > (pushConstants.meshletBuf + 16 * gid);
     
     Meshlet meshlet;
@@ -46,11 +52,12 @@ void unlitMS( uint gtid : SV_GroupThreadID, uint gid : SV_GroupID, out indices u
     if (gtid < meshlet.vertexCount)
     {
         uint index = vk::RawBufferLoad < uint > (pushConstants.meshletVertexBuf + 4 * (meshlet.vertexOffset + gtid));
-        float3 pos = vk::RawBufferLoad < float3 > (pushConstants.posBuf + 12 * index + pushConstants.vertexOffset);
+        float3 pos = InstanceTransformPoint( instance, vk::RawBufferLoad < float3 > (pushConstants.posBuf + 12 * index + pushConstants.vertexOffset) );
         float2 uv = vk::RawBufferLoad < float2 > (pushConstants.uvBuf + 8 * index + (pushConstants.vertexOffset / (3 * 4)) * 8);
         
-        vertices[ gtid ].pos = mul( uniforms.localToClip, float4( pos.x, pos.y, pos.z, 1.0 ) );
+        vertices[ gtid ].pos = LocalToClip( pos );
         vertices[ gtid ].uv = uv;
+        vertices[ gtid ].tint = instance.tint;
         
         float3 color = float3(
             float( gid & 1 ),
@@ -62,6 +69,6 @@ void unlitMS( uint gtid : SV_GroupThreadID, uint gid : SV_GroupID, out indices u
 
 float4 unlitPS( VSOutput vsOut ) : SV_Target
 {
-    return texture2ds[ pushConstants.textureIndex ].Sample( samplers[ S_LINEAR_REPEAT ], vsOut.uv ) * uniforms.tint;
+    return texture2ds[ pushConstants.textureIndex ].Sample( samplers[ S_LINEAR_REPEAT ], vsOut.uv ) * uniforms.tint * vsOut.tint;
     //return float4( vsOut.color, 1 );
 }
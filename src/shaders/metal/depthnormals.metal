@@ -13,16 +13,19 @@ struct ColorInOut
 };
 
 vertex ColorInOut depthNormalsVS( uint vid [[ vertex_id ]],
+                          uint iid [[ instance_id ]],
                           constant Uniforms & uniforms [[ buffer(0) ]],
                           const device packed_float3* positions [[ buffer(1) ]],
                           const device packed_float2* uvs [[ buffer(2) ]],
-                          const device packed_float3* normals [[ buffer(3) ]] )
+                          const device packed_float3* normals [[ buffer(3) ]],
+                          const device InstanceData* instances [[ buffer(5) ]] )
 {
     ColorInOut out;
 
-    out.position = uniforms.localToClip * float4( positions[ vid ], 1 );
-    out.positionVS = (uniforms.localToView * float4( positions[ vid ], 1 )).xyz;
-    out.normalVS = (uniforms.localToView * float4( normals[ vid ], 0 )).xyz;
+    const float3 position = InstanceTransformPoint( instances[ iid ], float3( positions[ vid ] ) );
+    out.position = LocalToClip( uniforms, position );
+    out.positionVS = AffineTransformPoint( uniforms.localToView, position );
+    out.normalVS = AffineTransformVector( uniforms.localToView, InstanceTransformVector( instances[ iid ], float3( normals[ vid ] ) ) );
     out.uv = float2( uvs[ vid ] );
     
     return out;
@@ -137,7 +137,7 @@ kernel void cullLights(texture2d<float, access::read> depthNormalsTexture [[text
         {
             float4 center = pointLightBufferCenterAndRadius[ il ];
             float radius = center.w;
-            center.xyz = (uniforms.localToView * float4( center.xyz, 1.0f ) ).xyz;
+            center.xyz = AffineTransformPoint( uniforms.localToView, center.xyz );
 
 #if USE_MINMAX_Z
             if (-center.z + minZ < radius && center.z - maxZ < radius)
@@ -171,7 +171,7 @@ kernel void cullLights(texture2d<float, access::read> depthNormalsTexture [[text
         {
             float4 center = spotLightBufferCenterAndRadius[ il ];
             float radius = center.w;
-            center.xyz = (uniforms.localToView * float4( center.xyz, 1.0f ) ).xyz;
+            center.xyz = AffineTransformPoint( uniforms.localToView, center.xyz );
 
 #if USE_MINMAX_Z
             if (-center.z + minZ < radius && center.z - maxZ < radius)
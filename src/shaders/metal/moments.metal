@@ -12,14 +12,17 @@ struct ColorInOut
 };
 
 vertex ColorInOut momentsVS( uint vid [[ vertex_id ]],
+                             uint iid [[ instance_id ]],
                              constant Uniforms & uniforms [[ buffer(0) ]],
                              const device packed_float3* positions [[ buffer(1) ]],
-                             const device packed_float2* uvs [[ buffer(2) ]])
+                             const device packed_float2* uvs [[ buffer(2) ]],
+                             const device InstanceData* instances [[ buffer(5) ]])
 {
     ColorInOut out;
 
-    out.position = uniforms.localToClip * float4( positions[ vid ], 1 );
-    out.posVS = uniforms.localToView * float4( positions[ vid ], 1 );
+    const float3 position = InstanceTransformPoint( instances[ iid ], float3( positions[ vid ] ) );
+    out.position = LocalToClip( uniforms, position );
+    out.posVS = float4( AffineTransformPoint( uniforms.localToView, position ), 1 );
     out.uv = float2( uvs[ vid ] );
     
     return out;
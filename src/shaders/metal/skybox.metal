@@ -17,7 +17,7 @@ vertex ColorInOut skyboxVS( uint vid [[ vertex_id ]],
 {
     ColorInOut out;
 
-    out.position = uniforms.localToClip * float4( positions[ vid ], 1 );
+    out.position = LocalToClip( uniforms, float3( positions[ vid ] ) );
     out.uv = float3( positions[ vid ] );
     
     return out;
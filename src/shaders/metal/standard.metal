@@ -17,6 +17,7 @@ struct ColorInOut
     float3 positionWS;
     float3 tangentVS;
     float3 bitangentVS;
+    float4 tint;
 };
 
 uint GetTileIndex( float2 screenPos, float2 screenDim )
@@ -27,6 +28,18 @@ uint GetTileIndex( float2 screenPos, float2 screenDim )
     return tileIdx;
 }
 
+// Start of the pixel's list in lights assigned to clusters on the CPU, see LightClusters in light.cpp.
+// Cluster rows go down from the top of the screen in Vulkan's clip space, which is upside down here.
+uint GetClusterListStart( float2 screenPos, float viewDepth, constant Uniforms& uniforms, const device uint* lightIndexBuf )
+{
+    const uint tileRes = (uint)uniforms.clusterParams.x;
+    const uint tilesX = ((uint)uniforms.tilesXY.x + tileRes - 1) / tileRes;
+    const uint tilesY = ((uint)uniforms.tilesXY.y + tileRes - 1) / tileRes;
+    const float slice = clamp( floor( log( max( viewDepth, 1e-6f ) ) * uniforms.clusterParams.y + uniforms.clusterParams.z ), 0.0f, uniforms.clusterParams.w - 1 );
+    const uint clusterIndex = (uint)(screenPos.x / tileRes) + (uint)((uniforms.tilesXY.y - screenPos.y) / tileRes) * tilesX + (uint)slice * tilesX * tilesY;
+    return lightIndexBuf[ clusterIndex ];
+}
+
 float linstep( float low, float high, float v )
 {
     return saturate( (v - low) / (high - low) );
@@ -54,23 +67,30 @@ float VSM( float depth, float4 projCoord, texture2d<float, access::sample> shado
 }
 
 vertex ColorInOut standardVS( uint vid [[ vertex_id ]],
+                              uint iid [[ instance_id ]],
                               constant Uniforms & uniforms [[ buffer(0) ]],
                               const device packed_float3* positions [[ buffer(1) ]],
                               const device packed_float2* uvs [[ buffer(2) ]],
                               const device packed_float3* normals [[ buffer(3) ]],
-                              const device packed_float4* tangents [[ buffer(4) ]])
+                              const device packed_float4* tangents [[ buffer(4) ]],
+                              const device InstanceData* instances [[ buffer(5) ]])
 {
     ColorInOut out;
 
-    out.position = uniforms.localToClip * float4( positions[ vid ], 1 );
+    const float3 position = InstanceTransformPoint( instances[ iid ], float3( positions[ vid ] ) );
+    const float3 normal = InstanceTransformVector( instances[ iid ], float3( normals[ vid ] ) );
+    const float3 tangent = InstanceTransformVector( instances[ iid ], tangents[ vid ].xyz );
+
+    out.position = LocalToClip( uniforms, position );
     out.uv = float2( uvs[ vid ] );
-    out.normalVS = (uniforms.localToView * float4( normals[ vid ], 0 )).xyz;
-    out.projCoord = uniforms.localToShadowClip * float4( positions[ vid ], 1 );
-    out.positionVS = (uniforms.localToView * float4( positions[ vid ], 1 )).xyz;
-    out.positionWS = (uniforms.localToWorld * float4( positions[ vid ], 1 )).xyz;
-    out.tangentVS = (uniforms.localToView * float4( tangents[ vid ].xyz, 0 )).xyz;
-    float3 ct = cross( normals[ vid ], tangents[ vid ].xyz ) * tangents[ vid ].w;
-    out.bitangentVS = (uniforms.localToView * float4( ct, 0 ) ).xyz;
+    out.normalVS = AffineTransformVector( uniforms.localToView, normal );
+    out.projCoord = LocalToShadowClip( uniforms, position );
+    out.positionVS = AffineTransformPoint( uniforms.localToView, position );
+    out.positionWS = AffineTransformPoint( uniforms.localToWorld, position );
+    out.tangentVS = AffineTransformVector( uniforms.localToView, tangent );
+    float3 ct = cross( normal, tangent ) * tangents[ vid ].w;
+    out.bitangentVS = AffineTransformVector( uniforms.localToView, ct );
+    out.tint = instances[ iid ].tint;
 
     return out;
 }
@@ -140,7 +160,7 @@ fragment float4 standardPS( ColorInOut in [[stage_in]], texture2d<float, access:
     
     float3 ambient = float3( 0.2, 0.2, 0.2 );
     float3 accumDiffuseAndSpecular = uniforms.lightColor.rgb;
-    const float3 surfaceToLightVS = -( uniforms.localToView * uniforms.lightDir ).xyz;
+    const float3 surfaceToLightVS = -AffineTransformVector( uniforms.localToView, uniforms.lightDir.xyz );
     float dotNL = saturate( dot( normalVS, surfaceToLightVS ) );
     const float dotNV = abs( dot( N, V ) ) + 1e-5f;
     
@@ -153,8 +173,7 @@ fragment float4 standardPS( ColorInOut in [[stage_in]], texture2d<float, access:
 
     float4 albedo = textureMap.sample( sampler0, in.uv );
 
-    const uint tileIndex = GetTileIndex( in.position.xy, uniforms.tilesXY.xy );
-    uint index = uniforms.maxLightsPerTile * tileIndex;
+    uint index = uniforms.clusterParams.w > 0 ? GetClusterListStart( in.position.xy, -in.positionVS.z, uniforms, lightIndexBuf ) : uniforms.maxLightsPerTile * GetTileIndex( in.position.xy, uniforms.tilesXY.xy );
     uint nextLightIndex = lightIndexBuf[ index ];
 
     // Point lights
@@ -173,7 +192,7 @@ fragment float4 standardPS( ColorInOut in [[stage_in]], texture2d<float, access:
         
         if (lightDistance < radius)
         {
-            const float3 vecToLightVS = (uniforms.localToView * float4( vecToLightWS, 0 )).xyz;
+            const float3 vecToLightVS = AffineTransformVector( uniforms.localToView, vecToLightWS );
             const float3 L = normalize( -vecToLightVS );
             const float3 H = normalize( L + V );
             
@@ -200,5 +219,5 @@ fragment float4 standardPS( ColorInOut in [[stage_in]], texture2d<float, access:
     }
 
     accumDiffuseAndSpecular = max( ambient, accumDiffuseAndSpecular );
-    return albedo * float4( saturate( accumDiffuseAndSpecular ) * shadow, 1 );
+    return albedo * float4( saturate( accumDiffuseAndSpecular ) * shadow, 1 ) * in.tint;
 }
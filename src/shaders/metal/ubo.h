@@ -1,11 +1,18 @@
 #include <simd/simd.h>
 
+// Rows of an affine transform, see Affine3x4 in the engine.
+struct Affine3x4
+{
+    float4 rows[ 3 ];
+};
+
+// Object transforms are affine, so they are 3x4. Use LocalToClip() and LocalToShadowClip() for clip space positions.
 struct Uniforms
 {
-    matrix_float4x4 localToClip;
-    matrix_float4x4 localToView;
-    matrix_float4x4 localToShadowClip;
-    matrix_float4x4 localToWorld;
+    Affine3x4 localToView;
+    Affine3x4 localToWorld;
+    matrix_float4x4 viewToClip;
+    matrix_float4x4 worldToShadowClip;
     matrix_float4x4 clipToView;
     float4 bloomParams;
     float4 tilesXY;
@@ -13,7 +20,47 @@ struct Uniforms
     float4 lightDir;
     float4 lightColor;
     float4 lightPosition;
+    float4 clusterParams; // x: tile size in pixels, y and z: depth slice scale and bias, w: slice count, 0 if lights are in tile lists.
     uint pointLightCount;
     uint spotLightCount;
     uint maxLightsPerTile;
 };
+
+inline float3 AffineTransformPoint( Affine3x4 affine, float3 pos )
+{
+    const float4 pos4 = float4( pos, 1 );
+    return float3( metal::dot( affine.rows[ 0 ], pos4 ), metal::dot( affine.rows[ 1 ], pos4 ), metal::dot( affine.rows[ 2 ], pos4 ) );
+}
+
+inline float3 AffineTransformVector( Affine3x4 affine, float3 dir )
+{
+    return float3( metal::dot( affine.rows[ 0 ].xyz, dir ), metal::dot( affine.rows[ 1 ].xyz, dir ), metal::dot( affine.rows[ 2 ].xyz, dir ) );
+}
+
+inline float4 LocalToClip( constant Uniforms& uniforms, float3 pos )
+{
+    return uniforms.viewToClip * float4( AffineTransformPoint( uniforms.localToView, pos ), 1 );
+}
+
+inline float4 LocalToShadowClip( constant Uniforms& uniforms, float3 pos )
+{
+    return uniforms.worldToShadowClip * float4( AffineTransformPoint( uniforms.localToWorld, pos ), 1 );
+}
+
+// Instance-to-world affine rows and tint. Non-instanced draws have one identity instance with white tint,
+// so vertex shaders can always apply the instance before localToView etc.
+struct InstanceData
+{
+    Affine3x4 localToWorld;
+    float4 tint;
+};
+
+inline float3 InstanceTransformPoint( InstanceData instance, float3 pos )
+{
+    return AffineTransformPoint( instance.localToWorld, pos );
+}
+
+inline float3 InstanceTransformVector( InstanceData instance, float3 dir )
+{
+    return AffineTransformVector( instance.localToWorld, dir );
+}
@@ -22,7 +22,7 @@ vertex ColorInOut uiVS( ImDrawVert in [[stage_in]], constant Uniforms& uniforms
 {
     ColorInOut out;
 
-    out.position = uniforms.localToClip * float4( in.pos, 0, 1 );
+    out.position = uniforms.viewToClip * float4( in.pos, 0, 1 );
     out.uv = in.uv;
     out.color = float4( in.col ) / float4( 255.0f );
 
@@ -8,17 +8,21 @@ struct ColorInOut
 {
     float4 position [[position]];
     float2 uv;
+    float4 tint;
 };
 
 vertex ColorInOut unlitVS( uint vid [[ vertex_id ]],
+                           uint iid [[ instance_id ]],
                           constant Uniforms & uniforms [[ buffer(0) ]],
                            const device packed_float3* positions [[ buffer(1) ]],
-                           const device packed_float2* uvs [[ buffer(2) ]])
+                           const device packed_float2* uvs [[ buffer(2) ]],
+                           const device InstanceData* instances [[ buffer(5) ]])
 {
     ColorInOut out;
 
-    out.position = uniforms.localToClip * float4( positions[ vid ], 1 );
+    out.position = LocalToClip( uniforms, InstanceTransformPoint( instances[ iid ], float3( positions[ vid ] ) ) );
     out.uv = float2( uvs[ vid ] );
+    out.tint = instances[ iid ].tint;
     
     return out;
 }
@@ -28,5 +32,5 @@ fragment float4 unlitPS( ColorInOut in [[stage_in]], texture2d<float, access::sa
 {
     constexpr sampler sampler0( coord::normalized, address::repeat, filter::nearest );
     //return float4( 1, 0, 0, 1 );
-    return textureMap.sample( sampler0, in.uv ) * uniforms.tint;
+    return textureMap.sample( sampler0, in.uv ) * uniforms.tint * in.tint;
 }
@@ -0,0 +1,761 @@
+// Theseus engine headless CPU benchmark. Times scene update, culling, scene membership, .tscene parsing and lights
+// with synthetic scenes and reports nanoseconds per object. Needs no window or GPU: the engine's platform
+// independent sources are compiled into this file and the renderer backend is replaced by no-ops.
+// Usage: bench [results.json]
+void UpdateUBO( const struct Affine3x4& localToView, const struct Matrix& viewToClip, const Affine3x4& localToWorld, const Matrix& worldToShadowClip, const struct ShaderParams& shaderParams, const struct Vec4& lightDirection, const Vec4& lightColor, const Vec4& lightPosition );
+
+#include "core/te_stdlib.cpp"
+#include "core/audio_common.cpp"
+#include "core/camera.cpp"
+#include "core/engine.cpp"
+#include "core/file.cpp"
+#include "core/frustum.cpp"
+#include "core/gameobject.cpp"
+#include "core/math.cpp"
+#include "core/math_batch.cpp"
+#include "core/occlusion.cpp"
+#include "core/profiler.cpp"
+#include "core/scene.cpp"
+#include "core/streaming.cpp"
+#include "core/transform.cpp"
+#include "core/world.cpp"
+#include "video/light.cpp"
+#include "video/material.cpp"
+#include "video/mesh.cpp"
+#include "video/stats.cpp"
+#include "video/textureloader.cpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Renderer and audio backend. Nothing is uploaded or drawn, so only the CPU side of the engine is measured.
+unsigned AddPositions( const float*, unsigned ) { return 0; }
+unsigned AddNormals( const float*, unsigned ) { return 0; }
+unsigned AddTangents( const float*, unsigned ) { return 0; }
+unsigned AddIndices( const unsigned short*, unsigned ) { return 0; }
+unsigned AddUVs( const float*, unsigned ) { return 0; }
+void ReadIndices( unsigned, unsigned, unsigned short* ) {}
+void ReadUVs( unsigned, unsigned, float* ) {}
+void ReadPositions( unsigned, unsigned, float* ) {}
+void ReadNormals( unsigned, unsigned, float* ) {}
+void ReadTangents( unsigned, unsigned, float* ) {}
+teBuffer CreateBuffer( unsigned, const char* ) { return teBuffer(); }
+teBuffer CreateStagingBuffer( unsigned, const char* ) { return teBuffer(); }
+void CopyBuffer( const teBuffer&, const teBuffer& ) {}
+void UpdateStagingBuffer( const teBuffer&, const void*, unsigned, unsigned ) {}
+static unsigned benchUploadBytes = 0;
+bool UploadBufferRanges( const teBuffer&, const void*, const BufferRange* ranges, unsigned rangeCount )
+{
+    for (unsigned i = 0; i < rangeCount; ++i)
+    {
+        benchUploadBytes += ranges[ i ].sizeBytes;
+    }
+
+    return true;
+}
+void UpdateUBO( const Affine3x4&, const Matrix&, const Affine3x4&, const Matrix&, const ShaderParams&, const Vec4&, const Vec4&, const Vec4& ) {}
+void UpdateInstances( const Matrix*, const Vec4*, unsigned ) {}
+void Draw( const teShader&, unsigned, unsigned, unsigned, unsigned, unsigned, unsigned, teBlendMode, teCullMode, teDepthMode, teTopology, teFillMode, unsigned, teTextureSampler, unsigned, unsigned, unsigned, unsigned ) {}
+void DrawLines() {}
+void BeginRendering( teTexture2D&, teTexture2D&, teClearFlag, const float* ) {}
+void EndRendering( teTexture2D&, teTexture2D& ) {}
+void PushGroupMarker( const char* ) {}
+void PopGroupMarker() {}
+void RendererGetSize( unsigned& outWidth, unsigned& outHeight ) { outWidth = 1920; outHeight = 1080; }
+void ShaderInitStorage( unsigned ) {}
+void teShaderDispatch( const teShader&, unsigned, unsigned, unsigned, const ShaderParams&, const char* ) {}
+void teFinalizeMeshBuffers() {}
+void QueueMeshBufferUploads() {}
+teTexture2D teCreateTexture2D( unsigned, unsigned, unsigned, teTextureFormat, const char* ) { return teTexture2D(); }
+teTexture2D teLoadTexture( const teFile&, unsigned, void*, int, int, teTextureFormat ) { return teTexture2D(); }
+teTexture2D CreateTextureFromDDS( const teFile&, unsigned, const DDSData& ) { return teTexture2D(); }
+void AudioBackendInitStorage( unsigned ) {}
+void LoadAudioWAV( const char*, unsigned ) {}
+void PlayAudioClip( unsigned ) {}
+
+void ResetFrameAllocator();
+
+static constexpr unsigned SceneSizes[] = { 1000, 10000, 100000 };
+static constexpr unsigned MaxObjects = 100000;
+static constexpr unsigned MeshCount = 64;
+static constexpr unsigned ObjectsPerSample = 2000000; // Iterations are chosen so each size does about this much work.
+static constexpr unsigned MaxSamples = 2000;
+static constexpr unsigned MaxResults = 32;
+static constexpr float WorldExtent = 200;
+static constexpr unsigned PointLightCount = 1024;
+static constexpr unsigned SpotLightCount = 256;
+static constexpr unsigned LightIterations = 200;
+
+struct BenchResult
+{
+    const char* name;
+    unsigned objectCount;
+    unsigned sampleCount;
+    double minNs;
+    double medianNs;
+    double p99Ns;
+};
+
+struct Bench
+{
+    teScene scene;
+    teScene membershipScene;
+    unsigned cameraIndex = 0;
+    teGameObject pointLights[ PointLightCount ];
+    unsigned spotLights[ SpotLightCount ];
+    teMesh meshes[ MeshCount ];
+    teGameObject* objects = nullptr;
+    unsigned* shuffledIndices = nullptr;
+    Vec3* aabbMins = nullptr;
+    Vec3* aabbMaxs = nullptr;
+    double samples[ MaxSamples ];
+    unsigned sampleCount = 0;
+    BenchResult results[ MaxResults ];
+    unsigned resultCount = 0;
+    std::chrono::steady_clock::time_point sampleStart;
+    unsigned randomState = 12345;
+};
+
+static Bench bench;
+
+// Same sequence on every platform, unlike <random> distributions.
+static float Random01()
+{
+    bench.randomState = bench.randomState * 1664525u + 1013904223u;
+    return (bench.randomState >> 8) / 16777216.0f;
+}
+
+static float RandomRange( float min, float max )
+{
+    return min + (max - min) * Random01();
+}
+
+static Vec3 RandomVec3( float min, float max )
+{
+    return Vec3( RandomRange( min, max ), RandomRange( min, max ), RandomRange( min, max ) );
+}
+
+static void BeginSample()
+{
+    bench.sampleStart = std::chrono::steady_clock::now();
+}
+
+static void EndSample()
+{
+    teAssert( bench.sampleCount < MaxSamples );
+    bench.samples[ bench.sampleCount++ ] = (double)std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - bench.sampleStart ).count();
+}
+
+static int CompareDoubles( const void* a, const void* b )
+{
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+// Converts the samples to ns/object and starts a new benchmark.
+static void AddResult( const char* name, unsigned objectCount )
+{
+    teAssert( bench.resultCount < MaxResults && bench.sampleCount > 0 );
+
+    qsort( bench.samples, bench.sampleCount, sizeof( double ), CompareDoubles );
+
+    const unsigned p99Index = (unsigned)ceil( bench.sampleCount * 0.99 ) - 1;
+
+    BenchResult& result = bench.results[ bench.resultCount++ ];
+    result.name = name;
+    result.objectCount = objectCount;
+    result.sampleCount = bench.sampleCount;
+    result.minNs = bench.samples[ 0 ] / objectCount;
+    result.medianNs = bench.samples[ bench.sampleCount / 2 ] / objectCount;
+    result.p99Ns = bench.samples[ p99Index ] / objectCount;
+
+    printf( "%-24s %7u objects %5u samples   min %9.2f   median %9.2f   p99 %9.2f ns/object\n",
+            name, objectCount, bench.sampleCount, result.minNs, result.medianNs, result.p99Ns );
+
+    bench.sampleCount = 0;
+}
+
+static void CreateMeshes()
+{
+    for (unsigned m = 0; m < MeshCount; ++m)
+    {
+        bench.meshes[ m ] = teCreateCubeMesh();
+
+        const Vec3 center = RandomVec3( -1, 1 );
+        const Vec3 halfSize = RandomVec3( 0.25f, 4 );
+        meshes[ bench.meshes[ m ].index ].subMeshes[ 0 ].aabbMin = center - halfSize;
+        meshes[ bench.meshes[ m ].index ].subMeshes[ 0 ].aabbMax = center + halfSize;
+    }
+}
+
+static void CreateCamera()
+{
+    bench.cameraIndex = teCreateGameObject( "camera", teComponent::Transform | teComponent::Camera ).index;
+    teCameraSetProjection( bench.cameraIndex, 45, 1920 / 1080.0f, 0.1f, WorldExtent * 2 );
+    teTransformSetLocalPosition( bench.cameraIndex, Vec3( 0, 0, WorldExtent ) );
+
+    TransformSolveLocalMatrix( bench.cameraIndex, true );
+    UpdateFrustum( (int)bench.cameraIndex, teTransformGetLocalPosition( bench.cameraIndex ), teTransformGetViewDirection( bench.cameraIndex ) );
+}
+
+static void CreateObjects( unsigned objectCount )
+{
+    for (unsigned i = 0; i < objectCount; ++i)
+    {
+        bench.objects[ i ] = teCreateGameObject( "object", teComponent::Transform | teComponent::MeshRenderer );
+        const unsigned index = bench.objects[ i ].index;
+
+        Quaternion rotation;
+        rotation.FromAxisAngle( RandomVec3( -1, 1 ).Normalized(), RandomRange( 0, 360 ) );
+
+        teTransformSetLocalPosition( index, RandomVec3( -WorldExtent, WorldExtent ) );
+        teTransformSetLocalRotation( index, rotation );
+        teTransformSetLocalScale( index, RandomRange( 0.5f, 2 ) );
+        teMeshRendererSetMesh( index, &bench.meshes[ (unsigned)(Random01() * MeshCount) % MeshCount ] );
+        teSceneAdd( bench.scene, index );
+
+        bench.aabbMins[ i ] = RandomVec3( -WorldExtent, WorldExtent );
+        bench.aabbMaxs[ i ] = bench.aabbMins[ i ] + RandomVec3( 0.5f, 8 );
+        bench.shuffledIndices[ i ] = index;
+    }
+
+    for (unsigned i = objectCount - 1; i > 0; --i)
+    {
+        const unsigned j = (unsigned)(Random01() * (i + 1)) % (i + 1);
+        const unsigned tmp = bench.shuffledIndices[ i ];
+        bench.shuffledIndices[ i ] = bench.shuffledIndices[ j ];
+        bench.shuffledIndices[ j ] = tmp;
+    }
+}
+
+static void DestroyObjects( unsigned objectCount )
+{
+    for (unsigned i = 0; i < objectCount; ++i)
+    {
+        teDestroyGameObject( bench.objects[ i ] );
+    }
+}
+
+static void BenchUpdateAndCull( unsigned objectCount, unsigned iterations )
+{
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        BeginSample();
+        SolveSceneTransforms( bench.scene );
+        UpdateTransformsAndCull( bench.scene, bench.cameraIndex );
+        EndSample();
+        ResetFrameAllocator();
+    }
+
+    AddResult( "UpdateTransformsAndCull", objectCount );
+}
+
+static void BenchSceneAddRemove( unsigned objectCount, unsigned iterations )
+{
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        BeginSample();
+
+        for (unsigned o = 0; o < objectCount; ++o)
+        {
+            teSceneAdd( bench.membershipScene, bench.objects[ o ].index );
+        }
+
+        EndSample();
+
+        for (unsigned o = 0; o < objectCount; ++o)
+        {
+            teSceneRemove( bench.membershipScene, bench.shuffledIndices[ o ] );
+        }
+    }
+
+    AddResult( "teSceneAdd", objectCount );
+
+    // Removal is in random order, so the moved last objects are scattered like in a game.
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        for (unsigned o = 0; o < objectCount; ++o)
+        {
+            teSceneAdd( bench.membershipScene, bench.objects[ o ].index );
+        }
+
+        BeginSample();
+
+        for (unsigned o = 0; o < objectCount; ++o)
+        {
+            teSceneRemove( bench.membershipScene, bench.shuffledIndices[ o ] );
+        }
+
+        EndSample();
+    }
+
+    AddResult( "teSceneRemove", objectCount );
+}
+
+static void BenchFrustum( unsigned objectCount, unsigned iterations )
+{
+    unsigned visibleCount = 0;
+
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        BeginSample();
+
+        for (unsigned o = 0; o < objectCount; ++o)
+        {
+            visibleCount += BoxInFrustum( (int)bench.cameraIndex, bench.aabbMins[ o ], bench.aabbMaxs[ o ] ) ? 1 : 0;
+        }
+
+        EndSample();
+    }
+
+    // Keeps the tests from being optimized away.
+    teAssert( visibleCount <= objectCount * iterations );
+    AddResult( "BoxInFrustum", objectCount );
+
+    bool* isInFrustum = teMallocArray< bool >( objectCount, teMemoryTag::Other );
+
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        BeginSample();
+        BoxesInFrustum( (int)bench.cameraIndex, bench.aabbMins, bench.aabbMaxs, objectCount, isInFrustum );
+        EndSample();
+    }
+
+    teFree( isInFrustum );
+    AddResult( "BoxesInFrustum", objectCount );
+}
+
+static void CreatePointLight( unsigned lightIndex )
+{
+    bench.pointLights[ lightIndex ] = teCreateGameObject( "point light", teComponent::Transform | teComponent::PointLight );
+    tePointLightSetParams( bench.pointLights[ lightIndex ].index, RandomRange( 1, 20 ), Vec3( 1, 1, 1 ), 1 );
+    SetPointLightPosition( bench.pointLights[ lightIndex ].index, RandomVec3( -WorldExtent, WorldExtent ) );
+}
+
+// Lights are created once and shared by the light benchmarks.
+static void CreateLights()
+{
+    InitLightTiler( 1920, 1080 );
+    teLightSetCpuClustering( true );
+
+    for (unsigned i = 0; i < PointLightCount; ++i)
+    {
+        CreatePointLight( i );
+    }
+
+    for (unsigned i = 0; i < SpotLightCount; ++i)
+    {
+        const unsigned index = teCreateGameObject( "spot light", teComponent::Transform | teComponent::SpotLight ).index;
+        bench.spotLights[ i ] = index;
+        Vec3 position = RandomVec3( -WorldExtent, WorldExtent );
+        teSpotLightSetParams( index, position, Vec3( 1, 1, 1 ), RandomRange( 10, 60 ), RandomVec3( -1, 1 ).Normalized(), RandomRange( 5, 40 ) );
+    }
+}
+
+// Tests every light against every cluster one at a time with scalar math, to check AssignLightsToClusters' SIMD tests,
+// per-slice light lists and list layout. Clusters must be in the light's screen and depth range, like in AssignLightsToClusters.
+// @return Number of clusters whose lists differ.
+static unsigned CheckLightClusters( const Matrix& worldToView, const Matrix& viewToClip )
+{
+    const LightClusters& clusters = gLightClusters;
+    ClusterLight* lights = teMallocArray< ClusterLight >( PointLightCount + SpotLightCount, teMemoryTag::Other );
+    bool* isVisible = teMallocArray< bool >( PointLightCount + SpotLightCount, teMemoryTag::Other );
+
+    for (unsigned i = 0; i < PointLightCount + SpotLightCount; ++i)
+    {
+        const bool isSpot = i >= PointLightCount;
+        const unsigned tilerIndex = isSpot ? i - PointLightCount : i;
+        isVisible[ i ] = GetClusterLight( isSpot ? gLightTiler.spotLightCenterAndRadius[ tilerIndex ] : gLightTiler.pointLightCenterAndRadius[ tilerIndex ], worldToView, viewToClip, tilerIndex, lights[ i ] );
+
+        if (isSpot)
+        {
+            const Vec4& params = gLightTiler.spotLightParams[ tilerIndex ];
+            Matrix::TransformDirection( Vec3( params.x, params.y, params.z ), worldToView, &lights[ i ].direction );
+            lights[ i ].direction = lights[ i ].direction.Normalized();
+            lights[ i ].cosAngle = params.w;
+            lights[ i ].sinAngle = sqrtf( fmaxf( 1 - params.w * params.w, 0 ) );
+        }
+    }
+
+    unsigned mismatchCount = 0;
+
+    for (unsigned slice = 0; slice < LightClusters::SliceCount; ++slice)
+    {
+        for (unsigned y = 0; y < clusters.tilesY; ++y)
+        {
+            for (unsigned x = 0; x < clusters.tilesX; ++x)
+            {
+                const float minX = clusters.minX[ slice * clusters.tilesXPadded + x ];
+                const float maxX = clusters.maxX[ slice * clusters.tilesXPadded + x ];
+                const float minY = clusters.minY[ slice * clusters.tilesY + y ];
+                const float maxY = clusters.maxY[ slice * clusters.tilesY + y ];
+                const float minZ = -clusters.sliceFar[ slice ];
+                const float maxZ = -clusters.sliceNear[ slice ];
+                const float extentY = (maxY - minY) * 0.5f;
+                const float extentZ = (maxZ - minZ) * 0.5f;
+
+                const unsigned clusterIndex = x + y * clusters.tilesX + slice * clusters.tilesX * clusters.tilesY;
+                unsigned cursor = clusters.data[ clusterIndex ];
+                bool isSame = true;
+
+                for (unsigned i = 0; i < PointLightCount + SpotLightCount; ++i)
+                {
+                    const ClusterLight& light = lights[ i ];
+
+                    if (i == PointLightCount)
+                    {
+                        // Point lights' sentinel.
+                        isSame = isSame && clusters.data[ cursor++ ] == LightClusters::Sentinel;
+                    }
+
+                    const float dx = fmaxf( fmaxf( minX - light.center.x, light.center.x - maxX ), 0 );
+                    const float dy = fmaxf( fmaxf( minY - light.center.y, light.center.y - maxY ), 0 );
+                    const float dz = fmaxf( fmaxf( minZ - light.center.z, light.center.z - maxZ ), 0 );
+                    const bool isInRange = isVisible[ i ] && x >= light.tileX0 && x <= light.tileX1 && y >= light.tileY0 && y <= light.tileY1 &&
+                                           slice >= light.slice0 && slice <= light.slice1;
+                    bool isInCluster = isInRange && dx * dx + (dy * dy + dz * dz) <= light.radius * light.radius;
+
+                    if (isInCluster && i >= PointLightCount)
+                    {
+                        const float toCenterX = (minX + maxX) * 0.5f - light.center.x;
+                        const float toCenterY = (minY + maxY) * 0.5f - light.center.y;
+                        const float toCenterZ = (minZ + maxZ) * 0.5f - light.center.z;
+                        const float extentX = (maxX - minX) * 0.5f;
+                        const float sphereRadius = sqrtf( extentX * extentX + (extentY * extentY + extentZ * extentZ) );
+                        const float toCenterSq = toCenterX * toCenterX + (toCenterY * toCenterY + toCenterZ * toCenterZ);
+                        const float along = toCenterX * light.direction.x + (toCenterY * light.direction.y + toCenterZ * light.direction.z);
+                        const float distance = light.cosAngle * sqrtf( fmaxf( toCenterSq - along * along, 0 ) ) - along * light.sinAngle;
+                        isInCluster = distance <= sphereRadius && along <= sphereRadius + light.radius && along >= -sphereRadius;
+                    }
+
+                    if (isInCluster)
+                    {
+                        isSame = isSame && clusters.data[ cursor++ ] == light.index;
+                    }
+                }
+
+                isSame = isSame && clusters.data[ cursor ] == LightClusters::Sentinel;
+                mismatchCount += isSame ? 0 : 1;
+            }
+        }
+    }
+
+    teFree( lights );
+    teFree( isVisible );
+
+    return mismatchCount;
+}
+
+static void BenchLightClusters()
+{
+    const Matrix worldToView = teTransformGetMatrix( bench.cameraIndex );
+    const Matrix viewToClip = teCameraGetProjection( bench.cameraIndex );
+    unsigned dataCount = 0;
+
+    for (unsigned i = 0; i < LightIterations; ++i)
+    {
+        BeginSample();
+        dataCount = AssignLightsToClusters( worldToView, viewToClip );
+        EndSample();
+        ResetFrameAllocator();
+    }
+
+    AddResult( "AssignLightsToClusters", PointLightCount + SpotLightCount );
+
+    const unsigned clusterCount = gLightClusters.tilesX * gLightClusters.tilesY * LightClusters::SliceCount;
+    printf( "Light clusters: %u clusters, %.1f lights per cluster\n", clusterCount, (dataCount - 3 * clusterCount) / (float)clusterCount );
+}
+
+// Times finding and uploading changed lights when no light has changed and when every 8th point light has moved,
+// and prints the bytes uploaded per frame.
+static void BenchLightUploads()
+{
+    benchUploadBytes = 0;
+    UploadLights();
+    const unsigned firstFrameBytes = benchUploadBytes;
+
+    for (unsigned i = 0; i < LightIterations; ++i)
+    {
+        benchUploadBytes = 0;
+        BeginSample();
+        UploadLights();
+        EndSample();
+        ResetFrameAllocator();
+    }
+
+    AddResult( "UploadLights unchanged", PointLightCount + SpotLightCount );
+    const unsigned unchangedBytes = benchUploadBytes;
+
+    for (unsigned i = 0; i < LightIterations; ++i)
+    {
+        for (unsigned lightIndex = i % 8; lightIndex < PointLightCount; lightIndex += 8)
+        {
+            SetPointLightPosition( bench.pointLights[ lightIndex ].index, RandomVec3( -WorldExtent, WorldExtent ) );
+        }
+
+        benchUploadBytes = 0;
+        BeginSample();
+        UploadLights();
+        EndSample();
+        ResetFrameAllocator();
+    }
+
+    AddResult( "UploadLights 1/8 moved", PointLightCount + SpotLightCount );
+
+    printf( "Light uploads: %u bytes in the first frame, %u bytes unchanged, %u bytes with 1/8 of point lights moved\n",
+            firstFrameBytes, unchangedBytes, benchUploadBytes );
+}
+
+// Every slot must belong to a light that has that slot, and all lights must have one.
+// @return Number of wrong slots and counts.
+static unsigned CheckLightSlots()
+{
+    unsigned errorCount = (GetPointLightCount() != PointLightCount ? 1 : 0) + (GetSpotLightCount() != SpotLightCount ? 1 : 0);
+
+    for (unsigned i = 0; i < GetPointLightCount(); ++i)
+    {
+        errorCount += pointLights[ gLightTiler.pointLightGameObjects[ i ] ].tilerIndex != i ? 1 : 0;
+    }
+
+    for (unsigned i = 0; i < GetSpotLightCount(); ++i)
+    {
+        errorCount += spotLights[ gLightTiler.spotLightGameObjects[ i ] ].tilerIndex != i ? 1 : 0;
+    }
+
+    return errorCount;
+}
+
+// Rasterizes a wall covering the left half of the view and tests boxes behind, in front of and next to it.
+// SSE3 builds also rasterize random boxes with the SSE3 and scalar rasterizers, which must write the same depth and tile depth.
+// @return Number of failed checks.
+static unsigned CheckOcclusion()
+{
+    // View space is local space, so boxes in front of the camera have negative z.
+    Matrix viewToClip;
+    viewToClip.MakeProjection( 60, 2, 0.1f, 100 );
+
+    OcclusionClear();
+    OcclusionRasterizeBox( Vec3( -20, -20, -11 ), Vec3( 0, 20, -10 ), viewToClip );
+    OcclusionBuildHierarchy();
+
+    unsigned errorCount = 0;
+    errorCount += OcclusionIsBoxVisible( Vec3( -7, -1, -31 ), Vec3( -5, 1, -29 ), viewToClip ) ? 1 : 0; // Behind the wall.
+    errorCount += OcclusionIsBoxVisible( Vec3( -7, -1, -6 ), Vec3( -5, 1, -4 ), viewToClip ) ? 0 : 1; // In front of the wall.
+    errorCount += OcclusionIsBoxVisible( Vec3( 5, -1, -31 ), Vec3( 7, 1, -29 ), viewToClip ) ? 0 : 1; // Behind, but right of the wall.
+    errorCount += OcclusionIsBoxVisible( Vec3( -1, -1, -1 ), Vec3( 1, 1, 1 ), viewToClip ) ? 0 : 1; // Straddles the near plane.
+
+    if (errorCount > 0)
+    {
+        printf( "Occlusion: %u wall checks failed!\n", errorCount );
+    }
+
+#ifdef SIMD_SSE3
+    static float sseDepth[ DepthWidth * DepthHeight ];
+    static float sseTileMaxDepth[ TileCountX * TileCountY ];
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        occlusionForceScalar = pass == 1;
+        OcclusionClear();
+
+        // Same boxes in both passes. Some cross the near plane and the screen edges.
+        for (unsigned i = 0; i < 256; ++i)
+        {
+            const float x = -40 + (float)(i % 16) * 5;
+            const float y = -20 + (float)(i / 16) * 2.5f;
+            const float z = -1 - (float)((i * 7) % 31) * 2;
+            const float size = 0.5f + (float)(i % 5);
+            OcclusionRasterizeBox( Vec3( x, y, z ), Vec3( x + size, y + size * 0.5f, z + size ), viewToClip );
+        }
+
+        OcclusionBuildHierarchy();
+
+        if (pass == 0)
+        {
+            memcpy( sseDepth, occlusion.depth, sizeof( sseDepth ) );
+            memcpy( sseTileMaxDepth, occlusion.tileMaxDepth, sizeof( sseTileMaxDepth ) );
+        }
+    }
+
+    occlusionForceScalar = false;
+
+    unsigned mismatchCount = 0;
+
+    for (unsigned i = 0; i < DepthWidth * DepthHeight; ++i)
+    {
+        mismatchCount += memcmp( &sseDepth[ i ], &occlusion.depth[ i ], sizeof( float ) ) != 0 ? 1 : 0;
+    }
+
+    for (unsigned i = 0; i < TileCountX * TileCountY; ++i)
+    {
+        mismatchCount += memcmp( &sseTileMaxDepth[ i ], &occlusion.tileMaxDepth[ i ], sizeof( float ) ) != 0 ? 1 : 0;
+    }
+
+    if (mismatchCount > 0)
+    {
+        printf( "Occlusion: %u depths differ between the SSE3 and scalar rasterizers!\n", mismatchCount );
+    }
+
+    errorCount += mismatchCount;
+#endif
+
+    OcclusionClear();
+
+    return errorCount;
+}
+
+// Destroys and recreates every 8th point light, like short-lived effect lights, and disables and enables every 8th spot light.
+// Reported per add, remove, enable or disable.
+static void BenchLightSlots()
+{
+    for (unsigned i = 0; i < LightIterations; ++i)
+    {
+        BeginSample();
+
+        for (unsigned lightIndex = i % 8; lightIndex < PointLightCount; lightIndex += 8)
+        {
+            teDestroyGameObject( bench.pointLights[ lightIndex ] );
+            CreatePointLight( lightIndex );
+        }
+
+        for (unsigned lightIndex = i % 8; lightIndex < SpotLightCount; lightIndex += 8)
+        {
+            teSpotLightSetEnabled( bench.spotLights[ lightIndex ], false );
+        }
+
+        for (unsigned lightIndex = i % 8; lightIndex < SpotLightCount; lightIndex += 8)
+        {
+            teSpotLightSetEnabled( bench.spotLights[ lightIndex ], true );
+        }
+
+        EndSample();
+    }
+
+    AddResult( "Light add/remove", (PointLightCount + SpotLightCount) / 8 * 2 );
+}
+
+// Game objects are destroyed after each parse, so this must run after the other benchmarks have destroyed theirs.
+static void BenchReadScene( unsigned objectCount, unsigned iterations )
+{
+    const unsigned lineBytes = 32;
+    teFile sceneFile;
+    sceneFile.data = (unsigned char*)teMalloc( objectCount * lineBytes, teMemoryTag::Other );
+    strcpy( sceneFile.path, "bench.tscene" );
+
+    // Names repeat so the interned name pool doesn't fill up.
+    for (unsigned i = 0; i < objectCount; ++i)
+    {
+        sceneFile.size += (unsigned)snprintf( (char*)sceneFile.data + sceneFile.size, lineBytes, "gameobject object%u\n", i % 256 );
+    }
+
+    teShader standardShader;
+    teTexture2D textures[ 1 ];
+    teMaterial materialArray[ 1 ];
+    teMesh meshArray[ 1 ];
+
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        BeginSample();
+        teSceneReadScene( sceneFile, standardShader, bench.objects, textures, materialArray, meshArray );
+        EndSample();
+
+        DestroyObjects( objectCount );
+    }
+
+    teFree( sceneFile.data );
+    AddResult( "teSceneReadScene text", objectCount );
+}
+
+static void WriteJson( const char* path )
+{
+    FILE* file = fopen( path, "w" );
+
+    if (!file)
+    {
+        printf( "Could not open %s for writing!\n", path );
+        return;
+    }
+
+#if defined( SIMD_SSE3 )
+    const char* simd = "SSE3";
+#elif defined( SIMD_NEON )
+    const char* simd = "NEON";
+#else
+    const char* simd = "none";
+#endif
+
+    fprintf( file, "{\n  \"simd\": \"%s\",\n  \"kernels\": \"%s\",\n  \"unit\": \"ns/object\",\n  \"results\": [\n", simd, MathBatchGetKernelName() );
+
+    for (unsigned r = 0; r < bench.resultCount; ++r)
+    {
+        const BenchResult& result = bench.results[ r ];
+        fprintf( file, "    { \"name\": \"%s\", \"objects\": %u, \"samples\": %u, \"min\": %.3f, \"median\": %.3f, \"p99\": %.3f }%s\n",
+                 result.name, result.objectCount, result.sampleCount, result.minNs, result.medianNs, result.p99Ns, r + 1 < bench.resultCount ? "," : "" );
+    }
+
+    fprintf( file, "  ]\n}\n" );
+    fclose( file );
+
+    printf( "Wrote %s\n", path );
+}
+
+int main( int argc, char* argv[] )
+{
+    teEngineDesc desc;
+    desc.maxGameObjects = MaxObjects + PointLightCount + SpotLightCount + 16; // Camera, index 0 and the shadow caster's scene slot.
+    desc.maxMeshes = MeshCount + 16;
+    teInitEngine( desc );
+
+    bench.scene = teCreateScene( 0 );
+    bench.membershipScene = teCreateScene( 0 );
+    bench.objects = teMallocArray< teGameObject >( MaxObjects, teMemoryTag::Other );
+    bench.shuffledIndices = teMallocArray< unsigned >( MaxObjects, teMemoryTag::Other );
+    bench.aabbMins = teMallocArray< Vec3 >( MaxObjects, teMemoryTag::Other );
+    bench.aabbMaxs = teMallocArray< Vec3 >( MaxObjects, teMemoryTag::Other );
+
+    CreateMeshes();
+    CreateCamera();
+
+    for (unsigned objectCount : SceneSizes)
+    {
+        const unsigned iterations = ObjectsPerSample / objectCount < MaxSamples ? ObjectsPerSample / objectCount : MaxSamples;
+
+        CreateObjects( objectCount );
+        BenchUpdateAndCull( objectCount, iterations );
+        BenchSceneAddRemove( objectCount, iterations );
+        BenchFrustum( objectCount, iterations );
+        DestroyObjects( objectCount );
+        BenchReadScene( objectCount, iterations );
+    }
+
+    CreateLights();
+    BenchLightUploads();
+    BenchLightSlots();
+    BenchLightClusters();
+    const unsigned clusterMismatchCount = CheckLightClusters( teTransformGetMatrix( bench.cameraIndex ), teCameraGetProjection( bench.cameraIndex ) );
+    const unsigned lightSlotErrorCount = CheckLightSlots();
+    const unsigned occlusionErrorCount = CheckOcclusion();
+
+    WriteJson( argc > 1 ? argv[ 1 ] : "bench.json" );
+
+    if (clusterMismatchCount > 0)
+    {
+        printf( "Light clusters: %u clusters differ from testing every light!\n", clusterMismatchCount );
+        return 1;
+    }
+
+    if (lightSlotErrorCount > 0)
+    {
+        printf( "Light slots: %u slots or counts are wrong!\n", lightSlotErrorCount );
+        return 1;
+    }
+
+    if (occlusionErrorCount > 0)
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,780 @@
+// Theseus engine math tests and micro-benchmarks. Checks core/math.cpp's kernels against plain scalar reference
+// implementations and reports their throughput. `make mathbench` builds this with the platform's SIMD path and
+// without it, so both paths are checked against the same references.
+// Batched kernels pick AVX2 at runtime when the CPU has it, so the SIMD build is also run with TE_NO_AVX2 set.
+// Returns 1 if a kernel disagrees with its reference.
+#include "affine3x4.h"
+#include "vec3.h"
+#include "camera.h"
+#include "core/math.cpp"
+#include "core/math_batch.cpp"
+#include <chrono>
+#include <stdio.h>
+
+// ScreenPointToRay reads the camera, which this executable doesn't have.
+float teCameraGetFovDegrees( unsigned ) { return 45; }
+float teCameraGetFar( unsigned ) { return 100; }
+const Vec3& teTransformGetLocalPosition( unsigned ) { static Vec3 position; return position; }
+Matrix teTransformGetMatrix( unsigned ) { return Matrix(); }
+
+static constexpr unsigned InputCount = 1024;
+static constexpr unsigned BenchRepeats = 2000;
+static constexpr unsigned BenchRuns = 5;
+
+struct MathBench
+{
+    Matrix matrices[ InputCount ];
+    Matrix affineMatrices[ InputCount ]; // Rotation, uniform scale and translation, so they can be inverted accurately.
+    Affine3x4 affines[ InputCount ]; // affineMatrices as Affine3x4.
+    Quaternion quaternions[ InputCount ];
+    float scales[ InputCount ];
+    Vec3 points[ InputCount ];
+    Vec4 points4[ InputCount ];
+    Vec3 aabbMins[ InputCount ];
+    Vec3 aabbMaxs[ InputCount ];
+    Vec4 planes[ 6 ]; // Normals point inside, like a frustum's.
+    Matrix batchMatrices[ InputCount ];
+    Affine3x4 batchAffines[ InputCount ];
+    unsigned batchIndices[ InputCount ];
+    Vec3 batchPoints[ InputCount ];
+    bool batchIsInside[ InputCount ];
+    unsigned randomState = 12345;
+    unsigned failureCount = 0;
+    float sink = 0; // Outputs of benchmarked calls are added here, so they aren't optimized away.
+};
+
+static MathBench mb;
+
+static float RandomRange( float min, float max )
+{
+    mb.randomState = mb.randomState * 1664525u + 1013904223u;
+    return min + (max - min) * ((mb.randomState >> 8) / 16777216.0f);
+}
+
+static Vec3 RandomVec3( float min, float max )
+{
+    return Vec3( RandomRange( min, max ), RandomRange( min, max ), RandomRange( min, max ) );
+}
+
+static void CreateInputs()
+{
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        for (unsigned e = 0; e < 16; ++e)
+        {
+            mb.matrices[ i ].m[ e ] = RandomRange( -2, 2 );
+        }
+
+        mb.quaternions[ i ].FromAxisAngle( RandomVec3( -1, 1 ).Normalized(), RandomRange( -360, 360 ) );
+        mb.quaternions[ i ].GetMatrix( mb.affineMatrices[ i ] );
+        mb.scales[ i ] = RandomRange( 0.5f, 2 );
+        mb.affineMatrices[ i ].Scale( mb.scales[ i ], mb.scales[ i ], mb.scales[ i ] );
+        mb.affineMatrices[ i ].SetTranslation( RandomVec3( -100, 100 ) );
+        Affine3x4::FromMatrix( mb.affineMatrices[ i ], mb.affines[ i ] );
+
+        mb.points[ i ] = RandomVec3( -100, 100 );
+        mb.points4[ i ] = Vec4( mb.points[ i ].x, mb.points[ i ].y, mb.points[ i ].z, RandomRange( -1, 1 ) );
+        mb.aabbMins[ i ] = RandomVec3( -20, 20 );
+        mb.aabbMaxs[ i ] = mb.aabbMins[ i ] + RandomVec3( 0.1f, 20 );
+    }
+
+    for (unsigned p = 0; p < 6; ++p)
+    {
+        const Vec3 normal = RandomVec3( -1, 1 ).Normalized();
+        mb.planes[ p ] = Vec4( normal.x, normal.y, normal.z, RandomRange( 0, 40 ) );
+    }
+}
+
+// Tracks the largest difference to the reference, relative to the reference's magnitude when it's over 1.
+struct Check
+{
+    const char* name;
+    float tolerance;
+    float maxError = 0;
+    unsigned valueCount = 0;
+    unsigned exactCount = 0;
+};
+
+static void CheckValue( Check& check, float value, float reference )
+{
+    const float magnitude = fabsf( reference ) > 1 ? fabsf( reference ) : 1;
+    const float error = fabsf( value - reference ) / magnitude;
+
+    check.maxError = error > check.maxError || error != error ? error : check.maxError;
+    check.exactCount += memcmp( &value, &reference, sizeof( float ) ) == 0 ? 1 : 0;
+    ++check.valueCount;
+}
+
+static void CheckVec3( Check& check, const Vec3& value, const Vec3& reference )
+{
+    CheckValue( check, value.x, reference.x );
+    CheckValue( check, value.y, reference.y );
+    CheckValue( check, value.z, reference.z );
+}
+
+static void CheckMatrix( Check& check, const Matrix& value, const Matrix& reference )
+{
+    for (unsigned e = 0; e < 16; ++e)
+    {
+        CheckValue( check, value.m[ e ], reference.m[ e ] );
+    }
+}
+
+static void Report( const Check& check )
+{
+    const bool isPassed = check.maxError <= check.tolerance;
+    mb.failureCount += isPassed ? 0 : 1;
+
+    printf( "%-4s %-28s max error %.3g (tolerance %.3g), %u/%u bit-exact\n",
+            isPassed ? "ok" : "FAIL", check.name, check.maxError, check.tolerance, check.exactCount, check.valueCount );
+}
+
+static void RefMultiply( const Matrix& a, const Matrix& b, Matrix& out )
+{
+    for (unsigned row = 0; row < 4; ++row)
+    {
+        for (unsigned column = 0; column < 4; ++column)
+        {
+            float sum = 0;
+
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                sum += a.m[ row * 4 + k ] * b.m[ k * 4 + column ];
+            }
+
+            out.m[ row * 4 + column ] = sum;
+        }
+    }
+}
+
+static Vec3 RefTransformPoint( const Vec3& p, const Matrix& m )
+{
+    return Vec3( m.m[ 0 ] * p.x + m.m[ 4 ] * p.y + m.m[ 8 ] * p.z + m.m[ 12 ],
+                 m.m[ 1 ] * p.x + m.m[ 5 ] * p.y + m.m[ 9 ] * p.z + m.m[ 13 ],
+                 m.m[ 2 ] * p.x + m.m[ 6 ] * p.y + m.m[ 10 ] * p.z + m.m[ 14 ] );
+}
+
+static Quaternion RefQuaternionMultiply( const Quaternion& a, const Quaternion& b )
+{
+    Quaternion out;
+    out.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    out.y = a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z;
+    out.z = a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x;
+    out.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+    return out;
+}
+
+// Rotation, then uniform scale, then translation, like transforms were solved before Matrix::Compose.
+static void RefCompose( const Quaternion& q, const Vec3& position, float scale, Matrix& out )
+{
+    Matrix rotation;
+    rotation.m[ 0 ] = 1 - 2 * (q.y * q.y + q.z * q.z);
+    rotation.m[ 1 ] = 2 * (q.x * q.y - q.w * q.z);
+    rotation.m[ 2 ] = 2 * (q.x * q.z + q.w * q.y);
+    rotation.m[ 4 ] = 2 * (q.x * q.y + q.w * q.z);
+    rotation.m[ 5 ] = 1 - 2 * (q.x * q.x + q.z * q.z);
+    rotation.m[ 6 ] = 2 * (q.y * q.z - q.w * q.x);
+    rotation.m[ 8 ] = 2 * (q.x * q.z - q.w * q.y);
+    rotation.m[ 9 ] = 2 * (q.y * q.z + q.w * q.x);
+    rotation.m[ 10 ] = 1 - 2 * (q.x * q.x + q.y * q.y);
+
+    Matrix scaling;
+    scaling.m[ 0 ] = scaling.m[ 5 ] = scaling.m[ 10 ] = scale;
+    Matrix translation;
+    translation.m[ 12 ] = position.x;
+    translation.m[ 13 ] = position.y;
+    translation.m[ 14 ] = position.z;
+
+    Matrix scaled;
+    RefMultiply( rotation, scaling, scaled );
+    RefMultiply( scaled, translation, out );
+}
+
+static float RefIntersectRayAABB( const Vec3& origin, const Vec3& target, const Vec3& min, const Vec3& max )
+{
+    const Vec3 dir = (origin - target).Normalized();
+    const float origins[ 3 ] = { origin.x, origin.y, origin.z };
+    const float dirs[ 3 ] = { dir.x, dir.y, dir.z };
+    const float mins[ 3 ] = { min.x, min.y, min.z };
+    const float maxs[ 3 ] = { max.x, max.y, max.z };
+    float tmin = -1e30f;
+    float tmax = 1e30f;
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        const float t1 = (mins[ axis ] - origins[ axis ]) / dirs[ axis ];
+        const float t2 = (maxs[ axis ] - origins[ axis ]) / dirs[ axis ];
+        tmin = fmaxf( tmin, fminf( t1, t2 ) );
+        tmax = fminf( tmax, fmaxf( t1, t2 ) );
+    }
+
+    return (tmax < 0 || tmin > tmax) ? -1.0f : tmin;
+}
+
+static void TestMultiply()
+{
+    Check check{ "Multiply", 1e-6f };
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Matrix& a = mb.matrices[ i ];
+        const Matrix& b = mb.matrices[ (i + 1) % InputCount ];
+        Matrix value, reference;
+        Matrix::Multiply( a, b, value );
+        RefMultiply( a, b, reference );
+        CheckMatrix( check, value, reference );
+
+        // Output can alias an input.
+        Matrix aliased = a;
+        Matrix::Multiply( aliased, b, aliased );
+        CheckMatrix( check, aliased, reference );
+    }
+
+    Report( check );
+}
+
+static void TestTransformPoint()
+{
+    Check check{ "TransformPoint Vec3", 1e-5f }; // SIMD paths add in a different order.
+    Check check4{ "TransformPoint Vec4", 1e-6f };
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Matrix& m = mb.matrices[ i ];
+        Vec3 value;
+        Matrix::TransformPoint( mb.points[ i ], m, value );
+        CheckVec3( check, value, RefTransformPoint( mb.points[ i ], m ) );
+
+        const Vec4& p = mb.points4[ i ];
+        Vec4 value4;
+        Matrix::TransformPoint( p, m, value4 );
+        CheckValue( check4, value4.x, m.m[ 0 ] * p.x + m.m[ 4 ] * p.y + m.m[ 8 ] * p.z + m.m[ 12 ] * p.w );
+        CheckValue( check4, value4.y, m.m[ 1 ] * p.x + m.m[ 5 ] * p.y + m.m[ 9 ] * p.z + m.m[ 13 ] * p.w );
+        CheckValue( check4, value4.z, m.m[ 2 ] * p.x + m.m[ 6 ] * p.y + m.m[ 10 ] * p.z + m.m[ 14 ] * p.w );
+        CheckValue( check4, value4.w, m.m[ 3 ] * p.x + m.m[ 7 ] * p.y + m.m[ 11 ] * p.z + m.m[ 15 ] * p.w );
+    }
+
+    Report( check );
+    Report( check4 );
+}
+
+// Counts go past 8 and aren't multiples of it, so the AVX2 paths' remainder loops are tested too.
+static void TestBatches()
+{
+    Check checkMultiply{ "MultiplyBatch", 1e-5f }; // FMA rounds once per multiply-add.
+    Check checkTransform{ "TransformPoints", 1e-5f };
+    Check checkBoxes{ "BoxesInPlanes", 0 };
+    Check checkCompose{ "Affine3x4::ComposeBatch", 1e-6f };
+
+    for (unsigned count = 0; count <= 35; ++count)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            mb.batchMatrices[ i ] = mb.matrices[ count + i ];
+        }
+
+        // Output aliases the input.
+        Matrix::MultiplyBatch( mb.batchMatrices, mb.affineMatrices[ count ], mb.batchMatrices, count );
+        Matrix::TransformPoints( &mb.points[ count ], mb.matrices[ count ], mb.batchPoints, count );
+        BoxesInPlanes( mb.planes, 6, &mb.aabbMins[ count ], &mb.aabbMaxs[ count ], count, mb.batchIsInside );
+
+        // Indices are reversed, so the inputs aren't read in order.
+        for (unsigned i = 0; i < count; ++i)
+        {
+            mb.batchIndices[ i ] = 2 * count - 1 - i;
+        }
+
+        Affine3x4::ComposeBatch( mb.quaternions, mb.points, mb.scales, mb.batchIndices, count, mb.batchAffines );
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Matrix reference;
+            RefMultiply( mb.matrices[ count + i ], mb.affineMatrices[ count ], reference );
+            CheckMatrix( checkMultiply, mb.batchMatrices[ i ], reference );
+            CheckVec3( checkTransform, mb.batchPoints[ i ], RefTransformPoint( mb.points[ count + i ], mb.matrices[ count ] ) );
+
+            const Vec3& min = mb.aabbMins[ count + i ];
+            const Vec3& max = mb.aabbMaxs[ count + i ];
+            bool isInside = true;
+
+            for (unsigned p = 0; p < 6; ++p)
+            {
+                const Vec4& plane = mb.planes[ p ];
+                const Vec3 positive( plane.x >= 0 ? max.x : min.x, plane.y >= 0 ? max.y : min.y, plane.z >= 0 ? max.z : min.z );
+                isInside = isInside && Vec3::Dot( Vec3( plane.x, plane.y, plane.z ), positive ) + plane.w >= 0;
+            }
+
+            CheckValue( checkBoxes, mb.batchIsInside[ i ] ? 1.0f : 0.0f, isInside ? 1.0f : 0.0f );
+
+            const unsigned index = mb.batchIndices[ i ];
+            Matrix composed;
+            mb.batchAffines[ index ].GetMatrix( composed );
+            RefCompose( mb.quaternions[ index ], mb.points[ index ], mb.scales[ index ], reference );
+            CheckMatrix( checkCompose, composed, reference );
+        }
+    }
+
+    Report( checkMultiply );
+    Report( checkTransform );
+    Report( checkBoxes );
+    Report( checkCompose );
+}
+
+static void TestTransformDirection()
+{
+    Check check{ "TransformDirection", 1e-6f };
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Matrix& m = mb.matrices[ i ];
+        const Vec3& d = mb.points[ i ];
+        Vec3 value;
+        Matrix::TransformDirection( d, m, &value );
+        CheckVec3( check, value, Vec3( m.m[ 0 ] * d.x + m.m[ 4 ] * d.y + m.m[ 8 ] * d.z,
+                                       m.m[ 1 ] * d.x + m.m[ 5 ] * d.y + m.m[ 9 ] * d.z,
+                                       m.m[ 2 ] * d.x + m.m[ 6 ] * d.y + m.m[ 10 ] * d.z ) );
+    }
+
+    Report( check );
+}
+
+// Inverses are checked by multiplying them with the original, which should give identity.
+static void TestInvert()
+{
+    Check check{ "Invert", 1e-4f };
+    Check checkTranspose{ "InverseTranspose", 1e-4f };
+    const Matrix identity;
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Matrix& m = mb.affineMatrices[ i ];
+        Matrix inverse, product;
+        Matrix::Invert( m, inverse );
+        RefMultiply( m, inverse, product );
+        CheckMatrix( check, product, identity );
+
+        Matrix inverseTranspose, transposed;
+        Matrix::InverseTranspose( m.m, inverseTranspose.m );
+        inverseTranspose.Transpose( transposed );
+        RefMultiply( m, transposed, product );
+        CheckMatrix( checkTranspose, product, identity );
+    }
+
+    Report( check );
+    Report( checkTranspose );
+}
+
+static void TestQuaternion()
+{
+    Check checkCompose{ "Quaternion * Quaternion", 1e-4f };
+    Check checkRotate{ "Quaternion * Vec3", 1e-4f };
+    Check checkRoundTrip{ "Quaternion matrix round trip", 1e-5f };
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Quaternion& q1 = mb.quaternions[ i ];
+        const Quaternion& q2 = mb.quaternions[ (i + 1) % InputCount ];
+        const Vec3& v = mb.points[ i ];
+
+        // Composition rotates by q2 first.
+        CheckVec3( checkCompose, (q1 * q2) * v, q1 * (q2 * v) );
+
+        // Quaternions rotate like the transpose of their matrix.
+        Matrix rotation, transposed;
+        q1.GetMatrix( rotation );
+        rotation.Transpose( transposed );
+        Vec3 rotated;
+        Matrix::TransformDirection( v, transposed, &rotated );
+        CheckVec3( checkRotate, q1 * v, rotated );
+
+        // FromMatrix takes the transpose of GetMatrix's output. q and -q are the same rotation.
+        Quaternion roundTrip;
+        roundTrip.FromMatrix( transposed );
+        const float sign = roundTrip.x * q1.x + roundTrip.y * q1.y + roundTrip.z * q1.z + roundTrip.w * q1.w < 0 ? -1.0f : 1.0f;
+        CheckValue( checkRoundTrip, roundTrip.x * sign, q1.x );
+        CheckValue( checkRoundTrip, roundTrip.y * sign, q1.y );
+        CheckValue( checkRoundTrip, roundTrip.z * sign, q1.z );
+        CheckValue( checkRoundTrip, roundTrip.w * sign, q1.w );
+    }
+
+    Report( checkCompose );
+    Report( checkRotate );
+    Report( checkRoundTrip );
+
+    Check checkMultiply{ "Quaternion * reference", 1e-6f };
+    Check checkNormalize{ "Quaternion::Normalize", 1e-6f };
+    Check checkMatrix{ "Matrix::Compose", 1e-6f };
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Quaternion& q1 = mb.quaternions[ i ];
+        const Quaternion& q2 = mb.quaternions[ (i + 1) % InputCount ];
+        const Quaternion product = q1 * q2;
+        const Quaternion reference = RefQuaternionMultiply( q1, q2 );
+        CheckValue( checkMultiply, product.x, reference.x );
+        CheckValue( checkMultiply, product.y, reference.y );
+        CheckValue( checkMultiply, product.z, reference.z );
+        CheckValue( checkMultiply, product.w, reference.w );
+
+        Quaternion scaled = q1;
+        scaled.x *= mb.scales[ i ];
+        scaled.y *= mb.scales[ i ];
+        scaled.z *= mb.scales[ i ];
+        scaled.w *= mb.scales[ i ];
+        scaled.Normalize();
+        CheckValue( checkNormalize, scaled.x, q1.x );
+        CheckValue( checkNormalize, scaled.y, q1.y );
+        CheckValue( checkNormalize, scaled.z, q1.z );
+        CheckValue( checkNormalize, scaled.w, q1.w );
+
+        Matrix composed, composedReference;
+        Matrix::Compose( q1, mb.points[ i ], mb.scales[ i ], composed );
+        RefCompose( q1, mb.points[ i ], mb.scales[ i ], composedReference );
+        CheckMatrix( checkMatrix, composed, composedReference );
+    }
+
+    Report( checkMultiply );
+    Report( checkNormalize );
+    Report( checkMatrix );
+}
+
+// Affine3x4 is checked against the same operations on its Matrix form.
+static void TestAffine()
+{
+    Check checkRoundTrip{ "Affine3x4 matrix round trip", 0 };
+    Check checkCompose{ "Affine3x4::Compose", 1e-6f };
+    Check checkMultiply{ "Affine3x4::Multiply", 1e-6f };
+    Check checkProjection{ "Affine3x4::MultiplyProjection", 1e-6f };
+    Check checkPoint{ "Affine3x4::TransformPoint", 1e-5f };
+    Check checkDirection{ "Affine3x4::TransformDirection", 1e-6f };
+    Check checkInvert{ "Affine3x4::Invert", 1e-4f };
+    const Matrix identity;
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Affine3x4& a = mb.affines[ i ];
+        const Affine3x4& b = mb.affines[ (i + 1) % InputCount ];
+        const Vec3& v = mb.points[ i ];
+
+        Matrix value, reference;
+        a.GetMatrix( value );
+        CheckMatrix( checkRoundTrip, value, mb.affineMatrices[ i ] );
+
+        Affine3x4 composed;
+        Affine3x4::Compose( mb.quaternions[ i ], v, mb.scales[ i ], composed );
+        composed.GetMatrix( value );
+        RefCompose( mb.quaternions[ i ], v, mb.scales[ i ], reference );
+        CheckMatrix( checkCompose, value, reference );
+
+        Affine3x4 product;
+        Affine3x4::Multiply( a, b, product );
+        product.GetMatrix( value );
+        RefMultiply( mb.affineMatrices[ i ], mb.affineMatrices[ (i + 1) % InputCount ], reference );
+        CheckMatrix( checkMultiply, value, reference );
+
+        Affine3x4::MultiplyProjection( a, mb.matrices[ i ], value );
+        RefMultiply( mb.affineMatrices[ i ], mb.matrices[ i ], reference );
+        CheckMatrix( checkProjection, value, reference );
+
+        Vec3 transformed;
+        Affine3x4::TransformPoint( v, a, transformed );
+        CheckVec3( checkPoint, transformed, RefTransformPoint( v, mb.affineMatrices[ i ] ) );
+
+        Vec3 reference3;
+        Affine3x4::TransformDirection( v, a, transformed );
+        Matrix::TransformDirection( v, mb.affineMatrices[ i ], &reference3 );
+        CheckVec3( checkDirection, transformed, reference3 );
+
+        Affine3x4 inverse;
+        Affine3x4::Invert( a, inverse );
+        Affine3x4::Multiply( a, inverse, product );
+        product.GetMatrix( value );
+        CheckMatrix( checkInvert, value, identity );
+    }
+
+    Report( checkRoundTrip );
+    Report( checkCompose );
+    Report( checkMultiply );
+    Report( checkProjection );
+    Report( checkPoint );
+    Report( checkDirection );
+    Report( checkInvert );
+}
+
+static void TestIntersectRayAABB()
+{
+    Check check{ "IntersectRayAABB", 1e-5f };
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        const Vec3& origin = mb.points[ i ];
+        const Vec3 target = mb.points[ (i + 1) % InputCount ];
+        CheckValue( check, IntersectRayAABB( origin, target, mb.aabbMins[ i ], mb.aabbMaxs[ i ] ),
+                    RefIntersectRayAABB( origin, target, mb.aabbMins[ i ], mb.aabbMaxs[ i ] ) );
+    }
+
+    Report( check );
+}
+
+static void TestGetMinMax()
+{
+    Check check{ "GetMinMax", 0 };
+
+    for (unsigned count = 1; count <= 64; ++count)
+    {
+        Vec3 reference[ 2 ] = { mb.points[ count ], mb.points[ count ] };
+
+        for (unsigned i = count; i < count * 2; ++i)
+        {
+            reference[ 0 ] = Vec3( fminf( reference[ 0 ].x, mb.points[ i ].x ), fminf( reference[ 0 ].y, mb.points[ i ].y ), fminf( reference[ 0 ].z, mb.points[ i ].z ) );
+            reference[ 1 ] = Vec3( fmaxf( reference[ 1 ].x, mb.points[ i ].x ), fmaxf( reference[ 1 ].y, mb.points[ i ].y ), fmaxf( reference[ 1 ].z, mb.points[ i ].z ) );
+        }
+
+        Vec3 min, max;
+        GetMinMax( &mb.points[ count ], count, min, max );
+        CheckVec3( check, min, reference[ 0 ] );
+        CheckVec3( check, max, reference[ 1 ] );
+
+        GetMinMax( &mb.points[ count ], (int)count, min, max );
+        CheckVec3( check, min, reference[ 0 ] );
+        CheckVec3( check, max, reference[ 1 ] );
+    }
+
+    Report( check );
+}
+
+// Runs kernel over all inputs BenchRepeats times, BenchRuns times, and reports the fastest run.
+template< typename Kernel >
+static void Bench( const char* name, Kernel kernel )
+{
+    double bestNs = 1e30;
+
+    for (unsigned run = 0; run < BenchRuns; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (unsigned repeat = 0; repeat < BenchRepeats; ++repeat)
+        {
+            for (unsigned i = 0; i < InputCount; ++i)
+            {
+                kernel( i );
+            }
+        }
+
+        const double ns = (double)std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - start ).count();
+        bestNs = ns < bestNs ? ns : bestNs;
+    }
+
+    const double nsPerCall = bestNs / ((double)BenchRepeats * InputCount);
+    printf( "%-28s %8.2f ns/call %10.1f Mcalls/s\n", name, nsPerCall, 1000.0 / nsPerCall );
+}
+
+static void RunBenchmarks()
+{
+    Bench( "Multiply", []( unsigned i )
+    {
+        Matrix out;
+        Matrix::Multiply( mb.matrices[ i ], mb.affineMatrices[ i ], out );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "TransformPoint Vec3", []( unsigned i )
+    {
+        Vec3 out;
+        Matrix::TransformPoint( mb.points[ i ], mb.matrices[ i ], out );
+        mb.sink += out.x;
+    } );
+
+    Bench( "TransformPoint Vec4", []( unsigned i )
+    {
+        Vec4 out;
+        Matrix::TransformPoint( mb.points4[ i ], mb.matrices[ i ], out );
+        mb.sink += out.x;
+    } );
+
+    Bench( "TransformDirection", []( unsigned i )
+    {
+        Vec3 out;
+        Matrix::TransformDirection( mb.points[ i ], mb.matrices[ i ], &out );
+        mb.sink += out.x;
+    } );
+
+    Bench( "Invert", []( unsigned i )
+    {
+        Matrix out;
+        Matrix::Invert( mb.affineMatrices[ i ], out );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "InverseTranspose", []( unsigned i )
+    {
+        Matrix out;
+        Matrix::InverseTranspose( mb.affineMatrices[ i ].m, out.m );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "Quaternion * Quaternion", []( unsigned i )
+    {
+        const Quaternion out = mb.quaternions[ i ] * mb.quaternions[ (i + 1) % InputCount ];
+        mb.sink += out.w;
+    } );
+
+    Bench( "Quaternion::GetMatrix", []( unsigned i )
+    {
+        Matrix out;
+        mb.quaternions[ i ].GetMatrix( out );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "Quaternion::Normalize", []( unsigned i )
+    {
+        Quaternion q = mb.quaternions[ i ];
+        q.x += 0.01f;
+        q.Normalize();
+        mb.sink += q.x;
+    } );
+
+    // Transform solve before Matrix::Compose.
+    Bench( "GetMatrix, Scale, Multiply", []( unsigned i )
+    {
+        Matrix out;
+        mb.quaternions[ i ].GetMatrix( out );
+        out.Scale( mb.scales[ i ], mb.scales[ i ], mb.scales[ i ] );
+        Matrix translation;
+        translation.SetTranslation( mb.points[ i ] );
+        Matrix::Multiply( out, translation, out );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "Matrix::Compose", []( unsigned i )
+    {
+        Matrix out;
+        Matrix::Compose( mb.quaternions[ i ], mb.points[ i ], mb.scales[ i ], out );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "Affine3x4::Compose", []( unsigned i )
+    {
+        Affine3x4 out;
+        Affine3x4::Compose( mb.quaternions[ i ], mb.points[ i ], mb.scales[ i ], out );
+        mb.sink += out.m[ i % 12 ];
+    } );
+
+    Bench( "Affine3x4::Multiply", []( unsigned i )
+    {
+        Affine3x4 out;
+        Affine3x4::Multiply( mb.affines[ i ], mb.affines[ (i + 1) % InputCount ], out );
+        mb.sink += out.m[ i % 12 ];
+    } );
+
+    Bench( "Affine3x4::MultiplyProjection", []( unsigned i )
+    {
+        Matrix out;
+        Affine3x4::MultiplyProjection( mb.affines[ i ], mb.matrices[ i ], out );
+        mb.sink += out.m[ i & 15 ];
+    } );
+
+    Bench( "Affine3x4::TransformPoint", []( unsigned i )
+    {
+        Vec3 out;
+        Affine3x4::TransformPoint( mb.points[ i ], mb.affines[ i ], out );
+        mb.sink += out.x;
+    } );
+
+    Bench( "Affine3x4::Invert", []( unsigned i )
+    {
+        Affine3x4 out;
+        Affine3x4::Invert( mb.affines[ i ], out );
+        mb.sink += out.m[ i % 12 ];
+    } );
+
+    Bench( "Quaternion::FromMatrix", []( unsigned i )
+    {
+        Quaternion out;
+        out.FromMatrix( mb.affineMatrices[ i ] );
+        mb.sink += out.w;
+    } );
+
+    Bench( "IntersectRayAABB", []( unsigned i )
+    {
+        mb.sink += IntersectRayAABB( mb.points[ i ], mb.points[ (i + 1) % InputCount ], mb.aabbMins[ i ], mb.aabbMaxs[ i ] );
+    } );
+
+    Bench( "GetMinMax 8 points", []( unsigned i )
+    {
+        Vec3 min, max;
+        GetMinMax( &mb.points[ i & (InputCount - 8) ], 8u, min, max );
+        mb.sink += min.x + max.x;
+    } );
+
+    // Batched kernels run once per 64 inputs, so these are per element too.
+    Bench( "MultiplyBatch", []( unsigned i )
+    {
+        if ((i & 63) == 0)
+        {
+            Matrix::MultiplyBatch( &mb.matrices[ i ], mb.affineMatrices[ 0 ], &mb.batchMatrices[ i ], 64 );
+            mb.sink += mb.batchMatrices[ i ].m[ 0 ];
+        }
+    } );
+
+    Bench( "TransformPoints", []( unsigned i )
+    {
+        if ((i & 63) == 0)
+        {
+            Matrix::TransformPoints( &mb.points[ i ], mb.matrices[ 0 ], &mb.batchPoints[ i ], 64 );
+            mb.sink += mb.batchPoints[ i ].x;
+        }
+    } );
+
+    for (unsigned i = 0; i < InputCount; ++i)
+    {
+        mb.batchIndices[ i ] = i;
+    }
+
+    Bench( "Affine3x4::ComposeBatch", []( unsigned i )
+    {
+        if ((i & 63) == 0)
+        {
+            Affine3x4::ComposeBatch( mb.quaternions, mb.points, mb.scales, &mb.batchIndices[ i ], 64, mb.batchAffines );
+            mb.sink += mb.batchAffines[ i ].m[ 0 ];
+        }
+    } );
+
+    Bench( "BoxesInPlanes 6 planes", []( unsigned i )
+    {
+        if ((i & 63) == 0)
+        {
+            BoxesInPlanes( mb.planes, 6, &mb.aabbMins[ i ], &mb.aabbMaxs[ i ], 64, &mb.batchIsInside[ i ] );
+            mb.sink += mb.batchIsInside[ i ] ? 1 : 0;
+        }
+    } );
+}
+
+int main()
+{
+#if defined( SIMD_SSE3 )
+    printf( "Math kernels, SSE3 build\n" );
+#elif defined( SIMD_NEON )
+    printf( "Math kernels, NEON build\n" );
+#else
+    printf( "Math kernels, scalar build\n" );
+#endif
+    printf( "Batched kernels: %s\n", MathBatchGetKernelName() );
+
+    CreateInputs();
+
+    TestMultiply();
+    TestTransformPoint();
+    TestBatches();
+    TestTransformDirection();
+    TestInvert();
+    TestQuaternion();
+    TestAffine();
+    TestIntersectRayAABB();
+    TestGetMinMax();
+
+    RunBenchmarks();
+    printf( "%u failures (sink %g)\n", mb.failureCount, mb.sink );
+
+    return mb.failureCount == 0 ? 0 : 1;
+}
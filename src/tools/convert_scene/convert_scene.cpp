@@ -0,0 +1,319 @@
+// Theseus engine scene compiler. Converts a text .tscene into a binary .tsceneb.
+// Limitations:
+//   - Names and file names can't contain spaces.
+//   - Like the runtime text parser, light lines only add the light component, and lightcolor is ignored.
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "scene_binary.h"
+
+constexpr unsigned MaxItems = 10000;
+constexpr unsigned MaxStringBytes = 200000;
+
+char gStrings[ MaxStringBytes ];
+unsigned gNextFreeString = 0;
+
+SceneBinaryTexture gTextures[ MaxItems ];
+SceneBinaryMaterial gMaterials[ MaxItems ];
+SceneBinaryMesh gMeshes[ MaxItems ];
+SceneBinaryGameObject gGameObjects[ MaxItems ];
+float gPositions[ MaxItems * 3 ];
+float gRotations[ MaxItems * 4 ];
+float gScales[ MaxItems ];
+SceneBinaryMeshMaterial gMeshMaterials[ MaxItems ];
+SceneBinaryHeader gHeader;
+
+// Must match teComponent.
+constexpr uint32_t ComponentTransform = 1;
+constexpr uint32_t ComponentMeshRenderer = 4;
+constexpr uint32_t ComponentPointLight = 8;
+constexpr uint32_t ComponentSpotLight = 16;
+
+unsigned InsertString( const char* str )
+{
+    const size_t len = strlen( str );
+
+    if (gNextFreeString + len + 1 > MaxStringBytes)
+    {
+        printf( "String table is full!\n" );
+        exit( 1 );
+    }
+
+    memcpy( gStrings + gNextFreeString, str, len + 1 );
+    unsigned outIndex = gNextFreeString;
+    gNextFreeString += (unsigned)len + 1;
+
+    return outIndex;
+}
+
+// Unlike the runtime text parser, names must match exactly.
+template< typename T >
+uint32_t FindByName( const T* items, unsigned count, const char* name )
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (strcmp( gStrings + items[ i ].name, name ) == 0)
+        {
+            return i;
+        }
+    }
+
+    return SceneBinaryNone;
+}
+
+bool CheckCapacity( unsigned count, const char* what, unsigned lineNumber )
+{
+    if (count >= MaxItems)
+    {
+        printf( "line %u: too many %s!\n", lineNumber, what );
+        return false;
+    }
+
+    return true;
+}
+
+bool CheckGameObject( unsigned lineNumber )
+{
+    if (gHeader.gameObjectCount == 0)
+    {
+        printf( "line %u: component without gameobject!\n", lineNumber );
+        return false;
+    }
+
+    return true;
+}
+
+int Parse( FILE* file )
+{
+    char line[ 255 ];
+    unsigned lineNumber = 0;
+
+    while (fgets( line, 255, file ) != nullptr)
+    {
+        ++lineNumber;
+
+        char keyword[ 255 ] = {};
+        char arg1[ 255 ] = {};
+        char arg2[ 255 ] = {};
+
+        if (sscanf( line, "%254s %254s %254s", keyword, arg1, arg2 ) < 1)
+        {
+            continue;
+        }
+
+        SceneBinaryGameObject* go = gHeader.gameObjectCount > 0 ? &gGameObjects[ gHeader.gameObjectCount - 1 ] : nullptr;
+
+        // Keyword order matters: "meshrenderer" and "meshmaterial" must be tested before "mesh".
+        if (strcmp( keyword, "texture2d" ) == 0)
+        {
+            if (!CheckCapacity( gHeader.textureCount, "textures", lineNumber ))
+            {
+                return 1;
+            }
+
+            // TODO: if .dds is not supported by runtime, use .tga or .astc
+            char path[ 260 ] = {};
+            snprintf( path, sizeof( path ), "%s.dds", arg2 );
+
+            gTextures[ gHeader.textureCount ].name = InsertString( arg1 );
+            gTextures[ gHeader.textureCount ].path = InsertString( path );
+            ++gHeader.textureCount;
+        }
+        else if (strcmp( keyword, "material" ) == 0)
+        {
+            if (!CheckCapacity( gHeader.materialCount, "materials", lineNumber ))
+            {
+                return 1;
+            }
+
+            gMaterials[ gHeader.materialCount ].name = InsertString( arg1 );
+            gMaterials[ gHeader.materialCount ].tex0 = SceneBinaryNone;
+            gMaterials[ gHeader.materialCount ].tex1 = SceneBinaryNone;
+            ++gHeader.materialCount;
+        }
+        else if (strcmp( keyword, "tex0" ) == 0 || strcmp( keyword, "tex1" ) == 0)
+        {
+            if (gHeader.materialCount == 0)
+            {
+                printf( "line %u: %s without material!\n", lineNumber, keyword );
+                return 1;
+            }
+
+            const uint32_t texture = FindByName( gTextures, gHeader.textureCount, arg1 );
+
+            if (texture == SceneBinaryNone)
+            {
+                printf( "line %u: could not find texture '%s'\n", lineNumber, arg1 );
+            }
+
+            SceneBinaryMaterial& material = gMaterials[ gHeader.materialCount - 1 ];
+            (keyword[ 3 ] == '0' ? material.tex0 : material.tex1) = texture;
+        }
+        else if (strcmp( keyword, "gameobject" ) == 0)
+        {
+            if (!CheckCapacity( gHeader.gameObjectCount, "gameobjects", lineNumber ))
+            {
+                return 1;
+            }
+
+            SceneBinaryGameObject& newGo = gGameObjects[ gHeader.gameObjectCount ];
+            newGo.name = InsertString( arg1 );
+            newGo.components = ComponentTransform;
+            newGo.mesh = SceneBinaryNone;
+            newGo.firstMeshMaterial = gHeader.meshMaterialCount;
+            newGo.meshMaterialCount = 0;
+
+            float* position = &gPositions[ gHeader.gameObjectCount * 3 ];
+            position[ 0 ] = position[ 1 ] = position[ 2 ] = 0;
+
+            float* rotation = &gRotations[ gHeader.gameObjectCount * 4 ];
+            rotation[ 0 ] = rotation[ 1 ] = rotation[ 2 ] = 0;
+            rotation[ 3 ] = 1;
+
+            gScales[ gHeader.gameObjectCount ] = 1;
+
+            ++gHeader.gameObjectCount;
+        }
+        else if (strcmp( keyword, "position" ) == 0)
+        {
+            if (!CheckGameObject( lineNumber ))
+            {
+                return 1;
+            }
+
+            float* position = &gPositions[ (gHeader.gameObjectCount - 1) * 3 ];
+            sscanf( line, "%*s %f %f %f", &position[ 0 ], &position[ 1 ], &position[ 2 ] );
+        }
+        else if (strcmp( keyword, "meshrenderer" ) == 0)
+        {
+            if (!CheckGameObject( lineNumber ))
+            {
+                return 1;
+            }
+
+            go->components |= ComponentMeshRenderer;
+            go->mesh = FindByName( gMeshes, gHeader.meshCount, arg1 );
+
+            if (go->mesh == SceneBinaryNone)
+            {
+                printf( "line %u: meshrenderer: could not find '%s'\n", lineNumber, arg1 );
+            }
+        }
+        else if (strcmp( keyword, "meshmaterial" ) == 0)
+        {
+            if (!CheckGameObject( lineNumber ) || !CheckCapacity( gHeader.meshMaterialCount, "meshmaterials", lineNumber ))
+            {
+                return 1;
+            }
+
+            const uint32_t material = FindByName( gMaterials, gHeader.materialCount, arg2 );
+
+            if (material == SceneBinaryNone)
+            {
+                printf( "line %u: meshmaterial: could not find material '%s'\n", lineNumber, arg2 );
+                continue;
+            }
+
+            // Mesh materials are stored contiguously per gameobject.
+            if (go->firstMeshMaterial + go->meshMaterialCount != gHeader.meshMaterialCount)
+            {
+                printf( "line %u: meshmaterial must follow its gameobject's other meshmaterials!\n", lineNumber );
+                return 1;
+            }
+
+            gMeshMaterials[ gHeader.meshMaterialCount ].subMesh = strcmp( arg1, "all" ) == 0 ? SceneBinaryAllSubMeshes : (uint32_t)atoi( arg1 );
+            gMeshMaterials[ gHeader.meshMaterialCount ].material = material;
+            ++gHeader.meshMaterialCount;
+            ++go->meshMaterialCount;
+        }
+        else if (strcmp( keyword, "mesh" ) == 0)
+        {
+            if (!CheckCapacity( gHeader.meshCount, "meshes", lineNumber ))
+            {
+                return 1;
+            }
+
+            gMeshes[ gHeader.meshCount ].name = InsertString( arg1 );
+            gMeshes[ gHeader.meshCount ].path = InsertString( arg2 );
+            ++gHeader.meshCount;
+        }
+        else if (strcmp( keyword, "light" ) == 0)
+        {
+            if (!CheckGameObject( lineNumber ))
+            {
+                return 1;
+            }
+
+            go->components |= strcmp( arg1, "spot" ) == 0 ? ComponentSpotLight : ComponentPointLight;
+        }
+        else if (strcmp( keyword, "lightcolor" ) == 0)
+        {
+            printf( "line %u: lightcolor is not supported yet.\n", lineNumber );
+        }
+    }
+
+    return 0;
+}
+
+int WriteSceneBinary( const char* path )
+{
+    FILE* file = fopen( path, "wb" );
+
+    if (file == nullptr)
+    {
+        printf( "Could not open file for writing: %s\n", path );
+        return 1;
+    }
+
+    // Keeps the string table size a multiple of 4 so the file size stays aligned.
+    while (gNextFreeString % 4 != 0)
+    {
+        gStrings[ gNextFreeString++ ] = 0;
+    }
+
+    memcpy( gHeader.magic, SceneBinaryMagic, sizeof( gHeader.magic ) );
+    gHeader.stringTableBytes = gNextFreeString;
+
+    fwrite( &gHeader, sizeof( gHeader ), 1, file );
+    fwrite( gTextures, sizeof( SceneBinaryTexture ), gHeader.textureCount, file );
+    fwrite( gMaterials, sizeof( SceneBinaryMaterial ), gHeader.materialCount, file );
+    fwrite( gMeshes, sizeof( SceneBinaryMesh ), gHeader.meshCount, file );
+    fwrite( gGameObjects, sizeof( SceneBinaryGameObject ), gHeader.gameObjectCount, file );
+    fwrite( gPositions, sizeof( float ) * 3, gHeader.gameObjectCount, file );
+    fwrite( gRotations, sizeof( float ) * 4, gHeader.gameObjectCount, file );
+    fwrite( gScales, sizeof( float ), gHeader.gameObjectCount, file );
+    fwrite( gMeshMaterials, sizeof( SceneBinaryMeshMaterial ), gHeader.meshMaterialCount, file );
+    fwrite( gStrings, 1, gHeader.stringTableBytes, file );
+    fclose( file );
+
+    return 0;
+}
+
+int main( int argc, char* argv[] )
+{
+    if (argc != 3 || !strstr( argv[ 1 ], ".tscene" ))
+    {
+        printf( "usage: ./convert_scene file.tscene file.tsceneb\n" );
+        return 0;
+    }
+
+    FILE* file = fopen( argv[ 1 ], "rb" );
+
+    if (!file)
+    {
+        printf( "Could not open %s\n", argv[ 1 ] );
+        return 1;
+    }
+
+    const int result = Parse( file );
+    fclose( file );
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    printf( "gameobjects: %u, textures: %u, materials: %u, meshes: %u\n", gHeader.gameObjectCount, gHeader.textureCount, gHeader.materialCount, gHeader.meshCount );
+
+    return WriteSceneBinary( argv[ 2 ] );
+}
@@ -95,6 +95,8 @@ struct SceneView
     char openFilePath[ 280 ];
     int gizmoAxisSelected = -1;
     int selectedMaterialIndex = -1;
+    char editedName[ 100 ] = {};
+    bool isEditingName = false;
 
     float lightDir[ 3 ] = { 0.02f, -1, 0.02f };
     float lightColor[ 3 ] = { 1, 1, 1 };
@@ -340,11 +342,14 @@ void GetColliders( unsigned screenX, unsigned screenY, bool skipGizmo, int& outC
 {
     // Try to select a light under pointer.
     {
-        for (unsigned i = 0; i < teSceneGetMaxGameObjects(); ++i)
+        unsigned pointLightCount = 0;
+        const unsigned* pointLights = teGameObjectGetObjectsWithComponent( teComponent::PointLight, pointLightCount );
+
+        for (unsigned i = 0; i < pointLightCount; ++i)
         {
-            unsigned goIndex = teSceneGetGameObjectIndex( sceneView.scene, i );
+            unsigned goIndex = pointLights[ i ];
 
-            if (goIndex != 0 && goIndex != sceneView.translateGizmoGo.index && goIndex != sceneView.camera3d.index && teGameObjectGetComponents( goIndex ) & teComponent::PointLight)
+            if (goIndex != sceneView.translateGizmoGo.index && goIndex != sceneView.camera3d.index && teSceneContains( sceneView.scene, goIndex ))
             {
                 const Vec3 screenPoint = teCameraGetScreenPoint( sceneView.camera3d.index, teTransformGetLocalPosition( goIndex ), (float)sceneView.width, (float)sceneView.height );
                 float x = screenPoint.x;
@@ -877,11 +882,14 @@ void RenderSceneView( float gridStep )
     shaderParams.tilesXY[ 3 ] = -1.0f;
     teDrawQuad( sceneView.fullscreenShader, teCameraGetColorTexture( sceneView.camera3d.index ), shaderParams, teBlendMode::Off );
 
-    for (unsigned i = 0; i < teSceneGetMaxGameObjects(); ++i)
+    unsigned pointLightCount = 0;
+    const unsigned* pointLights = teGameObjectGetObjectsWithComponent( teComponent::PointLight, pointLightCount );
+
+    for (unsigned i = 0; i < pointLightCount; ++i)
     {
-        unsigned goIndex = teSceneGetGameObjectIndex( sceneView.scene, i );
+        unsigned goIndex = pointLights[ i ];
 
-        if (goIndex != 0 && goIndex != sceneView.translateGizmoGo.index && goIndex != sceneView.camera3d.index && teGameObjectGetComponents( goIndex ) & teComponent::PointLight)
+        if (goIndex != sceneView.translateGizmoGo.index && goIndex != sceneView.camera3d.index && teSceneContains( sceneView.scene, goIndex ))
         {
             const Vec3 screenPoint = teCameraGetScreenPoint( sceneView.camera3d.index, teTransformGetLocalPosition( goIndex ), (float)sceneView.width, (float)sceneView.height );
 
@@ -988,7 +996,19 @@ void RenderSceneView( float gridStep )
         }
         else if (selectedGoIndex != sceneView.translateGizmoGo.index && selectedGoIndex != sceneView.camera3d.index)
         {
-            ImGui::InputText( "name", teGameObjectGetName( selectedGoIndex ), 100 );
+            // The name is set when editing finishes, so every keystroke doesn't intern a new name.
+            if (!sceneView.isEditingName)
+            {
+                strncpy( sceneView.editedName, teGameObjectGetName( selectedGoIndex ), sizeof( sceneView.editedName ) - 1 );
+            }
+
+            ImGui::InputText( "name", sceneView.editedName, sizeof( sceneView.editedName ) );
+            sceneView.isEditingName = ImGui::IsItemActive();
+
+            if (ImGui::IsItemDeactivatedAfterEdit())
+            {
+                teGameObjectSetName( selectedGoIndex, sceneView.editedName );
+            }
          
             if (ImGui::CollapsingHeader( "Transform" ))
             {
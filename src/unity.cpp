@@ -1,4 +1,4 @@
-void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16 ], const float localToWorld[ 16 ], const struct ShaderParams& shaderParams, const struct Vec4& lightDirection, const Vec4& lightColor, const Vec4& lightPosition );
+void UpdateUBO( const struct Affine3x4& localToView, const struct Matrix& viewToClip, const Affine3x4& localToWorld, const Matrix& worldToShadowClip, const struct ShaderParams& shaderParams, const struct Vec4& lightDirection, const Vec4& lightColor, const Vec4& lightPosition );
 
 #if VK_USE_PLATFORM_WIN32_KHR
 #include "window_win32.cpp"
@@ -14,15 +14,22 @@ void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16
 #include "core/te_stdlib.cpp"
 #include "core/audio_common.cpp"
 #include "core/camera.cpp"
+#include "core/engine.cpp"
 #include "core/file.cpp"
 #include "core/frustum.cpp"
 #include "core/gameobject.cpp"
 #include "core/math.cpp"
+#include "core/math_batch.cpp"
+#include "core/occlusion.cpp"
+#include "core/profiler.cpp"
 #include "core/scene.cpp"
+#include "core/streaming.cpp"
 #include "core/transform.cpp"
+#include "core/world.cpp"
 #include "video/light.cpp"
 #include "material.cpp"
 #include "mesh.cpp"
+#include "stats.cpp"
 #include "textureloader.cpp"
 #if VK_USE_PLATFORM_WIN32_KHR || VK_USE_PLATFORM_WAYLAND_KHR || VK_USE_PLATFORM_XCB_KHR
 #include "vulkan/buffer_vulkan.cpp"
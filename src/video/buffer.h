@@ -6,8 +6,19 @@ struct teBuffer
     unsigned sizeBytes = 0;
 };
 
+struct BufferRange
+{
+    unsigned offset = 0;
+    unsigned sizeBytes = 0;
+};
+
 teBuffer CreateBuffer( unsigned size, const char* debugName );
 teBuffer CreateStagingBuffer( unsigned size, const char* debugName );
 void CopyBuffer( const teBuffer& source, const teBuffer& destination );
 void UpdateStagingBuffer( const teBuffer& buffer, const void* data, unsigned dataBytes, unsigned offset );
+void ReadStagingBuffer( const teBuffer& buffer, void* outData, unsigned dataBytes, unsigned offset );
+// Writes ranges of data to the current frame's upload ring and copies them to the same offsets in destination before the
+// frame's later draws and dispatches. Doesn't wait for the GPU. Must not be called between BeginRendering and EndRendering.
+// @return false if the frame's upload ring is full, in which case nothing is uploaded.
+bool UploadBufferRanges( const teBuffer& destination, const void* data, const BufferRange* ranges, unsigned rangeCount );
 
@@ -1,24 +1,49 @@
 #include "light.h"
 #include "buffer.h"
 #include "matrix.h"
+#include "profiler.h"
+#include "renderer.h"
 #include "shader.h"
+#include "te_stdlib.h"
 #include "vec3.h"
+#include <math.h>
+#include <chrono>
+#ifdef SIMD_SSE3
+#include <pmmintrin.h>
+#endif
+
+void StatSet( teStat stat, float value );
+
+static constexpr unsigned NoLightSlot = ~0u;
 
 struct LightImpl
 {
-    unsigned tilerIndex = 0;
+    unsigned tilerIndex = NoLightSlot; // NoLightSlot if the light is disabled or there were no free slots.
     float intensity = 1.0f;
+    bool isAdded = false;
+    bool isEnabled = false; // An enabled light without a slot waits for one to be freed.
 
     // SpotLight specific stuff
     float coneAngle;
     Vec3 direction;
+
+    // Values of a light that has no tiler slot. They're moved to and from the tiler when the light gets or loses a slot.
+    Vec4 centerAndRadius;
+    Vec4 color;
+    Vec4 params;
 };
 
-LightImpl pointLights[ 10000 ];
-LightImpl spotLights[ 10000 ];
+// Indexed by game object.
+LightImpl* pointLights = nullptr;
+LightImpl* spotLights = nullptr;
+static unsigned lightCapacity = 0;
 
-unsigned gCurrentPointTilerIndex = 0;
-unsigned gCurrentSpotTilerIndex = 0;
+void LightInitStorage( unsigned maxGameObjects )
+{
+    lightCapacity = maxGameObjects;
+    pointLights = teMallocArray< LightImpl >( maxGameObjects, teMemoryTag::Renderer );
+    spotLights = teMallocArray< LightImpl >( maxGameObjects, teMemoryTag::Renderer );
+}
 
 struct LightTiler
 {
@@ -29,23 +54,86 @@ struct LightTiler
     teBuffer lightIndexBuffer;
     teBuffer pointLightCenterAndRadiusBuffer;
     teBuffer pointLightColorBuffer;
-    teBuffer pointLightCenterAndRadiusStagingBuffer;
-    teBuffer pointLightColorStagingBuffer;
 
     teBuffer spotLightCenterAndRadiusBuffer;
     teBuffer spotLightColorBuffer;
-    teBuffer spotLightCenterAndRadiusStagingBuffer;
-    teBuffer spotLightColorStagingBuffer;
     teBuffer spotLightParamBuffer;
-    teBuffer spotLightParamStagingBuffer;
 
     Vec4 pointLightCenterAndRadius[ MaxLights ];
     Vec4 pointLightColors[ MaxLights ];
     Vec4 spotLightCenterAndRadius[ MaxLights ];
     Vec4 spotLightColors[ MaxLights ];
     Vec4 spotLightParams[ MaxLights ];
+
+    // Lights are packed to the start of the arrays, so the light culler and shaders only see enabled lights.
+    // Removing or disabling a light moves the last light to its slot.
+    unsigned pointLightGameObjects[ MaxLights ]; // Game object of each slot.
+    unsigned spotLightGameObjects[ MaxLights ];
+    unsigned pointLightCount = 0;
+    unsigned spotLightCount = 0;
+    unsigned pointLightWaitingCount = 0; // Enabled lights that didn't get a slot because all were used.
+    unsigned spotLightWaitingCount = 0;
+
+    // What the buffers contain for the first uploaded*Count lights. Lights are uploaded when they differ from these,
+    // so lights that haven't changed since the last frame cost nothing. The editor writes lights through pointers,
+    // so changes are found by comparing instead of by marking them in setters.
+    Vec4 uploadedPointLightCenterAndRadius[ MaxLights ];
+    Vec4 uploadedPointLightColors[ MaxLights ];
+    Vec4 uploadedSpotLightCenterAndRadius[ MaxLights ];
+    Vec4 uploadedSpotLightColors[ MaxLights ];
+    Vec4 uploadedSpotLightParams[ MaxLights ];
+    unsigned uploadedPointLightCount = 0;
+    unsigned uploadedSpotLightCount = 0;
 } gLightTiler;
 
+// Lights assigned to clusters on the CPU, used instead of the light culling shader when enabled by teLightSetCpuClustering().
+// Clusters are screen tiles of TileRes pixels split into SliceCount exponential depth slices, and cluster index is
+// x + y * tilesX + slice * tilesX * tilesY. The uploaded buffer starts with the start of each cluster's list, and lists have
+// the same layout as the light culling shader's tile lists: point light indices, sentinel, spot light indices, sentinel.
+struct LightClusters
+{
+    static constexpr unsigned TileRes = 64;
+    static constexpr unsigned SliceCount = 24;
+    static constexpr unsigned MaxLightsPerCluster = 256;
+    static constexpr unsigned AverageLightsPerCluster = 32; // Sizes the buffer. Lists that don't fit are cut.
+    static constexpr unsigned Sentinel = 0x7fffffff; // LIGHT_INDEX_BUFFER_SENTINEL in shaders.
+
+    teBuffer buffer;
+    unsigned* data = nullptr; // Copy of buffer, capacity elements.
+    unsigned capacity = 0;
+    unsigned widthPixels = 0;
+    unsigned heightPixels = 0;
+    unsigned tilesX = 0;
+    unsigned tilesY = 0;
+    unsigned tilesXPadded = 0; // Bounds rows have a multiple of 4 clusters, so they can be tested 4 at a time.
+    float sliceScale = 0; // slice = log( depth ) * sliceScale + sliceBias
+    float sliceBias = 0;
+    bool isEnabled = false;
+    bool isActive = false; // Clusters were uploaded this frame. If the upload ring was full, the light culling shader is used instead.
+
+    // View space bounds. View space looks down -z and a cluster's x bounds only depend on its column and slice,
+    // and y bounds on its row and slice, so they're stored per slice instead of per cluster.
+    float* minX = nullptr; // [ slice * tilesXPadded + x ]
+    float* maxX = nullptr;
+    float* minY = nullptr; // [ slice * tilesY + y ]
+    float* maxY = nullptr;
+    float sliceNear[ SliceCount ] = {}; // Depth, ie. -z.
+    float sliceFar[ SliceCount ] = {};
+    float boundsProjection[ 3 ] = {}; // Projection's x scale, y scale and z scale that the bounds were computed for.
+} gLightClusters;
+
+// A light in view space, with the range of clusters its bounding sphere can touch.
+struct ClusterLight
+{
+    Vec3 center;
+    float radius;
+    Vec3 direction; // Spot lights only.
+    float cosAngle;
+    float sinAngle;
+    unsigned index; // Tiler index.
+    unsigned tileX0, tileX1, tileY0, tileY1, slice0, slice1;
+};
+
 teBuffer GetPointLightCenterAndRadiusBuffer()
 {
     return gLightTiler.pointLightCenterAndRadiusBuffer;
@@ -73,167 +161,366 @@ teBuffer GetSpotLightColorBuffer()
 
 teBuffer GetLightIndexBuffer()
 {
-    return gLightTiler.lightIndexBuffer;
+    return gLightClusters.isActive ? gLightClusters.buffer : gLightTiler.lightIndexBuffer;
 }
 
-void teAddPointLight( unsigned index )
+// x: cluster tile size in pixels, y and z: depth slice scale and bias, w: slice count, 0 if clusters are not used.
+Vec4 GetLightClusterParams()
 {
-    pointLights[ index ].tilerIndex = gCurrentPointTilerIndex++;
+    return Vec4( (float)LightClusters::TileRes, gLightClusters.sliceScale, gLightClusters.sliceBias, gLightClusters.isActive ? (float)LightClusters::SliceCount : 0.0f );
 }
 
-void teAddSpotLight( unsigned index )
+void teLightSetCpuClustering( bool enable )
 {
-    spotLights[ index ].tilerIndex = gCurrentSpotTilerIndex++;
+    gLightClusters.isEnabled = enable;
 }
 
-unsigned GetPointLightCount()
+// Point and spot light storage, so that they can share the slot code. params is nullptr for point lights.
+struct LightArrays
+{
+    LightImpl* lights;
+    Vec4* centerAndRadius;
+    Vec4* colors;
+    Vec4* params;
+    unsigned* gameObjects;
+    unsigned* count;
+    unsigned* waitingCount;
+    const char* typeName;
+};
+
+// Where a light's values are: its tiler slot, or its LightImpl if it has no slot.
+struct LightValues
+{
+    Vec4* centerAndRadius;
+    Vec4* color;
+    Vec4* params;
+};
+
+static LightArrays GetPointLightArrays()
 {
-    return gCurrentPointTilerIndex;
+    return { pointLights, gLightTiler.pointLightCenterAndRadius, gLightTiler.pointLightColors, nullptr, gLightTiler.pointLightGameObjects, &gLightTiler.pointLightCount, &gLightTiler.pointLightWaitingCount, "point" };
 }
 
-unsigned GetSpotLightCount()
+static LightArrays GetSpotLightArrays()
 {
-    return gCurrentSpotTilerIndex;
+    return { spotLights, gLightTiler.spotLightCenterAndRadius, gLightTiler.spotLightColors, gLightTiler.spotLightParams, gLightTiler.spotLightGameObjects, &gLightTiler.spotLightCount, &gLightTiler.spotLightWaitingCount, "spot" };
 }
 
-void tePointLightSetParams( unsigned goIndex, float radius, const Vec3& color, float intensity )
+// Moves the light's values to the next free slot. If there are none, the light waits until one is freed.
+static void AddToTiler( const LightArrays& arrays, unsigned goIndex )
 {
-    unsigned tilerIndex = pointLights[ goIndex ].tilerIndex;
+    LightImpl& light = arrays.lights[ goIndex ];
+    teAssert( light.tilerIndex == NoLightSlot );
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (*arrays.count == LightTiler::MaxLights)
     {
+        teLog( teLogLevel::Warning, "Too many %s lights, max is %u\n", arrays.typeName, LightTiler::MaxLights );
+        ++(*arrays.waitingCount);
         return;
     }
-    
-    pointLights[ goIndex ].intensity = intensity;
 
-    gLightTiler.pointLightCenterAndRadius[ tilerIndex ].w = radius;
-    gLightTiler.pointLightColors[ tilerIndex ] = Vec4( color.x, color.y, color.z, 1 );    
+    const unsigned slot = (*arrays.count)++;
+    light.tilerIndex = slot;
+    arrays.gameObjects[ slot ] = goIndex;
+    arrays.centerAndRadius[ slot ] = light.centerAndRadius;
+    arrays.colors[ slot ] = light.color;
+
+    if (arrays.params)
+    {
+        arrays.params[ slot ] = light.params;
+    }
 }
 
-void teSpotLightSetParams( unsigned goIndex, Vec3& position, const Vec3& color, float coneAngleDegrees, const Vec3& direction, float falloffRadius )
+// Moves the light's values out of its slot, and the last light to the slot.
+static void RemoveFromTiler( const LightArrays& arrays, unsigned goIndex )
 {
-    unsigned tilerIndex = spotLights[ goIndex ].tilerIndex;
+    LightImpl& light = arrays.lights[ goIndex ];
+    const unsigned slot = light.tilerIndex;
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (slot == NoLightSlot)
     {
         return;
     }
 
+    light.centerAndRadius = arrays.centerAndRadius[ slot ];
+    light.color = arrays.colors[ slot ];
+    light.params = arrays.params ? arrays.params[ slot ] : Vec4();
+    light.tilerIndex = NoLightSlot;
+
+    const unsigned lastSlot = --(*arrays.count);
 
-    gLightTiler.spotLightCenterAndRadius[ tilerIndex ] = Vec4( position.x, position.y, position.z, falloffRadius );
-    gLightTiler.spotLightColors[ tilerIndex ] = Vec4( color.x, color.y, color.z, 1 );
-    gLightTiler.spotLightParams[ tilerIndex ] = Vec4( direction.x, direction.y, direction.z, (float)cos( coneAngleDegrees * 3.14159265f / 180.0f ) );
+    if (slot != lastSlot)
+    {
+        arrays.centerAndRadius[ slot ] = arrays.centerAndRadius[ lastSlot ];
+        arrays.colors[ slot ] = arrays.colors[ lastSlot ];
+
+        if (arrays.params)
+        {
+            arrays.params[ slot ] = arrays.params[ lastSlot ];
+        }
+
+        arrays.gameObjects[ slot ] = arrays.gameObjects[ lastSlot ];
+        arrays.lights[ arrays.gameObjects[ slot ] ].tilerIndex = slot;
+    }
 }
 
-void SetPointLightPosition( unsigned goIndex, const Vec3& positionWS )
+// Takes the light out of its slot or out of the waiting lights. A freed slot is given to a waiting light.
+// Finding the waiting light scans every light, but only when more lights were enabled than there are slots.
+static void DisableLight( const LightArrays& arrays, unsigned goIndex )
 {
-    unsigned tilerIndex = pointLights[ goIndex ].tilerIndex;
+    LightImpl& light = arrays.lights[ goIndex ];
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (!light.isEnabled)
     {
         return;
     }
-    
-    gLightTiler.pointLightCenterAndRadius[ tilerIndex ].x = positionWS.x;
-    gLightTiler.pointLightCenterAndRadius[ tilerIndex ].y = positionWS.y;
-    gLightTiler.pointLightCenterAndRadius[ tilerIndex ].z = positionWS.z;
+
+    light.isEnabled = false;
+
+    if (light.tilerIndex == NoLightSlot)
+    {
+        --(*arrays.waitingCount);
+        return;
+    }
+
+    RemoveFromTiler( arrays, goIndex );
+
+    for (unsigned i = 0; i < lightCapacity && *arrays.waitingCount > 0; ++i)
+    {
+        if (arrays.lights[ i ].isEnabled && arrays.lights[ i ].tilerIndex == NoLightSlot)
+        {
+            --(*arrays.waitingCount);
+            AddToTiler( arrays, i );
+            break;
+        }
+    }
 }
 
-void SetSpotLightPosition( unsigned goIndex, const Vec3& positionWS )
+// teGameObjectAddComponent adds the lights again when other components are added, so adding is ignored for lights that exist.
+static void AddLight( const LightArrays& arrays, unsigned goIndex )
 {
-    unsigned tilerIndex = spotLights[ goIndex ].tilerIndex;
+    if (arrays.lights[ goIndex ].isAdded)
+    {
+        return;
+    }
+
+    arrays.lights[ goIndex ] = LightImpl();
+    arrays.lights[ goIndex ].isAdded = true;
+    arrays.lights[ goIndex ].isEnabled = true;
+    AddToTiler( arrays, goIndex );
+}
 
-    if (tilerIndex >= LightTiler::MaxLights)
+static void RemoveLight( const LightArrays& arrays, unsigned goIndex )
+{
+    DisableLight( arrays, goIndex );
+    arrays.lights[ goIndex ] = LightImpl();
+}
+
+static void SetLightEnabled( const LightArrays& arrays, unsigned goIndex, bool enable )
+{
+    LightImpl& light = arrays.lights[ goIndex ];
+
+    if (!light.isAdded)
     {
         return;
     }
 
-    gLightTiler.spotLightCenterAndRadius[ tilerIndex ].x = positionWS.x;
-    gLightTiler.spotLightCenterAndRadius[ tilerIndex ].y = positionWS.y;
-    gLightTiler.spotLightCenterAndRadius[ tilerIndex ].z = positionWS.z;
+    if (enable && !light.isEnabled)
+    {
+        light.isEnabled = true;
+        AddToTiler( arrays, goIndex );
+    }
+    else if (!enable)
+    {
+        DisableLight( arrays, goIndex );
+    }
 }
 
-float* tePointLightAccessRadius( unsigned goIndex )
+// @return false if the game object doesn't have the light.
+static bool GetLightValues( const LightArrays& arrays, unsigned goIndex, LightValues& outValues )
 {
-    unsigned tilerIndex = pointLights[ goIndex ].tilerIndex;
+    LightImpl& light = arrays.lights[ goIndex ];
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (!light.isAdded)
     {
-        return nullptr;
+        return false;
     }
 
-    return &gLightTiler.pointLightCenterAndRadius[ tilerIndex ].w;
+    const unsigned slot = light.tilerIndex;
+
+    if (slot == NoLightSlot)
+    {
+        outValues = { &light.centerAndRadius, &light.color, &light.params };
+    }
+    else
+    {
+        outValues = { &arrays.centerAndRadius[ slot ], &arrays.colors[ slot ], arrays.params ? &arrays.params[ slot ] : &light.params };
+    }
+
+    return true;
 }
 
-float* tePointLightAccessColor( unsigned goIndex )
+void teAddPointLight( unsigned index )
 {
-    unsigned tilerIndex = pointLights[ goIndex ].tilerIndex;
+    AddLight( GetPointLightArrays(), index );
+}
+
+void teAddSpotLight( unsigned index )
+{
+    AddLight( GetSpotLightArrays(), index );
+}
+
+void RemovePointLight( unsigned index )
+{
+    RemoveLight( GetPointLightArrays(), index );
+}
+
+void RemoveSpotLight( unsigned index )
+{
+    RemoveLight( GetSpotLightArrays(), index );
+}
+
+void tePointLightSetEnabled( unsigned goIndex, bool enable )
+{
+    SetLightEnabled( GetPointLightArrays(), goIndex, enable );
+}
+
+void teSpotLightSetEnabled( unsigned goIndex, bool enable )
+{
+    SetLightEnabled( GetSpotLightArrays(), goIndex, enable );
+}
+
+bool tePointLightIsEnabled( unsigned goIndex )
+{
+    return pointLights[ goIndex ].isEnabled;
+}
+
+bool teSpotLightIsEnabled( unsigned goIndex )
+{
+    return spotLights[ goIndex ].isEnabled;
+}
+
+unsigned GetPointLightCount()
+{
+    return gLightTiler.pointLightCount;
+}
 
-    if (tilerIndex >= LightTiler::MaxLights)
+unsigned GetSpotLightCount()
+{
+    return gLightTiler.spotLightCount;
+}
+
+void tePointLightSetParams( unsigned goIndex, float radius, const Vec3& color, float intensity )
+{
+    LightValues values;
+
+    if (!GetLightValues( GetPointLightArrays(), goIndex, values ))
     {
-        return nullptr;
+        return;
     }
 
-    return &gLightTiler.pointLightColors[ tilerIndex ].x;
+    pointLights[ goIndex ].intensity = intensity;
+
+    values.centerAndRadius->w = radius;
+    *values.color = Vec4( color.x, color.y, color.z, 1 );
 }
 
-float* teSpotLightAccessRadius( unsigned goIndex )
+void teSpotLightSetParams( unsigned goIndex, Vec3& position, const Vec3& color, float coneAngleDegrees, const Vec3& direction, float falloffRadius )
 {
-    unsigned tilerIndex = spotLights[ goIndex ].tilerIndex;
+    LightValues values;
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (!GetLightValues( GetSpotLightArrays(), goIndex, values ))
     {
-        return nullptr;
+        return;
     }
 
-    return &gLightTiler.spotLightCenterAndRadius[ tilerIndex ].w;
+    *values.centerAndRadius = Vec4( position.x, position.y, position.z, falloffRadius );
+    *values.color = Vec4( color.x, color.y, color.z, 1 );
+    *values.params = Vec4( direction.x, direction.y, direction.z, (float)cos( coneAngleDegrees * 3.14159265f / 180.0f ) );
 }
 
-float* teSpotLightAccessColor( unsigned goIndex )
+void SetPointLightPosition( unsigned goIndex, const Vec3& positionWS )
 {
-    unsigned tilerIndex = spotLights[ goIndex ].tilerIndex;
+    LightValues values;
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (!GetLightValues( GetPointLightArrays(), goIndex, values ))
     {
-        return nullptr;
+        return;
     }
 
-    return &gLightTiler.spotLightColors[ tilerIndex ].x;
+    values.centerAndRadius->x = positionWS.x;
+    values.centerAndRadius->y = positionWS.y;
+    values.centerAndRadius->z = positionWS.z;
 }
 
-float* teSpotLightAccessConeAngle( unsigned goIndex )
+void SetSpotLightPosition( unsigned goIndex, const Vec3& positionWS )
 {
-    unsigned tilerIndex = spotLights[ goIndex ].tilerIndex;
+    LightValues values;
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (!GetLightValues( GetSpotLightArrays(), goIndex, values ))
     {
-        return nullptr;
+        return;
     }
 
-    return &spotLights[ goIndex ].coneAngle;
+    values.centerAndRadius->x = positionWS.x;
+    values.centerAndRadius->y = positionWS.y;
+    values.centerAndRadius->z = positionWS.z;
+}
+
+// The pointers are valid until a light is added, removed, enabled or disabled.
+float* tePointLightAccessRadius( unsigned goIndex )
+{
+    LightValues values;
+
+    return GetLightValues( GetPointLightArrays(), goIndex, values ) ? &values.centerAndRadius->w : nullptr;
+}
+
+float* tePointLightAccessColor( unsigned goIndex )
+{
+    LightValues values;
+
+    return GetLightValues( GetPointLightArrays(), goIndex, values ) ? &values.color->x : nullptr;
+}
+
+float* teSpotLightAccessRadius( unsigned goIndex )
+{
+    LightValues values;
+
+    return GetLightValues( GetSpotLightArrays(), goIndex, values ) ? &values.centerAndRadius->w : nullptr;
+}
+
+float* teSpotLightAccessColor( unsigned goIndex )
+{
+    LightValues values;
+
+    return GetLightValues( GetSpotLightArrays(), goIndex, values ) ? &values.color->x : nullptr;
+}
+
+float* teSpotLightAccessConeAngle( unsigned goIndex )
+{
+    return spotLights[ goIndex ].isAdded ? &spotLights[ goIndex ].coneAngle : nullptr;
 }
 
 void tePointLightGetParams( unsigned goIndex, Vec3& outPosition, float& outRadius, Vec3& outColor, float& outIntensity )
 {
-    unsigned tilerIndex = pointLights[ goIndex ].tilerIndex;
+    LightValues values;
 
-    if (tilerIndex >= LightTiler::MaxLights)
+    if (!GetLightValues( GetPointLightArrays(), goIndex, values ))
     {
         return;
     }
 
-    outPosition.x = gLightTiler.pointLightCenterAndRadius[ tilerIndex ].x;
-    outPosition.y = gLightTiler.pointLightCenterAndRadius[ tilerIndex ].y;
-    outPosition.z = gLightTiler.pointLightCenterAndRadius[ tilerIndex ].z;
-    
-    outRadius = gLightTiler.pointLightCenterAndRadius[ tilerIndex ].w;
+    outPosition.x = values.centerAndRadius->x;
+    outPosition.y = values.centerAndRadius->y;
+    outPosition.z = values.centerAndRadius->z;
+
+    outRadius = values.centerAndRadius->w;
 
     outIntensity = pointLights[ goIndex ].intensity;
 
-    outColor.x = gLightTiler.pointLightColors[ tilerIndex ].x;
-    outColor.y = gLightTiler.pointLightColors[ tilerIndex ].y;
-    outColor.z = gLightTiler.pointLightColors[ tilerIndex ].z;
+    outColor.x = values.color->x;
+    outColor.y = values.color->y;
+    outColor.z = values.color->z;
 }
 
 unsigned GetMaxLightsPerTile( unsigned height )
@@ -260,30 +547,490 @@ void InitLightTiler( unsigned widthPixels, unsigned heightPixels )
     gLightTiler.lightIndexBuffer = CreateBuffer( maxLightsPerTile * tileCount * sizeof( unsigned ), "lightIndexBuffer" );
     gLightTiler.pointLightCenterAndRadiusBuffer = CreateBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "pointLightCenterAndRadiusBuffer" );
     gLightTiler.pointLightColorBuffer = CreateBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "pointLightColorBuffer" );
-    gLightTiler.pointLightCenterAndRadiusStagingBuffer = CreateStagingBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "pointLightCenterAndRadiusStagingBuffer" );
-    gLightTiler.pointLightColorStagingBuffer = CreateStagingBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "pointLightColorStagingBuffer" );
     gLightTiler.spotLightCenterAndRadiusBuffer = CreateBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "spotLightCenterAndRadiusBuffer" );
     gLightTiler.spotLightColorBuffer = CreateBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "spotLightColorBuffer" );
-    gLightTiler.spotLightCenterAndRadiusStagingBuffer = CreateStagingBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "spotLightCenterAndRadiusStagingBuffer" );
-    gLightTiler.spotLightColorStagingBuffer = CreateStagingBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "spotLightColorStagingBuffer" );
     gLightTiler.spotLightParamBuffer = CreateBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "spotLightParamBuffer" );
-    gLightTiler.spotLightParamStagingBuffer = CreateStagingBuffer( LightTiler::MaxLights * 4 * sizeof( float ), "spotLightParamStagingBuffer" );
+    gLightTiler.uploadedPointLightCount = 0;
+    gLightTiler.uploadedSpotLightCount = 0;
+
+    LightClusters& clusters = gLightClusters;
+    clusters.widthPixels = widthPixels;
+    clusters.heightPixels = heightPixels;
+    clusters.tilesX = (widthPixels + LightClusters::TileRes - 1) / LightClusters::TileRes;
+    clusters.tilesY = (heightPixels + LightClusters::TileRes - 1) / LightClusters::TileRes;
+    clusters.tilesXPadded = (clusters.tilesX + 3) & ~3u;
+
+    const unsigned clusterCount = clusters.tilesX * clusters.tilesY * LightClusters::SliceCount;
+    clusters.capacity = clusterCount * (LightClusters::AverageLightsPerCluster + 3);
+    clusters.data = teMallocArray< unsigned >( clusters.capacity, teMemoryTag::Renderer );
+    clusters.minX = teMallocArray< float >( LightClusters::SliceCount * clusters.tilesXPadded, teMemoryTag::Renderer );
+    clusters.maxX = teMallocArray< float >( LightClusters::SliceCount * clusters.tilesXPadded, teMemoryTag::Renderer );
+    clusters.minY = teMallocArray< float >( LightClusters::SliceCount * clusters.tilesY, teMemoryTag::Renderer );
+    clusters.maxY = teMallocArray< float >( LightClusters::SliceCount * clusters.tilesY, teMemoryTag::Renderer );
+    clusters.buffer = CreateBuffer( clusters.capacity * sizeof( unsigned ), "lightClusterBuffer" );
+}
+
+// Recomputes cluster bounds if the projection has changed. Pixel rows go down from the top of the screen like in Vulkan.
+static void UpdateClusterBounds( const Matrix& viewToClip )
+{
+    LightClusters& clusters = gLightClusters;
+
+    if (clusters.boundsProjection[ 0 ] == viewToClip.m[ 0 ] && clusters.boundsProjection[ 1 ] == viewToClip.m[ 5 ] && clusters.boundsProjection[ 2 ] == viewToClip.m[ 10 ])
+    {
+        return;
+    }
+
+    clusters.boundsProjection[ 0 ] = viewToClip.m[ 0 ];
+    clusters.boundsProjection[ 1 ] = viewToClip.m[ 5 ];
+    clusters.boundsProjection[ 2 ] = viewToClip.m[ 10 ];
+
+    // See Matrix::MakeProjection.
+    const float nearDepth = viewToClip.m[ 14 ] / viewToClip.m[ 10 ];
+    const float farDepth = viewToClip.m[ 14 ] / (viewToClip.m[ 10 ] + 1);
+    clusters.sliceScale = LightClusters::SliceCount / logf( farDepth / nearDepth );
+    clusters.sliceBias = -logf( nearDepth ) * clusters.sliceScale;
+
+    for (unsigned slice = 0; slice < LightClusters::SliceCount; ++slice)
+    {
+        const float sliceNear = nearDepth * powf( farDepth / nearDepth, slice / (float)LightClusters::SliceCount );
+        const float sliceFar = nearDepth * powf( farDepth / nearDepth, (slice + 1) / (float)LightClusters::SliceCount );
+        clusters.sliceNear[ slice ] = sliceNear;
+        clusters.sliceFar[ slice ] = sliceFar;
+
+        // Tile edges are lines through the origin, view x / depth = ndc x / x scale.
+        for (unsigned x = 0; x < clusters.tilesXPadded; ++x)
+        {
+            const unsigned i = slice * clusters.tilesXPadded + x;
+
+            if (x >= clusters.tilesX)
+            {
+                // Padding never intersects anything.
+                clusters.minX[ i ] = 1e30f;
+                clusters.maxX[ i ] = -1e30f;
+                continue;
+            }
+
+            const float slope0 = (2.0f * x * LightClusters::TileRes / clusters.widthPixels - 1) / viewToClip.m[ 0 ];
+            const float slope1 = (2.0f * (x + 1) * LightClusters::TileRes / clusters.widthPixels - 1) / viewToClip.m[ 0 ];
+            clusters.minX[ i ] = fminf( slope0 * sliceNear, slope0 * sliceFar );
+            clusters.maxX[ i ] = fmaxf( slope1 * sliceNear, slope1 * sliceFar );
+        }
+
+        for (unsigned y = 0; y < clusters.tilesY; ++y)
+        {
+            const unsigned i = slice * clusters.tilesY + y;
+            const float slope0 = (2.0f * y * LightClusters::TileRes / clusters.heightPixels - 1) / viewToClip.m[ 5 ];
+            const float slope1 = (2.0f * (y + 1) * LightClusters::TileRes / clusters.heightPixels - 1) / viewToClip.m[ 5 ];
+            const float minSlope = fminf( slope0, slope1 );
+            const float maxSlope = fmaxf( slope0, slope1 );
+            clusters.minY[ i ] = fminf( minSlope * sliceNear, minSlope * sliceFar );
+            clusters.maxY[ i ] = fmaxf( maxSlope * sliceNear, maxSlope * sliceFar );
+        }
+    }
+}
+
+static unsigned GetClusterSlice( float depth )
+{
+    const float slice = floorf( logf( fmaxf( depth, 1e-6f ) ) * gLightClusters.sliceScale + gLightClusters.sliceBias );
+
+    return slice < 0 ? 0 : (slice >= LightClusters::SliceCount ? LightClusters::SliceCount - 1 : (unsigned)slice);
+}
+
+static unsigned GetClusterTile( float slope, float projectionScale, unsigned sizePixels, unsigned tileCount )
+{
+    const float tile = floorf( (slope * projectionScale + 1) * 0.5f * sizePixels / LightClusters::TileRes );
+
+    return tile < 0 ? 0 : (tile >= tileCount ? tileCount - 1 : (unsigned)tile);
+}
+
+// Transforms a light to view space and finds the clusters that its bounding sphere's screen and depth bounds overlap.
+// @return false if the light is outside the depth range or has no radius.
+static bool GetClusterLight( const Vec4& centerAndRadius, const Matrix& worldToView, const Matrix& viewToClip, unsigned index, ClusterLight& outLight )
+{
+    const LightClusters& clusters = gLightClusters;
+
+    outLight.radius = centerAndRadius.w;
+    outLight.index = index;
+    Matrix::TransformPoint( Vec3( centerAndRadius.x, centerAndRadius.y, centerAndRadius.z ), worldToView, outLight.center );
+
+    const float depth = -outLight.center.z;
+    const float radius = outLight.radius;
+
+    if (radius <= 0 || depth + radius < clusters.sliceNear[ 0 ] || depth - radius > clusters.sliceFar[ LightClusters::SliceCount - 1 ])
+    {
+        return false;
+    }
+
+    outLight.slice0 = GetClusterSlice( depth - radius );
+    outLight.slice1 = GetClusterSlice( depth + radius );
+
+    // The sphere's x / depth is between the extremes of its bounding box corners, unless it's behind the near plane.
+    if (depth - radius <= clusters.sliceNear[ 0 ])
+    {
+        outLight.tileX0 = 0;
+        outLight.tileX1 = clusters.tilesX - 1;
+        outLight.tileY0 = 0;
+        outLight.tileY1 = clusters.tilesY - 1;
+        return true;
+    }
+
+    const float minSlopeX = fminf( (outLight.center.x - radius) / (depth - radius), (outLight.center.x - radius) / (depth + radius) );
+    const float maxSlopeX = fmaxf( (outLight.center.x + radius) / (depth - radius), (outLight.center.x + radius) / (depth + radius) );
+    const float minSlopeY = fminf( (outLight.center.y - radius) / (depth - radius), (outLight.center.y - radius) / (depth + radius) );
+    const float maxSlopeY = fmaxf( (outLight.center.y + radius) / (depth - radius), (outLight.center.y + radius) / (depth + radius) );
+    outLight.tileX0 = GetClusterTile( minSlopeX, viewToClip.m[ 0 ], clusters.widthPixels, clusters.tilesX );
+    outLight.tileX1 = GetClusterTile( maxSlopeX, viewToClip.m[ 0 ], clusters.widthPixels, clusters.tilesX );
+
+    // Y scale is negative, so the order can flip.
+    const unsigned tileY0 = GetClusterTile( minSlopeY, viewToClip.m[ 5 ], clusters.heightPixels, clusters.tilesY );
+    const unsigned tileY1 = GetClusterTile( maxSlopeY, viewToClip.m[ 5 ], clusters.heightPixels, clusters.tilesY );
+    outLight.tileY0 = tileY0 < tileY1 ? tileY0 : tileY1;
+    outLight.tileY1 = tileY0 < tileY1 ? tileY1 : tileY0;
+
+    return true;
+}
+
+// @return Bit i set if the sphere intersects cluster i of the 4 whose x bounds are given. The rest of the distance is distanceYZSq.
+static unsigned SphereClusterMask4( const float* minX, const float* maxX, float centerX, float radiusSq, float distanceYZSq )
+{
+#ifdef SIMD_SSE3
+    const __m128 center = _mm_set1_ps( centerX );
+    const __m128 dx = _mm_max_ps( _mm_max_ps( _mm_sub_ps( _mm_loadu_ps( minX ), center ), _mm_sub_ps( center, _mm_loadu_ps( maxX ) ) ), _mm_setzero_ps() );
+    const __m128 distanceSq = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_set1_ps( distanceYZSq ) );
+
+    return (unsigned)_mm_movemask_ps( _mm_cmple_ps( distanceSq, _mm_set1_ps( radiusSq ) ) );
+#else
+    unsigned mask = 0;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const float dx = fmaxf( fmaxf( minX[ i ] - centerX, centerX - maxX[ i ] ), 0 );
+        mask |= dx * dx + distanceYZSq <= radiusSq ? (1u << i) : 0;
+    }
+
+    return mask;
+#endif
+}
+
+// @return Bit i set if the spot light's cone can touch cluster i of the 4 whose x bounds are given. Clusters are
+//         approximated by their bounding spheres, which share y, z and y and z extents.
+static unsigned ConeClusterMask4( const float* minX, const float* maxX, const ClusterLight& spot, float centerY, float centerZ, float extentYZSq )
+{
+    const float toCenterY = centerY - spot.center.y;
+    const float toCenterZ = centerZ - spot.center.z;
+    const float toCenterYZSq = toCenterY * toCenterY + toCenterZ * toCenterZ;
+    const float alongYZ = toCenterY * spot.direction.y + toCenterZ * spot.direction.z;
+
+#ifdef SIMD_SSE3
+    const __m128 half = _mm_set1_ps( 0.5f );
+    const __m128 min4 = _mm_loadu_ps( minX );
+    const __m128 max4 = _mm_loadu_ps( maxX );
+    const __m128 toCenterX = _mm_sub_ps( _mm_mul_ps( _mm_add_ps( min4, max4 ), half ), _mm_set1_ps( spot.center.x ) );
+    const __m128 extentX = _mm_mul_ps( _mm_sub_ps( max4, min4 ), half );
+    const __m128 sphereRadius = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( extentX, extentX ), _mm_set1_ps( extentYZSq ) ) );
+    const __m128 toCenterSq = _mm_add_ps( _mm_mul_ps( toCenterX, toCenterX ), _mm_set1_ps( toCenterYZSq ) );
+    const __m128 along = _mm_add_ps( _mm_mul_ps( toCenterX, _mm_set1_ps( spot.direction.x ) ), _mm_set1_ps( alongYZ ) );
+    const __m128 acrossSq = _mm_max_ps( _mm_sub_ps( toCenterSq, _mm_mul_ps( along, along ) ), _mm_setzero_ps() );
+    const __m128 distance = _mm_sub_ps( _mm_mul_ps( _mm_set1_ps( spot.cosAngle ), _mm_sqrt_ps( acrossSq ) ), _mm_mul_ps( along, _mm_set1_ps( spot.sinAngle ) ) );
+    const __m128 isInAngle = _mm_cmple_ps( distance, sphereRadius );
+    const __m128 isInRange = _mm_and_ps( _mm_cmple_ps( along, _mm_add_ps( sphereRadius, _mm_set1_ps( spot.radius ) ) ),
+                                         _mm_cmpge_ps( along, _mm_sub_ps( _mm_setzero_ps(), sphereRadius ) ) );
+
+    return (unsigned)_mm_movemask_ps( _mm_and_ps( isInAngle, isInRange ) );
+#else
+    unsigned mask = 0;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        const float toCenterX = (minX[ i ] + maxX[ i ]) * 0.5f - spot.center.x;
+        const float extentX = (maxX[ i ] - minX[ i ]) * 0.5f;
+        const float sphereRadius = sqrtf( extentX * extentX + extentYZSq );
+        const float toCenterSq = toCenterX * toCenterX + toCenterYZSq;
+        const float along = toCenterX * spot.direction.x + alongYZ;
+        const float acrossSq = fmaxf( toCenterSq - along * along, 0 );
+        const float distance = spot.cosAngle * sqrtf( acrossSq ) - along * spot.sinAngle;
+        mask |= distance <= sphereRadius && along <= sphereRadius + spot.radius && along >= -sphereRadius ? (1u << i) : 0;
+    }
+
+    return mask;
+#endif
+}
+
+// Appends lights that touch the clusters of one row to the row's per-column lists.
+static void AssignRowLights( const ClusterLight* lights, const unsigned* sliceLights, unsigned sliceLightCount, unsigned slice, unsigned y,
+                             bool isSpot, unsigned* rowLights, unsigned* rowCounts )
+{
+    const LightClusters& clusters = gLightClusters;
+    const float* minX = &clusters.minX[ slice * clusters.tilesXPadded ];
+    const float* maxX = &clusters.maxX[ slice * clusters.tilesXPadded ];
+    const float minY = clusters.minY[ slice * clusters.tilesY + y ];
+    const float maxY = clusters.maxY[ slice * clusters.tilesY + y ];
+    const float minZ = -clusters.sliceFar[ slice ];
+    const float maxZ = -clusters.sliceNear[ slice ];
+
+    for (unsigned l = 0; l < sliceLightCount; ++l)
+    {
+        const ClusterLight& light = lights[ sliceLights[ l ] ];
+
+        if (y < light.tileY0 || y > light.tileY1)
+        {
+            continue;
+        }
+
+        const float dy = fmaxf( fmaxf( minY - light.center.y, light.center.y - maxY ), 0 );
+        const float dz = fmaxf( fmaxf( minZ - light.center.z, light.center.z - maxZ ), 0 );
+        const float distanceYZSq = dy * dy + dz * dz;
+        const float radiusSq = light.radius * light.radius;
+
+        if (distanceYZSq > radiusSq)
+        {
+            continue;
+        }
+
+        const float extentY = (maxY - minY) * 0.5f;
+        const float extentZ = (maxZ - minZ) * 0.5f;
+
+        // Starts from a multiple of 4. Clusters outside the light's range are skipped below.
+        for (unsigned x = light.tileX0 & ~3u; x <= light.tileX1; x += 4)
+        {
+            unsigned mask = SphereClusterMask4( &minX[ x ], &maxX[ x ], light.center.x, radiusSq, distanceYZSq );
+
+            if (isSpot && mask != 0)
+            {
+                mask &= ConeClusterMask4( &minX[ x ], &maxX[ x ], light, (minY + maxY) * 0.5f, (minZ + maxZ) * 0.5f, extentY * extentY + extentZ * extentZ );
+            }
+
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                const unsigned tileX = x + i;
+
+                if ((mask & (1u << i)) == 0 || tileX < light.tileX0 || tileX > light.tileX1 || rowCounts[ tileX ] == LightClusters::MaxLightsPerCluster)
+                {
+                    continue;
+                }
+
+                rowLights[ tileX * LightClusters::MaxLightsPerCluster + rowCounts[ tileX ]++ ] = light.index;
+            }
+        }
+    }
+}
+
+// Fills gLightClusters.data with each cluster's point and spot lights. Slices are independent apart from where
+// they're written, so this could be split into jobs per slice. Needs a perspective projection.
+// @return Number of elements written.
+unsigned AssignLightsToClusters( const Matrix& worldToView, const Matrix& viewToClip )
+{
+    TE_PROFILE_SCOPE( "AssignLightsToClusters" );
+
+    teAssert( viewToClip.m[ 11 ] == -1 );
+
+    LightClusters& clusters = gLightClusters;
+    UpdateClusterBounds( viewToClip );
+
+    ClusterLight* pointLightsVS = (ClusterLight*)teFrameAlloc( gLightTiler.pointLightCount * sizeof( ClusterLight ) );
+    ClusterLight* spotLightsVS = (ClusterLight*)teFrameAlloc( gLightTiler.spotLightCount * sizeof( ClusterLight ) );
+    unsigned pointLightCount = 0;
+    unsigned spotLightCount = 0;
+
+    for (unsigned i = 0; i < gLightTiler.pointLightCount; ++i)
+    {
+        pointLightCount += GetClusterLight( gLightTiler.pointLightCenterAndRadius[ i ], worldToView, viewToClip, i, pointLightsVS[ pointLightCount ] ) ? 1 : 0;
+    }
+
+    for (unsigned i = 0; i < gLightTiler.spotLightCount; ++i)
+    {
+        ClusterLight& spot = spotLightsVS[ spotLightCount ];
+
+        if (GetClusterLight( gLightTiler.spotLightCenterAndRadius[ i ], worldToView, viewToClip, i, spot ))
+        {
+            const Vec4& params = gLightTiler.spotLightParams[ i ];
+            Matrix::TransformDirection( Vec3( params.x, params.y, params.z ), worldToView, &spot.direction );
+            spot.direction = spot.direction.Normalized();
+            spot.cosAngle = params.w;
+            spot.sinAngle = sqrtf( fmaxf( 1 - params.w * params.w, 0 ) );
+            ++spotLightCount;
+        }
+    }
+
+    const unsigned clusterCount = clusters.tilesX * clusters.tilesY * LightClusters::SliceCount;
+    unsigned* sliceLights = (unsigned*)teFrameAlloc( (pointLightCount + spotLightCount) * sizeof( unsigned ) );
+    unsigned* rowLights = (unsigned*)teFrameAlloc( 2 * clusters.tilesX * LightClusters::MaxLightsPerCluster * sizeof( unsigned ) );
+    unsigned* rowCounts = (unsigned*)teFrameAlloc( 2 * clusters.tilesX * sizeof( unsigned ) );
+    unsigned* rowSpotLights = rowLights + clusters.tilesX * LightClusters::MaxLightsPerCluster;
+    unsigned* rowSpotCounts = rowCounts + clusters.tilesX;
+    unsigned cursor = clusterCount;
+    unsigned cutCount = 0;
+
+    for (unsigned slice = 0; slice < LightClusters::SliceCount; ++slice)
+    {
+        unsigned slicePointCount = 0;
+        unsigned sliceSpotCount = 0;
+
+        for (unsigned i = 0; i < pointLightCount; ++i)
+        {
+            if (slice >= pointLightsVS[ i ].slice0 && slice <= pointLightsVS[ i ].slice1)
+            {
+                sliceLights[ slicePointCount++ ] = i;
+            }
+        }
+
+        unsigned* sliceSpotLights = sliceLights + slicePointCount;
+
+        for (unsigned i = 0; i < spotLightCount; ++i)
+        {
+            if (slice >= spotLightsVS[ i ].slice0 && slice <= spotLightsVS[ i ].slice1)
+            {
+                sliceSpotLights[ sliceSpotCount++ ] = i;
+            }
+        }
+
+        for (unsigned y = 0; y < clusters.tilesY; ++y)
+        {
+            for (unsigned x = 0; x < clusters.tilesX; ++x)
+            {
+                rowCounts[ x ] = 0;
+                rowSpotCounts[ x ] = 0;
+            }
+
+            AssignRowLights( pointLightsVS, sliceLights, slicePointCount, slice, y, false, rowLights, rowCounts );
+            AssignRowLights( spotLightsVS, sliceSpotLights, sliceSpotCount, slice, y, true, rowSpotLights, rowSpotCounts );
+
+            for (unsigned x = 0; x < clusters.tilesX; ++x)
+            {
+                const unsigned clusterIndex = x + y * clusters.tilesX + slice * clusters.tilesX * clusters.tilesY;
+                clusters.data[ clusterIndex ] = cursor;
+
+                // Room is left for the sentinels of this and later clusters.
+                const unsigned room = clusters.capacity - cursor - 2 * (clusterCount - clusterIndex);
+                const unsigned pointCount = rowCounts[ x ] < room ? rowCounts[ x ] : room;
+                const unsigned spotCount = rowSpotCounts[ x ] < room - pointCount ? rowSpotCounts[ x ] : room - pointCount;
+                cutCount += rowCounts[ x ] + rowSpotCounts[ x ] - pointCount - spotCount;
+
+                for (unsigned i = 0; i < pointCount; ++i)
+                {
+                    clusters.data[ cursor++ ] = rowLights[ x * LightClusters::MaxLightsPerCluster + i ];
+                }
+
+                clusters.data[ cursor++ ] = LightClusters::Sentinel;
+
+                for (unsigned i = 0; i < spotCount; ++i)
+                {
+                    clusters.data[ cursor++ ] = rowSpotLights[ x * LightClusters::MaxLightsPerCluster + i ];
+                }
+
+                clusters.data[ cursor++ ] = LightClusters::Sentinel;
+            }
+        }
+    }
+
+    if (cutCount > 0)
+    {
+        teLog( teLogLevel::Warning, "Light cluster buffer is full, %u light assignments were cut\n", cutCount );
+    }
+
+    return cursor;
+}
+
+static bool IsLightChanged( const Vec4& light, const Vec4& uploaded )
+{
+    return light.x != uploaded.x || light.y != uploaded.y || light.z != uploaded.z || light.w != uploaded.w;
+}
+
+// Uploads the lights that differ from uploaded, and the lights at or after uploadedCount, and copies them to uploaded.
+// Changed lights that are close to each other are merged into one range, as a copy costs more than a few extra bytes.
+// @return false if the frame's upload ring was full. Nothing is uploaded then, and the lights are retried next frame.
+static bool UploadChangedLights( const teBuffer& buffer, const Vec4* lights, Vec4* uploaded, unsigned count, unsigned uploadedCount )
+{
+    constexpr unsigned MaxMergedGap = 4;
+
+    // Ranges are separated by at least one unchanged light.
+    BufferRange* ranges = (BufferRange*)teFrameAlloc( (count / 2 + 1) * sizeof( BufferRange ) );
+    unsigned rangeCount = 0;
+    unsigned rangeEnd = 0;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (i < uploadedCount && !IsLightChanged( lights[ i ], uploaded[ i ] ))
+        {
+            continue;
+        }
+
+        if (rangeCount > 0 && i - rangeEnd <= MaxMergedGap)
+        {
+            ranges[ rangeCount - 1 ].sizeBytes = (i + 1) * sizeof( Vec4 ) - ranges[ rangeCount - 1 ].offset;
+        }
+        else
+        {
+            ranges[ rangeCount ].offset = i * sizeof( Vec4 );
+            ranges[ rangeCount ].sizeBytes = sizeof( Vec4 );
+            ++rangeCount;
+        }
+
+        rangeEnd = i + 1;
+    }
+
+    if (!UploadBufferRanges( buffer, lights, ranges, rangeCount ))
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < rangeCount; ++i)
+    {
+        teMemcpy( (char*)uploaded + ranges[ i ].offset, (const char*)lights + ranges[ i ].offset, ranges[ i ].sizeBytes );
+    }
+
+    return true;
+}
+
+// Lights are uploaded through the frame's upload ring, so static lights aren't uploaded at all and the upload size depends on
+// how many lights changed instead of on MaxLights.
+static void UploadLights()
+{
+    LightTiler& tiler = gLightTiler;
+    const unsigned pointLightCount = tiler.pointLightCount;
+    const unsigned spotLightCount = tiler.spotLightCount;
+
+    const bool arePointCentersUploaded = UploadChangedLights( tiler.pointLightCenterAndRadiusBuffer, tiler.pointLightCenterAndRadius, tiler.uploadedPointLightCenterAndRadius, pointLightCount, tiler.uploadedPointLightCount );
+    const bool arePointColorsUploaded = UploadChangedLights( tiler.pointLightColorBuffer, tiler.pointLightColors, tiler.uploadedPointLightColors, pointLightCount, tiler.uploadedPointLightCount );
+
+    if (arePointCentersUploaded && arePointColorsUploaded)
+    {
+        tiler.uploadedPointLightCount = pointLightCount;
+    }
+
+    const bool areSpotCentersUploaded = UploadChangedLights( tiler.spotLightCenterAndRadiusBuffer, tiler.spotLightCenterAndRadius, tiler.uploadedSpotLightCenterAndRadius, spotLightCount, tiler.uploadedSpotLightCount );
+    const bool areSpotColorsUploaded = UploadChangedLights( tiler.spotLightColorBuffer, tiler.spotLightColors, tiler.uploadedSpotLightColors, spotLightCount, tiler.uploadedSpotLightCount );
+    const bool areSpotParamsUploaded = UploadChangedLights( tiler.spotLightParamBuffer, tiler.spotLightParams, tiler.uploadedSpotLightParams, spotLightCount, tiler.uploadedSpotLightCount );
+
+    if (areSpotCentersUploaded && areSpotColorsUploaded && areSpotParamsUploaded)
+    {
+        tiler.uploadedSpotLightCount = spotLightCount;
+    }
 }
 
 void CullLights( const teShader& shader, const Matrix& localToView, const Matrix& viewToClip, unsigned widthPixels, unsigned heightPixels, unsigned depthNormalsTextureIndex )
 {
-    UpdateStagingBuffer( gLightTiler.pointLightCenterAndRadiusStagingBuffer, gLightTiler.pointLightCenterAndRadius, LightTiler::MaxLights * 4 * sizeof( float ), 0 );
-    UpdateStagingBuffer( gLightTiler.pointLightColorStagingBuffer, gLightTiler.pointLightColors, LightTiler::MaxLights * 4 * sizeof( float ), 0 );
+    TE_PROFILE_SCOPE( "CullLights" );
+
+    UploadLights();
+
+    gLightClusters.isActive = false;
 
-    UpdateStagingBuffer( gLightTiler.spotLightCenterAndRadiusStagingBuffer, gLightTiler.spotLightCenterAndRadius, LightTiler::MaxLights * 4 * sizeof( float ), 0 );
-    UpdateStagingBuffer( gLightTiler.spotLightColorStagingBuffer, gLightTiler.spotLightColors, LightTiler::MaxLights * 4 * sizeof( float ), 0 );
-    UpdateStagingBuffer( gLightTiler.spotLightParamStagingBuffer, gLightTiler.spotLightParams, LightTiler::MaxLights * 4 * sizeof( float ), 0 );
+    if (gLightClusters.isEnabled)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        BufferRange range;
+        range.sizeBytes = AssignLightsToClusters( localToView, viewToClip ) * sizeof( unsigned );
+        gLightClusters.isActive = UploadBufferRanges( gLightClusters.buffer, gLightClusters.data, &range, 1 );
 
-    CopyBuffer( gLightTiler.pointLightCenterAndRadiusStagingBuffer, gLightTiler.pointLightCenterAndRadiusBuffer );
-    CopyBuffer( gLightTiler.pointLightColorStagingBuffer, gLightTiler.pointLightColorBuffer );
-    CopyBuffer( gLightTiler.spotLightCenterAndRadiusStagingBuffer, gLightTiler.spotLightCenterAndRadiusBuffer );
-    CopyBuffer( gLightTiler.spotLightColorStagingBuffer, gLightTiler.spotLightColorBuffer );
-    CopyBuffer( gLightTiler.spotLightParamStagingBuffer, gLightTiler.spotLightParamBuffer );
+        StatSet( teStat::CpuLightClusteringMs, std::chrono::duration< float, std::milli >( std::chrono::steady_clock::now() - startTime ).count() );
+
+        if (gLightClusters.isActive)
+        {
+            return;
+        }
+    }
 
     ShaderParams params = {};
 
@@ -1,5 +1,6 @@
 #include "material.h"
 #include "shader.h"
+#include "te_stdlib.h"
 #include "texture.h"
 #include "vec3.h"
 
@@ -10,20 +11,45 @@ struct MaterialImpl
     Vec4 tint{ 1, 1, 1, 1 };
 };
 
-static constexpr unsigned MaxMaterial = 500;
-MaterialImpl materials[ MaxMaterial ];
+void EngineEnsureInitialized();
+
+MaterialImpl* materials = nullptr;
+static unsigned materialCapacity = 0;
 unsigned materialCount = 0;
+// Indices of destroyed materials, reused before materialCount grows.
+static unsigned* freeMaterials = nullptr;
+static unsigned freeMaterialCount = 0;
+
+void MaterialInitStorage( unsigned capacity )
+{
+    materials = teMallocArray< MaterialImpl >( capacity, teMemoryTag::Renderer );
+    freeMaterials = teMallocArray< unsigned >( capacity, teMemoryTag::Renderer );
+    materialCapacity = capacity;
+}
 
 teMaterial teCreateMaterial( const teShader& shader )
 {
+    EngineEnsureInitialized();
+    teAssert( freeMaterialCount > 0 || materialCount < materialCapacity );
+
     teMaterial outMaterial;
-    outMaterial.index = materialCount++;
+    outMaterial.index = freeMaterialCount > 0 ? freeMaterials[ --freeMaterialCount ] : materialCount++;
     
+    materials[ outMaterial.index ] = MaterialImpl();
     materials[ outMaterial.index ].shader = shader;
     
     return outMaterial;
 }
 
+void teDestroyMaterial( const teMaterial& material )
+{
+    teAssert( material.index < materialCount );
+    teAssert( freeMaterialCount < materialCapacity );
+
+    materials[ material.index ] = MaterialImpl();
+    freeMaterials[ freeMaterialCount++ ] = material.index;
+}
+
 void teMaterialSetTexture2D( const teMaterial& material, const struct teTexture2D& tex, unsigned slot )
 {
     if (slot < 3)
@@ -4,16 +4,29 @@
 #include "file.h"
 #include "te_stdlib.h"
 #include "vec3.h"
+#include "matrix.h"
+#include "profiler.h"
+#include <math.h>
 #include <stdint.h>
+#include <new>
 
 unsigned AddPositions( const float* positions, unsigned bytes );
 unsigned AddNormals( const float* normals, unsigned bytes );
 unsigned AddTangents( const float* tangents, unsigned bytes );
 unsigned AddIndices( const unsigned short* indices, unsigned bytes );
 unsigned AddUVs( const float* uvs, unsigned bytes );
-
-static constexpr unsigned MaxMeshes = 10000;
-static constexpr unsigned MaxMaterials = 1000;
+void ReadIndices( unsigned offset, unsigned bytes, unsigned short* outIndices );
+void ReadUVs( unsigned offset, unsigned bytes, float* outUVs );
+void ReadPositions( unsigned offset, unsigned bytes, float* outPositions );
+void ReadNormals( unsigned offset, unsigned bytes, float* outNormals );
+void ReadTangents( unsigned offset, unsigned bytes, float* outTangents );
+void EngineEnsureInitialized();
+
+// Every mesh renderer has room for this many submeshes, so it dominates mesh renderer memory. Can be lowered with -D.
+#ifndef TE_MAX_SUBMESHES
+#define TE_MAX_SUBMESHES 1000
+#endif
+static constexpr unsigned MaxMaterials = TE_MAX_SUBMESHES;
 
 // Copied from meshoptimizer.
 struct meshopt_Meshlet
@@ -73,15 +86,84 @@ struct MeshRenderer
     teMaterial materials[ MaxMaterials ];
     bool       isSubMeshCulled[ MaxMaterials ];
     bool       enabled = true;
+    bool       isOccluder = false;
+    bool       isStatic = false;
+};
+
+static constexpr unsigned InstanceBatchSize = 64;
+
+// Instance origins' bounds and the largest instance scale, so batch bounds don't have to be recomputed when the mesh changes.
+struct InstanceBatch
+{
+    Vec3  originMin;
+    Vec3  originMax;
+    float maxScale = 0;
+};
+
+// Instanced mesh renderers use MeshRenderer's mesh and materials.
+struct MeshInstances
+{
+    Matrix*        localMatrices = nullptr; // Instance to game object space.
+    Vec4*          tints = nullptr;
+    InstanceBatch* batches = nullptr;
+    unsigned       count = 0;
+    unsigned       capacity = 0;
 };
 
-static MeshImpl meshes[ MaxMeshes ];
+static MeshImpl* meshes = nullptr;
 static unsigned meshIndex = 0;
-static struct MeshRenderer meshRenderers[ MaxMeshes ];
+static unsigned meshCapacity = 0;
+// Indexed by game object.
+static struct MeshRenderer* meshRenderers = nullptr;
+static MeshInstances* meshInstances = nullptr;
+static unsigned meshRendererCapacity = 0;
+static teArena meshArena = { nullptr, 1024 * 1024, 0, 0, teMemoryTag::Mesh }; // Meshes live until exit, so their CPU data is never freed individually.
+
+void MeshInitStorage( unsigned maxMeshes, unsigned maxGameObjects )
+{
+    meshes = teMallocArray< MeshImpl >( maxMeshes, teMemoryTag::Mesh );
+    meshCapacity = maxMeshes;
+    meshRenderers = teMallocArray< struct MeshRenderer >( maxGameObjects, teMemoryTag::Mesh );
+    meshInstances = teMallocArray< MeshInstances >( maxGameObjects, teMemoryTag::Mesh );
+    meshRendererCapacity = maxGameObjects;
+}
+
+static SubMesh* AllocateSubMeshes( unsigned count )
+{
+    SubMesh* subMeshes = (SubMesh*)teArenaAlloc( meshArena, count * sizeof( SubMesh ), alignof( SubMesh ) );
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        new (&subMeshes[ i ]) SubMesh();
+    }
+
+    return subMeshes;
+}
+
+static void CreateMeshletBuffers( SubMesh& subMesh )
+{
+    const unsigned meshletBufferSize = subMesh.meshletCount * sizeof( meshopt_Meshlet );
+    subMesh.meshletBuffer = CreateBuffer( meshletBufferSize, "meshletBuffer" );
+    subMesh.meshletStagingBuffer = CreateStagingBuffer( meshletBufferSize, "meshletStagingBuffer" );
+    UpdateStagingBuffer( subMesh.meshletStagingBuffer, subMesh.meshlets, meshletBufferSize, 0 );
+    CopyBuffer( subMesh.meshletStagingBuffer, subMesh.meshletBuffer );
+
+    const unsigned meshletVerticesBufferSize = subMesh.meshletVerticesCount * sizeof( unsigned );
+    subMesh.meshletVertexBuffer = CreateBuffer( meshletVerticesBufferSize, "meshletVertexBuffer" );
+    subMesh.meshletVertexStagingBuffer = CreateStagingBuffer( meshletVerticesBufferSize, "meshletVertexStagingBuffer" );
+    UpdateStagingBuffer( subMesh.meshletVertexStagingBuffer, subMesh.meshletVertices, meshletVerticesBufferSize, 0 );
+    CopyBuffer( subMesh.meshletVertexStagingBuffer, subMesh.meshletVertexBuffer );
+
+    const unsigned meshletTrianglesBufferSize = subMesh.meshletTriangleCount * sizeof( uint32_t );
+    subMesh.meshletTriangleBuffer = CreateBuffer( meshletTrianglesBufferSize, "meshletTrianglesBuffer" );
+    subMesh.meshletTriangleStagingBuffer = CreateStagingBuffer( meshletTrianglesBufferSize, "meshletTrianglesStagingBuffer" );
+    UpdateStagingBuffer( subMesh.meshletTriangleStagingBuffer, subMesh.meshletTriangles, meshletTrianglesBufferSize, 0 );
+    CopyBuffer( subMesh.meshletTriangleStagingBuffer, subMesh.meshletTriangleBuffer );
+}
 
 teBuffer& GetMeshletVertexBuffer( unsigned index, unsigned subMeshIndex )
 {
-    teAssert( index < MaxMeshes );
+    teAssert( index < meshCapacity );
     teAssert( subMeshIndex < meshes[ index ].subMeshCount );
 
     return meshes[ index ].subMeshes[ subMeshIndex ].meshletVertexBuffer;
@@ -89,7 +171,7 @@ teBuffer& GetMeshletVertexBuffer( unsigned index, unsigned subMeshIndex )
 
 teBuffer& GetMeshletTriangleBuffer( unsigned index, unsigned subMeshIndex )
 {
-    teAssert( index < MaxMeshes );
+    teAssert( index < meshCapacity );
     teAssert( subMeshIndex < meshes[ index ].subMeshCount );
 
     return meshes[ index ].subMeshes[ subMeshIndex ].meshletTriangleBuffer;
@@ -97,7 +179,7 @@ teBuffer& GetMeshletTriangleBuffer( unsigned index, unsigned subMeshIndex )
 
 teBuffer& GetMeshletBuffer( unsigned index, unsigned subMeshIndex )
 {
-    teAssert( index < MaxMeshes );
+    teAssert( index < meshCapacity );
     teAssert( subMeshIndex < meshes[ index ].subMeshCount );
 
     return meshes[ index ].subMeshes[ subMeshIndex ].meshletBuffer;
@@ -105,7 +187,7 @@ teBuffer& GetMeshletBuffer( unsigned index, unsigned subMeshIndex )
 
 unsigned GetMeshletCount( unsigned index, unsigned subMeshIndex )
 {
-    teAssert( index < MaxMeshes );
+    teAssert( index < meshCapacity );
     teAssert( subMeshIndex < meshes[ index ].subMeshCount );
     
     return meshes[ index ].subMeshes[ subMeshIndex ].meshletCount;
@@ -113,7 +195,8 @@ unsigned GetMeshletCount( unsigned index, unsigned subMeshIndex )
 
 teMesh teCreateCubeMesh()
 {
-    teAssert( meshIndex < MaxMeshes );
+    EngineEnsureInitialized();
+    teAssert( meshIndex + 1 < meshCapacity );
 
     teMesh outMesh;
     outMesh.index = ++meshIndex;
@@ -152,7 +235,7 @@ teMesh teCreateCubeMesh()
     };
 
     meshes[ outMesh.index ].subMeshCount = 1;
-    meshes[ outMesh.index ].subMeshes = new SubMesh[ 1 ]();
+    meshes[ outMesh.index ].subMeshes = AllocateSubMeshes( 1 );
     meshes[ outMesh.index ].subMeshes[ 0 ].positionOffset = AddPositions( positions, sizeof( positions ) );
     meshes[ outMesh.index ].subMeshes[ 0 ].positionCount = 30;
     meshes[ outMesh.index ].subMeshes[ 0 ].uvOffset = AddUVs( uvs, sizeof( uvs ) );
@@ -166,7 +249,7 @@ teMesh teCreateCubeMesh()
     meshes[ outMesh.index ].subMeshes[ 0 ].tangentOffset = AddTangents( tangents, sizeof( tangents ) );
     meshes[ outMesh.index ].subMeshes[ 0 ].tangentCount = 30;
     meshes[ outMesh.index ].subMeshes[ 0 ].nameIndex = 0;
-    meshes[ outMesh.index ].names = (char*)teMalloc( 10 );
+    meshes[ outMesh.index ].names = (char*)teArenaAlloc( meshArena, 10, 1 );
     meshes[ outMesh.index ].names[ 0 ] = 0;
 
     return outMesh;
@@ -174,7 +257,8 @@ teMesh teCreateCubeMesh()
 
 teMesh teCreateQuadMesh()
 {
-    teAssert( meshIndex < MaxMeshes );
+    EngineEnsureInitialized();
+    teAssert( meshIndex + 1 < meshCapacity );
 
     teMesh outMesh;
     outMesh.index = ++meshIndex;
@@ -210,7 +294,7 @@ teMesh teCreateQuadMesh()
     };
 
     meshes[ outMesh.index ].subMeshCount = 1;
-    meshes[ outMesh.index ].subMeshes = new SubMesh[ 1 ]();
+    meshes[ outMesh.index ].subMeshes = AllocateSubMeshes( 1 );
     meshes[ outMesh.index ].subMeshes[ 0 ].positionOffset = AddPositions( positions, sizeof( positions ) );
     meshes[ outMesh.index ].subMeshes[ 0 ].positionCount = 4;
     meshes[ outMesh.index ].subMeshes[ 0 ].uvOffset = AddUVs( uvs, sizeof( uvs ) );
@@ -223,124 +307,272 @@ teMesh teCreateQuadMesh()
     meshes[ outMesh.index ].subMeshes[ 0 ].normalCount = 4;
     meshes[ outMesh.index ].subMeshes[ 0 ].tangentOffset = AddTangents( tangents, sizeof( tangents ) );
     meshes[ outMesh.index ].subMeshes[ 0 ].tangentCount = 4;
-    meshes[ outMesh.index ].names = (char*)teMalloc( 10 );
+    meshes[ outMesh.index ].names = (char*)teArenaAlloc( meshArena, 10, 1 );
     meshes[ outMesh.index ].names[ 0 ] = 0;
 
     return outMesh;
 }
 
-teMesh teLoadMesh( const teFile& file )
+// CPU side of a .t3d file. ParseMesh only reads the file's bytes and allocates, so streaming workers can run it and
+// CreateMesh only has to append the vertex streams and create the GPU buffers.
+struct MeshData
 {
-    teAssert( meshIndex < MaxMeshes );
+    struct SubMeshData
+    {
+        Vec3 aabbMin;
+        Vec3 aabbMax;
+        const unsigned short* indices = nullptr; // Points into the file.
+        const float* positions = nullptr; // Points into the file.
+        const float* uvs = nullptr; // Points into the file.
+        const float* normals = nullptr; // Points into the file.
+        const float* tangents = nullptr; // Points into the file.
+        meshopt_Meshlet* meshlets = nullptr; // Points into cpuData.
+        unsigned* meshletVertices = nullptr; // Points into cpuData.
+        uint32_t* meshletTriangles = nullptr; // Points into cpuData.
+        unsigned faceCount = 0;
+        unsigned vertexCount = 0;
+        unsigned meshletCount = 0;
+        unsigned meshletVerticesCount = 0;
+        unsigned meshletTriangleCount = 0;
+        unsigned nameIndex = 0;
+    };
 
-    if (!file.data)
+    SubMeshData* subMeshes = nullptr; // Allocated with the MeshData.
+    unsigned subMeshCount = 0;
+    unsigned char* cpuData = nullptr; // Meshlets and names. The created mesh keeps it until exit.
+    char* names = nullptr; // Points into cpuData.
+};
+
+// Reads a .t3d file front to back. A read past the end of the file marks the reader invalid and returns nullptr.
+struct MeshReader
+{
+    const unsigned char* pointer = nullptr;
+    const unsigned char* end = nullptr;
+    bool isValid = true;
+
+    const unsigned char* Read( size_t bytes )
     {
-        return teCreateCubeMesh();
+        if (!isValid || (size_t)(end - pointer) < bytes)
+        {
+            isValid = false;
+            return nullptr;
+        }
+
+        const unsigned char* outData = pointer;
+        pointer += bytes;
+        return outData;
     }
 
-    teMesh outMesh;
-    outMesh.index = ++meshIndex;
-    strncpy( outMesh.path, file.path, sizeof( outMesh.path ) );
+    unsigned ReadUnsigned()
+    {
+        unsigned outValue = 0;
+        const unsigned char* data = Read( 4 );
+
+        if (data)
+        {
+            memcpy( &outValue, data, 4 );
+        }
+
+        return outValue;
+    }
+};
+
+// Safe to call from any thread. The vertex streams point into file, so it must outlive CreateMesh.
+// @return nullptr if the file isn't a .t3d file of the current version or is truncated.
+MeshData* ParseMesh( const teFile& file )
+{
+    TE_PROFILE_SCOPE( "ParseMesh" );
 
     // Header is something like "t3d0003" where the last numbers are version that is incremented when reading compatibility breaks.
-    if (file.data[ 0 ] != 't' || file.data[ 1 ] != '3' || file.data[ 2 ] != 'd' || file.data[ 6 ] != '4')
+    if (!file.data || file.size < 12 || file.data[ 0 ] != 't' || file.data[ 1 ] != '3' || file.data[ 2 ] != 'd' || file.data[ 6 ] != '4')
     {
         tePrint( "%s has wrong version!\n", file.path );
-        return outMesh;
+        return nullptr;
     }
 
-    unsigned char* pointer = &file.data[ 8 ];
-    meshes[ outMesh.index ].subMeshCount = *((unsigned*)pointer);
-    meshes[ outMesh.index ].subMeshes = new SubMesh[ meshes[ outMesh.index ].subMeshCount ]();
-    pointer += 4;
+    MeshReader reader;
+    reader.pointer = &file.data[ 8 ];
+    reader.end = file.data + file.size;
 
-    for (unsigned m = 0; m < meshes[ outMesh.index ].subMeshCount; ++m)
+    const unsigned subMeshCount = reader.ReadUnsigned();
+
+    // Every submesh has at least its AABB and six counts.
+    if (subMeshCount > (size_t)(reader.end - reader.pointer) / (6 * 4 + 6 * 4))
     {
-        meshes[ outMesh.index ].subMeshes[ m ].aabbMin.x = *((float*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].aabbMin.y = *((float*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].aabbMin.z = *((float*)pointer);
-
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].aabbMax.x = *((float*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].aabbMax.y = *((float*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].aabbMax.z = *((float*)pointer);
-
-        pointer += 4;
-        const unsigned faceCount = *((unsigned*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].indicesOffset = AddIndices( (const unsigned short*)pointer, faceCount * 2 * 3 );
-        meshes[ outMesh.index ].subMeshes[ m ].indexCount = faceCount;
-        pointer += faceCount * 2 * 3;
-
-        if (faceCount % 2 != 0)
+        tePrint( "%s is truncated!\n", file.path );
+        return nullptr;
+    }
+
+    MeshData* data = (MeshData*)teMalloc( sizeof( MeshData ) + subMeshCount * sizeof( MeshData::SubMeshData ), teMemoryTag::Mesh );
+    new (data) MeshData();
+    data->subMeshes = (MeshData::SubMeshData*)(data + 1);
+    data->subMeshCount = subMeshCount;
+
+    // Meshlets and names are copied to cpuData after all sizes are known, so their file locations are kept until then.
+    const unsigned char** meshletSources = teMallocArray< const unsigned char* >( subMeshCount * 3 + 1, teMemoryTag::Mesh );
+    size_t cpuDataBytes = 0;
+
+    for (unsigned m = 0; m < subMeshCount; ++m)
+    {
+        MeshData::SubMeshData& subMesh = *new (&data->subMeshes[ m ]) MeshData::SubMeshData();
+
+        const unsigned char* aabb = reader.Read( 6 * 4 );
+
+        if (aabb)
+        {
+            memcpy( &subMesh.aabbMin.x, aabb + 0, 4 );
+            memcpy( &subMesh.aabbMin.y, aabb + 4, 4 );
+            memcpy( &subMesh.aabbMin.z, aabb + 8, 4 );
+            memcpy( &subMesh.aabbMax.x, aabb + 12, 4 );
+            memcpy( &subMesh.aabbMax.y, aabb + 16, 4 );
+            memcpy( &subMesh.aabbMax.z, aabb + 20, 4 );
+        }
+
+        subMesh.faceCount = reader.ReadUnsigned();
+        subMesh.indices = (const unsigned short*)reader.Read( (size_t)subMesh.faceCount * 2 * 3 );
+
+        if (subMesh.faceCount % 2 != 0)
         {
-            pointer += 2;
+            reader.Read( 2 );
         }
 
-        const unsigned vertexCount = *((unsigned*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].positionOffset = AddPositions( (float*)pointer, vertexCount * 3 * 4 );
-        meshes[ outMesh.index ].subMeshes[ m ].positionCount = vertexCount;
-        pointer += vertexCount * 3 * 4;
-        meshes[ outMesh.index ].subMeshes[ m ].uvOffset = AddUVs( (float*)pointer, vertexCount * 2 * 4 );
-        meshes[ outMesh.index ].subMeshes[ m ].uvCount = vertexCount;
-        pointer += vertexCount * 2 * 4;
-        meshes[ outMesh.index ].subMeshes[ m ].normalOffset = AddNormals( (float*)pointer, vertexCount * 3 * 4 );
-        meshes[ outMesh.index ].subMeshes[ m ].normalCount = vertexCount;
-        pointer += vertexCount * 3 * 4;
-        meshes[ outMesh.index ].subMeshes[ m ].tangentOffset = AddTangents( (float*)pointer, vertexCount * 4 * 4 );
-        meshes[ outMesh.index ].subMeshes[ m ].tangentCount = vertexCount;
-        pointer += vertexCount * 4 * 4;
-        meshes[ outMesh.index ].subMeshes[ m ].meshletCount = *((unsigned*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].meshlets = (meshopt_Meshlet*)teMalloc( meshes[ outMesh.index ].subMeshes[ m ].meshletCount * sizeof( meshopt_Meshlet ) );
-        memcpy( meshes[ outMesh.index ].subMeshes[ m ].meshlets, pointer, meshes[ outMesh.index ].subMeshes[ m ].meshletCount * sizeof( meshopt_Meshlet ) );
-        pointer += meshes[ outMesh.index ].subMeshes[ m ].meshletCount * sizeof( meshopt_Meshlet );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletVerticesCount = *((unsigned*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].meshletVertices = (unsigned*)teMalloc( meshes[ outMesh.index ].subMeshes[ m ].meshletVerticesCount * sizeof( unsigned ) );
-        memcpy( meshes[ outMesh.index ].subMeshes[ m ].meshletVertices, pointer, meshes[ outMesh.index ].subMeshes[ m ].meshletVerticesCount * sizeof( unsigned ) );
-        pointer += meshes[ outMesh.index ].subMeshes[ m ].meshletVerticesCount * sizeof( unsigned );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleCount = *((unsigned*)pointer);
-        pointer += 4;
-        meshes[ outMesh.index ].subMeshes[ m ].meshletTriangles = (uint32_t*)teMalloc( meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleCount * sizeof( uint32_t ) );
-        memcpy( meshes[ outMesh.index ].subMeshes[ m ].meshletTriangles, pointer, meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleCount * sizeof( uint32_t ) );
-        pointer += meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleCount * sizeof( uint32_t );
-
-        meshes[ outMesh.index ].subMeshes[ m ].nameIndex = *((unsigned*)pointer);
-        pointer += 4;
-
-        const unsigned meshletBufferSize = meshes[ outMesh.index ].subMeshes[ m ].meshletCount * sizeof( meshopt_Meshlet );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletBuffer = CreateBuffer( meshletBufferSize, "meshletBuffer" );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletStagingBuffer = CreateStagingBuffer( meshletBufferSize, "meshletStagingBuffer" );
-        UpdateStagingBuffer( meshes[ outMesh.index ].subMeshes[ m ].meshletStagingBuffer, meshes[ outMesh.index ].subMeshes[ m ].meshlets, meshletBufferSize, 0 );
-        CopyBuffer( meshes[ outMesh.index ].subMeshes[ m ].meshletStagingBuffer, meshes[ outMesh.index ].subMeshes[ m ].meshletBuffer );
-
-        const unsigned meshletVerticesBufferSize = meshes[ outMesh.index ].subMeshes[ m ].meshletVerticesCount * sizeof( unsigned );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletVertexBuffer = CreateBuffer( meshletVerticesBufferSize, "meshletVertexBuffer" );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletVertexStagingBuffer = CreateStagingBuffer( meshletVerticesBufferSize, "meshletVertexStagingBuffer" );
-        UpdateStagingBuffer( meshes[ outMesh.index ].subMeshes[ m ].meshletVertexStagingBuffer, meshes[ outMesh.index ].subMeshes[ m ].meshletVertices, meshletVerticesBufferSize, 0 );
-        CopyBuffer( meshes[ outMesh.index ].subMeshes[ m ].meshletVertexStagingBuffer, meshes[ outMesh.index ].subMeshes[ m ].meshletVertexBuffer );
-
-        const unsigned meshletTrianglesBufferSize = meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleCount * sizeof( uint32_t );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleBuffer = CreateBuffer( meshletTrianglesBufferSize, "meshletTrianglesBuffer" );
-        meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleStagingBuffer = CreateStagingBuffer( meshletTrianglesBufferSize, "meshletTrianglesStagingBuffer" );
-        UpdateStagingBuffer( meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleStagingBuffer, meshes[ outMesh.index ].subMeshes[ m ].meshletTriangles, meshletTrianglesBufferSize, 0 );
-        CopyBuffer( meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleStagingBuffer, meshes[ outMesh.index ].subMeshes[ m ].meshletTriangleBuffer );
+        subMesh.vertexCount = reader.ReadUnsigned();
+        subMesh.positions = (const float*)reader.Read( (size_t)subMesh.vertexCount * 3 * 4 );
+        subMesh.uvs = (const float*)reader.Read( (size_t)subMesh.vertexCount * 2 * 4 );
+        subMesh.normals = (const float*)reader.Read( (size_t)subMesh.vertexCount * 3 * 4 );
+        subMesh.tangents = (const float*)reader.Read( (size_t)subMesh.vertexCount * 4 * 4 );
+
+        subMesh.meshletCount = reader.ReadUnsigned();
+        meshletSources[ m * 3 + 0 ] = reader.Read( (size_t)subMesh.meshletCount * sizeof( meshopt_Meshlet ) );
+        subMesh.meshletVerticesCount = reader.ReadUnsigned();
+        meshletSources[ m * 3 + 1 ] = reader.Read( (size_t)subMesh.meshletVerticesCount * sizeof( unsigned ) );
+        subMesh.meshletTriangleCount = reader.ReadUnsigned();
+        meshletSources[ m * 3 + 2 ] = reader.Read( (size_t)subMesh.meshletTriangleCount * sizeof( uint32_t ) );
+        subMesh.nameIndex = reader.ReadUnsigned();
+
+        if (!reader.isValid)
+        {
+            break;
+        }
+
+        cpuDataBytes += (size_t)subMesh.meshletCount * sizeof( meshopt_Meshlet ) + (size_t)subMesh.meshletVerticesCount * sizeof( unsigned ) + (size_t)subMesh.meshletTriangleCount * sizeof( uint32_t );
+    }
+
+    const unsigned namesSize = reader.ReadUnsigned();
+    meshletSources[ subMeshCount * 3 ] = reader.Read( namesSize );
+
+    if (!reader.isValid)
+    {
+        tePrint( "%s is truncated!\n", file.path );
+        teFree( meshletSources );
+        teFree( data );
+        return nullptr;
+    }
+
+    // Meshlet arrays are 4-byte elements, so they stay aligned when packed back to back.
+    data->cpuData = (unsigned char*)teMalloc( cpuDataBytes + namesSize, teMemoryTag::Mesh );
+    unsigned char* cpuPointer = data->cpuData;
+
+    for (unsigned m = 0; m < subMeshCount; ++m)
+    {
+        MeshData::SubMeshData& subMesh = data->subMeshes[ m ];
+
+        subMesh.meshlets = (meshopt_Meshlet*)cpuPointer;
+        memcpy( cpuPointer, meshletSources[ m * 3 + 0 ], subMesh.meshletCount * sizeof( meshopt_Meshlet ) );
+        cpuPointer += subMesh.meshletCount * sizeof( meshopt_Meshlet );
+
+        subMesh.meshletVertices = (unsigned*)cpuPointer;
+        memcpy( cpuPointer, meshletSources[ m * 3 + 1 ], subMesh.meshletVerticesCount * sizeof( unsigned ) );
+        cpuPointer += subMesh.meshletVerticesCount * sizeof( unsigned );
+
+        subMesh.meshletTriangles = (uint32_t*)cpuPointer;
+        memcpy( cpuPointer, meshletSources[ m * 3 + 2 ], subMesh.meshletTriangleCount * sizeof( uint32_t ) );
+        cpuPointer += subMesh.meshletTriangleCount * sizeof( uint32_t );
+    }
+
+    data->names = (char*)cpuPointer;
+    memcpy( cpuPointer, meshletSources[ subMeshCount * 3 ], namesSize );
+
+    teFree( meshletSources );
+
+    return data;
+}
+
+// Must be called on the render thread. Takes ownership of data and frees it, except for cpuData which the mesh keeps.
+teMesh CreateMesh( const char* path, MeshData* data )
+{
+    TE_PROFILE_SCOPE( "CreateMesh" );
+
+    EngineEnsureInitialized();
+    teAssert( meshIndex + 1 < meshCapacity );
+
+    teMesh outMesh;
+    outMesh.index = ++meshIndex;
+    strncpy( outMesh.path, path, sizeof( outMesh.path ) - 1 );
+
+    MeshImpl& mesh = meshes[ outMesh.index ];
+    mesh.subMeshCount = data->subMeshCount;
+    mesh.subMeshes = AllocateSubMeshes( data->subMeshCount );
+    mesh.names = data->names;
+
+    for (unsigned m = 0; m < data->subMeshCount; ++m)
+    {
+        const MeshData::SubMeshData& source = data->subMeshes[ m ];
+        SubMesh& subMesh = mesh.subMeshes[ m ];
+
+        subMesh.aabbMin = source.aabbMin;
+        subMesh.aabbMax = source.aabbMax;
+        subMesh.indicesOffset = AddIndices( source.indices, source.faceCount * 2 * 3 );
+        subMesh.indexCount = source.faceCount;
+        subMesh.positionOffset = AddPositions( source.positions, source.vertexCount * 3 * 4 );
+        subMesh.positionCount = source.vertexCount;
+        subMesh.uvOffset = AddUVs( source.uvs, source.vertexCount * 2 * 4 );
+        subMesh.uvCount = source.vertexCount;
+        subMesh.normalOffset = AddNormals( source.normals, source.vertexCount * 3 * 4 );
+        subMesh.normalCount = source.vertexCount;
+        subMesh.tangentOffset = AddTangents( source.tangents, source.vertexCount * 4 * 4 );
+        subMesh.tangentCount = source.vertexCount;
+        subMesh.meshlets = source.meshlets;
+        subMesh.meshletCount = source.meshletCount;
+        subMesh.meshletVertices = source.meshletVertices;
+        subMesh.meshletVerticesCount = source.meshletVerticesCount;
+        subMesh.meshletTriangles = source.meshletTriangles;
+        subMesh.meshletTriangleCount = source.meshletTriangleCount;
+        subMesh.nameIndex = source.nameIndex;
+
+        CreateMeshletBuffers( subMesh );
     }
 
-    unsigned namesSize = *((unsigned*)pointer);
-    pointer += 4;
-    meshes[ outMesh.index ].names = (char*)teMalloc( namesSize );
-    memcpy( meshes[ outMesh.index ].names, pointer, namesSize );
+    teFree( data );
 
     return outMesh;
 }
 
+teMesh teLoadMesh( const teFile& file )
+{
+    TE_PROFILE_SCOPE( "teLoadMesh" );
+
+    if (!file.data)
+    {
+        return teCreateCubeMesh();
+    }
+
+    MeshData* data = ParseMesh( file );
+
+    if (!data)
+    {
+        EngineEnsureInitialized();
+        teAssert( meshIndex + 1 < meshCapacity );
+
+        teMesh outMesh;
+        outMesh.index = ++meshIndex;
+        strncpy( outMesh.path, file.path, sizeof( outMesh.path ) );
+        return outMesh;
+    }
+
+    return CreateMesh( file.path, data );
+}
+
 void teMeshGetSubMeshLocalAABB( const teMesh& mesh, unsigned subMeshIndex, Vec3& outAABBMin, Vec3& outAABBMax )
 {
     teAssert( subMeshIndex < MaxMaterials );
@@ -357,7 +589,7 @@ unsigned teMeshGetSubMeshCount( const teMesh* mesh )
     }
 
     teAssert( mesh->index != 0);
-    teAssert( mesh->index < MaxMeshes );
+    teAssert( mesh->index < meshCapacity );
     return meshes[ mesh->index ].subMeshCount;
 }
 
@@ -368,7 +600,7 @@ char* teMeshGetSubMeshName( const teMesh& mesh, unsigned subMeshIndex )
 
 teMesh* teMeshRendererGetMesh( unsigned gameObjectIndex )
 {
-    teAssert( gameObjectIndex < MaxMeshes );
+    teAssert( gameObjectIndex < meshRendererCapacity );
     return meshRenderers[ gameObjectIndex ].mesh;
 }
 
@@ -388,22 +620,46 @@ void MeshRendererSetCulled( unsigned gameObjectIndex, unsigned subMeshIndex, boo
 
 void teMeshRendererSetMesh( unsigned gameObjectIndex, teMesh* mesh )
 {
-    teAssert( gameObjectIndex < MaxMeshes );
+    teAssert( gameObjectIndex < meshRendererCapacity );
     meshRenderers[ gameObjectIndex ].mesh = mesh;
 }
 
 void teMeshRendererSetEnabled( unsigned gameObjectIndex, bool enable )
 {
-    teAssert( gameObjectIndex < MaxMeshes );
+    teAssert( gameObjectIndex < meshRendererCapacity );
     meshRenderers[ gameObjectIndex ].enabled = enable;
 }
 
 bool teMeshRendererIsEnabled( unsigned gameObjectIndex )
 {
-    teAssert( gameObjectIndex < MaxMeshes );
+    teAssert( gameObjectIndex < meshRendererCapacity );
     return meshRenderers[ gameObjectIndex ].enabled;
 }
 
+void teMeshRendererSetOccluder( unsigned gameObjectIndex, bool isOccluder )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    meshRenderers[ gameObjectIndex ].isOccluder = isOccluder;
+}
+
+void teMeshRendererSetStatic( unsigned gameObjectIndex, bool isStatic )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    meshRenderers[ gameObjectIndex ].isStatic = isStatic;
+}
+
+bool teMeshRendererIsStatic( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    return meshRenderers[ gameObjectIndex ].isStatic;
+}
+
+bool teMeshRendererIsOccluder( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    return meshRenderers[ gameObjectIndex ].isOccluder;
+}
+
 const teMaterial& teMeshRendererGetMaterial( unsigned gameObjectIndex, unsigned subMeshIndex )
 {
     teAssert( subMeshIndex < MaxMaterials );
@@ -413,7 +669,7 @@ const teMaterial& teMeshRendererGetMaterial( unsigned gameObjectIndex, unsigned
 
 void teMeshRendererSetMaterial( unsigned gameObjectIndex, const struct teMaterial& material, unsigned subMeshIndex )
 {
-    teAssert( gameObjectIndex < MaxMeshes );
+    teAssert( gameObjectIndex < meshRendererCapacity );
     teAssert( subMeshIndex < MaxMaterials );
 
     meshRenderers[ gameObjectIndex ].materials[ subMeshIndex ] = material;
@@ -474,3 +730,314 @@ unsigned teMeshGetTangentOffset( const teMesh& mesh, unsigned subMeshIndex )
     teAssert( subMeshIndex < meshes[ mesh.index ].subMeshCount );
     return meshes[ mesh.index ].subMeshes[ subMeshIndex ].tangentOffset;
 }
+
+// Upper 3x3's Frobenius norm, which is at least as large as the longest axis after scaling and rotation.
+static float GetMaxScale( const Matrix& matrix )
+{
+    float sum = 0;
+
+    for (unsigned row = 0; row < 3; ++row)
+    {
+        for (unsigned column = 0; column < 3; ++column)
+        {
+            sum += matrix.m[ row * 4 + column ] * matrix.m[ row * 4 + column ];
+        }
+    }
+
+    return sqrtf( sum );
+}
+
+static void UpdateInstanceBatch( MeshInstances& instances, unsigned batchIndex )
+{
+    InstanceBatch& batch = instances.batches[ batchIndex ];
+    const unsigned firstInstance = batchIndex * InstanceBatchSize;
+    const unsigned endInstance = firstInstance + InstanceBatchSize < instances.count ? firstInstance + InstanceBatchSize : instances.count;
+
+    batch.originMin = Vec3( instances.localMatrices[ firstInstance ].m[ 12 ], instances.localMatrices[ firstInstance ].m[ 13 ], instances.localMatrices[ firstInstance ].m[ 14 ] );
+    batch.originMax = batch.originMin;
+    batch.maxScale = 0;
+
+    for (unsigned i = firstInstance; i < endInstance; ++i)
+    {
+        const Matrix& matrix = instances.localMatrices[ i ];
+        batch.originMin.x = matrix.m[ 12 ] < batch.originMin.x ? matrix.m[ 12 ] : batch.originMin.x;
+        batch.originMin.y = matrix.m[ 13 ] < batch.originMin.y ? matrix.m[ 13 ] : batch.originMin.y;
+        batch.originMin.z = matrix.m[ 14 ] < batch.originMin.z ? matrix.m[ 14 ] : batch.originMin.z;
+        batch.originMax.x = matrix.m[ 12 ] > batch.originMax.x ? matrix.m[ 12 ] : batch.originMax.x;
+        batch.originMax.y = matrix.m[ 13 ] > batch.originMax.y ? matrix.m[ 13 ] : batch.originMax.y;
+        batch.originMax.z = matrix.m[ 14 ] > batch.originMax.z ? matrix.m[ 14 ] : batch.originMax.z;
+
+        const float scale = GetMaxScale( matrix );
+        batch.maxScale = scale > batch.maxScale ? scale : batch.maxScale;
+    }
+}
+
+unsigned teInstancedMeshRendererAddInstance( unsigned gameObjectIndex, const Matrix& localMatrix, const Vec4& tint )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+
+    MeshInstances& instances = meshInstances[ gameObjectIndex ];
+
+    if (instances.count == instances.capacity)
+    {
+        const unsigned newCapacity = instances.capacity == 0 ? InstanceBatchSize : instances.capacity * 2;
+        Matrix* localMatrices = (Matrix*)teMalloc( newCapacity * sizeof( Matrix ), teMemoryTag::Mesh );
+        Vec4* tints = (Vec4*)teMalloc( newCapacity * sizeof( Vec4 ), teMemoryTag::Mesh );
+        InstanceBatch* batches = (InstanceBatch*)teMalloc( (newCapacity / InstanceBatchSize) * sizeof( InstanceBatch ), teMemoryTag::Mesh );
+
+        if (instances.capacity > 0)
+        {
+            teMemcpy( localMatrices, instances.localMatrices, instances.count * sizeof( Matrix ) );
+            teMemcpy( tints, instances.tints, instances.count * sizeof( Vec4 ) );
+            teMemcpy( batches, instances.batches, (instances.capacity / InstanceBatchSize) * sizeof( InstanceBatch ) );
+            teFree( instances.localMatrices );
+            teFree( instances.tints );
+            teFree( instances.batches );
+        }
+
+        instances.localMatrices = localMatrices;
+        instances.tints = tints;
+        instances.batches = batches;
+        instances.capacity = newCapacity;
+    }
+
+    const unsigned instanceIndex = instances.count++;
+    instances.localMatrices[ instanceIndex ] = localMatrix;
+    instances.tints[ instanceIndex ] = tint;
+    UpdateInstanceBatch( instances, instanceIndex / InstanceBatchSize );
+
+    return instanceIndex;
+}
+
+void teInstancedMeshRendererSetInstance( unsigned gameObjectIndex, unsigned instanceIndex, const Matrix& localMatrix, const Vec4& tint )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    teAssert( instanceIndex < meshInstances[ gameObjectIndex ].count );
+
+    meshInstances[ gameObjectIndex ].localMatrices[ instanceIndex ] = localMatrix;
+    meshInstances[ gameObjectIndex ].tints[ instanceIndex ] = tint;
+    UpdateInstanceBatch( meshInstances[ gameObjectIndex ], instanceIndex / InstanceBatchSize );
+}
+
+unsigned teInstancedMeshRendererGetInstanceCount( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    return meshInstances[ gameObjectIndex ].count;
+}
+
+void teInstancedMeshRendererClearInstances( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    meshInstances[ gameObjectIndex ].count = 0;
+}
+
+void MeshRendererReset( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+
+    MeshInstances& instances = meshInstances[ gameObjectIndex ];
+
+    if (instances.capacity > 0)
+    {
+        teFree( instances.localMatrices );
+        teFree( instances.tints );
+        teFree( instances.batches );
+    }
+
+    instances = MeshInstances();
+    meshRenderers[ gameObjectIndex ] = {};
+}
+
+const Matrix* InstancedMeshRendererGetLocalMatrices( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    return meshInstances[ gameObjectIndex ].localMatrices;
+}
+
+const Vec4* InstancedMeshRendererGetTints( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    return meshInstances[ gameObjectIndex ].tints;
+}
+
+unsigned InstancedMeshRendererGetBatchCount( unsigned gameObjectIndex )
+{
+    teAssert( gameObjectIndex < meshRendererCapacity );
+    return (meshInstances[ gameObjectIndex ].count + InstanceBatchSize - 1) / InstanceBatchSize;
+}
+
+// outAabbMin and outAabbMax are in the game object's space and contain every instance's mesh AABB in the batch.
+void InstancedMeshRendererGetBatch( unsigned gameObjectIndex, unsigned batchIndex, const Vec3& meshAabbMin, const Vec3& meshAabbMax,
+                                    unsigned& outFirstInstance, unsigned& outInstanceCount, Vec3& outAabbMin, Vec3& outAabbMax )
+{
+    teAssert( batchIndex < InstancedMeshRendererGetBatchCount( gameObjectIndex ) );
+
+    const MeshInstances& instances = meshInstances[ gameObjectIndex ];
+    const InstanceBatch& batch = instances.batches[ batchIndex ];
+
+    outFirstInstance = batchIndex * InstanceBatchSize;
+    outInstanceCount = outFirstInstance + InstanceBatchSize < instances.count ? InstanceBatchSize : instances.count - outFirstInstance;
+
+    const Vec3 farthestCorner( fabsf( meshAabbMin.x ) > fabsf( meshAabbMax.x ) ? fabsf( meshAabbMin.x ) : fabsf( meshAabbMax.x ),
+                               fabsf( meshAabbMin.y ) > fabsf( meshAabbMax.y ) ? fabsf( meshAabbMin.y ) : fabsf( meshAabbMax.y ),
+                               fabsf( meshAabbMin.z ) > fabsf( meshAabbMax.z ) ? fabsf( meshAabbMin.z ) : fabsf( meshAabbMax.z ) );
+    const float extent = sqrtf( Vec3::Dot( farthestCorner, farthestCorner ) ) * batch.maxScale;
+
+    outAabbMin = Vec3( batch.originMin.x - extent, batch.originMin.y - extent, batch.originMin.z - extent );
+    outAabbMax = Vec3( batch.originMax.x + extent, batch.originMax.y + extent, batch.originMax.z + extent );
+}
+
+// Merges submeshes into one submesh in world space. Vertex and index streams are appended to the geometry buffers,
+// so teFinalizeMeshBuffers() must be called afterwards. Sources must either all have meshlets or none.
+teMesh CreateStaticBatchMesh( const teMesh* const* sourceMeshes, const unsigned* sourceSubMeshIndices, const Matrix* sourceLocalToWorlds, unsigned sourceCount )
+{
+    EngineEnsureInitialized();
+    teAssert( meshIndex + 1 < meshCapacity );
+    teAssert( sourceCount > 0 );
+
+    unsigned vertexCount = 0;
+    unsigned triangleCount = 0;
+    SubMesh batch;
+
+    for (unsigned s = 0; s < sourceCount; ++s)
+    {
+        const SubMesh& source = meshes[ sourceMeshes[ s ]->index ].subMeshes[ sourceSubMeshIndices[ s ] ];
+        vertexCount += source.positionCount;
+        triangleCount += source.indexCount;
+        batch.meshletCount += source.meshletCount;
+        batch.meshletVerticesCount += source.meshletVerticesCount;
+        batch.meshletTriangleCount += source.meshletTriangleCount;
+    }
+
+    teAssert( vertexCount <= 65536 ); // Indices are 16-bit.
+
+    float* positions = (float*)teMalloc( vertexCount * 3 * 4, teMemoryTag::Mesh );
+    float* uvs = (float*)teMalloc( vertexCount * 2 * 4, teMemoryTag::Mesh );
+    float* normals = (float*)teMalloc( vertexCount * 3 * 4, teMemoryTag::Mesh );
+    float* tangents = (float*)teMalloc( vertexCount * 4 * 4, teMemoryTag::Mesh );
+    unsigned short* indices = (unsigned short*)teMalloc( triangleCount * 3 * 2, teMemoryTag::Mesh );
+
+    batch.meshlets = (meshopt_Meshlet*)teArenaAlloc( meshArena, batch.meshletCount * sizeof( meshopt_Meshlet ) );
+    batch.meshletVertices = (unsigned*)teArenaAlloc( meshArena, batch.meshletVerticesCount * sizeof( unsigned ) );
+    batch.meshletTriangles = (uint32_t*)teArenaAlloc( meshArena, batch.meshletTriangleCount * sizeof( uint32_t ) );
+
+    unsigned vertexBase = 0;
+    unsigned triangleBase = 0;
+    unsigned meshletBase = 0;
+    unsigned meshletVertexBase = 0;
+    unsigned meshletTriangleBase = 0;
+
+    for (unsigned s = 0; s < sourceCount; ++s)
+    {
+        const SubMesh& source = meshes[ sourceMeshes[ s ]->index ].subMeshes[ sourceSubMeshIndices[ s ] ];
+        const Matrix& localToWorld = sourceLocalToWorlds[ s ];
+        Matrix normalMatrix;
+        Matrix::InverseTranspose( localToWorld.m, normalMatrix.m );
+
+        float* sourcePositions = positions + vertexBase * 3;
+        float* sourceNormals = normals + vertexBase * 3;
+        float* sourceTangents = tangents + vertexBase * 4;
+        ReadPositions( source.positionOffset, source.positionCount * 3 * 4, sourcePositions );
+        ReadUVs( source.uvOffset, source.positionCount * 2 * 4, uvs + vertexBase * 2 );
+        ReadNormals( source.normalOffset, source.positionCount * 3 * 4, sourceNormals );
+        ReadTangents( source.tangentOffset, source.positionCount * 4 * 4, sourceTangents );
+
+        for (unsigned v = 0; v < source.positionCount; ++v)
+        {
+            Vec3 position;
+            Matrix::TransformPoint( Vec3( sourcePositions[ v * 3 + 0 ], sourcePositions[ v * 3 + 1 ], sourcePositions[ v * 3 + 2 ] ), localToWorld, position );
+            sourcePositions[ v * 3 + 0 ] = position.x;
+            sourcePositions[ v * 3 + 1 ] = position.y;
+            sourcePositions[ v * 3 + 2 ] = position.z;
+
+            if (vertexBase + v == 0)
+            {
+                batch.aabbMin = position;
+                batch.aabbMax = position;
+            }
+
+            batch.aabbMin.x = position.x < batch.aabbMin.x ? position.x : batch.aabbMin.x;
+            batch.aabbMin.y = position.y < batch.aabbMin.y ? position.y : batch.aabbMin.y;
+            batch.aabbMin.z = position.z < batch.aabbMin.z ? position.z : batch.aabbMin.z;
+            batch.aabbMax.x = position.x > batch.aabbMax.x ? position.x : batch.aabbMax.x;
+            batch.aabbMax.y = position.y > batch.aabbMax.y ? position.y : batch.aabbMax.y;
+            batch.aabbMax.z = position.z > batch.aabbMax.z ? position.z : batch.aabbMax.z;
+
+            Vec3 normal;
+            Matrix::TransformDirection( Vec3( sourceNormals[ v * 3 + 0 ], sourceNormals[ v * 3 + 1 ], sourceNormals[ v * 3 + 2 ] ), normalMatrix, &normal );
+            normal.Normalize();
+            sourceNormals[ v * 3 + 0 ] = normal.x;
+            sourceNormals[ v * 3 + 1 ] = normal.y;
+            sourceNormals[ v * 3 + 2 ] = normal.z;
+
+            Vec3 tangent;
+            Matrix::TransformDirection( Vec3( sourceTangents[ v * 4 + 0 ], sourceTangents[ v * 4 + 1 ], sourceTangents[ v * 4 + 2 ] ), localToWorld, &tangent );
+            tangent.Normalize();
+            sourceTangents[ v * 4 + 0 ] = tangent.x;
+            sourceTangents[ v * 4 + 1 ] = tangent.y;
+            sourceTangents[ v * 4 + 2 ] = tangent.z;
+        }
+
+        unsigned short* sourceIndices = indices + triangleBase * 3;
+        ReadIndices( source.indicesOffset, source.indexCount * 3 * 2, sourceIndices );
+
+        for (unsigned i = 0; i < source.indexCount * 3; ++i)
+        {
+            sourceIndices[ i ] = (unsigned short)(sourceIndices[ i ] + vertexBase);
+        }
+
+        // Meshlet vertices index the submesh's vertices and meshlets index the meshlet arrays, so both are rebased.
+        for (unsigned i = 0; i < source.meshletCount; ++i)
+        {
+            batch.meshlets[ meshletBase + i ] = source.meshlets[ i ];
+            batch.meshlets[ meshletBase + i ].vertex_offset += meshletVertexBase;
+            batch.meshlets[ meshletBase + i ].triangle_offset += meshletTriangleBase;
+        }
+
+        for (unsigned i = 0; i < source.meshletVerticesCount; ++i)
+        {
+            batch.meshletVertices[ meshletVertexBase + i ] = source.meshletVertices[ i ] + vertexBase;
+        }
+
+        teMemcpy( batch.meshletTriangles + meshletTriangleBase, source.meshletTriangles, source.meshletTriangleCount * sizeof( uint32_t ) );
+
+        vertexBase += source.positionCount;
+        triangleBase += source.indexCount;
+        meshletBase += source.meshletCount;
+        meshletVertexBase += source.meshletVerticesCount;
+        meshletTriangleBase += source.meshletTriangleCount;
+    }
+
+    teMesh outMesh;
+    outMesh.index = ++meshIndex;
+
+    meshes[ outMesh.index ].subMeshCount = 1;
+    meshes[ outMesh.index ].subMeshes = AllocateSubMeshes( 1 );
+    SubMesh& subMesh = meshes[ outMesh.index ].subMeshes[ 0 ];
+    subMesh = batch;
+    subMesh.positionOffset = AddPositions( positions, vertexCount * 3 * 4 );
+    subMesh.positionCount = vertexCount;
+    subMesh.uvOffset = AddUVs( uvs, vertexCount * 2 * 4 );
+    subMesh.uvCount = vertexCount;
+    subMesh.normalOffset = AddNormals( normals, vertexCount * 3 * 4 );
+    subMesh.normalCount = vertexCount;
+    subMesh.tangentOffset = AddTangents( tangents, vertexCount * 4 * 4 );
+    subMesh.tangentCount = vertexCount;
+    subMesh.indicesOffset = AddIndices( indices, triangleCount * 3 * 2 );
+    subMesh.indexCount = triangleCount;
+    meshes[ outMesh.index ].names = (char*)teArenaAlloc( meshArena, 1, 1 );
+    meshes[ outMesh.index ].names[ 0 ] = 0;
+
+    if (subMesh.meshletCount > 0)
+    {
+        CreateMeshletBuffers( subMesh );
+    }
+
+    teFree( positions );
+    teFree( uvs );
+    teFree( normals );
+    teFree( tangents );
+    teFree( indices );
+
+    return outMesh;
+}
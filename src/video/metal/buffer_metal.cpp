@@ -9,6 +9,7 @@ struct BufferImpl
 };
 
 BufferImpl buffers[ 10000 ];
+TE_TRACK_STATIC_MEMORY( buffersMemory, teMemoryTag::Renderer, sizeof( buffers ) );
 unsigned bufferCount = 0;
 
 teBuffer CreateBuffer( MTL::Device* device, unsigned dataBytes, bool isStaging, const char* debugName )
@@ -1,16 +1,19 @@
 #include <Foundation/Foundation.hpp>
 #include <Metal/Metal.hpp>
 #include <QuartzCore/QuartzCore.hpp>
+#include "affine3x4.h"
 #include "buffer.h"
 #include "camera.h"
 #include "material.h"
 #include "matrix.h"
 #include "mesh.h"
+#include "profiler.h"
 #include "renderer.h"
 #include "shader.h"
 #include "texture.h"
 #include "te_stdlib.h"
 #include "vec3.h"
+#include <atomic>
 
 void InitLightTiler( unsigned widthPixels, unsigned heightPixels );
 teBuffer CreateBuffer( MTL::Device* device, unsigned dataBytes, bool isStaging, const char* debugName );
@@ -22,19 +25,27 @@ MTL::Texture* TextureGetMetalTexture( unsigned index );
 unsigned GetMaxLightsPerTile( unsigned height );
 unsigned GetPointLightCount();
 unsigned GetSpotLightCount();
+Vec4 GetLightClusterParams();
 teBuffer GetPointLightCenterAndRadiusBuffer();
 teBuffer GetPointLightColorBuffer();
+void ResetFrameAllocator();
+void ProfilerNewFrame();
+void StatAdd( teStat stat, unsigned amount );
+void StatSet( teStat stat, float value );
+void StatsNewFrame();
+void StreamingUpdate();
 
 static const unsigned MaxPSOs = 100;
 static constexpr unsigned UiBufferBytes = 1024 * 1024 * 8;
 
 // Must match shader header ubo.h
+// Object transforms are affine, so shaders get localToClip and localToShadowClip by multiplying them with the view's projections.
 struct PerObjectUboStruct
 {
-    Matrix   localToClip;
-    Matrix   localToView;
-    Matrix   localToShadowClip;
-    Matrix   localToWorld;
+    Affine3x4 localToView;
+    Affine3x4 localToWorld;
+    Matrix   viewToClip;
+    Matrix   worldToShadowClip;
     Matrix   clipToView;
     Vec4     bloomParams;
     Vec4     tilesXY;
@@ -42,6 +53,7 @@ struct PerObjectUboStruct
     Vec4     lightDir;
     Vec4     lightColor;
     Vec4     lightPosition;
+    Vec4     clusterParams;
     unsigned pointLightCount{ 0 };
     unsigned spotLightCount{ 0 };
     unsigned maxLightsPerTile{ 0 };
@@ -49,11 +61,25 @@ struct PerObjectUboStruct
 
 constexpr unsigned UniformBufferSize = sizeof( PerObjectUboStruct ) * 10000;
 
+// Must match shader header ubo.h
+struct InstanceData
+{
+    Affine3x4 localToWorld;
+    Vec4      tint;
+};
+
+constexpr unsigned MaxInstancesPerFrame = 65536;
+constexpr unsigned UploadRingSizeBytes = 4 * 1024 * 1024;
+
 struct FrameResource
 {
     MTL::CommandBuffer* commandBuffer;
     MTL::Buffer*        uniformBuffer;
     unsigned            uboOffset = 0;
+    MTL::Buffer*        instanceBuffer; // Slot 0 is an identity instance used by non-instanced draws.
+    unsigned            instanceOffset = 1;
+    MTL::Buffer*        uploadBuffer; // Source of UploadBufferRanges() copies.
+    unsigned            uploadOffset = 0;
 };
 
 struct PSO
@@ -95,6 +121,12 @@ struct Renderer
     unsigned positionCounter = 0;
     unsigned normalCounter = 0;
     unsigned tangentCounter = 0;
+    // Geometry below these offsets has been copied from the staging buffers to the mesh buffers.
+    unsigned finalizedIndexCounter = 0;
+    unsigned finalizedUVCounter = 0;
+    unsigned finalizedPositionCounter = 0;
+    unsigned finalizedNormalCounter = 0;
+    unsigned finalizedTangentCounter = 0;
 
     unsigned width = 0;
     unsigned height = 0;
@@ -118,8 +150,8 @@ struct Renderer
     teBuffer lineVertexBuffer;
     unsigned lineCount = 0;
 
-    unsigned statDrawCalls = 0;
-    unsigned statPSOBinds = 0;
+    std::atomic< float > gpuFrameMs{ 0 }; // Written by the command buffer's completion handler.
+    unsigned pendingInstanceCount = 0; // Set by UpdateInstances() for the next Draw().
 };
 
 Renderer renderer;
@@ -308,6 +340,26 @@ void teCreateRenderer( unsigned swapInterval, void* windowHandle, unsigned width
         renderer.frameResources[ i ].uniformBuffer = renderer.device->newBuffer( UniformBufferSize, MTL::ResourceCPUCacheModeDefaultCache );
 #endif
         renderer.frameResources[ i ].uniformBuffer->setLabel( NS::String::string( "uniform buffer", NS::UTF8StringEncoding ) );
+
+#if !TARGET_OS_IPHONE
+        renderer.frameResources[ i ].instanceBuffer = renderer.device->newBuffer( MaxInstancesPerFrame * sizeof( InstanceData ), MTL::ResourceStorageModeManaged );
+#else
+        renderer.frameResources[ i ].instanceBuffer = renderer.device->newBuffer( MaxInstancesPerFrame * sizeof( InstanceData ), MTL::ResourceCPUCacheModeDefaultCache );
+#endif
+        renderer.frameResources[ i ].instanceBuffer->setLabel( NS::String::string( "instance buffer", NS::UTF8StringEncoding ) );
+
+        InstanceData identity = { Affine3x4(), Vec4( 1, 1, 1, 1 ) };
+        memcpy( renderer.frameResources[ i ].instanceBuffer->contents(), &identity, sizeof( InstanceData ) );
+#if !TARGET_OS_IPHONE
+        renderer.frameResources[ i ].instanceBuffer->didModifyRange( NS::Range::Make( 0, sizeof( InstanceData ) ) );
+#endif
+
+#if !TARGET_OS_IPHONE
+        renderer.frameResources[ i ].uploadBuffer = renderer.device->newBuffer( UploadRingSizeBytes, MTL::ResourceStorageModeManaged );
+#else
+        renderer.frameResources[ i ].uploadBuffer = renderer.device->newBuffer( UploadRingSizeBytes, MTL::ResourceCPUCacheModeDefaultCache );
+#endif
+        renderer.frameResources[ i ].uploadBuffer->setLabel( NS::String::string( "upload ring", NS::UTF8StringEncoding ) );
     }
     
     unsigned char pixels[ 32 * 32 * 4 ];
@@ -323,12 +375,14 @@ void teCreateRenderer( unsigned swapInterval, void* windowHandle, unsigned width
 
 void PushGroupMarker( const char* name )
 {
+    teProfileBegin( name );
     renderer.renderEncoder->pushDebugGroup( NS::String::string( name, NS::UTF8StringEncoding ) );
 }
 
 void PopGroupMarker()
 {
     renderer.renderEncoder->popDebugGroup();
+    teProfileEnd();
 }
 
 void UpdateStagingBuffer( const teBuffer& buffer, const void* data, unsigned dataBytes, unsigned offset )
@@ -338,6 +392,14 @@ void UpdateStagingBuffer( const teBuffer& buffer, const void* data, unsigned dat
     uint8_t* bufferPointer = (uint8_t *)(BufferGetBuffer( buffer )->contents());
 
     teMemcpy( bufferPointer + offset, data, dataBytesNextMultipleOf4 );
+    StatAdd( teStat::BufferUploadBytes, dataBytesNextMultipleOf4 );
+}
+
+void ReadStagingBuffer( const teBuffer& buffer, void* outData, unsigned dataBytes, unsigned offset )
+{
+    const uint8_t* bufferPointer = (const uint8_t *)(BufferGetBuffer( buffer )->contents());
+
+    teMemcpy( outData, bufferPointer + offset, dataBytes );
 }
 
 unsigned AddIndices( const unsigned short* indices, unsigned bytes )
@@ -395,15 +457,41 @@ unsigned AddTangents( const float* tangents, unsigned bytes )
     return renderer.tangentCounter - bytes;
 }
 
-void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16 ],
-                const float localToWorld[ 16 ],
+// Geometry stays in the staging buffers after teFinalizeMeshBuffers(), so it can be read back for static batching.
+void ReadIndices( unsigned offset, unsigned bytes, unsigned short* outIndices )
+{
+    ReadStagingBuffer( renderer.staticMeshIndexStagingBuffer, outIndices, bytes, offset );
+}
+
+void ReadUVs( unsigned offset, unsigned bytes, float* outUVs )
+{
+    ReadStagingBuffer( renderer.staticMeshUVStagingBuffer, outUVs, bytes, offset );
+}
+
+void ReadPositions( unsigned offset, unsigned bytes, float* outPositions )
+{
+    ReadStagingBuffer( renderer.staticMeshPositionStagingBuffer, outPositions, bytes, offset );
+}
+
+void ReadNormals( unsigned offset, unsigned bytes, float* outNormals )
+{
+    ReadStagingBuffer( renderer.staticMeshNormalStagingBuffer, outNormals, bytes, offset );
+}
+
+void ReadTangents( unsigned offset, unsigned bytes, float* outTangents )
+{
+    ReadStagingBuffer( renderer.staticMeshTangentStagingBuffer, outTangents, bytes, offset );
+}
+
+void UpdateUBO( const Affine3x4& localToView, const Matrix& viewToClip,
+                const Affine3x4& localToWorld, const Matrix& worldToShadowClip,
                 const ShaderParams& shaderParams, const Vec4& lightDir, const Vec4& lightColor, const Vec4& lightPosition )
 {
     PerObjectUboStruct uboStruct = {};
-    uboStruct.localToClip.InitFrom( localToClip );
-    uboStruct.localToView.InitFrom( shaderParams.localToView );
-    uboStruct.localToShadowClip.InitFrom( localToShadowClip );
-    uboStruct.localToWorld.InitFrom( localToWorld );
+    uboStruct.localToView = localToView;
+    uboStruct.localToWorld = localToWorld;
+    uboStruct.viewToClip = viewToClip;
+    uboStruct.worldToShadowClip = worldToShadowClip;
     uboStruct.clipToView.InitFrom( shaderParams.clipToView );
     uboStruct.bloomParams.w = shaderParams.bloomThreshold;
     uboStruct.tilesXY.x = shaderParams.tilesXY[ 0 ];
@@ -413,6 +501,7 @@ void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16
     uboStruct.lightDir = lightDir;
     uboStruct.lightColor = lightColor;
     uboStruct.lightPosition = lightPosition;
+    uboStruct.clusterParams = GetLightClusterParams();
     uboStruct.tint.x = shaderParams.tint[ 0 ];
     uboStruct.tint.y = shaderParams.tint[ 1 ];
     uboStruct.tint.z = shaderParams.tint[ 2 ];
@@ -428,16 +517,52 @@ void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16
 #if !TARGET_OS_IPHONE
     uniformBuffer->didModifyRange( NS::Range::Make( renderer.frameResources[ 0 ].uboOffset, sizeof( PerObjectUboStruct ) ) );
 #endif
+    StatAdd( teStat::UBOBytes, sizeof( PerObjectUboStruct ) );
+}
+
+void UpdateInstances( const Matrix* instanceToWorld, const Vec4* tints, unsigned instanceCount )
+{
+    FrameResource& frame = renderer.frameResources[ 0 ];
+
+    if (frame.instanceOffset + instanceCount > MaxInstancesPerFrame)
+    {
+        teLog( teLogLevel::Warning, "Instance buffer is full, max is %u instances per frame\n", MaxInstancesPerFrame );
+        instanceCount = MaxInstancesPerFrame - frame.instanceOffset;
+    }
+
+    InstanceData* instances = (InstanceData*)frame.instanceBuffer->contents() + frame.instanceOffset;
+
+    for (unsigned i = 0; i < instanceCount; ++i)
+    {
+        Affine3x4::FromMatrix( instanceToWorld[ i ], instances[ i ].localToWorld );
+        instances[ i ].tint = tints[ i ];
+    }
+
+    StatAdd( teStat::BufferUploadBytes, instanceCount * sizeof( InstanceData ) );
+
+#if !TARGET_OS_IPHONE
+    frame.instanceBuffer->didModifyRange( NS::Range::Make( frame.instanceOffset * sizeof( InstanceData ), instanceCount * sizeof( InstanceData ) ) );
+#endif
+    renderer.pendingInstanceCount = instanceCount;
 }
 
 void teBeginFrame()
 {
+    ProfilerNewFrame();
+    StatsNewFrame();
+    StatSet( teStat::GpuFrameMs, renderer.gpuFrameMs.load( std::memory_order_relaxed ) );
+
+    TE_PROFILE_SCOPE( "teBeginFrame" );
+
+    ResetFrameAllocator();
+    StreamingUpdate();
+
     renderer.frameResources[ 0 ].commandBuffer = renderer.commandQueue->commandBuffer();
     renderer.frameResources[ 0 ].commandBuffer->setLabel( NS::String::string( "command buffer", NS::UTF8StringEncoding ) );
     renderer.frameResources[ 0 ].uboOffset = 0;
-
-    renderer.statDrawCalls = 0;
-    renderer.statPSOBinds = 0;
+    renderer.frameResources[ 0 ].instanceOffset = 1;
+    renderer.frameResources[ 0 ].uploadOffset = 0;
+    renderer.pendingInstanceCount = 0;
 }
 
 teTextureFormat GetSwapchainColorFormat()
@@ -452,8 +577,15 @@ void SetDrawable( CA::MetalDrawable* drawable )
 
 void teEndFrame()
 {
+    TE_PROFILE_SCOPE( "teEndFrame" );
+
     renderer.frameResources[ 0 ].commandBuffer->presentDrawable( gDrawable );
+    renderer.frameResources[ 0 ].commandBuffer->addCompletedHandler( []( MTL::CommandBuffer* commandBuffer )
+    {
+        renderer.gpuFrameMs.store( (float)((commandBuffer->GPUEndTime() - commandBuffer->GPUStartTime()) * 1000.0), std::memory_order_relaxed );
+    } );
     renderer.frameResources[ 0 ].commandBuffer->commit();
+    StatAdd( teStat::QueueSubmits, 1 );
 }
 
 void BeginRendering( teTexture2D& color, teTexture2D& depth, teClearFlag clearFlag, const float* clearColor )
@@ -530,15 +662,138 @@ void CopyBuffer( const teBuffer& source, const teBuffer& destination )
     blit_encoder->endEncoding();
     cmd_buffer->commit();
     cmd_buffer->waitUntilCompleted();
+    StatAdd( teStat::QueueSubmits, 1 );
+    StatAdd( teStat::QueueWaits, 1 );
+}
+
+// The copies are committed in their own command buffer like teShaderDispatch(), so they're ordered after the
+// previously committed frames and before the dispatches and the frame's command buffer that are committed later.
+bool UploadBufferRanges( const teBuffer& destination, const void* data, const BufferRange* ranges, unsigned rangeCount )
+{
+    if (rangeCount == 0)
+    {
+        return true;
+    }
+
+    FrameResource& frame = renderer.frameResources[ 0 ];
+    unsigned uploadBytes = 0;
+
+    for (unsigned i = 0; i < rangeCount; ++i)
+    {
+        teAssert( ranges[ i ].offset + ranges[ i ].sizeBytes <= BufferGetSizeBytes( destination ) );
+        uploadBytes += (ranges[ i ].sizeBytes + 15) & ~15u;
+    }
+
+    if (frame.uploadOffset + uploadBytes > UploadRingSizeBytes)
+    {
+        teLog( teLogLevel::Warning, "Upload ring is full, max is %u bytes per frame\n", UploadRingSizeBytes );
+        return false;
+    }
+
+    MTL::CommandBuffer* cmdBuffer = renderer.commandQueue->commandBuffer();
+    cmdBuffer->setLabel( NS::String::string( "upload cmdbuffer", NS::UTF8StringEncoding ) );
+    MTL::BlitCommandEncoder* blitEncoder = cmdBuffer->blitCommandEncoder();
+    uint8_t* uploadData = (uint8_t*)frame.uploadBuffer->contents();
+
+    for (unsigned i = 0; i < rangeCount; ++i)
+    {
+        memcpy( uploadData + frame.uploadOffset, (const uint8_t*)data + ranges[ i ].offset, ranges[ i ].sizeBytes );
+        blitEncoder->copyFromBuffer( frame.uploadBuffer, frame.uploadOffset, BufferGetBuffer( destination ), ranges[ i ].offset, ranges[ i ].sizeBytes );
+        frame.uploadOffset += (ranges[ i ].sizeBytes + 15) & ~15u;
+    }
+
+#if !TARGET_OS_IPHONE
+    frame.uploadBuffer->didModifyRange( NS::Range::Make( frame.uploadOffset - uploadBytes, uploadBytes ) );
+#endif
+    blitEncoder->endEncoding();
+    cmdBuffer->commit();
+    StatAdd( teStat::QueueSubmits, 1 );
+    StatAdd( teStat::BufferUploadBytes, uploadBytes );
+    return true;
+}
+
+struct MeshBufferCopy
+{
+    teBuffer source;
+    teBuffer destination;
+    unsigned offset;
+    unsigned sizeBytes;
+};
+
+// @return Count of copies for the geometry that has been added since the previous call. Geometry is only appended.
+static unsigned TakeNewMeshData( MeshBufferCopy outCopies[ 5 ] )
+{
+    const MeshBufferCopy copies[ 5 ] =
+    {
+        { renderer.staticMeshIndexStagingBuffer, renderer.staticMeshIndexBuffer, renderer.finalizedIndexCounter, renderer.indexCounter - renderer.finalizedIndexCounter },
+        { renderer.staticMeshUVStagingBuffer, renderer.staticMeshUVBuffer, renderer.finalizedUVCounter, renderer.uvCounter - renderer.finalizedUVCounter },
+        { renderer.staticMeshPositionStagingBuffer, renderer.staticMeshPositionBuffer, renderer.finalizedPositionCounter, renderer.positionCounter - renderer.finalizedPositionCounter },
+        { renderer.staticMeshNormalStagingBuffer, renderer.staticMeshNormalBuffer, renderer.finalizedNormalCounter, renderer.normalCounter - renderer.finalizedNormalCounter },
+        { renderer.staticMeshTangentStagingBuffer, renderer.staticMeshTangentBuffer, renderer.finalizedTangentCounter, renderer.tangentCounter - renderer.finalizedTangentCounter },
+    };
+
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        if (copies[ i ].sizeBytes > 0)
+        {
+            outCopies[ count++ ] = copies[ i ];
+        }
+    }
+
+    renderer.finalizedIndexCounter = renderer.indexCounter;
+    renderer.finalizedUVCounter = renderer.uvCounter;
+    renderer.finalizedPositionCounter = renderer.positionCounter;
+    renderer.finalizedNormalCounter = renderer.normalCounter;
+    renderer.finalizedTangentCounter = renderer.tangentCounter;
+
+    return count;
+}
+
+// @return The committed command buffer, or nullptr if there was nothing to copy.
+static MTL::CommandBuffer* CommitNewMeshData()
+{
+    MeshBufferCopy copies[ 5 ];
+    const unsigned copyCount = TakeNewMeshData( copies );
+
+    if (copyCount == 0)
+    {
+        return nullptr;
+    }
+
+    MTL::CommandBuffer* cmdBuffer = renderer.commandQueue->commandBuffer();
+    cmdBuffer->setLabel( NS::String::string( "mesh upload cmdbuffer", NS::UTF8StringEncoding ) );
+    MTL::BlitCommandEncoder* blitEncoder = cmdBuffer->blitCommandEncoder();
+
+    for (unsigned i = 0; i < copyCount; ++i)
+    {
+        blitEncoder->copyFromBuffer( BufferGetBuffer( copies[ i ].source ), copies[ i ].offset, BufferGetBuffer( copies[ i ].destination ), copies[ i ].offset, copies[ i ].sizeBytes );
+        StatAdd( teStat::BufferUploadBytes, copies[ i ].sizeBytes );
+    }
+
+    blitEncoder->endEncoding();
+    cmdBuffer->commit();
+    StatAdd( teStat::QueueSubmits, 1 );
+
+    return cmdBuffer;
 }
 
 void teFinalizeMeshBuffers()
 {
-    CopyBuffer( renderer.staticMeshIndexStagingBuffer, renderer.staticMeshIndexBuffer );
-    CopyBuffer( renderer.staticMeshUVStagingBuffer, renderer.staticMeshUVBuffer );
-    CopyBuffer( renderer.staticMeshPositionStagingBuffer, renderer.staticMeshPositionBuffer );
-    CopyBuffer( renderer.staticMeshNormalStagingBuffer, renderer.staticMeshNormalBuffer );
-    CopyBuffer( renderer.staticMeshTangentStagingBuffer, renderer.staticMeshTangentBuffer );
+    MTL::CommandBuffer* cmdBuffer = CommitNewMeshData();
+
+    if (cmdBuffer)
+    {
+        cmdBuffer->waitUntilCompleted();
+        StatAdd( teStat::QueueWaits, 1 );
+    }
+}
+
+// Called by streaming. The copies are ordered before the frame's command buffer that's committed later, so nothing waits.
+void QueueMeshBufferUploads()
+{
+    CommitNewMeshData();
 }
 
 static int GetPSO( MTL::Function* vertexProgram, MTL::Function* pixelProgram, teBlendMode blendMode, teTopology topology, MTL::PixelFormat colorFormat, MTL::PixelFormat depthFormat, bool isUI )
@@ -669,9 +924,13 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned uvOffset, u
         renderer.renderEncoder->setDepthStencilState( renderer.depthStateNoneWriteOff );
     }
 
-    NS::Range rangeOffsets = { 0, 5 };
-    MTL::Buffer* buffers[] = { renderer.frameResources[ 0 ].uniformBuffer, BufferGetBuffer( renderer.staticMeshPositionBuffer ), BufferGetBuffer( renderer.staticMeshUVBuffer ), BufferGetBuffer( renderer.staticMeshNormalBuffer ), BufferGetBuffer( renderer.staticMeshTangentBuffer ) };
-    NS::UInteger offsets[] = { renderer.frameResources[ 0 ].uboOffset, positionOffset, uvOffset, normalOffset, tangentOffset };
+    // Instanced draws use the instances written by UpdateInstances(), others the identity instance in slot 0.
+    const unsigned instanceCount = renderer.pendingInstanceCount > 0 ? renderer.pendingInstanceCount : 1;
+    const unsigned firstInstance = renderer.pendingInstanceCount > 0 ? renderer.frameResources[ 0 ].instanceOffset : 0;
+
+    NS::Range rangeOffsets = { 0, 6 };
+    MTL::Buffer* buffers[] = { renderer.frameResources[ 0 ].uniformBuffer, BufferGetBuffer( renderer.staticMeshPositionBuffer ), BufferGetBuffer( renderer.staticMeshUVBuffer ), BufferGetBuffer( renderer.staticMeshNormalBuffer ), BufferGetBuffer( renderer.staticMeshTangentBuffer ), renderer.frameResources[ 0 ].instanceBuffer };
+    NS::UInteger offsets[] = { renderer.frameResources[ 0 ].uboOffset, positionOffset, uvOffset, normalOffset, tangentOffset, firstInstance * sizeof( InstanceData ) };
     
     renderer.renderEncoder->setTriangleFillMode( fillMode == teFillMode::Solid ? MTL::TriangleFillModeFill : MTL::TriangleFillModeLines );
     renderer.renderEncoder->setFragmentBuffer( renderer.frameResources[ 0 ].uniformBuffer, renderer.frameResources[ 0 ].uboOffset, 0 );
@@ -686,17 +945,22 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned uvOffset, u
                               indexCount * 3,
                                MTL::IndexTypeUInt16,
                              BufferGetBuffer( renderer.staticMeshIndexBuffer ),
-                       indexOffset);
+                       indexOffset,
+                       instanceCount);
+    StatAdd( teStat::Triangles, indexCount * instanceCount );
+
+    renderer.frameResources[ 0 ].instanceOffset += renderer.pendingInstanceCount;
+    renderer.pendingInstanceCount = 0;
 
     MoveToNextUboOffset();
-    ++renderer.statDrawCalls;
-    ++renderer.statPSOBinds;
+    StatAdd( teStat::DrawCalls, 1 );
+    StatAdd( teStat::PSOBinds, 1 );
 }
 
 void teDrawFullscreenTriangle( teShader& shader, teTexture2D& texture, const ShaderParams& shaderParams, teBlendMode blendMode )
 {
     Matrix identity;
-    UpdateUBO( identity.m, identity.m, identity.m, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    UpdateUBO( Affine3x4(), identity, Affine3x4(), identity, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
     Draw( shader, 0, 0, 0, 0, 3, 0, blendMode, teCullMode::Off, teDepthMode::NoneWriteOff, teTopology::Triangles, teFillMode::Solid, texture.index, teTextureSampler::NearestClamp, 0, 0, 0, 0 );
 }
 
@@ -713,13 +977,6 @@ void teUnmapUiMemory()
 {
 }
 
-float teRendererGetStat( teStat stat )
-{
-    if (stat == teStat::DrawCalls) return (float)renderer.statDrawCalls;
-    else if (stat == teStat::PSOBinds) return (float)renderer.statPSOBinds;
-    return 0;
-}
-
 void teUIDrawCall( const teShader& shader, const teTexture2D& fontTex, int displaySizeX, int displaySizeY, int scissorX, int scissorY, unsigned scissorW, unsigned scissorH, unsigned elementCount, unsigned indexOffset, unsigned vertexOffset )
 {
     MTL::PixelFormat colorFormat = renderer.renderPassDescriptorFBO->colorAttachments()->object( 0 )->texture()->pixelFormat();
@@ -748,10 +1005,10 @@ void teUIDrawCall( const teShader& shader, const teTexture2D& fontTex, int displ
         { (R+L)/(L-R),  (T+B)/(B-T), N/(F-N),   1.0f },
     };
     
-    Matrix localToClip;
-    localToClip.InitFrom( &orthoProjection[ 0 ][ 0 ] );
+    Matrix viewToClip;
+    viewToClip.InitFrom( &orthoProjection[ 0 ][ 0 ] );
     ShaderParams shaderParams = {};
-    UpdateUBO( localToClip.m, localToClip.m, localToClip.m, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    UpdateUBO( Affine3x4(), viewToClip, Affine3x4(), viewToClip, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
 
     const unsigned vertexStride = 20; // sizeof( ImDrawVert )
     const unsigned indexStride = 2; // sizeof( ImDrawIdx )
@@ -781,10 +1038,11 @@ void teUIDrawCall( const teShader& shader, const teTexture2D& fontTex, int displ
                                MTL::IndexTypeUInt16,
                              BufferGetBuffer( renderer.uiIndexBuffer ),
                        indexOffset * indexStride );
+    StatAdd( teStat::Triangles, elementCount / 3 );
     
     MoveToNextUboOffset();
-    ++renderer.statDrawCalls;
-    ++renderer.statPSOBinds;
+    StatAdd( teStat::DrawCalls, 1 );
+    StatAdd( teStat::PSOBinds, 1 );
 }
 
 void DrawLines()
@@ -808,13 +1066,14 @@ void DrawLines()
     renderer.renderEncoder->setVertexBuffer( BufferGetBuffer( renderer.lineVertexBuffer ), 0, 1 );
     renderer.renderEncoder->setVertexBufferOffset( 0, 0 );
     renderer.renderEncoder->setVertexBuffer( renderer.frameResources[ 0 ].uniformBuffer, renderer.frameResources[ 0 ].uboOffset, 0 );
+    renderer.renderEncoder->setVertexBuffer( renderer.frameResources[ 0 ].instanceBuffer, 0, 5 );
     renderer.renderEncoder->setFragmentTexture( TextureGetMetalTexture( renderer.defaultTexture2D.index ), 0 );
 
     renderer.renderEncoder->drawPrimitives( MTL::PrimitiveTypeLine, 0, renderer.lineCount, 1 );
     
     MoveToNextUboOffset();
-    ++renderer.statDrawCalls;
-    ++renderer.statPSOBinds;
+    StatAdd( teStat::DrawCalls, 1 );
+    StatAdd( teStat::PSOBinds, 1 );
 
     PopGroupMarker();
 }
@@ -1,11 +1,17 @@
 #include <Metal/Metal.hpp>
 #include "shader.h"
+#include "affine3x4.h"
+#include "material.h"
+#include "matrix.h"
+#include "profiler.h"
+#include "renderer.h"
 #include "texture.h"
 #include "te_stdlib.h"
 #include "vec3.h"
 
 void MoveToNextUboOffset();
 unsigned TextureGetFlags( unsigned index );
+void StatAdd( teStat stat, unsigned amount );
 
 extern MTL::Library* shaderLibrary;
 extern MTL::CommandQueue* gCommandQueue;
@@ -15,6 +21,7 @@ MTL::Texture* TextureGetMetalTexture( unsigned index );
 MTL::Buffer* GetUniformBufferAndOffset( unsigned& outOffset );
 teBuffer GetPointLightCenterAndRadiusBuffer();
 teBuffer GetLightIndexBuffer();
+void EngineEnsureInitialized();
 
 struct ShaderImpl
 {
@@ -27,10 +34,16 @@ struct ShaderImpl
     MTL::Size threadgroupCounts;
 };
 
-static constexpr unsigned MaxShaders = 40;
-static ShaderImpl shaders[ MaxShaders ];
+static ShaderImpl* shaders = nullptr;
+static unsigned shaderCapacity = 0;
 static unsigned shaderCount = 0;
 
+void ShaderInitStorage( unsigned maxShaders )
+{
+    shaders = teMallocArray< ShaderImpl >( maxShaders, teMemoryTag::Renderer );
+    shaderCapacity = maxShaders;
+}
+
 MTL::Function* teShaderGetVertexProgram( const teShader& shader )
 {
     return shaders[ shader.index ].vertexProgram;
@@ -43,7 +56,10 @@ MTL::Function* teShaderGetPixelProgram( const teShader& shader )
 
 teShader teCreateShader( const struct teFile& vertexFile, const teFile& pixelFile, const char* vertexName, const char* pixelName )
 {
-    teAssert( shaderCount < MaxShaders );
+    TE_PROFILE_SCOPE( "teCreateShader" );
+
+    EngineEnsureInitialized();
+    teAssert( shaderCount < shaderCapacity );
 
     teShader outShader;
     outShader.index = ++shaderCount;
@@ -82,7 +98,8 @@ teShader teCreateShader( const struct teFile& vertexFile, const teFile& pixelFil
 
 teShader teCreateComputeShader( const teFile& file, const char* name, unsigned threadsPerThreadgroupX, unsigned threadsPerThreadgroupY )
 {
-    teAssert( shaderCount < MaxShaders );
+    EngineEnsureInitialized();
+    teAssert( shaderCount < shaderCapacity );
 
     teShader outShader;
     outShader.index = ++shaderCount;
@@ -123,7 +140,11 @@ void teShaderDispatch( const teShader& shader, unsigned groupsX, unsigned groups
     teAssert( !params.writeTexture || (TextureGetFlags( params.writeTexture ) & teTextureFlags::UAV ) );
     
     Matrix identity;
-    UpdateUBO( identity.m, identity.m, identity.m, params, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    Matrix view;
+    view.InitFrom( params.localToView );
+    Affine3x4 localToView;
+    Affine3x4::FromMatrix( view, localToView );
+    UpdateUBO( localToView, identity, Affine3x4(), identity, params, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
     
     MTL::Size threadgroups = MTL::Size::Make( groupsX, groupsY, groupsZ );
 
@@ -176,6 +197,7 @@ void teShaderDispatch( const teShader& shader, unsigned groupsX, unsigned groups
     commandEncoder->endEncoding();
     
     commandBuffer->commit();
+    StatAdd( teStat::QueueSubmits, 1 );
     
     MoveToNextUboOffset();
 }
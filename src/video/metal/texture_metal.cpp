@@ -1,10 +1,13 @@
 #include <Metal/Metal.hpp>
 #include "texture.h"
 #include "file.h"
+#include "material.h"
+#include "renderer.h"
+#include "profiler.h"
 #include "te_stdlib.h"
+#include "textureloader.h"
 
-bool LoadTGA( const teFile& file, unsigned& outWidth, unsigned& outHeight, unsigned& outDataBeginOffset, unsigned& outBitsPerPixel );
-bool LoadDDS( const teFile& fileContents, unsigned& outWidth, unsigned& outHeight, teTextureFormat& outFormat, unsigned& outMipLevelCount, unsigned( &outMipOffsets )[ 15 ] );
+void StatAdd( teStat stat, unsigned amount );
 
 extern MTL::Device* gDevice;
 extern MTL::CommandQueue* gCommandQueue;
@@ -20,6 +23,7 @@ struct teTextureImpl
 };
 
 teTextureImpl textures[ TextureCount ];
+TE_TRACK_STATIC_MEMORY( texturesMemory, teMemoryTag::Texture, sizeof( textures ) );
 unsigned textureCount = 0;
 
 static inline unsigned Max2( unsigned x, unsigned y ) noexcept
@@ -163,7 +167,7 @@ void teTextureGetDimension( teTexture2D texture, unsigned& outWidth, unsigned& o
     outHeight = textures[ texture.index ].height;
 }
 
-teTexture2D teLoadTexture( const teFile& file, unsigned flags, void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat )
+static teTexture2D LoadTexture2D( const teFile& file, unsigned flags, void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat, const DDSData* parsedDDS )
 {
     teAssert( textureCount + 1 < TextureCount );
     teAssert( !(flags & teTextureFlags::UAV) );
@@ -240,6 +244,8 @@ teTexture2D teLoadTexture( const teFile& file, unsigned flags, void* pixels, int
         blitEncoder->endEncoding();
         cmdBuffer->commit();
         cmdBuffer->waitUntilCompleted();
+        StatAdd( teStat::QueueSubmits, 1 );
+        StatAdd( teStat::QueueWaits, 1 );
     }
     else if (pixels != nullptr)
     {
@@ -282,20 +288,32 @@ teTexture2D teLoadTexture( const teFile& file, unsigned flags, void* pixels, int
         blitEncoder->endEncoding();
         cmdBuffer->commit();
         cmdBuffer->waitUntilCompleted();
+        StatAdd( teStat::QueueSubmits, 1 );
+        StatAdd( teStat::QueueWaits, 1 );
     }
 #if !TARGET_OS_IPHONE
-    else if (strstr( file.path, ".dds" ) || strstr( file.path, ".DDS" ))
+    else if (parsedDDS || strstr( file.path, ".dds" ) || strstr( file.path, ".DDS" ))
     {
-        unsigned mipOffsets[ 15 ] = {};
-        bool loadRes = LoadDDS( file, tex.width, tex.height, outTexture.format, tex.mipLevelCount, mipOffsets  );
+        DDSData dds;
 
-        if (!loadRes)
+        // Streamed textures were parsed by a worker.
+        if (parsedDDS)
+        {
+            dds = *parsedDDS;
+        }
+        else if (!LoadDDS( file, dds ))
         {
             outTexture.index = 1;
             --textureCount;
             return outTexture;
         }
 
+        tex.width = dds.width;
+        tex.height = dds.height;
+        tex.mipLevelCount = dds.mipLevelCount;
+        outTexture.format = dds.format;
+        const unsigned* mipOffsets = dds.mipOffsets;
+
         tex.format = GetPixelFormat( outTexture.format );
         multiplier = (outTexture.format == teTextureFormat::BC1 || outTexture.format == teTextureFormat::BC1_SRGB || 
                       outTexture.format == teTextureFormat::BC4U || outTexture.format == teTextureFormat::BC4S) ? 2 : 4;
@@ -361,6 +379,8 @@ teTexture2D teLoadTexture( const teFile& file, unsigned flags, void* pixels, int
         blitEncoder->endEncoding();
         cmdBuffer->commit();
         cmdBuffer->waitUntilCompleted();
+        StatAdd( teStat::QueueSubmits, 1 );
+        StatAdd( teStat::QueueWaits, 1 );
     }
 #endif
     else
@@ -371,8 +391,24 @@ teTexture2D teLoadTexture( const teFile& file, unsigned flags, void* pixels, int
     return outTexture;
 }
 
+teTexture2D teLoadTexture( const teFile& file, unsigned flags, void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat )
+{
+    TE_PROFILE_SCOPE( "teLoadTexture" );
+
+    return LoadTexture2D( file, flags, pixels, pixelsWidth, pixelsHeight, pixelsFormat, nullptr );
+}
+
+teTexture2D CreateTextureFromDDS( const teFile& file, unsigned flags, const DDSData& dds )
+{
+    TE_PROFILE_SCOPE( "CreateTextureFromDDS" );
+
+    return LoadTexture2D( file, flags, nullptr, 0, 0, teTextureFormat::Invalid, &dds );
+}
+
 teTextureCube teLoadTexture( const teFile& negX, const teFile& posX, const teFile& negY, const teFile& posY, const teFile& negZ, const teFile& posZ, unsigned flags )
 {
+    TE_PROFILE_SCOPE( "teLoadTexture cube" );
+
     teAssert( textureCount + 1 < TextureCount );
     teAssert( !(flags & teTextureFlags::UAV) );
 
@@ -442,6 +478,8 @@ teTextureCube teLoadTexture( const teFile& negX, const teFile& posX, const teFil
                 blitEncoder->endEncoding();
                 cmdBuffer->commit();
                 cmdBuffer->waitUntilCompleted();
+                StatAdd( teStat::QueueSubmits, 1 );
+                StatAdd( teStat::QueueWaits, 1 );
             }
         }
     }
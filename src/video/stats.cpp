@@ -0,0 +1,109 @@
+#include "material.h"
+#include "renderer.h"
+#include "te_stdlib.h"
+
+static constexpr unsigned StatCount = (unsigned)teStat::Count;
+static constexpr unsigned StatHistoryFrames = 60;
+
+// Values are doubles so that byte counters don't lose precision like floats would.
+struct RendererStats
+{
+    double current[ StatCount ] = {};
+    double history[ StatHistoryFrames ][ StatCount ] = {};
+    unsigned historyIndex = 0;
+    unsigned historyCount = 0;
+    bool isFrameStarted = false;
+};
+
+static RendererStats rendererStats;
+TE_TRACK_STATIC_MEMORY( rendererStatsMemory, teMemoryTag::Renderer, sizeof( rendererStats ) );
+
+static bool IsGpuTime( teStat stat )
+{
+    return stat >= teStat::GpuFrameMs && stat <= teStat::GpuUIMs;
+}
+
+void StatAdd( teStat stat, unsigned amount )
+{
+    rendererStats.current[ (unsigned)stat ] += amount;
+}
+
+// GPU times are set when they have been read back and keep their value until the next read.
+void StatSet( teStat stat, float value )
+{
+    rendererStats.current[ (unsigned)stat ] = value;
+}
+
+// Called by teBeginFrame. Moves the finished frame's counters to the history and resets them.
+void StatsNewFrame()
+{
+    if (rendererStats.isFrameStarted)
+    {
+        for (unsigned statIndex = 0; statIndex < StatCount; ++statIndex)
+        {
+            rendererStats.history[ rendererStats.historyIndex ][ statIndex ] = rendererStats.current[ statIndex ];
+        }
+
+        rendererStats.historyIndex = (rendererStats.historyIndex + 1) % StatHistoryFrames;
+        rendererStats.historyCount = rendererStats.historyCount < StatHistoryFrames ? rendererStats.historyCount + 1 : StatHistoryFrames;
+    }
+
+    for (unsigned statIndex = 0; statIndex < StatCount; ++statIndex)
+    {
+        if (!IsGpuTime( (teStat)statIndex ))
+        {
+            rendererStats.current[ statIndex ] = 0;
+        }
+    }
+
+    rendererStats.isFrameStarted = true;
+}
+
+float teRendererGetStat( teStat stat )
+{
+    teAssert( stat < teStat::Count );
+
+    return stat < teStat::Count ? (float)rendererStats.current[ (unsigned)stat ] : 0;
+}
+
+float teRendererGetStatAverage( teStat stat )
+{
+    teAssert( stat < teStat::Count );
+
+    if (stat >= teStat::Count || rendererStats.historyCount == 0)
+    {
+        return 0;
+    }
+
+    double sum = 0;
+
+    for (unsigned frame = 0; frame < rendererStats.historyCount; ++frame)
+    {
+        sum += rendererStats.history[ frame ][ (unsigned)stat ];
+    }
+
+    return (float)(sum / rendererStats.historyCount);
+}
+
+void teRendererResetStats()
+{
+    rendererStats = RendererStats();
+}
+
+const char* teRendererGetStatName( teStat stat )
+{
+    static const char* Names[] =
+    {
+        "Draw calls", "PSO binds", "Triangles", "Meshlets", "Descriptor writes", "Push constant bytes", "UBO bytes",
+        "Buffer upload bytes", "Texture upload bytes", "Queue submits", "Queue waits",
+        "Shadow objects tested", "Shadow submeshes tested", "Shadow submeshes frustum culled", "Shadow submeshes drawn",
+        "Camera objects tested", "Camera submeshes tested", "Camera submeshes frustum culled", "Camera submeshes occlusion culled",
+        "Camera submeshes drawn", "Depth normals submeshes drawn", "Instances drawn", "Lights tiled",
+        "CPU light clustering ms",
+        "GPU frame ms", "GPU shadow ms", "GPU depth normals ms", "GPU light culling ms", "GPU opaque ms", "GPU alpha ms", "GPU bloom ms", "GPU UI ms",
+    };
+
+    static_assert( sizeof( Names ) / sizeof( Names[ 0 ] ) == StatCount, "Names must match teStat" );
+
+    return stat < teStat::Count ? Names[ (unsigned)stat ] : "Invalid";
+}
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include "file.h"
 #include "texture.h"
+#include "textureloader.h"
 #include "te_stdlib.h"
 
 #define DDS_MAGIC 0x20534444
@@ -298,6 +299,11 @@ bool LoadDDS( const teFile& fileContents, unsigned& outWidth, unsigned& outHeigh
     return true;
 }
 
+bool LoadDDS( const teFile& fileContents, DDSData& outData )
+{
+    return LoadDDS( fileContents, outData.width, outData.height, outData.format, outData.mipLevelCount, outData.mipOffsets );
+}
+
 // Supported format: RGBA8, non-RLE .tga
 bool LoadTGA( const teFile& file, unsigned& outWidth, unsigned& outHeight, unsigned& outDataBeginOffset, unsigned& outBitsPerPixel )
 {
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "texture.h"
+
+struct teFile;
+
+// Header and mip table of a .dds file. Filling it only reads the file's bytes, so streaming workers can do it and
+// the render thread only has to create the texture and copy the mips.
+struct DDSData
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned mipLevelCount = 0;
+    unsigned mipOffsets[ 15 ] = {};
+    teTextureFormat format = teTextureFormat::Invalid;
+};
+
+bool LoadTGA( const teFile& file, unsigned& outWidth, unsigned& outHeight, unsigned& outDataBeginOffset, unsigned& outBitsPerPixel );
+bool LoadDDS( const teFile& fileContents, unsigned& outWidth, unsigned& outHeight, teTextureFormat& outFormat, unsigned& outMipLevelCount, unsigned( &outMipOffsets )[ 15 ] );
+bool LoadDDS( const teFile& fileContents, DDSData& outData );
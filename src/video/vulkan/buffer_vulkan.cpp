@@ -1,5 +1,6 @@
 #include <vulkan/vulkan.h>
 #include "buffer.h"
+#include "te_stdlib.h"
 
 void SetObjectName( VkDevice device, uint64_t object, VkObjectType objectType, const char* name );
 uint32_t GetMemoryType( uint32_t typeBits, const VkPhysicalDeviceMemoryProperties& deviceMemoryProperties, VkFlags properties );
@@ -12,6 +13,7 @@ struct BufferImpl
 };
 
 BufferImpl buffers[ 10000 ];
+TE_TRACK_STATIC_MEMORY( buffersMemory, teMemoryTag::Renderer, sizeof( buffers ) );
 unsigned bufferCount = 0;
 
 VkBuffer BufferGetBuffer( const teBuffer& buffer )
@@ -54,6 +56,11 @@ teBuffer CreateBuffer( VkDevice device, const VkPhysicalDeviceMemoryProperties&
     allocInfo.pNext = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? &flagsInfo : nullptr;
     allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, deviceMemoryProperties, memoryFlags );
     VK_CHECK( vkAllocateMemory( device, &allocInfo, nullptr, &buffers[ outBuffer.index ].memory ) );
+
+    if (memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        teMemoryTrackAllocation( teMemoryTag::Renderer, memReqs.size );
+    }
     SetObjectName( device, (uint64_t)buffers[ outBuffer.index ].memory, VK_OBJECT_TYPE_DEVICE_MEMORY, debugName );
 
     VK_CHECK( vkBindBufferMemory( device, buffers[ outBuffer.index ].buffer, buffers[ outBuffer.index ].memory, 0 ) );
@@ -1,11 +1,13 @@
 #include <vulkan/vulkan.h>
 #include <stdlib.h>
 #include "renderer.h"
+#include "affine3x4.h"
 #include "buffer.h"
 #include "camera.h"
 #include "file.h"
 #include "material.h"
 #include "matrix.h"
+#include "profiler.h"
 #include "texture.h"
 #include "te_stdlib.h"
 #include "shader.h"
@@ -25,7 +27,7 @@ teTextureCube teCreateTextureCube( VkDevice device, const VkPhysicalDeviceMemory
 teTextureCube teLoadTexture( const teFile& negX, const teFile& posX, const teFile& negY, const teFile& posY, const teFile& negZ, const teFile& posZ, unsigned flags,
     VkDevice device, VkBuffer* stagingBuffers, const VkPhysicalDeviceMemoryProperties& deviceMemoryProperties, VkQueue graphicsQueue, VkCommandBuffer cmdBuffer );
 teTexture2D teLoadTexture( const struct teFile& file, unsigned flags, VkDevice device, VkBuffer stagingBuffer, const VkPhysicalDeviceMemoryProperties& deviceMemoryProperties, VkQueue graphicsQueue, VkCommandBuffer cmdBuffer, const VkPhysicalDeviceProperties& properties,
-                           void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat );
+                           void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat, const struct DDSData* parsedDDS );
 VkImageView TextureGetView( teTexture2D texture );
 VkImage TextureGetImage( teTexture2D texture );
 unsigned TextureGetFlags( unsigned index );
@@ -36,6 +38,7 @@ VkBuffer BufferGetBuffer( const teBuffer& buffer );
 void WaylandDispatch();
 void InitLightTiler( unsigned widthPixels, unsigned heightPixels );
 unsigned GetPointLightCount();
+Vec4 GetLightClusterParams();
 teBuffer GetPointLightCenterAndRadiusBuffer();
 teBuffer GetPointLightColorBuffer();
 teBuffer GetLightIndexBuffer();
@@ -43,6 +46,12 @@ teBuffer& GetMeshletVertexBuffer( unsigned meshIndex, unsigned subMeshIndex );
 teBuffer& GetMeshletTriangleBuffer( unsigned meshIndex, unsigned subMeshIndex );
 teBuffer& GetMeshletBuffer( unsigned meshIndex, unsigned subMeshIndex );
 unsigned GetMeshletCount( unsigned index, unsigned subMeshIndex );
+void ResetFrameAllocator();
+void ProfilerNewFrame();
+void StatAdd( teStat stat, unsigned amount );
+void StatSet( teStat stat, float value );
+void StatsNewFrame();
+void StreamingUpdate();
 
 extern struct wl_display* gwlDisplay;
 extern struct wl_surface* gwlSurface;
@@ -72,6 +81,7 @@ struct PushConstants
     uint64_t spotLightCenterAndRadiusBuf;
     uint64_t spotLightColorBuf;
     uint64_t spotLightParamBuf;
+    uint64_t instanceBuf;
     int textureIndex;
     int shadowTextureIndex;
     int normalMapIndex;
@@ -110,12 +120,13 @@ struct PSO
     teTextureFormat depthFormat = teTextureFormat::Invalid;
 };
 
+// Object transforms are affine, so shaders get localToClip and localToShadowClip by multiplying them with the view's projections.
 struct PerObjectUboStruct
 {
-    Matrix localToClip;
-    Matrix localToView;
-    Matrix localToShadowClip;
-    Matrix localToWorld;
+    Affine3x4 localToView;
+    Affine3x4 localToWorld;
+    Matrix viewToClip;
+    Matrix worldToShadowClip;
     Matrix clipToView;
     Vec4 bloomParams;
     Vec4 tilesXY;
@@ -123,6 +134,7 @@ struct PerObjectUboStruct
     Vec4 lightDirection;
     Vec4 lightColor;
     Vec4 lightPosition;
+    Vec4 clusterParams;
     unsigned pointLightCount;
     unsigned spotLightCount;
     unsigned maxLightsPerTile;
@@ -135,6 +147,29 @@ struct Ubo
     size_t offset = 0;
 };
 
+// Must match InstanceData in ubo.h shader header!
+struct InstanceData
+{
+    Affine3x4 localToWorld;
+    Vec4 tint;
+};
+
+// Slot 0 is an identity instance used by non-instanced draws.
+struct InstanceBuffer
+{
+    InstanceData* data = nullptr;
+    teBuffer buffer;
+    unsigned offset = 1;
+};
+
+// Persistently mapped source of the frame's UploadBufferRanges() copies.
+struct UploadRing
+{
+    uint8_t* data = nullptr;
+    teBuffer buffer;
+    unsigned offset = 0;
+};
+
 struct SwapchainResource
 {
     VkImage image = VK_NULL_HANDLE;
@@ -147,6 +182,8 @@ struct SwapchainResource
     VkDeviceMemory depthStencilMem = VK_NULL_HANDLE;
     VkImageView depthStencilView = VK_NULL_HANDLE;
     Ubo ubo;
+    InstanceBuffer instances;
+    UploadRing uploads;
     teTextureFormat colorFormat = teTextureFormat::Invalid;
     teTextureFormat depthFormat = teTextureFormat::Invalid;
     static constexpr unsigned SetCount = 1000;
@@ -154,6 +191,21 @@ struct SwapchainResource
     VkDescriptorSet descriptorSets[ SetCount ] = {};
 };
 
+static constexpr unsigned MaxGpuScopesPerFrame = 64;
+static constexpr unsigned GpuQueriesPerFrame = 2 + MaxGpuScopesPerFrame * 2;
+static constexpr unsigned GpuStatCount = (unsigned)teStat::GpuUIMs - (unsigned)teStat::GpuFrameMs + 1;
+
+// Timestamp queries of one frame in flight. Queries 0 and 1 bracket the frame, scope i uses queries 2 + i * 2 and 3 + i * 2.
+// They're read when the frame's fence is waited on again, so reading never stalls.
+struct GpuTimerFrame
+{
+    int scopeStats[ MaxGpuScopesPerFrame ] = {}; // Offset from teStat::GpuFrameMs, -1 if the scope isn't reported.
+    unsigned openScopes[ MaxGpuScopesPerFrame ] = {};
+    unsigned scopeCount = 0;
+    unsigned openScopeCount = 0;
+    bool isSubmitted = false;
+};
+
 struct Renderer
 {
     VkInstance instance;
@@ -191,6 +243,13 @@ struct Renderer
     unsigned positionCounter = 0;
     unsigned normalCounter = 0;
     unsigned tangentCounter = 0;
+    // Geometry below these offsets has been copied from the staging buffers to the mesh buffers.
+    unsigned finalizedIndexCounter = 0;
+    unsigned finalizedUVCounter = 0;
+    unsigned finalizedPositionCounter = 0;
+    unsigned finalizedNormalCounter = 0;
+    unsigned finalizedTangentCounter = 0;
+    bool hasQueuedMeshUploads = false;
     teTextureFormat currentColorFormat = teTextureFormat::Invalid;
     teTextureFormat currentDepthFormat = teTextureFormat::Invalid;
 
@@ -217,6 +276,8 @@ struct Renderer
     VkDeviceMemory textureStagingMemories[ 6 ];
     VkMemoryAllocateInfo textureStagingMemAllocInfos[ 6 ];
     VkQueryPool queryPool;
+    GpuTimerFrame gpuTimerFrames[ 4 ];
+    uint64_t timestampMask = 0; // 0 if the graphics queue doesn't support timestamps.
     VkCommandBuffer texCommandBuffer = VK_NULL_HANDLE;
 
     static constexpr unsigned MaxPSOs = 250;
@@ -239,14 +300,14 @@ struct Renderer
 
     ShaderParams shaderParams;
 
-    unsigned statDrawCalls = 0;
-    unsigned statPSOBinds = 0;
-
     bool meshShaderSupported = false;
     unsigned lineCount = 0;
     teShader lineShader;
+    unsigned pendingInstanceCount = 0; // Set by UpdateInstances() for the next Draw().
 
     static constexpr unsigned uboSizeBytes = sizeof( PerObjectUboStruct ) * 10000;
+    static constexpr unsigned maxInstancesPerFrame = 65536;
+    static constexpr unsigned uploadRingSizeBytes = 4 * 1024 * 1024;
 };
 
 Renderer renderer;
@@ -523,6 +584,7 @@ static void CreateStagingTexture( unsigned index )
     renderer.textureStagingMemAllocInfos[ index ].allocationSize = (memReqs.size + renderer.properties.limits.nonCoherentAtomSize - 1) & ~(renderer.properties.limits.nonCoherentAtomSize - 1);;
     renderer.textureStagingMemAllocInfos[ index ].memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, renderer.deviceMemoryProperties, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
     VK_CHECK( vkAllocateMemory( renderer.device, &renderer.textureStagingMemAllocInfos[ index ], nullptr, &renderer.textureStagingMemories[ index ] ) );
+    teMemoryTrackAllocation( teMemoryTag::Texture, renderer.textureStagingMemAllocInfos[ index ].allocationSize );
     SetObjectName( renderer.device, (uint64_t)renderer.textureStagingMemories[ index ], VK_OBJECT_TYPE_DEVICE_MEMORY, "texture staging memory" );
 
     VK_CHECK( vkBindBufferMemory( renderer.device, renderer.textureStagingBuffers[ index ], renderer.textureStagingMemories[ index ], 0 ) );
@@ -548,6 +610,7 @@ void UpdateStagingTexture( const uint8_t* src, unsigned width, unsigned height,
     VK_CHECK( vkMapMemory( renderer.device, renderer.textureStagingMemories[ index ], 0, renderer.textureStagingMemAllocInfos[ index ].allocationSize, 0, &stagingData ) );
     
     teMemcpy( stagingData, src, imageSize );
+    StatAdd( teStat::TextureUploadBytes, (unsigned)imageSize );
 
     VkMappedMemoryRange flushRange = {};
     flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
@@ -769,6 +832,8 @@ static int GetPSO( const teShader& shader, teBlendMode blendMode, teCullMode cul
 
 teShader teCreateShader( const struct teFile& vertexFile, const struct teFile& fragmentFile, const char* vertexName, const char* fragmentName )
 {
+    TE_PROFILE_SCOPE( "teCreateShader" );
+
     return teCreateShader( renderer.device, vertexFile, fragmentFile, vertexName, fragmentName );
 }
 
@@ -794,14 +859,26 @@ teTextureCube teCreateTextureCube( unsigned dimension, unsigned flags, teTexture
 
 teTexture2D teLoadTexture( const struct teFile& file, unsigned flags, void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat )
 {
+    TE_PROFILE_SCOPE( "teLoadTexture" );
+
     teTexture2D outTexture = teLoadTexture( file, flags, renderer.device, renderer.textureStagingBuffers[ 0 ], renderer.deviceMemoryProperties, renderer.graphicsQueue, /*renderer.swapchainResources[renderer.frameIndex].drawCommandBuffer*/renderer.texCommandBuffer, renderer.properties,
-                                            pixels, pixelsWidth, pixelsHeight, pixelsFormat );
+                                            pixels, pixelsWidth, pixelsHeight, pixelsFormat, nullptr );
     
     return outTexture;
 }
 
+teTexture2D CreateTextureFromDDS( const teFile& file, unsigned flags, const DDSData& dds )
+{
+    TE_PROFILE_SCOPE( "CreateTextureFromDDS" );
+
+    return teLoadTexture( file, flags, renderer.device, renderer.textureStagingBuffers[ 0 ], renderer.deviceMemoryProperties, renderer.graphicsQueue, renderer.texCommandBuffer, renderer.properties,
+                          nullptr, 0, 0, teTextureFormat::Invalid, &dds );
+}
+
 teTextureCube teLoadTexture( const teFile& negX, const teFile& posX, const teFile& negY, const teFile& posY, const teFile& negZ, const teFile& posZ, unsigned flags )
 {
+    TE_PROFILE_SCOPE( "teLoadTexture cube" );
+
     teTextureCube outTexture = teLoadTexture( negX, posX, negY, posY, negZ, posZ, flags, renderer.device, renderer.textureStagingBuffers, renderer.deviceMemoryProperties, renderer.graphicsQueue, renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer );
 
     return outTexture;
@@ -926,14 +1003,135 @@ void EndRegion( VkCommandBuffer cmdBuffer )
     }
 }
 
+// Maps group marker and dispatch names to the passes that are reported by teRendererGetStat().
+static int GetGpuScopeStat( const char* name )
+{
+    struct ScopeStat { const char* name; teStat stat; };
+    static const ScopeStat scopeStats[] =
+    {
+        { "Shadow Map", teStat::GpuShadowMs },
+        { "DepthNormals", teStat::GpuDepthNormalsMs },
+        { "Cull Lights", teStat::GpuLightCullingMs },
+        { "Opaque", teStat::GpuOpaqueMs },
+        { "Alpha", teStat::GpuAlphaMs },
+        { "ImGui", teStat::GpuUIMs },
+    };
+
+    for (unsigned i = 0; i < sizeof( scopeStats ) / sizeof( scopeStats[ 0 ] ); ++i)
+    {
+        if (teStrcmp( name, scopeStats[ i ].name ) == 0)
+        {
+            return (int)scopeStats[ i ].stat - (int)teStat::GpuFrameMs;
+        }
+    }
+
+    if (teStrstr( name, "bloom" ) == name)
+    {
+        return (int)teStat::GpuBloomMs - (int)teStat::GpuFrameMs;
+    }
+
+    return -1;
+}
+
+static void BeginGpuScope( const char* name )
+{
+    GpuTimerFrame& frame = renderer.gpuTimerFrames[ renderer.frameIndex ];
+
+    teAssert( frame.openScopeCount < MaxGpuScopesPerFrame );
+
+    if (renderer.timestampMask == 0 || frame.scopeCount == MaxGpuScopesPerFrame)
+    {
+        frame.openScopes[ frame.openScopeCount++ ] = MaxGpuScopesPerFrame; // Not timed, but keeps EndGpuScope() balanced.
+        return;
+    }
+
+    // A scope inside a reported scope isn't reported, so Opaque inside Shadow Map counts only towards the shadow time.
+    bool isInsideReportedScope = false;
+
+    for (unsigned i = 0; i < frame.openScopeCount; ++i)
+    {
+        isInsideReportedScope |= frame.openScopes[ i ] != MaxGpuScopesPerFrame && frame.scopeStats[ frame.openScopes[ i ] ] != -1;
+    }
+
+    const unsigned scopeIndex = frame.scopeCount++;
+    frame.scopeStats[ scopeIndex ] = isInsideReportedScope ? -1 : GetGpuScopeStat( name );
+    frame.openScopes[ frame.openScopeCount++ ] = scopeIndex;
+
+    vkCmdWriteTimestamp( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, renderer.queryPool,
+                         renderer.frameIndex * GpuQueriesPerFrame + 2 + scopeIndex * 2 );
+}
+
+static void EndGpuScope()
+{
+    GpuTimerFrame& frame = renderer.gpuTimerFrames[ renderer.frameIndex ];
+    teAssert( frame.openScopeCount > 0 );
+
+    if (frame.openScopeCount == 0)
+    {
+        return;
+    }
+
+    const unsigned scopeIndex = frame.openScopes[ --frame.openScopeCount ];
+
+    if (scopeIndex != MaxGpuScopesPerFrame)
+    {
+        vkCmdWriteTimestamp( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, renderer.queryPool,
+                             renderer.frameIndex * GpuQueriesPerFrame + 3 + scopeIndex * 2 );
+    }
+}
+
+// Called after the frame's fence has been waited on, so the results are available if the frame was submitted.
+static void ReadGpuTimers()
+{
+    GpuTimerFrame& frame = renderer.gpuTimerFrames[ renderer.frameIndex ];
+
+    if (!frame.isSubmitted)
+    {
+        return;
+    }
+
+    frame.isSubmitted = false;
+
+    uint64_t timestamps[ GpuQueriesPerFrame ] = {};
+    const unsigned queryCount = 2 + frame.scopeCount * 2;
+    const VkResult result = vkGetQueryPoolResults( renderer.device, renderer.queryPool, renderer.frameIndex * GpuQueriesPerFrame, queryCount, sizeof( timestamps ),
+                                                   timestamps, sizeof( uint64_t ), VK_QUERY_RESULT_64_BIT );
+
+    if (result != VK_SUCCESS)
+    {
+        return;
+    }
+
+    const float tickMs = renderer.properties.limits.timestampPeriod * 1e-6f;
+    float timesMs[ GpuStatCount ] = {};
+    timesMs[ 0 ] = ((timestamps[ 1 ] - timestamps[ 0 ]) & renderer.timestampMask) * tickMs;
+
+    for (unsigned scopeIndex = 0; scopeIndex < frame.scopeCount; ++scopeIndex)
+    {
+        if (frame.scopeStats[ scopeIndex ] != -1)
+        {
+            timesMs[ frame.scopeStats[ scopeIndex ] ] += ((timestamps[ 3 + scopeIndex * 2 ] - timestamps[ 2 + scopeIndex * 2 ]) & renderer.timestampMask) * tickMs;
+        }
+    }
+
+    for (unsigned i = 0; i < GpuStatCount; ++i)
+    {
+        StatSet( (teStat)((unsigned)teStat::GpuFrameMs + i), timesMs[ i ] );
+    }
+}
+
 void PushGroupMarker( const char* name )
 {
+    teProfileBegin( name );
     BeginRegion( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, name, 0, 1, 0 );
+    BeginGpuScope( name );
 }
 
 void PopGroupMarker()
 {
+    EndGpuScope();
     EndRegion( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer );
+    teProfileEnd();
 }
 
 void CreateInstance()
@@ -1022,7 +1220,7 @@ void CreateDevice()
 {
     uint32_t gpuCount;
     VK_CHECK( vkEnumeratePhysicalDevices( renderer.instance, &gpuCount, nullptr ) );
-    VkPhysicalDevice* physicalDevices = (VkPhysicalDevice*)teMalloc( sizeof( VkPhysicalDevice ) * gpuCount );
+    VkPhysicalDevice* physicalDevices = (VkPhysicalDevice*)teMalloc( sizeof( VkPhysicalDevice ) * gpuCount, teMemoryTag::Renderer );
     VK_CHECK( vkEnumeratePhysicalDevices( renderer.instance, &gpuCount, physicalDevices ) );
     renderer.physicalDevice = physicalDevices[ 0 ];
     teFree( physicalDevices );
@@ -1048,7 +1246,7 @@ void CreateDevice()
         }
     }
 
-    VkQueueFamilyProperties* queueProps = (VkQueueFamilyProperties*)teMalloc( sizeof( VkQueueFamilyProperties ) * queueCount );
+    VkQueueFamilyProperties* queueProps = (VkQueueFamilyProperties*)teMalloc( sizeof( VkQueueFamilyProperties ) * queueCount, teMemoryTag::Renderer );
     vkGetPhysicalDeviceQueueFamilyProperties( renderer.physicalDevice, &queueCount, queueProps );
 
     for (renderer.graphicsQueueIndex = 0; renderer.graphicsQueueIndex < queueCount; ++renderer.graphicsQueueIndex)
@@ -1058,6 +1256,9 @@ void CreateDevice()
             break;
         }
     }
+
+    const uint32_t timestampValidBits = queueProps[ renderer.graphicsQueueIndex ].timestampValidBits;
+    renderer.timestampMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
     
     teFree( queueProps );
 
@@ -1110,7 +1311,7 @@ void CreateDevice()
     VkQueryPoolCreateInfo queryPoolInfo = {};
     queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
     queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-    queryPoolInfo.queryCount = 2;
+    queryPoolInfo.queryCount = GpuQueriesPerFrame * 4;
 
     VK_CHECK( vkCreateQueryPool( renderer.device, &queryPoolInfo, nullptr, &renderer.queryPool ) );
     SetObjectName( renderer.device, (uint64_t)renderer.queryPool, VK_OBJECT_TYPE_QUERY_POOL, "Query Pool" );
@@ -1205,7 +1406,7 @@ void CreateSwapchain( void* windowHandle, unsigned width, unsigned height, unsig
     uint32_t formatCount = 0;
     VK_CHECK( renderer.getPhysicalDeviceSurfaceFormatsKHR( renderer.physicalDevice, renderer.surface, &formatCount, nullptr ) );
 
-    VkSurfaceFormatKHR* surfFormats = (VkSurfaceFormatKHR*)teMalloc( sizeof( VkSurfaceFormatKHR ) * formatCount );
+    VkSurfaceFormatKHR* surfFormats = (VkSurfaceFormatKHR*)teMalloc( sizeof( VkSurfaceFormatKHR ) * formatCount, teMemoryTag::Renderer );
     VK_CHECK( renderer.getPhysicalDeviceSurfaceFormatsKHR( renderer.physicalDevice, renderer.surface, &formatCount, surfFormats ) );
 
     VkFormat colorFormat = VK_FORMAT_UNDEFINED;
@@ -1269,7 +1470,7 @@ void CreateSwapchain( void* windowHandle, unsigned width, unsigned height, unsig
     SetObjectName( renderer.device, (uint64_t)renderer.swapchain, VK_OBJECT_TYPE_SWAPCHAIN_KHR, "swap chain" );
 
     VK_CHECK( renderer.getSwapchainImagesKHR( renderer.device, renderer.swapchain, &renderer.swapchainImageCount, nullptr ) );
-    VkImage* images = (VkImage*)teMalloc( sizeof( VkImage ) * renderer.swapchainImageCount );
+    VkImage* images = (VkImage*)teMalloc( sizeof( VkImage ) * renderer.swapchainImageCount, teMemoryTag::Renderer );
     VK_CHECK( renderer.getSwapchainImagesKHR( renderer.device, renderer.swapchain, &renderer.swapchainImageCount, images ) );
 
     teAssert( renderer.swapchainImageCount < 5 );
@@ -1389,23 +1590,125 @@ void CreateBuffers()
     renderer.lineVertexBuffer = CreateBuffer( renderer.device, renderer.deviceMemoryProperties, 1024 * 1024 * 8, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "lineVertexBuffer" );
     renderer.uiVertexBuffer = CreateBuffer( renderer.device, renderer.deviceMemoryProperties, UiBufferBytes, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "uiVertexBuffer" );
     renderer.uiIndexBuffer = CreateBuffer( renderer.device, renderer.deviceMemoryProperties, UiBufferBytes, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "uiIndexBuffer" );
-    renderer.uiVertices = (float*)teMalloc( UiBufferBytes );
-    renderer.uiIndices = (uint16_t*)teMalloc( UiBufferBytes );
+    renderer.uiVertices = (float*)teMalloc( UiBufferBytes, teMemoryTag::Renderer );
+    renderer.uiIndices = (uint16_t*)teMalloc( UiBufferBytes, teMemoryTag::Renderer );
 
     for (unsigned i = 0; i < 4; ++i)
     {
         renderer.swapchainResources[ i ].ubo.buffer = CreateBuffer( renderer.device, renderer.deviceMemoryProperties, renderer.uboSizeBytes, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, "UBO" );
         VK_CHECK( vkMapMemory( renderer.device, BufferGetMemory( renderer.swapchainResources[ i ].ubo.buffer ), 0, renderer.uboSizeBytes, 0, (void**)&renderer.swapchainResources[ i ].ubo.uboData ) );
+
+        const unsigned instanceBufferBytes = renderer.maxInstancesPerFrame * sizeof( InstanceData );
+        renderer.swapchainResources[ i ].instances.buffer = CreateBuffer( renderer.device, renderer.deviceMemoryProperties, instanceBufferBytes, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, "instanceBuffer" );
+        VK_CHECK( vkMapMemory( renderer.device, BufferGetMemory( renderer.swapchainResources[ i ].instances.buffer ), 0, instanceBufferBytes, 0, (void**)&renderer.swapchainResources[ i ].instances.data ) );
+        renderer.swapchainResources[ i ].instances.data[ 0 ] = { Affine3x4(), Vec4( 1, 1, 1, 1 ) };
+
+        renderer.swapchainResources[ i ].uploads.buffer = CreateBuffer( renderer.device, renderer.deviceMemoryProperties, renderer.uploadRingSizeBytes, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "uploadRing" );
+        VK_CHECK( vkMapMemory( renderer.device, BufferGetMemory( renderer.swapchainResources[ i ].uploads.buffer ), 0, renderer.uploadRingSizeBytes, 0, (void**)&renderer.swapchainResources[ i ].uploads.data ) );
     }
 }
 
+struct MeshBufferCopy
+{
+    teBuffer source;
+    teBuffer destination;
+    unsigned offset;
+    unsigned sizeBytes;
+};
+
+// @return Count of copies for the geometry that has been added since the previous call. Geometry is only appended.
+static unsigned TakeNewMeshData( MeshBufferCopy outCopies[ 5 ] )
+{
+    const MeshBufferCopy copies[ 5 ] =
+    {
+        { renderer.staticMeshIndexStagingBuffer, renderer.staticMeshIndexBuffer, renderer.finalizedIndexCounter, renderer.indexCounter - renderer.finalizedIndexCounter },
+        { renderer.staticMeshUVStagingBuffer, renderer.staticMeshUVBuffer, renderer.finalizedUVCounter, renderer.uvCounter - renderer.finalizedUVCounter },
+        { renderer.staticMeshPositionStagingBuffer, renderer.staticMeshPositionBuffer, renderer.finalizedPositionCounter, renderer.positionCounter - renderer.finalizedPositionCounter },
+        { renderer.staticMeshNormalStagingBuffer, renderer.staticMeshNormalBuffer, renderer.finalizedNormalCounter, renderer.normalCounter - renderer.finalizedNormalCounter },
+        { renderer.staticMeshTangentStagingBuffer, renderer.staticMeshTangentBuffer, renderer.finalizedTangentCounter, renderer.tangentCounter - renderer.finalizedTangentCounter },
+    };
+
+    unsigned count = 0;
+
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        if (copies[ i ].sizeBytes > 0)
+        {
+            outCopies[ count++ ] = copies[ i ];
+        }
+    }
+
+    renderer.finalizedIndexCounter = renderer.indexCounter;
+    renderer.finalizedUVCounter = renderer.uvCounter;
+    renderer.finalizedPositionCounter = renderer.positionCounter;
+    renderer.finalizedNormalCounter = renderer.normalCounter;
+    renderer.finalizedTangentCounter = renderer.tangentCounter;
+
+    return count;
+}
+
+// The new ranges haven't been read by any command yet, so only the reads after the copies need a barrier.
+static void RecordMeshBufferCopies( VkCommandBuffer cmdBuffer, const MeshBufferCopy* copies, unsigned copyCount )
+{
+    for (unsigned i = 0; i < copyCount; ++i)
+    {
+        VkBufferCopy region = {};
+        region.srcOffset = copies[ i ].offset;
+        region.dstOffset = copies[ i ].offset;
+        region.size = copies[ i ].sizeBytes;
+        vkCmdCopyBuffer( cmdBuffer, BufferGetBuffer( copies[ i ].source ), BufferGetBuffer( copies[ i ].destination ), 1, &region );
+        StatAdd( teStat::BufferUploadBytes, copies[ i ].sizeBytes );
+    }
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+}
+
 void teFinalizeMeshBuffers()
 {
-    CopyBuffer( renderer.staticMeshIndexStagingBuffer, renderer.staticMeshIndexBuffer );
-    CopyBuffer( renderer.staticMeshUVStagingBuffer, renderer.staticMeshUVBuffer );
-    CopyBuffer( renderer.staticMeshPositionStagingBuffer, renderer.staticMeshPositionBuffer );
-    CopyBuffer( renderer.staticMeshNormalStagingBuffer, renderer.staticMeshNormalBuffer );
-    CopyBuffer( renderer.staticMeshTangentStagingBuffer, renderer.staticMeshTangentBuffer );
+    MeshBufferCopy copies[ 5 ];
+    const unsigned copyCount = TakeNewMeshData( copies );
+
+    if (copyCount == 0)
+    {
+        return;
+    }
+
+    VkCommandBufferAllocateInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufInfo.commandPool = renderer.cmdPool;
+    cmdBufInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufInfo.commandBufferCount = 1;
+
+    VkCommandBuffer copyCommandBuffer;
+    VK_CHECK( vkAllocateCommandBuffers( renderer.device, &cmdBufInfo, &copyCommandBuffer ) );
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    VK_CHECK( vkBeginCommandBuffer( copyCommandBuffer, &cmdBufferBeginInfo ) );
+    RecordMeshBufferCopies( copyCommandBuffer, copies, copyCount );
+    VK_CHECK( vkEndCommandBuffer( copyCommandBuffer ) );
+
+    VkSubmitInfo copySubmitInfo = {};
+    copySubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    copySubmitInfo.commandBufferCount = 1;
+    copySubmitInfo.pCommandBuffers = &copyCommandBuffer;
+
+    VK_CHECK( vkQueueSubmit( renderer.graphicsQueue, 1, &copySubmitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
+    VK_CHECK( vkQueueWaitIdle( renderer.graphicsQueue ) );
+    StatAdd( teStat::QueueWaits, 1 );
+    vkFreeCommandBuffers( renderer.device, cmdBufInfo.commandPool, 1, &copyCommandBuffer );
+}
+
+// Called by streaming before the frame's command buffer begins. The copies are recorded at its start, without waiting.
+void QueueMeshBufferUploads()
+{
+    renderer.hasQueuedMeshUploads = true;
 }
 
 void CreateSamplers()
@@ -1500,7 +1803,9 @@ void CopyVulkanBuffer( VkBuffer source, VkBuffer destination, unsigned bufferSiz
     copySubmitInfo.pCommandBuffers = &copyCommandBuffer;
 
     VK_CHECK( vkQueueSubmit( renderer.graphicsQueue, 1, &copySubmitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
     VK_CHECK( vkQueueWaitIdle( renderer.graphicsQueue ) );
+    StatAdd( teStat::QueueWaits, 1 );
     vkFreeCommandBuffers( renderer.device, cmdBufInfo.commandPool, 1, &copyCommandBuffer );
 }
 
@@ -1513,6 +1818,72 @@ void UpdateStagingBuffer( const teBuffer& buffer, const void* data, unsigned dat
     VK_CHECK( vkMapMemory( renderer.device, BufferGetMemory( buffer ), offset, dataBytes, 0, &bufferData ) );
 
     teMemcpy( bufferData, data, dataBytes );
+    StatAdd( teStat::BufferUploadBytes, dataBytes );
+    vkUnmapMemory( renderer.device, BufferGetMemory( buffer ) );
+}
+
+// The copies go to the frame's command buffer. Barriers order them after earlier commands that read the destination,
+// including the frames still in flight, and before the frame's later shader reads.
+bool UploadBufferRanges( const teBuffer& destination, const void* data, const BufferRange* ranges, unsigned rangeCount )
+{
+    if (rangeCount == 0)
+    {
+        return true;
+    }
+
+    UploadRing& uploads = renderer.swapchainResources[ renderer.frameIndex ].uploads;
+    unsigned uploadBytes = 0;
+
+    for (unsigned i = 0; i < rangeCount; ++i)
+    {
+        teAssert( ranges[ i ].offset + ranges[ i ].sizeBytes <= destination.sizeBytes );
+        uploadBytes += (ranges[ i ].sizeBytes + 15) & ~15u;
+    }
+
+    if (uploads.offset + uploadBytes > renderer.uploadRingSizeBytes)
+    {
+        teLog( teLogLevel::Warning, "Upload ring is full, max is %u bytes per frame\n", renderer.uploadRingSizeBytes );
+        return false;
+    }
+
+    VkBufferCopy* copies = (VkBufferCopy*)teFrameAlloc( rangeCount * sizeof( VkBufferCopy ) );
+
+    for (unsigned i = 0; i < rangeCount; ++i)
+    {
+        teMemcpy( uploads.data + uploads.offset, (const uint8_t*)data + ranges[ i ].offset, ranges[ i ].sizeBytes );
+        copies[ i ].srcOffset = uploads.offset;
+        copies[ i ].dstOffset = ranges[ i ].offset;
+        copies[ i ].size = ranges[ i ].sizeBytes;
+        uploads.offset += (ranges[ i ].sizeBytes + 15) & ~15u;
+    }
+
+    VkCommandBuffer cmdBuffer = renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer;
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+
+    vkCmdCopyBuffer( cmdBuffer, BufferGetBuffer( uploads.buffer ), BufferGetBuffer( destination ), rangeCount, copies );
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier( cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+
+    StatAdd( teStat::BufferUploadBytes, uploadBytes );
+    return true;
+}
+
+void ReadStagingBuffer( const teBuffer& buffer, void* outData, unsigned dataBytes, unsigned offset )
+{
+    teAssert( BufferGetMemory( buffer ) != VK_NULL_HANDLE );
+    teAssert( dataBytes + offset <= buffer.sizeBytes );
+
+    void* bufferData = nullptr;
+    VK_CHECK( vkMapMemory( renderer.device, BufferGetMemory( buffer ), offset, dataBytes, 0, &bufferData ) );
+
+    teMemcpy( outData, bufferData, dataBytes );
     vkUnmapMemory( renderer.device, BufferGetMemory( buffer ) );
 }
 
@@ -1571,6 +1942,32 @@ unsigned AddTangents( const float* tangents, unsigned bytes )
     return renderer.tangentCounter - bytes;
 }
 
+// Geometry stays in the staging buffers after teFinalizeMeshBuffers(), so it can be read back for static batching.
+void ReadIndices( unsigned offset, unsigned bytes, unsigned short* outIndices )
+{
+    ReadStagingBuffer( renderer.staticMeshIndexStagingBuffer, outIndices, bytes, offset );
+}
+
+void ReadUVs( unsigned offset, unsigned bytes, float* outUVs )
+{
+    ReadStagingBuffer( renderer.staticMeshUVStagingBuffer, outUVs, bytes, offset );
+}
+
+void ReadPositions( unsigned offset, unsigned bytes, float* outPositions )
+{
+    ReadStagingBuffer( renderer.staticMeshPositionStagingBuffer, outPositions, bytes, offset );
+}
+
+void ReadNormals( unsigned offset, unsigned bytes, float* outNormals )
+{
+    ReadStagingBuffer( renderer.staticMeshNormalStagingBuffer, outNormals, bytes, offset );
+}
+
+void ReadTangents( unsigned offset, unsigned bytes, float* outTangents )
+{
+    ReadStagingBuffer( renderer.staticMeshTangentStagingBuffer, outTangents, bytes, offset );
+}
+
 teTextureCube GetDefaultTextureCube()
 {
     return renderer.defaultTextureCube;
@@ -1649,7 +2046,9 @@ void teCreateRenderer( unsigned swapInterval, void* windowHandle, unsigned width
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &renderer.swapchainResources[ 0 ].drawCommandBuffer;
     VK_CHECK( vkQueueSubmit( renderer.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
     VK_CHECK( vkQueueWaitIdle( renderer.graphicsQueue ) );
+    StatAdd( teStat::QueueWaits, 1 );
 
     InitLightTiler( width, height );
 }
@@ -1668,8 +2067,18 @@ static VkSampler GetSampler( teTextureSampler sampler )
 
 void teBeginFrame()
 {
+    ProfilerNewFrame();
+    StatsNewFrame();
+
+    TE_PROFILE_SCOPE( "teBeginFrame" );
+
+    ResetFrameAllocator();
+    StreamingUpdate();
+
     vkWaitForFences( renderer.device, 1, &renderer.swapchainResources[ renderer.frameIndex ].fence, VK_TRUE, UINT64_MAX );
+    StatAdd( teStat::QueueWaits, 1 );
     vkResetFences( renderer.device, 1, &renderer.swapchainResources[ renderer.frameIndex ].fence );
+    ReadGpuTimers();
 
     VkResult err = renderer.acquireNextImageKHR( renderer.device, renderer.swapchain, UINT64_MAX, renderer.swapchainResources[ renderer.frameIndex ].imageAcquiredSemaphore, VK_NULL_HANDLE, &renderer.currentBuffer );
 
@@ -1705,15 +2114,36 @@ void teBeginFrame()
     renderer.samplerInfos[ 5 ].sampler = GetSampler( teTextureSampler::Anisotropic8Clamp );
 
     renderer.swapchainResources[ renderer.frameIndex ].ubo.offset = 0;
+    renderer.swapchainResources[ renderer.frameIndex ].instances.offset = 1;
+    renderer.swapchainResources[ renderer.frameIndex ].uploads.offset = 0;
+    renderer.pendingInstanceCount = 0;
     renderer.boundPSO = VK_NULL_HANDLE;
-    renderer.statDrawCalls = 0;
-    renderer.statPSOBinds = 0;
 
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     VK_CHECK( vkBeginCommandBuffer( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, &cmdBufInfo ) );
 
-    //vkCmdResetQueryPool( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.queryPool, 0, 2 );
+    renderer.gpuTimerFrames[ renderer.frameIndex ].scopeCount = 0;
+    renderer.gpuTimerFrames[ renderer.frameIndex ].openScopeCount = 0;
+
+    if (renderer.timestampMask != 0)
+    {
+        vkCmdResetQueryPool( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.queryPool, renderer.frameIndex * GpuQueriesPerFrame, GpuQueriesPerFrame );
+        vkCmdWriteTimestamp( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, renderer.queryPool, renderer.frameIndex * GpuQueriesPerFrame );
+    }
+
+    if (renderer.hasQueuedMeshUploads)
+    {
+        MeshBufferCopy copies[ 5 ];
+        const unsigned copyCount = TakeNewMeshData( copies );
+
+        if (copyCount > 0)
+        {
+            RecordMeshBufferCopies( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, copies, copyCount );
+        }
+
+        renderer.hasQueuedMeshUploads = false;
+    }
 
     SetImageLayout( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.swapchainResources[ renderer.currentBuffer ].image,
         VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1, 0, 1, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
@@ -1721,6 +2151,8 @@ void teBeginFrame()
 
 void teEndFrame()
 {
+    TE_PROFILE_SCOPE( "teEndFrame" );
+
     VkImageMemoryBarrier imageMemoryBarrier = {};
     imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -1738,6 +2170,15 @@ void teEndFrame()
 
     vkCmdPipelineBarrier( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier );
 
+    GpuTimerFrame& gpuTimerFrame = renderer.gpuTimerFrames[ renderer.frameIndex ];
+    teAssert( gpuTimerFrame.openScopeCount == 0 );
+
+    if (renderer.timestampMask != 0)
+    {
+        vkCmdWriteTimestamp( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, renderer.queryPool, renderer.frameIndex * GpuQueriesPerFrame + 1 );
+        gpuTimerFrame.isSubmitted = gpuTimerFrame.openScopeCount == 0;
+    }
+
     VK_CHECK( vkEndCommandBuffer( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer ) );
 
     VkPipelineStageFlags pipelineStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
@@ -1753,10 +2194,7 @@ void teEndFrame()
     submitInfo.pCommandBuffers = &renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer;
 
     VK_CHECK( vkQueueSubmit( renderer.graphicsQueue, 1, &submitInfo, renderer.swapchainResources[ renderer.frameIndex ].fence ) );
-
-    uint64_t timestamps[ 2 ] = {};
-    /*VkResult res =*/ vkGetQueryPoolResults(renderer.device, renderer.queryPool, 0, 2, sizeof(uint64_t) * 2, timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
-    tePrint( "GPU: %f ms\n", (timestamps[ 1 ] - timestamps[ 0 ]) * renderer.properties.limits.timestampPeriod * 1e-6f );
+    StatAdd( teStat::QueueSubmits, 1 );
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1852,12 +2290,8 @@ void BeginRendering( teTexture2D& color, teTexture2D& depth, teClearFlag clearFl
 
     vkCmdPipelineBarrier( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthMemoryBarrier );
 
-    vkCmdResetQueryPool( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.queryPool, 0, 2 );
-
     vkCmdBeginRendering( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, &renderInfo );
 
-    vkCmdWriteTimestamp( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, renderer.queryPool, 0 );
-
     VkViewport viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
     vkCmdSetViewport( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, 0, 1, &viewport );
 
@@ -1872,8 +2306,6 @@ void BeginRendering( teTexture2D& color, teTexture2D& depth, teClearFlag clearFl
 
 void EndRendering( teTexture2D& color, teTexture2D& depth )
 {
-    vkCmdWriteTimestamp( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, renderer.queryPool, 1 );
-
     vkCmdEndRendering( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer );
 
     VkImageMemoryBarrier imageMemoryBarrier = {};
@@ -1963,13 +2395,13 @@ void RendererGetSize( unsigned& outWidth, unsigned& outHeight )
     outHeight = renderer.swapchainHeight;
 }
 
-void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16 ], const float localToWorld[ 16 ], const ShaderParams& shaderParams, const Vec4& lightDirection, const Vec4& lightColor, const Vec4& lightPosition )
+void UpdateUBO( const Affine3x4& localToView, const Matrix& viewToClip, const Affine3x4& localToWorld, const Matrix& worldToShadowClip, const ShaderParams& shaderParams, const Vec4& lightDirection, const Vec4& lightColor, const Vec4& lightPosition )
 {
     PerObjectUboStruct uboStruct = {};
-    uboStruct.localToClip.InitFrom( localToClip );
-    uboStruct.localToView.InitFrom( shaderParams.localToView );
-    uboStruct.localToShadowClip.InitFrom( localToShadowClip );
-    uboStruct.localToWorld.InitFrom( localToWorld );
+    uboStruct.localToView = localToView;
+    uboStruct.localToWorld = localToWorld;
+    uboStruct.viewToClip = viewToClip;
+    uboStruct.worldToShadowClip = worldToShadowClip;
     uboStruct.clipToView.InitFrom( shaderParams.clipToView );
     uboStruct.bloomParams.w = shaderParams.bloomThreshold;
     uboStruct.tilesXY.x = shaderParams.tilesXY[ 0 ];
@@ -1986,11 +2418,13 @@ void UpdateUBO( const float localToClip[ 16 ], const float localToShadowClip[ 16
     uboStruct.lightPosition.y = lightPosition.y;
     uboStruct.lightPosition.z = lightPosition.z;
     uboStruct.lightPosition.w = 1;
+    uboStruct.clusterParams = GetLightClusterParams();
     uboStruct.pointLightCount = GetPointLightCount();
     uboStruct.spotLightCount = GetSpotLightCount();
     uboStruct.maxLightsPerTile = GetMaxLightsPerTile( renderer.swapchainHeight );
 
     teMemcpy( renderer.swapchainResources[ renderer.frameIndex ].ubo.uboData + renderer.swapchainResources[ renderer.frameIndex ].ubo.offset, &uboStruct, sizeof( uboStruct ) );
+    StatAdd( teStat::UBOBytes, sizeof( uboStruct ) );
 }
 
 static void UpdateDescriptors( const teTexture2D& writeTexture, size_t uboOffset )
@@ -2036,6 +2470,7 @@ static void UpdateDescriptors( const teTexture2D& writeTexture, size_t uboOffset
     sets[ 3 ].dstBinding = 3;
 
     vkUpdateDescriptorSets( renderer.device, DescriptorEntryCount, sets, 0, nullptr );
+    StatAdd( teStat::DescriptorWrites, TextureCount + SamplerCount + 2 );
 }
 
 static void BindDescriptors( VkPipelineBindPoint bindPoint )
@@ -2046,6 +2481,27 @@ static void BindDescriptors( VkPipelineBindPoint bindPoint )
     renderer.swapchainResources[ renderer.frameIndex ].setIndex = (renderer.swapchainResources[ renderer.frameIndex ].setIndex + 1) % renderer.swapchainResources[ renderer.frameIndex ].SetCount;
 }
 
+void UpdateInstances( const Matrix* instanceToWorld, const Vec4* tints, unsigned instanceCount )
+{
+    InstanceBuffer& instances = renderer.swapchainResources[ renderer.frameIndex ].instances;
+
+    if (instances.offset + instanceCount > renderer.maxInstancesPerFrame)
+    {
+        teLog( teLogLevel::Warning, "Instance buffer is full, max is %u instances per frame\n", renderer.maxInstancesPerFrame );
+        instanceCount = renderer.maxInstancesPerFrame - instances.offset;
+    }
+
+    for (unsigned i = 0; i < instanceCount; ++i)
+    {
+        Affine3x4::FromMatrix( instanceToWorld[ i ], instances.data[ instances.offset + i ].localToWorld );
+        instances.data[ instances.offset + i ].tint = tints[ i ];
+    }
+
+    StatAdd( teStat::BufferUploadBytes, instanceCount * sizeof( InstanceData ) );
+
+    renderer.pendingInstanceCount = instanceCount;
+}
+
 void MoveToNextUboOffset()
 {
     constexpr size_t offset = sizeof( PerObjectUboStruct );
@@ -2061,9 +2517,14 @@ void teShaderDispatch( const teShader& shader, unsigned groupsX, unsigned groups
     renderer.shaderParams = params;
 
     Matrix identity;
-    UpdateUBO( identity.m, identity.m, identity.m, params, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    Matrix view;
+    view.InitFrom( params.localToView );
+    Affine3x4 localToView;
+    Affine3x4::FromMatrix( view, localToView );
+    UpdateUBO( localToView, identity, Affine3x4(), identity, params, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
 
     BeginRegion( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, debugName, 1, 1, 1 );
+    BeginGpuScope( debugName );
 
     if (params.writeTexture != 0)
     {
@@ -2187,10 +2648,13 @@ void teShaderDispatch( const teShader& shader, unsigned groupsX, unsigned groups
     {
         vkCmdPushConstants( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pushConstants ), &pushConstants );
     }
+
+    StatAdd( teStat::PushConstantBytes, sizeof( pushConstants ) );
     
     vkCmdBindPipeline( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ShaderGetComputePSO( shader ) );
     vkCmdDispatch( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, groupsX, groupsY, groupsZ );
 
+    EndGpuScope();
     EndRegion( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer );
 
     MoveToNextUboOffset();
@@ -2261,7 +2725,7 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned /*uvOffset*
     {
         renderer.boundPSO = pso;
         vkCmdBindPipeline( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
-        ++renderer.statPSOBinds;
+        StatAdd( teStat::PSOBinds, 1 );
     }
 
     VkBufferDeviceAddressInfo posInfo = {};
@@ -2304,6 +2768,10 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned /*uvOffset*
     lightIndexInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
     lightIndexInfo.buffer = BufferGetBuffer( GetLightIndexBuffer() );
 
+    VkBufferDeviceAddressInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    instanceInfo.buffer = BufferGetBuffer( renderer.swapchainResources[ renderer.frameIndex ].instances.buffer );
+
     PushConstants pushConstants{};
     pushConstants.posBuf = vkGetBufferDeviceAddress( renderer.device, &posInfo );
     pushConstants.uvBuf = vkGetBufferDeviceAddress( renderer.device, &uvInfo );
@@ -2320,6 +2788,12 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned /*uvOffset*
     pushConstants.spotLightColorBuf = vkGetBufferDeviceAddress( renderer.device, &spotLightColorInfo );
     pushConstants.spotLightParamBuf = vkGetBufferDeviceAddress( renderer.device, &spotLightParamInfo );
 
+    // Instanced draws use the instances written by UpdateInstances(), others the identity instance in slot 0.
+    InstanceBuffer& instances = renderer.swapchainResources[ renderer.frameIndex ].instances;
+    const unsigned instanceCount = renderer.pendingInstanceCount > 0 ? renderer.pendingInstanceCount : 1;
+    const unsigned firstInstance = renderer.pendingInstanceCount > 0 ? instances.offset : 0;
+    pushConstants.instanceBuf = vkGetBufferDeviceAddress( renderer.device, &instanceInfo ) + firstInstance * sizeof( InstanceData );
+
     VkPipelineShaderStageCreateInfo vertexInfo, fragmentInfo, meshInfo;
     teShaderGetInfo( shader, vertexInfo, fragmentInfo, meshInfo );
 
@@ -2350,14 +2824,25 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned /*uvOffset*
     {
         vkCmdPushConstants( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pushConstants ), &pushConstants );
     }
+
+    StatAdd( teStat::PushConstantBytes, sizeof( pushConstants ) );
     
     if (vertexInfo.module)
     {
-        vkCmdDrawIndexed( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, indexCount * 3, 1, indexOffset / 2, positionOffset / (3 * 4), 0 );
+        vkCmdDrawIndexed( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, indexCount * 3, instanceCount, indexOffset / 2, positionOffset / (3 * 4), 0 );
+        StatAdd( teStat::Triangles, indexCount * instanceCount );
     }
     else if (meshInfo.module)
     {
-        renderer.CmdDrawMeshTasksEXT( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, GetMeshletCount( renderMeshIndex, subMeshIndex ), 1, 1);
+        renderer.CmdDrawMeshTasksEXT( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, GetMeshletCount( renderMeshIndex, subMeshIndex ), instanceCount, 1);
+        StatAdd( teStat::Meshlets, GetMeshletCount( renderMeshIndex, subMeshIndex ) * instanceCount );
+        StatAdd( teStat::Triangles, indexCount * instanceCount );
+    }
+
+    if (renderer.pendingInstanceCount > 0)
+    {
+        instances.offset += renderer.pendingInstanceCount;
+        renderer.pendingInstanceCount = 0;
     }
 
     MoveToNextUboOffset();
@@ -2367,13 +2852,13 @@ void Draw( const teShader& shader, unsigned positionOffset, unsigned /*uvOffset*
         renderer.samplerInfos[ i ].imageView = TextureGetView( renderer.defaultTexture2D );
     }
 
-    ++renderer.statDrawCalls;
+    StatAdd( teStat::DrawCalls, 1 );
 }
 
 void teDrawFullscreenTriangle( teShader& shader, teTexture2D& texture, const ShaderParams& shaderParams, teBlendMode blendMode )
 {
     Matrix identity;
-    UpdateUBO( identity.m, identity.m, identity.m, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
+    UpdateUBO( Affine3x4(), identity, Affine3x4(), identity, shaderParams, Vec4( 0, 0, 0, 1 ), Vec4( 1, 1, 1, 1 ), Vec4( 1, 1, 1, 1 ) );
     Draw( shader, 0, 0, 0, 0, 3, 0, blendMode, teCullMode::Off, teDepthMode::NoneWriteOff, teTopology::Triangles, teFillMode::Solid, texture.index, teTextureSampler::NearestRepeat, 0, 0, 0, 0 );
 }
 
@@ -2431,7 +2916,7 @@ void teUIDrawCall( const teShader& shader, const teTexture2D& fontTex, int displ
     {
         renderer.boundPSO = pso;
         vkCmdBindPipeline( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
-        ++renderer.statPSOBinds;
+        StatAdd( teStat::PSOBinds, 1 );
     }
 
     float displayPosX = 0; // TODO: Get from the application drawData
@@ -2457,12 +2942,15 @@ void teUIDrawCall( const teShader& shader, const teTexture2D& fontTex, int displ
     {
         vkCmdPushConstants( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pushConstants ), &pushConstants );
     }
+
+    StatAdd( teStat::PushConstantBytes, sizeof( pushConstants ) );
     
     vkCmdDrawIndexed( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, elementCount, 1, indexOffset, vertexOffset, 0 );
+    StatAdd( teStat::Triangles, elementCount / 3 );
 
     PopGroupMarker();
 
-    ++renderer.statDrawCalls;
+    StatAdd( teStat::DrawCalls, 1 );
 }
 
 void DrawLines()
@@ -2486,16 +2974,21 @@ void DrawLines()
     {
         renderer.boundPSO = pso;
         vkCmdBindPipeline( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pso );
-        ++renderer.statPSOBinds;
+        StatAdd( teStat::PSOBinds, 1 );
     }
 
     VkBufferDeviceAddressInfo vertexInfo = {};
     vertexInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
     vertexInfo.buffer = BufferGetBuffer( renderer.lineVertexBuffer );
 
+    VkBufferDeviceAddressInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    instanceInfo.buffer = BufferGetBuffer( renderer.swapchainResources[ renderer.frameIndex ].instances.buffer );
+
     PushConstants pushConstants{};
     pushConstants.posBuf = vkGetBufferDeviceAddress( renderer.device, &vertexInfo );
     pushConstants.uvBuf = vkGetBufferDeviceAddress( renderer.device, &vertexInfo ); // NOTE: dummy uv, line drawing doesn't use UVs.
+    pushConstants.instanceBuf = vkGetBufferDeviceAddress( renderer.device, &instanceInfo );
 
     if (renderer.meshShaderSupported)
     {
@@ -2506,22 +2999,15 @@ void DrawLines()
         vkCmdPushConstants( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( pushConstants ), &pushConstants );
     }
 
+    StatAdd( teStat::PushConstantBytes, sizeof( pushConstants ) );
+
     vkCmdDraw( renderer.swapchainResources[ renderer.frameIndex ].drawCommandBuffer, renderer.lineCount, 1, 0, 0 );
 
     MoveToNextUboOffset();
 
     PopGroupMarker();
 
-    ++renderer.statDrawCalls;
-}
-
-float teRendererGetStat( teStat stat )
-{
-    if (stat == teStat::DrawCalls) return (float)renderer.statDrawCalls;
-    if (stat == teStat::PSOBinds) return (float)renderer.statPSOBinds;
-    
-
-    return 0;
+    StatAdd( teStat::DrawCalls, 1 );
 }
 
 void teRendererUpdateLineBuffer( const teShader& shader, const struct Vec3* lines, unsigned count )
@@ -6,6 +6,7 @@
 void SetObjectName( VkDevice device, uint64_t object, VkObjectType objectType, const char* name );
 void RegisterFileForModifications( const teFile& file, void(*updateFunc)(const char*) );
 void ClearPSOCache();
+void EngineEnsureInitialized();
 VkPipelineLayout GetPipelineLayout();
 
 struct teShaderImpl
@@ -22,8 +23,8 @@ struct teShaderImpl
     VkPipeline computePso = {};
 };
 
-constexpr unsigned MaxShaders = 40;
-teShaderImpl shaders[ MaxShaders ];
+teShaderImpl* shaders = nullptr;
+unsigned shaderCapacity = 0;
 unsigned nextShaderIndex = 1;
 
 struct ShaderCacheEntry
@@ -38,7 +39,14 @@ struct ShaderCacheEntry
     inline static VkDevice device;
 };
 
-ShaderCacheEntry shaderCacheEntries[ MaxShaders ];
+ShaderCacheEntry* shaderCacheEntries = nullptr;
+
+void ShaderInitStorage( unsigned maxShaders )
+{
+    shaders = teMallocArray< teShaderImpl >( maxShaders, teMemoryTag::Renderer );
+    shaderCacheEntries = teMallocArray< ShaderCacheEntry >( maxShaders, teMemoryTag::Renderer );
+    shaderCapacity = maxShaders;
+}
 
 void teShaderGetInfo( const teShader& shader, VkPipelineShaderStageCreateInfo& outVertexInfo, VkPipelineShaderStageCreateInfo& outFragmentInfo, VkPipelineShaderStageCreateInfo& outMeshInfo )
 {
@@ -56,7 +64,7 @@ VkPipeline ShaderGetComputePSO( const teShader& shader )
 
 void ReloadShader( const char* path )
 {
-    for (unsigned i = 0; i < MaxShaders; ++i)
+    for (unsigned i = 0; i < shaderCapacity; ++i)
     {
         if (!teStrcmp( shaderCacheEntries[ i ].vertexPath, path ) || !teStrcmp( shaderCacheEntries[ i ].fragmentPath, path ))
         {
@@ -126,7 +134,8 @@ void ReloadShader( const char* path )
 
 teShader teCreateShader( VkDevice device, const struct teFile& vertexFile, const struct teFile& fragmentFile, const char* vertexName, const char* fragmentName )
 {
-    teAssert( nextShaderIndex < MaxShaders );
+    EngineEnsureInitialized();
+    teAssert( nextShaderIndex < shaderCapacity );
 
     ShaderCacheEntry::device = device;
 
@@ -166,7 +175,7 @@ teShader teCreateShader( VkDevice device, const struct teFile& vertexFile, const
     RegisterFileForModifications( vertexFile, ReloadShader );
     RegisterFileForModifications( fragmentFile, ReloadShader );
 
-    for (unsigned i = 0; i < MaxShaders; ++i)
+    for (unsigned i = 0; i < shaderCapacity; ++i)
     {
         if (shaderCacheEntries[ i ].shaderIndex == 0)
         {
@@ -184,7 +193,8 @@ teShader teCreateShader( VkDevice device, const struct teFile& vertexFile, const
 
 teShader teCreateMeshShader( VkDevice device, const teFile& meshShaderFile, const teFile& fragmentShaderFile, const char* meshShaderName, const char* fragmentShaderName )
 {
-    teAssert( nextShaderIndex < MaxShaders );
+    EngineEnsureInitialized();
+    teAssert( nextShaderIndex < shaderCapacity );
 
     ShaderCacheEntry::device = device;
 
@@ -226,7 +236,8 @@ teShader teCreateMeshShader( VkDevice device, const teFile& meshShaderFile, cons
 
 teShader teCreateComputeShader( VkDevice device, VkPipelineLayout pipelineLayout, const teFile& file, const char* name, unsigned /*threadsPerThreadgroupX*/, unsigned /*threadsPerThreadgroupY*/ )
 {
-    teAssert( nextShaderIndex < MaxShaders );
+    EngineEnsureInitialized();
+    teAssert( nextShaderIndex < shaderCapacity );
 
     ShaderCacheEntry::device = device;
 
@@ -263,7 +274,7 @@ teShader teCreateComputeShader( VkDevice device, VkPipelineLayout pipelineLayout
 
     RegisterFileForModifications( file, ReloadShader );
 
-    for (unsigned i = 0; i < MaxShaders; ++i)
+    for (unsigned i = 0; i < shaderCapacity; ++i)
     {
         if (shaderCacheEntries[ i ].shaderIndex == 0)
         {
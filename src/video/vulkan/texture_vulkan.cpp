@@ -1,16 +1,18 @@
 #include "texture.h"
 #include "file.h"
+#include "material.h"
+#include "renderer.h"
 #include "te_stdlib.h"
+#include "textureloader.h"
 #include <vulkan/vulkan.h>
 
 void SetObjectName( VkDevice device, uint64_t object, VkObjectType objectType, const char* name );
 uint32_t GetMemoryType( uint32_t typeBits, const VkPhysicalDeviceMemoryProperties& deviceMemoryProperties, VkFlags properties );
-bool LoadTGA( const teFile& file, unsigned& outWidth, unsigned& outHeight, unsigned& outDataBeginOffset, unsigned& outBitsPerPixel );
-bool LoadDDS( const teFile& fileContents, unsigned& outWidth, unsigned& outHeight, teTextureFormat& outFormat, unsigned& outMipLevelCount, unsigned( &outMipOffsets )[ 15 ] );
 void UpdateStagingTexture( const uint8_t* src, unsigned width, unsigned height, VkFormat format, unsigned index );
 void SetImageLayout( VkCommandBuffer cmdbuffer, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout,
     VkImageLayout newImageLayout, unsigned layerCount, unsigned mipLevel, unsigned mipLevelCount, VkPipelineStageFlags srcStageFlags );
 teTextureCube GetDefaultTextureCube();
+void StatAdd( teStat stat, unsigned amount );
 
 struct teTextureImpl
 {
@@ -24,6 +26,7 @@ struct teTextureImpl
 };
 
 teTextureImpl textures[ TextureCount ];
+TE_TRACK_STATIC_MEMORY( texturesMemory, teMemoryTag::Texture, sizeof( textures ) );
 unsigned textureCount = 0;
 
 static inline unsigned Max2( unsigned x, unsigned y ) noexcept
@@ -390,8 +393,10 @@ static void CreateBaseMip( teTextureImpl& tex, VkDevice device, VkPhysicalDevice
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmdBuffer;
     VK_CHECK( vkQueueSubmit( graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
 
     vkDeviceWaitIdle( device );
+    StatAdd( teStat::QueueWaits, 1 );
 }
 
 static void CreateMipLevels( teTextureImpl& tex, unsigned mipLevelCount, VkDevice device, VkQueue graphicsQueue, VkCommandBuffer cmdBuffer )
@@ -432,8 +437,10 @@ static void CreateMipLevels( teTextureImpl& tex, unsigned mipLevelCount, VkDevic
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmdBuffer;
     VK_CHECK( vkQueueSubmit( graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
 
     vkDeviceWaitIdle( device );
+    StatAdd( teStat::QueueWaits, 1 );
 
     VK_CHECK( vkBeginCommandBuffer( cmdBuffer, &cmdBufInfo ) );
 
@@ -457,8 +464,10 @@ static void CreateMipLevels( teTextureImpl& tex, unsigned mipLevelCount, VkDevic
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmdBuffer;
     VK_CHECK( vkQueueSubmit( graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
 
     vkDeviceWaitIdle( device );
+    StatAdd( teStat::QueueWaits, 1 );
 }
 
 static void CopyMipmapsFromDDS( teTextureImpl& tex, VkFormat format, unsigned faceCount, const teFile* files, unsigned mipOffsets[ 6 ][ 15 ], VkDevice device, VkCommandBuffer cmdBuffer, const VkPhysicalDeviceMemoryProperties& deviceMemoryProperties )
@@ -500,6 +509,7 @@ static void CopyMipmapsFromDDS( teTextureImpl& tex, VkFormat format, unsigned fa
             memAllocInfo.allocationSize = memReqs.size;
             memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, deviceMemoryProperties, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
             VK_CHECK( vkAllocateMemory( device, &memAllocInfo, nullptr, &stagingMemory[ mipLevel ] ) );
+            teMemoryTrackAllocation( teMemoryTag::Texture, memReqs.size );
 
             VK_CHECK( vkBindBufferMemory( device, stagingBuffers[ mipLevel ], stagingMemory[ mipLevel ], 0 ) );
 
@@ -514,6 +524,7 @@ static void CopyMipmapsFromDDS( teTextureImpl& tex, VkFormat format, unsigned fa
             }
 
             teMemcpy( stagingData, &files[ face ].data[ mipOffsets[ face ][ mipLevel ] ], amountToCopy );
+            StatAdd( teStat::TextureUploadBytes, (unsigned)amountToCopy );
 
             VkMappedMemoryRange flushRange = {};
             flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
@@ -540,7 +551,7 @@ static void CopyMipmapsFromDDS( teTextureImpl& tex, VkFormat format, unsigned fa
 }
 
 teTexture2D teLoadTexture( const struct teFile& file, unsigned flags, VkDevice device, VkBuffer stagingBuffer, const VkPhysicalDeviceMemoryProperties& deviceMemoryProperties, VkQueue graphicsQueue, VkCommandBuffer cmdBuffer, const VkPhysicalDeviceProperties& properties,
-                           void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat )
+                           void* pixels, int pixelsWidth, int pixelsHeight, teTextureFormat pixelsFormat, const DDSData* parsedDDS )
 {
     teAssert( !(flags & teTextureFlags::UAV) );
 
@@ -600,23 +611,31 @@ teTexture2D teLoadTexture( const struct teFile& file, unsigned flags, VkDevice d
         CreateBaseMip( tex, device, deviceMemoryProperties, graphicsQueue, &stagingBuffer, 1, format, tex.mipLevelCount, file.path, cmdBuffer );
         CreateMipLevels( tex, tex.mipLevelCount, device, graphicsQueue, cmdBuffer );
     }
-    else if (teStrstr( file.path, ".dds" ) || teStrstr( file.path, ".DDS" ))
+    else if (parsedDDS || teStrstr( file.path, ".dds" ) || teStrstr( file.path, ".DDS" ))
     {
-        teTextureFormat bcFormat = teTextureFormat::Invalid;
-        unsigned mipOffsets[ 15 ] = {};
+        DDSData dds;
         unsigned mipOffsets2[ 6 ][ 15 ] = {};
-        bool loadRes = LoadDDS( file, tex.width, tex.height, bcFormat, tex.mipLevelCount, mipOffsets );
-        
-        if (!loadRes)
+
+        // Streamed textures were parsed by a worker.
+        if (parsedDDS)
+        {
+            dds = *parsedDDS;
+        }
+        else if (!LoadDDS( file, dds ))
         {
             outTexture.index = 1;
             --textureCount;
             return outTexture;
         }
 
+        tex.width = dds.width;
+        tex.height = dds.height;
+        tex.mipLevelCount = dds.mipLevelCount;
+        teTextureFormat bcFormat = dds.format;
+
         for (unsigned i = 0; i < 15; ++i)
         {
-            mipOffsets2[ 0 ][ i ] = mipOffsets[ i ];
+            mipOffsets2[ 0 ][ i ] = dds.mipOffsets[ i ];
         }
 
         if (!(flags & teTextureFlags::GenerateMips))
@@ -669,8 +688,10 @@ teTexture2D teLoadTexture( const struct teFile& file, unsigned flags, VkDevice d
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &cmdBuffer;
         VK_CHECK( vkQueueSubmit( graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+        StatAdd( teStat::QueueSubmits, 1 );
 
         vkDeviceWaitIdle( device );
+        StatAdd( teStat::QueueWaits, 1 );
 
         VK_CHECK( vkBeginCommandBuffer( cmdBuffer, &cmdBufInfo ) );
 
@@ -679,8 +700,10 @@ teTexture2D teLoadTexture( const struct teFile& file, unsigned flags, VkDevice d
 
         vkEndCommandBuffer( cmdBuffer );
         VK_CHECK( vkQueueSubmit( graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+        StatAdd( teStat::QueueSubmits, 1 );
 
         vkDeviceWaitIdle( device );
+        StatAdd( teStat::QueueWaits, 1 );
     }
     else
     {
@@ -823,8 +846,10 @@ teTextureCube teLoadTexture( const teFile& negX, const teFile& posX, const teFil
     submitInfo.pCommandBuffers = &cmdBuffer;
 
     VK_CHECK( vkQueueSubmit( graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+    StatAdd( teStat::QueueSubmits, 1 );
 
     vkDeviceWaitIdle( device );
+    StatAdd( teStat::QueueWaits, 1 );
 
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;